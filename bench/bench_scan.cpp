@@ -0,0 +1,169 @@
+// Microbenchmark for the ByteScan kernels: every kernel the CPU has is timed on the
+// scans the server runs (header block parsing, chunked body decoding, multipart
+// boundaries) and checked against std::string::find on the same input, as is the
+// Horspool search for upload delimiters.
+//
+//   make bench
+
+#include "../include/ByteScan.hpp"
+#include "../include/RequestParser.hpp"
+#include "../include/ChunkedDecoder.hpp"
+#include "../include/BufferChain.hpp"
+#include "../include/BufferPool.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <sys/time.h>
+
+namespace {
+    const size_t BODY_SIZE = 8 * 1024 * 1024;
+
+    double now() {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1e6;
+    }
+
+    void report(const std::string& label, size_t bytes, size_t rounds, double seconds) {
+        std::cout << "  " << std::left << std::setw(12) << label << std::right << std::setw(10)
+                  << std::fixed << std::setprecision(0) << (bytes * rounds / seconds / 1e6) << " MB/s" << std::endl;
+    }
+
+    // Binary upload data: every byte value, CR and '-' included, turns up.
+    std::string randomBytes(size_t size) {
+        std::string data(size, 'x');
+        for (size_t i = 0; i < size; ++i)
+            data[i] = static_cast<char>(std::rand() & 0xff);
+        return data;
+    }
+
+    std::string headerBlock() {
+        std::ostringstream block;
+        block << "GET /index.html?lang=en HTTP/1.1\r\nHost: localhost\r\n";
+        for (int i = 0; i < 40; ++i)
+            block << "X-Header-" << i << ": " << std::string(200, static_cast<char>('a' + i % 26)) << "\r\n";
+        block << "Cookie: " << std::string(2000, 'c') << "\r\n\r\n";
+        return block.str();
+    }
+
+    std::string chunkedBody(const std::string& data, size_t chunkSize, const std::string& extension,
+                            const std::string& trailers) {
+        std::ostringstream body;
+        for (size_t pos = 0; pos < data.size(); pos += chunkSize) {
+            size_t length = (data.size() - pos < chunkSize) ? data.size() - pos : chunkSize;
+            body << std::hex << length << extension << "\r\n" << data.substr(pos, length) << "\r\n";
+        }
+        body << "0\r\n" << trailers << "\r\n";
+        return body.str();
+    }
+
+    bool check(bool ok, const std::string& what) {
+        if (!ok)
+            std::cout << "  MISMATCH: " << what << std::endl;
+        return ok;
+    }
+}
+
+int main() {
+    std::srand(42);
+    bool ok = true;
+
+    std::string headers = headerBlock();
+    std::string payload = randomBytes(BODY_SIZE);
+    std::string boundary = "\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW";
+    std::string multipart = payload + boundary + "--\r\n";
+    std::string extension = ";name=\"" + std::string(120, 'e') + "\"";
+    std::string trailers = "X-Checksum: " + std::string(2000, 'f') + "\r\n";
+    std::string chunked = chunkedBody(payload, 1024, extension, trailers);
+
+    std::vector<ByteScan::Kernel> kernels;
+    for (int k = ByteScan::SCALAR; k <= ByteScan::best(); ++k)
+        kernels.push_back(static_cast<ByteScan::Kernel>(k));
+
+    BufferPool pool;
+    BufferChain chain(pool);
+    chain.append(headers);
+
+    std::cout << "Header block (" << headers.size() << " bytes) through RequestParser" << std::endl;
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        ByteScan::use(kernels[k]);
+        const size_t rounds = 5000;
+        double start = now();
+        for (size_t r = 0; r < rounds; ++r) {
+            RequestParser parser;
+            ok &= check(parser.parse(chain) == RequestParser::COMPLETE
+                        && parser.request().headers.size() == 42, "header block");
+        }
+        report(ByteScan::name(kernels[k]), headers.size(), rounds, now() - start);
+    }
+
+    std::cout << "Multipart boundary after " << BODY_SIZE << " bytes" << std::endl;
+    size_t expected = multipart.find(boundary);
+    {
+        const size_t rounds = 20;
+        double start = now();
+        for (size_t r = 0; r < rounds; ++r)
+            ok &= check(multipart.find(boundary) == expected, "std::string::find");
+        report("std::string", multipart.size(), rounds, now() - start);
+    }
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        ByteScan::use(kernels[k]);
+        const size_t rounds = 20;
+        double start = now();
+        for (size_t r = 0; r < rounds; ++r)
+            ok &= check(ByteScan::find(multipart, boundary) == expected, "boundary");
+        report(ByteScan::name(kernels[k]), multipart.size(), rounds, now() - start);
+    }
+    {
+        ByteScan::use(ByteScan::SCALAR);
+        ByteScan::Horspool search(boundary);
+        const size_t rounds = 20;
+        double start = now();
+        for (size_t r = 0; r < rounds; ++r)
+            ok &= check(search.find(multipart.data(), multipart.size()) == expected, "horspool");
+        report("horspool", multipart.size(), rounds, now() - start);
+    }
+
+    std::cout << "Chunked body, 1024-byte chunks with extensions, through ChunkedDecoder" << std::endl;
+    BufferChain input(pool);
+    input.append(chunked);
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        ByteScan::use(kernels[k]);
+        const size_t rounds = 20;
+        double start = now();
+        for (size_t r = 0; r < rounds; ++r) {
+            BufferChain output(pool);
+            ChunkedDecoder decoder;
+            ok &= check(decoder.decode(input, 0, output) == chunked.size()
+                        && decoder.status() == ChunkedDecoder::COMPLETE && output.size() == BODY_SIZE
+                        && decoder.trailers().size() == 1, "chunked body");
+        }
+        report(ByteScan::name(kernels[k]), chunked.size(), rounds, now() - start);
+    }
+
+    std::cout << "Random needles against std::string::find" << std::endl;
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        ByteScan::use(kernels[k]);
+        ByteScan::Horspool search;
+        for (int i = 0; i < 20000; ++i) {
+            std::string hay(std::rand() % 200, 'a');
+            for (size_t j = 0; j < hay.size(); ++j)
+                hay[j] = "ab\r\n-"[std::rand() % 5];
+            std::string needle = hay.substr(std::rand() % (hay.size() + 1), 1 + std::rand() % 6);
+            if (std::rand() % 4 == 0)
+                needle = "\r\n-";
+            size_t from = std::rand() % (hay.size() + 2);
+            ok &= check(ByteScan::find(hay, needle, from) == hay.find(needle, from), "find");
+            search.assign(needle);
+            ok &= check(search.find(hay.data(), hay.size()) == hay.find(needle), "horspool");
+            size_t stop = hay.find_first_of("\r\n-");
+            ok &= check(ByteScan::firstOf(hay.data(), hay.size(), '\r', '\n', '-')
+                        == (stop == std::string::npos ? hay.size() : stop), "firstOf");
+        }
+        std::cout << "  " << ByteScan::name(kernels[k]) << (ok ? " ok" : " FAILED") << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// CGI spawn latency against the size of the parent: /bin/true is started through each
+// cgi_launcher mode while the process holds more and more touched memory, the way a
+// worker does once its buffers and caches have filled. "launch" is the time spent in
+// CgiLauncher::launch(), which the event loop waits for; "exit" runs until the child's
+// stdout reports EOF.
+//
+//   make bench_spawn              # 0, 256 and 1024 MB
+//   ./bench/bench_spawn 0 2048    # sizes in MB
+
+#include "../include/CgiLauncher.hpp"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+namespace {
+    const size_t ROUNDS = 200;
+
+    double now() {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1e6;
+    }
+
+    long rssMb() {
+        long pages = 0, resident = 0;
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (statm) {
+            if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+                resident = 0;
+            std::fclose(statm);
+        }
+        return resident * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+    }
+
+    bool runOnce(CgiLauncher& launcher, const CgiCommand& command, double& launchTime) {
+        int input[2], output[2];
+        if (pipe2(input, O_CLOEXEC) < 0)
+            return false;
+        if (pipe2(output, O_CLOEXEC) < 0) {
+            close(input[0]);
+            close(input[1]);
+            return false;
+        }
+
+        double start = now();
+        pid_t pid = launcher.launch(command, input[0], output[1]);
+        launchTime += now() - start;
+        close(input[0]);
+        close(output[1]);
+        close(input[1]);
+
+        char buf[256];
+        while (read(output[0], buf, sizeof(buf)) > 0) {}
+        close(output[0]);
+        if (pid > 0)
+            launcher.reap(pid);
+        return pid > 0;
+    }
+
+    void measure(CgiLauncher& launcher, const CgiCommand& command, long sizeMb) {
+        double launchTime = 0;
+        double start = now();
+        for (size_t i = 0; i < ROUNDS; ++i) {
+            if (!runOnce(launcher, command, launchTime)) {
+                std::cerr << "launch failed" << std::endl;
+                return;
+            }
+        }
+        double total = now() - start;
+        std::cout << "  " << std::setw(6) << sizeMb << " MB  " << std::left << std::setw(8)
+                  << CgiLauncher::modeName(launcher.getMode()) << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(8) << launchTime / ROUNDS * 1e6 << " us launch"
+                  << std::setw(8) << total / ROUNDS * 1e6 << " us exit" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<long> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::atol(argv[i]));
+    if (sizes.empty()) {
+        sizes.push_back(0);
+        sizes.push_back(256);
+        sizes.push_back(1024);
+    }
+
+    CgiCommand command;
+    command.argv.push_back("/bin/true");
+    command.env.push_back("PATH=/usr/bin:/bin");
+    command.directory = "/";
+
+    // The zygote is started while the process is small, as a worker starts it.
+    CgiLauncher forked, spawned, zygote;
+    forked.start(CgiLauncher::FORK);
+    spawned.start(CgiLauncher::SPAWN);
+    if (!zygote.start(CgiLauncher::ZYGOTE))
+        return 1;
+
+    std::vector<char*> blocks;
+    long held = 0;
+    std::cout << "CGI spawn latency (" << ROUNDS << " launches of /bin/true each):" << std::endl;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        for (; held < sizes[i]; ++held) {
+            char* block = new char[1024 * 1024];
+            std::memset(block, 1, 1024 * 1024);
+            blocks.push_back(block);
+        }
+        std::cout << "  parent RSS " << rssMb() << " MB" << std::endl;
+        measure(forked, command, held);
+        measure(spawned, command, held);
+        measure(zygote, command, held);
+    }
+
+    for (size_t i = 0; i < blocks.size(); ++i)
+        delete[] blocks[i];
+    return 0;
+}
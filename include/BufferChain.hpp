@@ -0,0 +1,87 @@
+#ifndef BUFFERCHAIN_HPP
+#define BUFFERCHAIN_HPP
+
+#include <string>
+#include <deque>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "BufferPool.hpp"
+
+// Immutable bytes shared by reference between any number of chains (and a cache).
+// Reference counting is not atomic: a buffer never leaves the worker that made it.
+class SharedBuffer {
+private:
+    std::string bytes;
+    size_t refs;
+
+    ~SharedBuffer() {}
+    SharedBuffer(const SharedBuffer&);
+    SharedBuffer& operator=(const SharedBuffer&);
+
+public:
+    explicit SharedBuffer(const std::string& data) : bytes(data), refs(1) {}
+
+    const char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    void retain() { ++refs; }
+    void release() { if (--refs == 0) delete this; }
+};
+
+// Byte queue made of pooled fixed-size blocks. Appending never moves bytes already
+// stored, consuming from the front hands whole blocks back to the pool, and the
+// fd helpers fill/drain the chain with a single readv()/sendmsg() call.
+class BufferChain {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+    static const int MAX_IOV = 64;
+
+private:
+    struct Segment {
+        char* block;
+        size_t start;
+        size_t end;
+        SharedBuffer* shared;  // block belongs to this buffer instead of the pool
+    };
+
+    BufferPool* pool;
+    std::deque<Segment> segments;
+    size_t length;
+
+    void releaseSegment(const Segment& seg);
+    bool tailWritable() const;
+    void locate(size_t pos, size_t& segIndex, size_t& offset) const;
+    bool matchesAt(size_t segIndex, size_t offset, const std::string& needle) const;
+    int fillIov(struct iovec* iov, size_t& attempted) const;
+
+    BufferChain(const BufferChain&);
+    BufferChain& operator=(const BufferChain&);
+
+public:
+    explicit BufferChain(BufferPool& bufferPool);
+    ~BufferChain();
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    void append(const char* data, size_t count);
+    void append(const std::string& data);
+    void assign(const std::string& data);
+    void appendShared(SharedBuffer* buffer);
+    void appendShared(SharedBuffer* buffer, size_t offset, size_t count);
+    void splice(BufferChain& other);
+    void consume(size_t count);
+    void moveTail(size_t pos, BufferChain& dest);
+    void erase(size_t pos, size_t count);
+
+    size_t find(const std::string& needle, size_t from = 0) const;
+    char at(size_t pos) const;
+    size_t contiguous(size_t pos, const char*& data) const;
+    std::string substr(size_t pos, size_t count = npos) const;
+
+    ssize_t readFrom(int fd, size_t maxBytes, off_t offset = -1);
+    ssize_t sendTo(int socketFd, size_t& attempted, int flags = 0);
+    ssize_t writeTo(int fd, size_t& attempted);
+};
+
+#endif
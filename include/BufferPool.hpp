@@ -0,0 +1,41 @@
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <vector>
+#include <map>
+#include <set>
+#include <cstddef>
+
+// Per-worker slab allocator for fixed-size I/O blocks. Blocks are handed out from the
+// lowest-addressed slab that has one free, so load drains back out of the newest slabs;
+// a slab whose blocks are all free again is returned to the system once more than
+// MAX_IDLE_SLABS are idle, so a burst does not pin its peak for the life of the worker.
+class BufferPool {
+public:
+    static const size_t BLOCK_SIZE = 16384;
+    static const size_t BLOCKS_PER_SLAB = 64;
+    static const size_t MAX_IDLE_SLABS = 4;
+
+private:
+    std::map<char*, std::vector<char*> > slabs;   // base address -> its free blocks
+    std::set<char*> available;                     // slabs with a free block
+    size_t idleSlabs;
+    size_t inUse;
+
+    void addSlab();
+
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+public:
+    BufferPool();
+    ~BufferPool();
+
+    char* acquire();
+    void release(char* block);
+
+    size_t blocksInUse() const;
+    size_t slabCount() const;
+};
+
+#endif
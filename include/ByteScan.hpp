@@ -0,0 +1,47 @@
+#ifndef BYTESCAN_HPP
+#define BYTESCAN_HPP
+
+#include <string>
+#include <cstddef>
+
+// Delimiter search over raw bytes for the parser, the chunk decoder and the multipart
+// splitter. The SSE2 or AVX2 kernel is picked once from what the CPU reports; other
+// machines get the scalar loops.
+namespace ByteScan {
+    enum Kernel {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+    Kernel best();
+    Kernel active();
+    void use(Kernel kernel);
+    const char* name(Kernel kernel);
+
+    size_t firstOf(const char* data, size_t size, char a, char b, char c);
+    size_t find(const char* data, size_t size, const char* needle, size_t needleSize);
+    size_t find(const std::string& haystack, const std::string& needle, size_t from = 0);
+
+    // Boyer-Moore-Horspool search for one needle over many buffers, such as a multipart
+    // delimiter over a streamed body: the shift table is built once per needle, and a
+    // long needle skips most of the input without looking at it. Used on machines left
+    // with the scalar kernel.
+    class Horspool {
+    private:
+        std::string pattern;
+        size_t shift[256];
+
+    public:
+        Horspool();
+        explicit Horspool(const std::string& needle);
+
+        void assign(const std::string& needle);
+        const std::string& needle() const;
+        size_t find(const char* data, size_t size) const;
+    };
+}
+
+#endif
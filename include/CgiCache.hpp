@@ -0,0 +1,59 @@
+#ifndef CGICACHE_HPP
+#define CGICACHE_HPP
+
+#include <string>
+#include <map>
+#include "BufferChain.hpp"
+#include "Compression.hpp"
+#include "CgiHandler.hpp"
+#include "LruCache.hpp"
+
+struct CgiCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t expired;
+    size_t evictions;
+
+    CgiCacheStats() : hits(0), misses(0), expired(0), evictions(0) {}
+};
+
+// Byte-budgeted LRU of CGI responses (cgi_cache), keyed by the expanded cgi_cache_key.
+// A response is its header block as the script sent it and its identity body; gzip and
+// deflate variants are added the first time a client asks for them. An entry past its
+// expiry is dropped by the lookup that finds it. One instance per location per worker.
+class CgiCache {
+public:
+    struct Response {
+        CgiHeaders headers;
+        SharedBuffer* body;
+        unsigned long storedAtMs;
+        unsigned long expiresAtMs;
+    };
+
+private:
+    struct Entry {
+        Response response;
+        std::map<Compression::Coding, SharedBuffer*> variants;
+
+        void release();
+    };
+
+    LruCache<Entry> entries;
+    size_t expiredCount;
+
+    CgiCache(const CgiCache&);
+    CgiCache& operator=(const CgiCache&);
+
+public:
+    explicit CgiCache(size_t capacityBytes);
+
+    const Response* lookup(const std::string& key, unsigned long nowMs, bool& expired);
+    void insert(const std::string& key, const CgiHeaders& headers, SharedBuffer* body,
+                unsigned long nowMs, unsigned long expiresAtMs);
+    SharedBuffer* findVariant(const std::string& key, Compression::Coding coding);
+    void addVariant(const std::string& key, Compression::Coding coding, SharedBuffer* body);
+
+    CgiCacheStats getStats() const;
+};
+
+#endif
@@ -13,66 +13,101 @@
 #include <fcntl.h>
 
 #include "Config.hpp"
+#include "CgiLauncher.hpp"
 #include "ClientConnection.hpp"
+#include "OpenFileCache.hpp"
+#include "RequestParser.hpp"
+#include "Compression.hpp"
+
+class CgiCache;
+struct CgiCacheStats;
+
+// What a script's header block says about its response.
+struct CgiHeaders {
+    int statusCode;
+    std::string statusText;
+    std::string contentType;
+    std::string location;
+    std::string contentLength;   // as the script sent it, "" if it did not
+    std::string additional;      // every other header line, CRLF-terminated
+    
+    CgiHeaders() : statusCode(200), statusText("OK"), contentType("text/html") {}
+};
 
 class CgiHandler {
 private:
+    static const size_t READ_CHUNK = 64 * 1024;  // default pipe capacity
+    
     Config& config;
+    OpenFileCache& openFiles;
+    CgiLauncher& launcher;
+    std::map<const LocationConfig*, CgiCache*> caches;   // cgi_cache, made on first use
+    
+    CgiHandler(const CgiHandler&);
+    CgiHandler& operator=(const CgiHandler&);
     
     std::string getCgiExtension(const std::string& path, const LocationConfig* location);
     std::string findInterpreter(const std::string& extension, const LocationConfig* location);
     
-    char** buildEnvironment(ClientConnection* client, const std::string& scriptPath,
-                           const std::string& pathInfo, const std::string& queryString,
-                           const std::string& method, const std::string& headers,
-                           size_t contentLength);
-    void freeEnvironment(char** env);
+    std::vector<std::string> buildEnvVars(ClientConnection* client, const std::string& scriptPath,
+                                          const std::string& pathInfo, const std::string& queryString,
+                                          const ParsedRequest& request, size_t contentLength);
     void addServerEnvVars(std::vector<std::string>& envVars, const ServerConfig& serverConfig);
     void addRequestEnvVars(std::vector<std::string>& envVars, ClientConnection* client,
-                           const std::string& method, const std::string& absScriptPath,
+                           const ParsedRequest& request, const std::string& absScriptPath,
                            const std::string& pathInfo, const std::string& queryString,
-                           const std::string& headers, size_t contentLength);
+                           size_t contentLength);
     
-    std::string getHeaderValue(const std::string& headers, const std::string& headerName);
     std::string convertHeaderToEnvName(const std::string& headerName);
-    std::vector<std::string> buildHttpHeaderVars(const std::string& headers);
+    std::vector<std::string> buildHttpHeaderVars(const ParsedRequest& request,
+                                                 const std::vector<RequestHeader>& trailers);
     
     std::string extractPathInfo(const std::string& path, const std::string& scriptPath);
     std::string getScriptDirectory(const std::string& scriptPath);
-    void splitPathAndQuery(const std::string& fullPath, std::string& path, std::string& query);
+    std::string getScriptBaseName(const std::string& scriptPath);
     
     bool createPipes(int inputPipe[2], int outputPipe[2]);
-    void setupChildProcess(int inputPipe[2], int outputPipe[2], const std::string& scriptFilePath);
-    void setupParentProcess(ClientConnection* client, int inputPipe[2], int outputPipe[2],
-                           pid_t pid, const std::string& body);
+    void setupParentProcess(ClientConnection* client, int inputPipe[2], int outputPipe[2], pid_t pid);
     bool isStandaloneCgi(const std::string& interpreter);
-    void executeChild(const std::string& interpreter, const std::string& scriptFilePath, char** env);
     bool validateCgiSetup(const std::string& path, const LocationConfig* location,
                          const std::string& scriptFilePath, std::string& interpreter);
     void setScriptName(ClientConnection* client, const std::string& cleanPath);
     
-    void parseCgiHeader(const std::string& line, int& statusCode, std::string& statusText,
-                       std::string& contentType, std::string& location, std::string& additionalHeaders);
+    void parseCgiHeader(const std::string& line, CgiHeaders& headers);
+    bool takeHeaders(BufferChain& output, CgiHeaders& headers);
+    std::string responseHead(const CgiHeaders& headers);
+    Compression::Coding chooseCoding(const LocationConfig* location, const std::string& acceptEncoding,
+                                     CgiHeaders& headers, size_t size);
+    
+    CgiCache* cacheFor(const LocationConfig* location);
+    std::string cacheKey(const ParsedRequest& request, const LocationConfig* location);
+    int cacheLifetime(const CgiHeaders& headers, const LocationConfig* location);
+    void sendStored(ClientConnection* client, const LocationConfig* location, const std::string& acceptEncoding,
+                    CgiCache* cache, const std::string& key, CgiHeaders headers, SharedBuffer* body);
     
 public:
-    CgiHandler(Config& cfg);
+    CgiHandler(Config& cfg, OpenFileCache& files, CgiLauncher& processLauncher);
     ~CgiHandler();
     
-    static const int DEFAULT_CGI_TIMEOUT = 30;
-    
     bool isCgiRequest(const std::string& path, const LocationConfig* location);
-    bool startCgi(ClientConnection* client, const std::string& method,
-                  const std::string& path, const std::string& headers,
-                  const std::string& body, const LocationConfig* location,
+    bool serveCached(ClientConnection* client, const ParsedRequest& request, const LocationConfig* location);
+    bool getCacheStats(CgiCacheStats& total) const;
+    bool startCgi(ClientConnection* client, const ParsedRequest& request,
+                  size_t contentLength, const LocationConfig* location,
                   const std::string& scriptFilePath);
+    void startFastCgi(ClientConnection* client, const ParsedRequest& request,
+                      size_t contentLength, const LocationConfig* location,
+                      const std::string& scriptFilePath);
     
     ssize_t writeToCgi(ClientConnection* client);
     ssize_t readFromCgi(ClientConnection* client);
     void buildResponse(ClientConnection* client);
-    bool hasTimedOut(ClientConnection* client, int timeoutSeconds = 30);
+    bool beginStream(ClientConnection* client);
+    void relayOutput(ClientConnection* client);
+    void endStream(ClientConnection* client);
     void killCgi(ClientConnection* client);
     void cleanup(ClientConnection* client);
-    bool checkCgiComplete(ClientConnection* client);
+    void checkCgiComplete(ClientConnection* client);
 };
 
 #endif
@@ -0,0 +1,90 @@
+#ifndef CGILAUNCHER_HPP
+#define CGILAUNCHER_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+// What a CGI process is started with; its stdin and stdout are passed alongside.
+struct CgiCommand {
+    std::vector<std::string> argv;
+    std::vector<std::string> env;
+    std::string directory;
+};
+
+// Starts the CGI processes of one worker (cgi_launcher).
+// - fork: the worker forks itself, copying the page tables of everything it holds
+// - spawn: posix_spawn(), which glibc runs as a vfork-style clone sharing the
+//   worker's memory until the exec, so the cost does not grow with the worker
+// - zygote: a helper forked at startup, while the worker is still small, receives
+//   each command and its pipe ends over a socket (SCM_RIGHTS) and forks the script
+//   itself. Its scripts are its children: it reaps them, and kills them on request.
+//   If the helper dies, the worker falls back to spawn.
+class CgiLauncher {
+public:
+    enum Mode {
+        FORK,
+        SPAWN,
+        ZYGOTE
+    };
+
+    static bool parseMode(const std::string& value, Mode& mode);
+    static const char* modeName(Mode mode);
+
+private:
+    enum MessageType {
+        LAUNCH = 1,
+        KILL = 2
+    };
+
+    struct MessageHeader {
+        uint32_t type;
+        uint32_t length;     // payload bytes after the header
+        int32_t pid;         // KILL
+    };
+
+    Mode mode;
+    pid_t zygotePid;
+    int zygoteFd;
+    std::vector<pid_t> exiting;          // handed back before they could be waited for
+    std::vector<pid_t> zygoteChildren;   // in the helper: scripts not yet reaped
+
+    pid_t forkChild(const CgiCommand& command, int stdinFd, int stdoutFd);
+    pid_t spawnChild(const CgiCommand& command, int stdinFd, int stdoutFd);
+    pid_t askZygote(const CgiCommand& command, int stdinFd, int stdoutFd);
+    void zygoteGone();
+
+    void runZygote();
+    bool serveZygoteRequest();
+    void reapZygoteChildren();
+    void closeInheritedFds();
+
+    static char** buildVector(const std::vector<std::string>& strings);
+    static void freeVector(char** vector);
+    static void execChild(char** argv, char** env, const std::string& directory,
+                          int stdinFd, int stdoutFd);
+    static std::string encode(const CgiCommand& command);
+    static bool decode(const std::string& payload, CgiCommand& command);
+    static bool readFully(int fd, void* data, size_t size);
+    static bool writeFully(int fd, const void* data, size_t size);
+    static void logExit(int status);
+
+    CgiLauncher(const CgiLauncher&);
+    CgiLauncher& operator=(const CgiLauncher&);
+
+public:
+    CgiLauncher();
+    ~CgiLauncher();
+
+    bool start(Mode launchMode);
+    void stop();
+    Mode getMode() const;
+
+    pid_t launch(const CgiCommand& command, int stdinFd, int stdoutFd);
+    void kill(pid_t pid);
+    void reap(pid_t pid);
+    void collect();
+};
+
+#endif
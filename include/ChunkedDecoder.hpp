@@ -0,0 +1,62 @@
+#ifndef CHUNKEDDECODER_HPP
+#define CHUNKEDDECODER_HPP
+
+#include <string>
+#include <vector>
+#include "BufferChain.hpp"
+#include "RequestParser.hpp"
+
+// Resumable decoder for a chunked request body (RFC 9112, section 7.1). decode() looks
+// at every raw byte once, however the body is split over reads, appends the chunk data
+// to the output and keeps the trailer fields. Size, extension and trailer lines are
+// scanned with ByteScan like header lines. The decoded size is checked against the
+// limit as it grows.
+class ChunkedDecoder {
+public:
+    enum Status {
+        INCOMPLETE,
+        COMPLETE,
+        FAILED
+    };
+
+private:
+    enum State {
+        SIZE_START,
+        SIZE,
+        EXTENSION,
+        SIZE_LF,
+        DATA,
+        DATA_END,
+        DATA_LF,
+        TRAILER_START,
+        TRAILER_NAME,
+        TRAILER_VALUE,
+        TRAILER_LF,
+        BLANK_LF,
+        DONE,
+        ERROR
+    };
+
+    State state;
+    size_t chunkRemaining;
+    size_t decoded;
+    size_t limit;
+    int errorStatus;
+    std::vector<RequestHeader> trailerFields;
+
+    size_t scanRun(const char* data, size_t size);
+    State step(char c);
+    State fail(int status);
+
+public:
+    ChunkedDecoder();
+
+    void reset(size_t maxSize);
+    size_t decode(const BufferChain& input, size_t from, BufferChain& output);
+    Status status() const;
+    int error() const;
+    size_t size() const;
+    const std::vector<RequestHeader>& trailers() const;
+};
+
+#endif
@@ -2,8 +2,27 @@
 #define CLIENTCONNECTION_HPP
 
 #include <string>
-#include <ctime>
+#include <deque>
 #include <sys/types.h>
+#include "EventHandle.hpp"
+#include "TimerWheel.hpp"
+#include "BufferChain.hpp"
+#include "RequestParser.hpp"
+#include "ChunkedDecoder.hpp"
+#include "MultipartUpload.hpp"
+
+struct LocationConfig;
+class FastCgiConnection;
+
+// One part of a multi-range body: header text sent from the chain, then a slice of fileFd.
+struct FileRange {
+	std::string header;
+	off_t offset;
+	off_t length;
+
+	FileRange(const std::string& text, off_t start, off_t count)
+		: header(text), offset(start), length(count) {}
+};
 
 class ClientConnection {
 public:
@@ -16,31 +35,70 @@ public:
 	int fd;
 	size_t serverIndex;
 	State state;
+	size_t slot;
+	bool closed;
+	bool readable;
+	bool writable;
+
+	EventHandle handle;
+	EventHandle cgiInputHandle;
+	EventHandle cgiOutputHandle;
+	TimerNode timer;
 
-	std::string requestBuffer;
-	std::string responseBuffer;
+	BufferChain requestBuffer;
+	BufferChain pipelineBuffer;       // bytes received after the end of the current request
+	BufferChain pipelinedResponses;   // finished responses waiting for the one in responseBuffer
+	size_t pipelinedCount;
+	BufferChain responseBuffer;
+	std::string responseStatus;
 	size_t bytesSent;
+	int fileFd;
+	off_t fileOffset;
+	off_t fileRemaining;
+	std::deque<FileRange> fileRanges;
+	bool closeAfterResponse;          // the response body ends where the connection does
 
-	bool headersComplete;
-	size_t headerEndOffset;
+	RequestParser parser;
+	bool headersComplete;             // parsed and checked against the body size limits
 	size_t bodyBytesReceived;
 	size_t maxBodySize;
+	ChunkedDecoder chunked;
+	BufferChain requestBody;          // decoded chunked body; the raw chunks leave requestBuffer
+	MultipartUpload upload;           // POST upload written to disk as the body arrives
+	size_t bodyStreamed;              // body bytes handed to upload or cgiInput, out of the buffers
+	bool bodyPaused;                  // socket not read until the CGI takes cgiInput
 
 	pid_t cgiPid;
 	int cgiInputFd;
 	int cgiOutputFd;
-	std::string cgiBody;
-	size_t cgiBodyOffset;
-	std::string cgiOutputBuffer;
+	BufferChain cgiInput;             // body bytes the script has not read yet
+	bool cgiInputComplete;            // the whole body is in (or through) cgiInput
+	BufferChain cgiOutputBuffer;
+	bool cgiStreaming;                // head sent, body relayed as the script writes it
+	bool cgiChunked;
+	size_t cgiBodyLeft;               // what the script's Content-Length still allows, or npos
 	std::string cgiScriptName;
-	time_t cgiStartTime;
+	int cgiTimeout;
+	const LocationConfig* cgiLocation;     // gzip settings for the CGI response
+	std::string cgiAcceptEncoding;
+	std::string cgiCacheKey;          // cgi_cache: where buildResponse stores the response
+	std::string cgiCacheStatus;       // X-Cache-Status of a response not served from the cache
+	FastCgiConnection* fastcgi;       // fastcgi_pass: backend connection carrying the request
+	unsigned short fastcgiId;
+	std::string fastcgiParams;        // encoded PARAMS stream, until the request is sent
 
-	ClientConnection(int socket, size_t servIdx = 0);
+	ClientConnection(int socket, size_t servIdx, BufferPool& pool);
 	~ClientConnection();
 
 	void clearBuffers();
+	void resetRequest();
 	bool isResponseComplete() const;
-	size_t getRemainingBytes() const;
+	bool hasOutput() const;
+	bool isWaitingForCgi() const;
+	void attachFile(int fd, off_t offset, off_t length);
+	void queueFileRange(const std::string& header, off_t offset, off_t length);
+	void nextFileRange();
+	void closeFile();
 	void resetCgiState();
 	bool isCgiActive() const;
 };
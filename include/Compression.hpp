@@ -0,0 +1,27 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <string>
+#include "Config.hpp"
+
+// On-the-fly gzip / deflate of response bodies with zlib, driven by the gzip* location
+// directives. Bodies are compressed in one pass in memory, so anything larger than
+// MAX_BODY_SIZE is sent as it is.
+namespace Compression {
+    enum Coding {
+        IDENTITY,
+        GZIP,
+        DEFLATE
+    };
+
+    static const size_t MAX_BODY_SIZE = 4194304;
+
+    double quality(const std::string& acceptEncoding, const std::string& coding);
+    bool appliesTo(const LocationConfig* location, const std::string& contentType);
+    Coding negotiate(const LocationConfig* location, const std::string& acceptEncoding,
+                     const std::string& contentType, size_t size);
+    const char* name(Coding coding);
+    bool compress(const char* data, size_t size, Coding coding, int level, std::string& out);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef COMPRESSIONCACHE_HPP
+#define COMPRESSIONCACHE_HPP
+
+#include <string>
+#include "BufferChain.hpp"
+#include "LruCache.hpp"
+
+struct CompressionCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+
+    CompressionCacheStats() : hits(0), misses(0), evictions(0) {}
+};
+
+// Byte-budgeted LRU of compressed static file bodies, keyed by file, coding and level.
+// Each body remembers the ETag of the file it was made from; a lookup with a different
+// tag drops it, so a changed file is compressed again instead of served stale.
+// One instance per server block per worker.
+class CompressionCache {
+private:
+    struct Entry {
+        SharedBuffer* body;
+        std::string etag;
+
+        void release() {
+            body->release();
+        }
+    };
+
+    LruCache<Entry> entries;
+
+    CompressionCache(const CompressionCache&);
+    CompressionCache& operator=(const CompressionCache&);
+
+public:
+    explicit CompressionCache(size_t capacityBytes);
+
+    bool isEnabled() const;
+
+    SharedBuffer* lookup(const std::string& key, const std::string& etag);
+    void insert(const std::string& key, const std::string& etag, SharedBuffer* body);
+
+    CompressionCacheStats getStats() const;
+};
+
+#endif
@@ -7,8 +7,23 @@
 #include <cstdlib>
 #include <vector>
 #include <map>
+#include "CgiLauncher.hpp"
 
 struct LocationConfig {
+    static const int DEFAULT_CGI_TIMEOUT = 30;
+    static const long MAX_EXPIRES = 315360000;   // ten years, also what "expires max" sends
+    static const size_t DEFAULT_GZIP_MIN_LENGTH = 20;
+    static const int DEFAULT_GZIP_COMP_LEVEL = 1;
+    static const size_t DEFAULT_FASTCGI_KEEPALIVE = 8;
+    static const int DEFAULT_CGI_CACHE_VALID = 1;
+    
+    enum Expires {
+        EXPIRES_OFF,
+        EXPIRES_EPOCH,
+        EXPIRES_MAX,
+        EXPIRES_AFTER
+    };
+    
     std::string path;
     std::string root;
     std::string alias;
@@ -22,19 +37,58 @@ struct LocationConfig {
     std::string redirect;
     size_t clientMaxBodySize;
     bool hasClientMaxBodySize;
+    int cgiTimeout;
+    bool cgiBuffering;           // off: relay the script's output as it is written
+    std::string fastcgiPass;     // "unix:/path" or "host:port"; cgi_ext requests go to this backend
+    size_t fastcgiKeepalive;     // idle backend connections kept open per worker
+    size_t cgiCache;             // bytes of CGI responses kept per worker, 0 = off
+    int cgiCacheValid;           // seconds a cached response is served, unless the script says otherwise
+    std::vector<std::string> cgiCacheKey;   // literal text and $variables, joined by spaces
+    Expires expires;
+    long expiresSeconds;         // EXPIRES_AFTER only; negative means already expired
+    std::string cacheControl;    // replaces the Cache-Control value derived from expires
+    bool gzipStatic;             // serve precompressed .br / .gz siblings when accepted
+    bool gzip;                   // compress responses on the fly
+    std::vector<std::string> gzipTypes;   // lowercase MIME types, "*" for all; text/html always
+    size_t gzipMinLength;
+    int gzipCompLevel;
     
     LocationConfig();
 };
 
 struct ServerConfig {
+    static const int DEFAULT_BACKLOG = 511;
+    static const int DEFAULT_CLIENT_HEADER_TIMEOUT = 60;
+    static const int DEFAULT_CLIENT_BODY_TIMEOUT = 60;
+    static const int DEFAULT_KEEPALIVE_TIMEOUT = 75;
+    static const int DEFAULT_SEND_TIMEOUT = 60;
+    static const size_t DEFAULT_SENDFILE_THRESHOLD = 16384;
+    static const size_t DEFAULT_STATIC_CACHE_MAX_ENTRY = 65536;
+    static const int DEFAULT_OPEN_FILE_CACHE_VALID = 60;
+    static const size_t DEFAULT_PIPELINE_DEPTH = 16;
+    static const size_t MAX_PIPELINE_DEPTH = 1024;
+    
     std::string host;
     int port;
+    int backlog;
     std::string root;
     std::string index;
     bool autoindex;
     size_t clientMaxBodySize;
     std::map<int, std::string> errorPages;
     std::vector<LocationConfig> locations;
+    int clientHeaderTimeout;
+    int clientBodyTimeout;
+    int keepaliveTimeout;
+    int sendTimeout;
+    size_t sendfileThreshold;
+    size_t staticCacheSize;      // 0 disables the static response cache
+    size_t staticCacheMaxEntry;
+    size_t gzipCacheSize;        // 0 disables the compressed-variant cache
+    size_t openFileCacheMax;     // 0 disables the open-file cache
+    int openFileCacheValid;
+    bool openFileCacheErrors;
+    size_t pipelineDepth;        // responses built ahead for pipelined requests, 1 = one at a time
     
     ServerConfig();
 };
@@ -43,7 +97,14 @@ class Config {
 private:
     std::vector<ServerConfig> servers;
     std::string configFile;
+    size_t workerProcesses;
+    size_t workerThreads;
+    bool workerCpuAffinity;
+    bool edgeTriggered;
+    CgiLauncher::Mode cgiLauncher;
     
+    bool parseGlobalDirective(const std::vector<std::string>& tokens);
+    bool parseWorkerCount(const std::string& directive, const std::string& value, size_t& count);
     bool parseServerBlock(std::ifstream& file, std::string& line);
     bool parseLocationBlock(std::ifstream& file, std::string& line, ServerConfig& server);
     bool parseServerDirective(const std::string& directive, const std::vector<std::string>& tokens, 
@@ -51,6 +112,16 @@ private:
     bool parseLocationDirective(const std::string& directive, const std::vector<std::string>& tokens, 
                                 LocationConfig& location);
     bool parseListenDirective(const std::vector<std::string>& tokens, ServerConfig& server);
+    static long parseDigits(const std::string& value, size_t maxDigits = 9);
+    bool parseTimeout(const std::string& directive, const std::string& value, int minimum, int& seconds);
+    bool parseByteCount(const std::string& directive, const std::string& value, size_t& bytes);
+    bool parseCount(const std::string& directive, const std::string& value, size_t& count);
+    bool parseOpenFileCache(const std::vector<std::string>& tokens, ServerConfig& server);
+    bool parsePipelineDepth(const std::string& value, ServerConfig& server);
+    bool parseExpires(const std::string& value, LocationConfig& location);
+    bool parseGzipCompLevel(const std::string& value, LocationConfig& location);
+    bool parseFastCgiPass(const std::string& value, LocationConfig& location);
+    bool parseCgiCacheKey(const std::vector<std::string>& tokens, LocationConfig& location);
     bool validateServerLine(const std::string& line);
     
     std::string trim(const std::string& str);
@@ -62,6 +133,9 @@ public:
     Config();
     ~Config();
     
+    static const long MAX_WORKERS = 256;
+    static const long MAX_TIMEOUT = 86400;
+    
     bool loadFromFile(const std::string& filename);
     
     const std::vector<ServerConfig>& getServers() const;
@@ -72,6 +146,12 @@ public:
     std::string getHost() const;
     std::string getRoot() const;
     std::string getIndex() const;
+    
+    size_t getWorkerProcesses() const;
+    size_t getWorkerThreads() const;
+    bool getWorkerCpuAffinity() const;
+    bool getEdgeTriggered() const;
+    CgiLauncher::Mode getCgiLauncher() const;
 };
 
 #endif
@@ -2,32 +2,43 @@
 #define CONNECTIONMANAGER_HPP
 
 #include <vector>
-#include <map>
 #include <sys/epoll.h>
 #include "ClientConnection.hpp"
+#include "FastCgi.hpp"
 
 class ConnectionManager {
 private:
 	std::vector<ClientConnection*> clients;
-	std::map<int, ClientConnection*> cgiPipeToClient;
+	std::vector<ClientConnection*> closedClients;
 	int epollFd;
+	BufferPool& bufferPool;
+	bool edgeTriggered;
+	FastCgiPool fastcgiPool;
+
+	bool registerHandle(EventHandle& handle, int fd, uint32_t events);
+	void unregisterHandle(EventHandle& handle);
 
 public:
-	ConnectionManager(int epoll_fd);
+	ConnectionManager(int epoll_fd, BufferPool& pool, bool edge = false);
 	~ConnectionManager();
 
-	void addClient(int clientSocket, size_t serverIndex);
-	void removeClient(int clientSocket);
-	ClientConnection* findClient(int fd);
+	ClientConnection* addClient(int clientSocket, size_t serverIndex);
+	void removeClient(ClientConnection* client);
+	void releaseClosedClients();
 	void closeAllClients();
-	void prepareResponseMode(ClientConnection* client);
+	bool prepareResponseMode(ClientConnection* client);
+	bool modifyClientEvents(ClientConnection* client, uint32_t events);
 
 	void addCgiPipes(ClientConnection* client);
 	void removeCgiPipes(ClientConnection* client);
-	void removeSingleCgiPipe(int pipeFd);
-	ClientConnection* findClientByCgiPipe(int pipeFd);
-	bool isCgiPipe(int fd);
+	void closeCgiInput(ClientConnection* client);
+	void watchCgiInput(ClientConnection* client);
+	void unwatchCgiInput(ClientConnection* client);
+	void watchCgiOutput(ClientConnection* client);
+	void unwatchCgiOutput(ClientConnection* client);
 	std::vector<ClientConnection*>& getClients();
+	FastCgiPool& getFastCgiPool();
+	bool isEdgeTriggered() const;
 };
 
 #endif
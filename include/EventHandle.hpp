@@ -0,0 +1,35 @@
+#ifndef EVENTHANDLE_HPP
+#define EVENTHANDLE_HPP
+
+#include <cstddef>
+
+class ClientConnection;
+class FastCgiConnection;
+
+// Stored in epoll_event.data.ptr for every registered fd so dispatch needs no lookup.
+// fd is reset to -1 when the fd is deregistered; events still queued in the current
+// epoll_wait batch for that handle are then skipped.
+struct EventHandle {
+    enum Type {
+        LISTENER,
+        CLIENT,
+        CGI_STDIN,
+        CGI_STDOUT,
+        FILE_WATCH,
+        FASTCGI,
+        WAKEUP
+    };
+
+    Type type;
+    int fd;
+    size_t serverIndex;
+    ClientConnection* client;
+    FastCgiConnection* backend;
+
+    EventHandle(Type t, ClientConnection* owner = NULL, size_t servIdx = 0)
+        : type(t), fd(-1), serverIndex(servIdx), client(owner), backend(NULL) {}
+
+    bool isStale() const { return fd < 0; }
+};
+
+#endif
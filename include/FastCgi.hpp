@@ -0,0 +1,111 @@
+#ifndef FASTCGI_HPP
+#define FASTCGI_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include "BufferChain.hpp"
+#include "EventHandle.hpp"
+
+class ClientConnection;
+
+// FastCGI 1.0 records, as php-fpm and other long-lived backends speak them.
+namespace FastCgi {
+    enum RecordType {
+        BEGIN_REQUEST = 1,
+        ABORT_REQUEST = 2,
+        END_REQUEST = 3,
+        PARAMS = 4,
+        STDIN = 5,
+        STDOUT = 6,
+        STDERR = 7,
+        GET_VALUES = 9,
+        GET_VALUES_RESULT = 10
+    };
+
+    static const size_t HEADER_SIZE = 8;
+    static const size_t MAX_CONTENT = 65535;
+
+    void appendRecord(BufferChain& out, int type, unsigned short id, const char* data, size_t size);
+    void appendStream(BufferChain& out, int type, unsigned short id, const std::string& data);
+    void appendStream(BufferChain& out, int type, unsigned short id, const BufferChain& data);
+    void appendParam(std::string& out, const std::string& name, const std::string& value);
+    bool readParam(const std::string& data, size_t& pos, std::string& name, std::string& value);
+}
+
+// What happened to a request while a backend connection was served.
+struct FastCgiEvent {
+    enum Kind {
+        OUTPUT,     // more of the response is in client->cgiOutputBuffer
+        ENDED,      // END_REQUEST: the response is complete
+        FAILED      // the connection broke or the backend refused the request
+    };
+
+    ClientConnection* client;
+    Kind kind;
+
+    FastCgiEvent(ClientConnection* owner, Kind what) : client(owner), kind(what) {}
+};
+
+// One socket to a backend. Requests are written to it as records and the records read
+// back are routed by request id to the client they belong to. The backend is asked
+// whether it multiplexes (FCGI_MPXS_CONNS); until it says so, one request at a time.
+class FastCgiConnection {
+public:
+    EventHandle handle;
+    std::string address;
+    size_t idleLimit;             // fastcgi_keepalive of the location that opened it
+    size_t capacity;
+    bool connecting;
+    bool paused;                  // not read while its only client has enough queued
+    uint32_t events;
+    BufferChain output;
+    BufferChain input;
+    std::map<unsigned short, ClientConnection*> requests;   // NULL once aborted
+
+    FastCgiConnection(const std::string& addr, size_t limit, BufferPool& pool);
+};
+
+// The backend connections of one worker, kept open between requests (fastcgi_keepalive
+// idle ones per address) and registered level-triggered on the worker's epoll instance.
+// Closed connections are deleted by releaseClosed() once the epoll batch is dispatched.
+class FastCgiPool {
+public:
+    static const size_t READ_CHUNK = 64 * 1024;
+    static const size_t MAX_REQUESTS = 64;   // per multiplexed connection
+
+private:
+    int epollFd;
+    BufferPool& bufferPool;
+    std::vector<FastCgiConnection*> connections;
+    std::vector<FastCgiConnection*> closedConnections;
+
+    FastCgiConnection* open(const std::string& address, size_t idleLimit);
+    FastCgiConnection* find(const std::string& address);
+    unsigned short nextId(const FastCgiConnection* conn) const;
+    bool flush(FastCgiConnection* conn);
+    bool receive(FastCgiConnection* conn, std::vector<FastCgiEvent>& results);
+    bool dispatch(FastCgiConnection* conn, int type, unsigned short id, size_t size,
+                  std::vector<FastCgiEvent>& results);
+    void readCapacity(FastCgiConnection* conn, const std::string& values);
+    void finishRequest(FastCgiConnection* conn, unsigned short id);
+    void updateEvents(FastCgiConnection* conn);
+    void closeConnection(FastCgiConnection* conn, std::vector<FastCgiEvent>* results);
+
+    FastCgiPool(const FastCgiPool&);
+    FastCgiPool& operator=(const FastCgiPool&);
+
+public:
+    FastCgiPool(int epoll_fd, BufferPool& pool);
+    ~FastCgiPool();
+
+    bool submit(ClientConnection* client, const std::string& address, size_t idleLimit);
+    void handleEvent(FastCgiConnection* conn, uint32_t activeEvents, std::vector<FastCgiEvent>& results);
+    void abort(ClientConnection* client);
+    void pauseOutput(ClientConnection* client, bool paused);
+    void releaseClosed();
+    void closeAll();
+};
+
+#endif
@@ -2,25 +2,35 @@
 #define HTTPREQUEST_HPP
 
 #include <string>
+#include <vector>
+#include <sys/stat.h>
 #include "ClientConnection.hpp"
 #include "Config.hpp"
+#include "StaticFileCache.hpp"
+#include "OpenFileCache.hpp"
+#include "CompressionCache.hpp"
 
 class CgiHandler;
 
+struct ByteRange {
+    off_t first;
+    off_t last;
+};
+
 class HttpRequest {
 private:
     Config& config;
     CgiHandler* cgiHandler;
+    StaticFileCache* fileCache;
+    OpenFileCache* openFiles;
+    CompressionCache* compressedFiles;
+    size_t rangeResponses;      // numbers multipart/byteranges boundaries
     
-    bool validateRequestLine(const std::string& method, const std::string& path, 
-                            const std::string& version, ClientConnection* client);
-    bool isMethodImplemented(const std::string& method);
     bool isMethodAllowed(const std::string& method, const std::string& path, size_t serverIndex);
     bool checkRedirect(const std::string& path, size_t serverIndex, 
                       std::string& redirectUrl, int& statusCode);
-    bool checkHostHeader(const std::string& headers, const std::string& version);
-    bool checkBodySizeLimit(ClientConnection* client, const std::string& method,
-                           const std::string& path, const std::string& headers, size_t bodyStart);
+    bool checkHostHeader(const ParsedRequest& request);
+    bool checkBodySizeLimit(ClientConnection* client, const ParsedRequest& request);
     
     const LocationConfig* findBestLocation(const std::string& path, const ServerConfig& server);
     std::string getPathRelativeToLocation(const std::string& path, const LocationConfig* location);
@@ -28,47 +38,53 @@ private:
                              const LocationConfig* location);
     bool findUploadLocation(const std::string& path, std::string& uploadDir, size_t serverIndex);
     
-    bool getContentLength(const std::string& headers, size_t& contentLength);
-    std::string getContentType(const std::string& headers);
-    std::string getBoundary(const std::string& headers);
-    bool isUploadRequest(const std::string& headers);
-    bool isChunkedTransferEncoding(const std::string& headers);
-    std::string unchunkBody(const std::string& chunkedBody);
+    std::string getBoundary(const ParsedRequest& request);
+    bool isUploadRequest(const ParsedRequest& request);
+    std::string readBody(ClientConnection* client, const ParsedRequest& request);
     
-    std::string extractFilename(const std::string& headers, const std::string& path);
-    std::string sanitizeFilename(const std::string& filename);
-    std::string generateUniqueFilename(const std::string& directory, const std::string& filename);
-    std::string extractMultipartBody(const std::string& body, const std::string& headers, 
-                                     std::string& extractedFilename);
+    std::string extractFilename(const ParsedRequest& request, const std::string& path);
     bool saveUploadedFile(const std::string& fullPath, const std::string& body);
     
-    bool handleCgiRequest(ClientConnection* client, const std::string& method,
-                         const std::string& path, const std::string& headers,
-                         size_t bodyStart);
-    std::string extractCgiBody(ClientConnection* client, const std::string& headers, size_t bodyStart);
+    bool handleCgiRequest(ClientConnection* client, const ParsedRequest& request);
+    std::string cgiScriptPath(const std::string& path, const ServerConfig& server, const LocationConfig* location);
+    bool reachesHandler(ClientConnection* client);
     
-    void handlePostUpload(ClientConnection* client, const std::string& path,
-                         const std::string& headers, size_t bodyStart);
+    void handlePostUpload(ClientConnection* client, const ParsedRequest& request);
+    void serveFile(ClientConnection* client, const std::string& fullPath, const ServerConfig& server,
+                   const LocationConfig* location, const ParsedRequest& request);
+    bool readFileInto(ClientConnection* client, int fd, off_t offset, size_t length);
+    void appendCachedResponse(ClientConnection* client, const CachedResponse& cached, const std::string& expires);
+    bool isNotModified(const ParsedRequest& request, const std::string& etag, time_t mtime);
+    std::string negotiateEncoding(const std::string& fullPath, const LocationConfig* location,
+                                  const ParsedRequest& request, std::string& filePath);
+    std::string buildVary(const LocationConfig* location, const std::string& contentType);
+    bool serveCompressed(ClientConnection* client, const std::string& fullPath, const LocationConfig* location,
+                         const ParsedRequest& request, const std::string& extraHeaders, bool headersOnly);
+    void serveListing(ClientConnection* client, const std::string& fullPath, const std::string& path,
+                      const LocationConfig* location, const ParsedRequest& request);
+    
+    bool parseRanges(const std::string& rangeHeader, off_t fileSize, std::vector<ByteRange>& ranges);
+    bool ifRangeMatches(const ParsedRequest& request, const std::string& etag, time_t mtime);
+    bool serveRanges(ClientConnection* client, int fd, const struct stat& fileStat, const std::string& fullPath,
+                     const ServerConfig& server, const ParsedRequest& request, const std::string& extraHeaders);
     
 public:
-    HttpRequest(Config& cfg);
+    HttpRequest(Config& cfg, size_t serverIndex, CgiLauncher& launcher);
     ~HttpRequest();
     
     void handleRequest(ClientConnection* client);
+    bool beginUpload(ClientConnection* client);
+    bool beginCgi(ClientConnection* client);
     
-    void handleGet(ClientConnection* client, const std::string& path);
-    void handleHead(ClientConnection* client, const std::string& path);
-    void handlePost(ClientConnection* client, const std::string& path, 
-                   const std::string& headers, size_t bodyStart);
-    void handlePut(ClientConnection* client, const std::string& path,
-                  const std::string& headers, size_t bodyStart);
-    void handleDelete(ClientConnection* client, const std::string& path);
+    void handleGet(ClientConnection* client, const ParsedRequest& request);
+    void handleHead(ClientConnection* client, const ParsedRequest& request);
+    void handlePost(ClientConnection* client, const ParsedRequest& request);
+    void handlePut(ClientConnection* client, const ParsedRequest& request);
+    void handleDelete(ClientConnection* client, const ParsedRequest& request);
     
     CgiHandler* getCgiHandler() const;
-    
-    static bool isRequestComplete(const std::string& buffer);
-    static std::string extractMethod(const std::string& headers);
-    static std::string extractPath(const std::string& headers);
+    StaticFileCache* getFileCache() const;
+    CompressionCache* getCompressionCache() const;
 };
 
 #endif
@@ -4,6 +4,8 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <ctime>
+#include <sys/types.h>
 #include "Config.hpp"
 
 class HttpResponse {
@@ -11,6 +13,7 @@ public:
     static std::string build200(const std::string& contentType, const std::string& body);
     static std::string build201(const std::string& body);
     static std::string build204();
+    static std::string build304(const std::string& extraHeaders);
     
     static std::string build301(const std::string& location);
     static std::string build302(const std::string& location);
@@ -21,16 +24,36 @@ public:
     static std::string build405(const ServerConfig* serverConfig = NULL);
     static std::string build411(const ServerConfig* serverConfig = NULL);
     static std::string build413(const ServerConfig* serverConfig = NULL);
+    static std::string build416(off_t fileSize, const ServerConfig* serverConfig = NULL);
+    static std::string build431(const ServerConfig* serverConfig = NULL);
     
     static std::string build500(const std::string& message, const ServerConfig* serverConfig = NULL);
     static std::string build501(const ServerConfig* serverConfig = NULL);
+    static std::string build502(const ServerConfig* serverConfig = NULL);
     static std::string build504(const ServerConfig* serverConfig = NULL);
     
     static std::string getStatusText(int statusCode);
     
-    static std::string buildFileResponse(const std::string& fullPath, const ServerConfig* serverConfig = NULL);
-    static std::string buildHeadResponse(const std::string& fullPath, const ServerConfig* serverConfig = NULL);
+    static std::string buildFileHeaders(const std::string& fullPath, off_t fileSize,
+                                        const std::string& extraHeaders = "");
+    static std::string buildEncodedHeaders(const std::string& contentType, size_t length,
+                                           const std::string& extraHeaders);
+    static std::string buildRangeHeaders(const std::string& fullPath, off_t first, off_t last, off_t fileSize,
+                                         const std::string& extraHeaders);
+    static std::string buildMultipartHeaders(const std::string& boundary, off_t contentLength,
+                                             const std::string& extraHeaders);
+    static std::string buildPartHeader(const std::string& fullPath, const std::string& boundary,
+                                       off_t first, off_t last, off_t fileSize);
+    static std::string buildHeadNotFound();
+    static std::string formatHttpDate(time_t value);
+    static bool parseHttpDate(const std::string& text, time_t& value);
+    
+    static std::string buildETag(ino_t inode, off_t fileSize, time_t mtime);
+    static std::string buildValidatorHeaders(const std::string& etag, time_t mtime);
+    static std::string buildCacheControl(const LocationConfig* location);
+    static std::string buildExpires(const LocationConfig* location, time_t now);
     static std::string buildDirectoryListing(const std::string& dirPath, const std::string& requestPath);
+    static std::string getContentType(const std::string& path);
     
 private:
     static std::string loadCustomErrorPage(int errorCode, const ServerConfig* serverConfig, const std::string& rootDir);
@@ -42,7 +65,6 @@ private:
     static std::string buildHtmlHeader(const std::string& requestPath);
     static std::string buildParentLink(const std::string& requestPath);
     static std::string buildEntriesTable(const std::vector<std::string>& directories, const std::vector<std::string>& files, const std::string& requestPath);
-    static std::string getContentType(const std::string& path);
 };
 
 #endif
@@ -0,0 +1,137 @@
+#ifndef LRUCACHE_HPP
+#define LRUCACHE_HPP
+
+#include <string>
+#include <map>
+#include <list>
+#include <cstddef>
+
+// Byte-budgeted LRU map from string keys to Value, shared by the response caches. Each
+// entry is charged the bytes it was inserted with (plus any grow()); inserting evicts
+// from the least recently used end until it fits. The cache owns what an entry holds:
+// Value::release() is called whenever one leaves, replaced, removed or evicted.
+template <typename Value>
+class LruCache {
+private:
+    struct Slot {
+        Value value;
+        size_t bytes;
+        std::list<std::string>::iterator lruPos;
+    };
+    typedef typename std::map<std::string, Slot>::iterator SlotIterator;
+
+    size_t capacity;
+    size_t usedBytes;
+    std::map<std::string, Slot> slots;
+    std::list<std::string> lru;     // most recently used first
+    size_t hitCount;
+    size_t missCount;
+    size_t evictionCount;
+
+    void erase(SlotIterator it) {
+        usedBytes -= it->second.bytes;
+        it->second.value.release();
+        lru.erase(it->second.lruPos);
+        slots.erase(it);
+    }
+
+    // Evicts from the least recently used end, skipping keep, until bytes more fit.
+    bool makeRoom(size_t bytes, const std::string* keep) {
+        if (bytes > capacity)
+            return false;
+        std::list<std::string>::iterator victim = lru.end();
+        while (usedBytes + bytes > capacity && victim != lru.begin()) {
+            --victim;
+            if (keep && *victim == *keep)
+                continue;
+            std::list<std::string>::iterator next = victim;
+            ++next;
+            erase(slots.find(*victim));
+            victim = next;
+            evictionCount++;
+        }
+        return usedBytes + bytes <= capacity;
+    }
+
+    LruCache(const LruCache&);
+    LruCache& operator=(const LruCache&);
+
+public:
+    explicit LruCache(size_t capacityBytes)
+        : capacity(capacityBytes), usedBytes(0), hitCount(0), missCount(0), evictionCount(0) {}
+
+    ~LruCache() {
+        clear();
+    }
+
+    bool isEnabled() const {
+        return capacity > 0;
+    }
+
+    // An entry as it is, without counting a hit or moving it up; for validity checks.
+    Value* peek(const std::string& key) {
+        SlotIterator it = slots.find(key);
+        return (it == slots.end()) ? NULL : &it->second.value;
+    }
+
+    Value* lookup(const std::string& key) {
+        SlotIterator it = slots.find(key);
+        if (it == slots.end()) {
+            missCount++;
+            return NULL;
+        }
+        hitCount++;
+        lru.splice(lru.begin(), lru, it->second.lruPos);
+        return &it->second.value;
+    }
+
+    // Replaces any entry under key. Returns false, leaving value with the caller, when
+    // bytes exceed the whole budget.
+    bool insert(const std::string& key, const Value& value, size_t bytes) {
+        remove(key);
+        if (!makeRoom(bytes, NULL))
+            return false;
+        lru.push_front(key);
+        Slot& slot = slots[key];
+        slot.value = value;
+        slot.bytes = bytes;
+        slot.lruPos = lru.begin();
+        usedBytes += bytes;
+        return true;
+    }
+
+    // Charges bytes more to the entry under key; others may be evicted for it, never itself.
+    bool grow(const std::string& key, size_t bytes) {
+        SlotIterator it = slots.find(key);
+        if (it == slots.end() || !makeRoom(bytes, &it->first))
+            return false;
+        it->second.bytes += bytes;
+        usedBytes += bytes;
+        return true;
+    }
+
+    void remove(const std::string& key) {
+        SlotIterator it = slots.find(key);
+        if (it != slots.end())
+            erase(it);
+    }
+
+    void clear() {
+        while (!slots.empty())
+            erase(slots.begin());
+    }
+
+    size_t hits() const {
+        return hitCount;
+    }
+
+    size_t misses() const {
+        return missCount;
+    }
+
+    size_t evictions() const {
+        return evictionCount;
+    }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef MULTIPARTUPLOAD_HPP
+#define MULTIPARTUPLOAD_HPP
+
+#include <string>
+#include <vector>
+#include "BufferChain.hpp"
+#include "ByteScan.hpp"
+
+struct UploadedFile {
+    std::string name;
+    std::string path;
+    size_t size;
+};
+
+// Writes a POST upload into the upload_store directory while its body arrives. A
+// multipart/form-data body is split at its delimiters (found with Boyer-Moore-Horspool,
+// across reads) and every part with a filename goes to a file of its own; form fields
+// are skipped. Any other body becomes a single file. Only a delimiter's worth of bytes
+// and the headers of the current part are held, whatever the size of the body.
+class MultipartUpload {
+public:
+    enum Status {
+        IDLE,
+        INCOMPLETE,
+        COMPLETE,
+        FAILED
+    };
+
+    static const size_t MAX_PART_HEADERS = 8192;
+
+private:
+    enum State {
+        UNUSED,
+        RAW,
+        PREAMBLE,
+        DELIMITER_END,
+        DELIMITER_LF,
+        CLOSE_DASH,
+        PART_HEADERS,
+        PART_DATA,
+        EPILOGUE,
+        DONE,
+        ERROR
+    };
+
+    State state;
+    int errorStatus;
+    std::string directory;
+    ByteScan::Horspool delimiter;
+    std::string tail;               // bytes that may start a delimiter split over reads
+    std::string partHeaders;
+    int fileFd;
+    std::vector<UploadedFile> written;
+
+    void consume(const char* data, size_t size);
+    size_t scanData(const char* data, size_t size);
+    void step(char c);
+    void emit(const char* data, size_t size);
+    void startPart();
+    void endPart();
+    bool openFile(const std::string& filename);
+    void closeFile();
+    void removeFiles();
+    void fail(int status);
+
+public:
+    MultipartUpload();
+    ~MultipartUpload();
+
+    bool begin(const std::string& uploadDir, const std::string& boundary, const std::string& filename);
+    void write(const BufferChain& input, size_t from, size_t count);
+    void finish();
+    void reset();
+
+    Status status() const;
+    int error() const;
+    const std::vector<UploadedFile>& files() const;
+
+    static std::string sanitizeFilename(const std::string& filename);
+    static std::string dispositionFilename(const std::string& disposition);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef OPENFILECACHE_HPP
+#define OPENFILECACHE_HPP
+
+#include <string>
+#include <map>
+#include <list>
+#include <ctime>
+#include <sys/types.h>
+
+struct FileInfo {
+    enum Type {
+        MISSING,
+        REGULAR,
+        DIRECTORY,
+        OTHER
+    };
+
+    Type type;
+    int error;              // errno of the failed stat() when MISSING
+    off_t size;
+    time_t mtime;
+    ino_t inode;
+    bool executable;        // filled in by resolve()
+    std::string realPath;   // filled in by resolve(); empty if it could not be resolved
+
+    FileInfo() : type(MISSING), error(0), size(0), mtime(0), inode(0), executable(false) {}
+};
+
+// Bounded path -> metadata cache in the spirit of nginx's open_file_cache. Entries are
+// trusted for validSeconds, then re-checked; failed lookups are only kept when
+// cacheErrors is set. Regular files keep one read-only fd open, and callers get a
+// duplicate of it, so a hit costs no path walk at all. With maxEntries == 0 every call
+// goes to the filesystem.
+class OpenFileCache {
+private:
+    struct Entry {
+        FileInfo info;
+        int fd;
+        bool resolved;
+        time_t validUntil;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    size_t maxEntries;
+    int validSeconds;
+    bool cacheErrors;
+    std::map<std::string, Entry> entries;
+    std::list<std::string> lru;     // most recently used first
+    Entry scratch;                  // result holder for uncached lookups
+
+    Entry& fetch(const std::string& path);
+    void load(Entry& entry, const std::string& path);
+    void resetEntry(Entry& entry);
+    void erase(std::map<std::string, Entry>::iterator it);
+
+    OpenFileCache(const OpenFileCache&);
+    OpenFileCache& operator=(const OpenFileCache&);
+
+public:
+    OpenFileCache(size_t maxCount, int ttlSeconds, bool keepErrors);
+    ~OpenFileCache();
+
+    bool isEnabled() const;
+
+    const FileInfo& lookup(const std::string& path);
+    const FileInfo& resolve(const std::string& path);
+    int openFile(const std::string& path);
+    void invalidate(const std::string& path);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef REQUESTPARSER_HPP
+#define REQUESTPARSER_HPP
+
+#include <string>
+#include <vector>
+#include "BufferChain.hpp"
+
+struct RequestHeader {
+    std::string name;       // lowercased
+    std::string value;      // without surrounding whitespace
+    int id;                 // ParsedRequest::HeaderId
+};
+
+// The request line and header block of one request, as produced by RequestParser.
+// Everything after the header block (body, pipelined requests) stays in the buffer.
+struct ParsedRequest {
+    // Headers the server reads itself. Their names are resolved once, by a perfect
+    // hash, while parsing; lookups by id are then a single array access.
+    enum HeaderId {
+        HOST,
+        CONTENT_LENGTH,
+        TRANSFER_ENCODING,
+        CONNECTION,
+        CONTENT_TYPE,
+        CONTENT_DISPOSITION,
+        RANGE,
+        IF_RANGE,
+        IF_NONE_MATCH,
+        IF_MODIFIED_SINCE,
+        ACCEPT_ENCODING,
+        EXPECT,
+        KNOWN_HEADERS,
+        OTHER_HEADER = KNOWN_HEADERS
+    };
+
+    enum Method {
+        METHOD_OTHER,
+        METHOD_GET,
+        METHOD_HEAD,
+        METHOD_POST,
+        METHOD_PUT,
+        METHOD_DELETE
+    };
+
+    enum Framing {
+        BODY_NONE,
+        BODY_LENGTH,
+        BODY_CHUNKED
+    };
+
+    Method method;
+    std::string methodName;
+    std::string target;     // as sent, query included
+    std::string path;       // target up to '?'
+    std::string query;
+    std::string version;
+    int versionMajor;
+    int versionMinor;
+    std::vector<RequestHeader> headers;
+    int known[KNOWN_HEADERS];   // index in headers of the first one with that id, or -1
+    size_t headerEnd;       // offset of the first body byte
+    Framing framing;
+    size_t contentLength;
+    bool connectionClose;
+    bool connectionKeepAlive;
+
+    static const size_t MAX_HEADERS = 100;
+
+    ParsedRequest();
+    void clear();
+
+    static HeaderId lookup(const char* name, size_t length);
+    const std::string* find(HeaderId id) const;
+    const std::string& header(HeaderId id) const;
+    const std::string* find(const std::string& name) const;
+    bool expectsContinue() const;
+    bool isHttp11() const;
+    bool keepAlive() const;
+};
+
+// Resumable request-line and header parser. parse() picks up at the first byte it has
+// not seen, so a header block arriving in many reads is scanned once in total. It stops
+// at the end of the header block; framing tells the caller where the body ends.
+class RequestParser {
+public:
+    enum Status {
+        INCOMPLETE,
+        COMPLETE,
+        FAILED
+    };
+
+private:
+    enum State {
+        LINE_START,
+        METHOD,
+        TARGET_START,
+        TARGET,
+        VERSION_START,
+        VERSION,
+        LINE_END,
+        LINE_LF,
+        HEADER_START,
+        HEADER_NAME,
+        VALUE_START,
+        VALUE,
+        HEADER_LF,
+        BLANK_LF,
+        DONE,
+        ERROR
+    };
+
+    State state;
+    size_t offset;
+    int errorStatus;
+    ParsedRequest parsed;
+
+    State step(char c);
+    size_t scanRun(const char* data, size_t size);
+    State fail(int status);
+    bool finishRequestLine();
+    State finishHeader();
+    State finishHeaders();
+
+public:
+    RequestParser();
+
+    void reset();
+    Status parse(const BufferChain& buffer);
+    Status status() const;
+    int error() const;
+    const ParsedRequest& request() const;
+};
+
+#endif
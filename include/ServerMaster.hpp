@@ -0,0 +1,65 @@
+#ifndef SERVERMASTER_HPP
+#define SERVERMASTER_HPP
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include "Config.hpp"
+#include "WebServer.hpp"
+
+struct WorkerProcess {
+    pid_t pid;
+    unsigned long startedAtMs;
+    unsigned long respawnAtMs;    // while pid is -1: when the master forks this slot again
+
+    WorkerProcess() : pid(-1), startedAtMs(0), respawnAtMs(0) {}
+};
+
+// Owns the parsed configuration and the event-loop workers.
+// - single worker: the loop runs on the calling thread
+// - worker_threads: one thread per worker, each with its own epoll instance and
+//   SO_REUSEPORT listeners, optionally pinned to a CPU
+// - worker_processes: the master binds the listeners once and forks workers that
+//   inherit them; a worker that dies is replaced immediately, or after
+//   RESPAWN_THROTTLE_SECONDS if it died right after starting or could not be forked
+class ServerMaster {
+private:
+    Config config;
+    std::vector<WebServer*> workers;
+    std::vector<pthread_t> threads;
+    std::vector<WorkerProcess> processes;
+    volatile sig_atomic_t stopping;
+
+    bool initializeWorkers(size_t count);
+    void runThreads();
+    void pinToCpu(pthread_t thread, size_t workerId);
+    void logWorkerStats();
+    void destroyWorkers();
+
+    void runProcesses();
+    pid_t spawnWorkerProcess(size_t slot, const sigset_t& originalMask);
+    void runWorkerProcess(size_t slot, const sigset_t& originalMask);
+    void reapWorkerProcesses();
+    bool respawnWorkerProcesses(const sigset_t& originalMask);
+    void waitForSignal(const sigset_t& originalMask);
+    void terminateWorkerProcesses();
+    bool hasLiveWorkerProcesses() const;
+    int findProcessSlot(pid_t pid) const;
+
+    static void* workerThreadMain(void* arg);
+    static void onChildExit(int);
+
+public:
+    static const int RESPAWN_THROTTLE_SECONDS = 1;
+
+    ServerMaster();
+    ~ServerMaster();
+
+    bool initialize(const std::string& configFile);
+    void run();
+    void stop();
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef STATICFILECACHE_HPP
+#define STATICFILECACHE_HPP
+
+#include <string>
+#include <map>
+#include <set>
+#include <list>
+#include <ctime>
+#include <sys/stat.h>
+#include "BufferChain.hpp"
+#include "EventHandle.hpp"
+
+struct StaticCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t invalidations;
+
+    StaticCacheStats() : hits(0), misses(0), evictions(0), invalidations(0) {}
+};
+
+// A complete 200 response plus what is needed to answer conditional requests for it.
+// Per-request headers (Expires) are inserted at headerEnd, in front of the blank line.
+struct CachedResponse {
+    SharedBuffer* response;
+    size_t headerEnd;
+    std::string etag;
+    time_t lastModified;
+};
+
+// Byte-budgeted LRU of complete static responses (headers and body in one SharedBuffer),
+// keyed by the caller (requested path plus the headers that vary with it). The directory of
+// every cached file is watched with inotify (one watch per directory, added on insert) and
+// any change to a watched name drops the entries read from it, so edits are visible at once.
+// One instance per server block per worker; the inotify fd is polled by that worker's epoll.
+class StaticFileCache {
+private:
+    struct Entry {
+        CachedResponse cached;
+        std::string path;                       // file the body was read from
+        std::list<std::string>::iterator lruPos;
+        int watch;
+    };
+
+    struct Watch {
+        std::string directory;
+        std::set<std::string> keys;             // entries read from this directory
+    };
+
+    size_t capacity;
+    size_t maxEntrySize;
+    size_t usedBytes;
+    int inotifyFd;
+    std::map<std::string, Entry> entries;
+    std::list<std::string> lru;                 // most recently used first
+    std::map<int, Watch> watches;               // watch descriptor -> directory and its entries
+    std::map<std::string, int> watchByDirectory;
+    StaticCacheStats stats;
+
+    int watchDirectory(const std::string& directory);
+    void unwatch(int watch);
+    void erase(std::map<std::string, Entry>::iterator it);
+    void invalidateWatch(int watch, const std::string& name);
+
+    StaticFileCache(const StaticFileCache&);
+    StaticFileCache& operator=(const StaticFileCache&);
+
+public:
+    EventHandle handle;
+
+    StaticFileCache(size_t capacityBytes, size_t maxEntryBytes, size_t serverIndex);
+    ~StaticFileCache();
+
+    bool isEnabled() const;
+    bool accepts(size_t responseSize) const;
+    int getWatchFd() const;
+
+    const CachedResponse* lookup(const std::string& key);
+    void insert(const std::string& key, const std::string& path, const CachedResponse& cached,
+                const struct stat& readStat);
+    void processWatchEvents();
+    void clear();
+
+    const StaticCacheStats& getStats() const;
+};
+
+#endif
@@ -10,6 +10,7 @@ namespace StringUtils {
     std::vector<std::string> split(const std::string& str, char delimiter);
     std::string intToString(int value);
     std::string sizeToString(size_t value);
+    bool isTokenChar(char c);
 }
 
 #endif
@@ -0,0 +1,55 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <vector>
+#include <cstddef>
+
+class ClientConnection;
+
+// Intrusive list node embedded in the object it times; a node is either unlinked or
+// sitting in exactly one wheel slot, so scheduling and cancelling are O(1).
+struct TimerNode {
+    TimerNode* prev;
+    TimerNode* next;
+    unsigned long expires;
+    ClientConnection* client;
+
+    TimerNode(ClientConnection* owner = NULL);
+    ~TimerNode();
+
+    bool isScheduled() const { return prev != NULL; }
+    void unlink();
+};
+
+// Hierarchical timing wheel (LEVELS x SLOTS, TICK_MS resolution). Timers far in the
+// future live in coarse upper levels and cascade down as their slot comes round.
+class TimerWheel {
+public:
+    static const unsigned long TICK_MS = 100;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int LEVELS = 4;
+
+private:
+    TimerNode slots[LEVELS][SLOTS];
+    unsigned long currentTick;
+
+    void insert(TimerNode& node);
+    void cascade(int level);
+    void expireSlot(TimerNode& head, std::vector<TimerNode*>& expired);
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+public:
+    TimerWheel();
+
+    void start(unsigned long nowMs);
+    void schedule(TimerNode& node, unsigned long timeoutMs);
+    void advance(unsigned long nowMs, std::vector<TimerNode*>& expired);
+    int nextTimeout(unsigned long nowMs, int maxMs) const;
+
+    static unsigned long monotonicMs();
+};
+
+#endif
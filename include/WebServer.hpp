@@ -13,73 +13,133 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <signal.h>
+#include <sys/sendfile.h>
 #include "Config.hpp"
+#include "EventHandle.hpp"
 #include "ConnectionManager.hpp"
 #include "HttpRequest.hpp"
 #include "CgiHandler.hpp"
+#include "TimerWheel.hpp"
 
 struct ServerSocket {
     int fd;
     std::string host;
     int port;
     size_t serverIndex;
+    EventHandle* handle;
     
-    ServerSocket() : fd(-1), port(0), serverIndex(0) {}
+    ServerSocket() : fd(-1), port(0), serverIndex(0), handle(NULL) {}
 };
 
+struct WorkerStats {
+    size_t connectionsAccepted;
+    size_t requestsProcessed;
+    size_t bytesReceived;
+    size_t bytesSent;
+    
+    WorkerStats() : connectionsAccepted(0), requestsProcessed(0), bytesReceived(0), bytesSent(0) {}
+};
+
+// One event loop: its own epoll instance, listeners, connections, read buffer and stats.
+// Several instances run side by side in multi-reactor mode (see ServerMaster).
 class WebServer {
 private:
-    Config config;
+    Config& config;
+    size_t workerId;
     std::vector<ServerSocket> serverSockets;
-    std::map<int, size_t> fdToServerIndex;
     int epollFd;
-    bool running;
+    volatile sig_atomic_t running;   // cleared by stop(), which may run in a signal handler
+    int wakeFd;                      // eventfd in the epoll set; stop() writes to it
+    EventHandle wakeHandle;
+    bool edgeTriggered;
     
     ConnectionManager* connManager;
     std::vector<HttpRequest*> httpHandlers;
+    CgiLauncher cgiLauncher;
+    BufferPool bufferPool;
+    std::vector<struct epoll_event> eventBuffer;
+    TimerWheel timers;
+    unsigned long nowMs;
+    std::vector<TimerNode*> expiredTimers;
+    std::vector<FastCgiEvent> fastcgiEvents;
+    WorkerStats stats;
     
-    bool setupServerSocket(const ServerConfig& serverConfig, size_t index);
+    bool setupServerSocket(const ServerConfig& serverConfig, size_t index, bool reusePort);
     void setupEpoll();
     bool isDuplicateBinding(const std::string& host, int port) const;
     void cleanupOnError();
     
     bool setNonBlocking(int fd);
-    bool addToEpoll(int fd, uint32_t events);
-    bool isServerSocket(int fd);
+    bool addToEpoll(int fd, uint32_t events, EventHandle* handle);
+    void closeServerSockets();
     
     void processEvents(struct epoll_event* events, int numEvents);
-    void handleNewConnection(int serverFd);
-    void handleClientRead(int clientSocket);
-    void handleClientWrite(int clientSocket);
-    void handleErrorEvent(int fd);
-    void handleClientEvent(int fd, uint32_t activeEvents);
-    void handleCgiPipeEvent(int fd, uint32_t activeEvents);
+    void handleNewConnection(EventHandle* listener);
+    void registerClient(int clientSocket, const struct sockaddr_in& clientAddr, size_t serverIndex);
+    void handleClientRead(ClientConnection* client);
+    void handleClientWrite(ClientConnection* client);
+    ssize_t sendResponseData(ClientConnection* client, size_t& attempted);
+    void handleClientEvent(ClientConnection* client, uint32_t activeEvents);
+    void driveClient(ClientConnection* client);
+    void consumeRequestData(ClientConnection* client, size_t bytesRead);
+    void parseRequestData(ClientConnection* client, size_t newBytes);
+    void handleCgiPipeEvent(EventHandle* handle, uint32_t activeEvents);
+    void handleFastCgiEvent(EventHandle* handle, uint32_t activeEvents);
     
-    bool parseHeaders(ClientConnection* client, size_t oldBufferSize);
+    bool parseHeaders(ClientConnection* client);
     void determineMaxBodySize(ClientConnection* client);
-    std::string extractRequestPath(ClientConnection* client);
     bool isValidPathMatch(const std::string& requestPath, const std::string& locPath);
     bool checkContentLengthHeader(ClientConnection* client);
+    bool decodeChunkedBody(ClientConnection* client);
+    bool streamUploadBody(ClientConnection* client);
+    bool streamCgiBody(ClientConnection* client);
+    bool flushCgiInput(ClientConnection* client);
+    void pauseBody(ClientConnection* client, bool paused);
     bool checkBodySize(ClientConnection* client);
     bool waitForCompleteBody(ClientConnection* client);
-    std::string extractMethod(const std::string& headers);
+    size_t messageLength(ClientConnection* client);
+    size_t messageLength(const BufferChain& buffer, const ParsedRequest& request);
     void processRequest(ClientConnection* client);
+    bool pipelineNextRequest(ClientConnection* client);
     
     bool shouldKeepAlive(ClientConnection* client);
-    void prepareForNextRequest(ClientConnection* client, int clientSocket);
+    void prepareForNextRequest(ClientConnection* client);
     
-    void handleCgiPipeRead(int pipeFd);
-    void handleCgiPipeWrite(int pipeFd);
+    void handleCgiPipeRead(ClientConnection* client);
+    void relayCgiOutput(ClientConnection* client);
+    void waitForCgiOutput(ClientConnection* client);
     void completeCgiRequest(ClientConnection* client, int fd);
-    void checkCgiTimeouts();
+    void passToFastCgi(ClientConnection* client);
+    void failFastCgi(ClientConnection* client);
+    void armTimer(ClientConnection* client, int seconds);
+    void beginResponse(ClientConnection* client);
+    void closeClient(ClientConnection* client);
+    void expireTimers();
+    void handleTimeout(ClientConnection* client);
+    void shutdown();
     
 public:
-    WebServer();
+    static const size_t READ_CHUNK = 256 * 1024;
+    static const size_t SENDFILE_CHUNK = 2 * 1024 * 1024;
+    static const size_t CGI_STREAM_BUFFER = 256 * 1024;
+    static const size_t ACCEPT_BATCH = 64;
+    static const size_t INITIAL_EVENT_BATCH = 64;
+    static const size_t MAX_EVENT_BATCH = 4096;
+    static const int EPOLL_TIMEOUT_MS = 1000;
+    
+    WebServer(Config& cfg, size_t id = 0);
     ~WebServer();
     
-    bool initialize(const std::string& configFile);
+    bool initialize(bool reusePort = false);
+    bool openListeners(bool reusePort);
+    bool startEventLoop();
     void run();
     void stop();
+    
+    void setWorkerId(size_t id);
+    size_t getWorkerId() const;
+    const WorkerStats& getStats() const;
 };
 
 #endif
@@ -0,0 +1,365 @@
+#include "../include/BufferChain.hpp"
+#include <cstring>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+BufferChain::BufferChain(BufferPool& bufferPool) : pool(&bufferPool), length(0) {}
+
+BufferChain::~BufferChain() {
+    clear();
+}
+
+size_t BufferChain::size() const {
+    return length;
+}
+
+bool BufferChain::empty() const {
+    return length == 0;
+}
+
+void BufferChain::releaseSegment(const Segment& seg) {
+    if (seg.shared)
+        seg.shared->release();
+    else
+        pool->release(seg.block);
+}
+
+bool BufferChain::tailWritable() const {
+    return !segments.empty() && !segments.back().shared && segments.back().end < BufferPool::BLOCK_SIZE;
+}
+
+void BufferChain::clear() {
+    for (size_t i = 0; i < segments.size(); ++i)
+        releaseSegment(segments[i]);
+    segments.clear();
+    length = 0;
+}
+
+void BufferChain::append(const char* data, size_t count) {
+    while (count > 0) {
+        if (!tailWritable()) {
+            Segment seg;
+            seg.block = pool->acquire();
+            seg.start = 0;
+            seg.end = 0;
+            seg.shared = NULL;
+            segments.push_back(seg);
+        }
+        Segment& tail = segments.back();
+        size_t chunk = BufferPool::BLOCK_SIZE - tail.end;
+        if (chunk > count)
+            chunk = count;
+        std::memcpy(tail.block + tail.end, data, chunk);
+        tail.end += chunk;
+        length += chunk;
+        data += chunk;
+        count -= chunk;
+    }
+}
+
+void BufferChain::append(const std::string& data) {
+    append(data.data(), data.size());
+}
+
+void BufferChain::assign(const std::string& data) {
+    clear();
+    append(data);
+}
+
+// References the whole buffer without copying it; the chain holds one reference
+// until the bytes have been consumed.
+void BufferChain::appendShared(SharedBuffer* buffer) {
+    appendShared(buffer, 0, buffer->size());
+}
+
+// References [offset, offset + count) of buffer, which must lie inside it.
+void BufferChain::appendShared(SharedBuffer* buffer, size_t offset, size_t count) {
+    if (count == 0)
+        return;
+    buffer->retain();
+    Segment seg;
+    seg.block = const_cast<char*>(buffer->data());
+    seg.start = offset;
+    seg.end = offset + count;
+    seg.shared = buffer;
+    segments.push_back(seg);
+    length += count;
+}
+
+// Moves every block of other to the end of this chain; both must share a pool.
+void BufferChain::splice(BufferChain& other) {
+    segments.insert(segments.end(), other.segments.begin(), other.segments.end());
+    length += other.length;
+    other.segments.clear();
+    other.length = 0;
+}
+
+void BufferChain::consume(size_t count) {
+    while (count > 0 && !segments.empty()) {
+        Segment& head = segments.front();
+        size_t available = head.end - head.start;
+        if (count < available) {
+            head.start += count;
+            length -= count;
+            return;
+        }
+        count -= available;
+        length -= available;
+        releaseSegment(head);
+        segments.pop_front();
+    }
+}
+
+// Moves [pos, size()) to the end of dest. Only the block holding pos is copied from;
+// the blocks after it change chains as they are.
+void BufferChain::moveTail(size_t pos, BufferChain& dest) {
+    if (pos >= length)
+        return;
+
+    size_t segIndex, offset;
+    locate(pos, segIndex, offset);
+    if (offset > 0) {
+        Segment& seg = segments[segIndex];
+        dest.append(seg.block + seg.start + offset, seg.end - seg.start - offset);
+        seg.end = seg.start + offset;
+        ++segIndex;
+    }
+    for (size_t i = segIndex; i < segments.size(); ++i) {
+        dest.segments.push_back(segments[i]);
+        dest.length += segments[i].end - segments[i].start;
+    }
+    segments.erase(segments.begin() + segIndex, segments.end());
+    length = pos;
+}
+
+// Drops [pos, pos + count). A cut inside a pool block moves the rest of that block down;
+// one inside a shared buffer becomes two segments of it.
+void BufferChain::erase(size_t pos, size_t count) {
+    if (pos >= length)
+        return;
+    if (count > length - pos)
+        count = length - pos;
+    length -= count;
+
+    size_t segIndex, offset;
+    locate(pos, segIndex, offset);
+    while (count > 0) {
+        Segment& seg = segments[segIndex];
+        size_t segLen = seg.end - seg.start;
+        size_t cut = (count < segLen - offset) ? count : segLen - offset;
+        count -= cut;
+        if (cut == segLen) {
+            releaseSegment(seg);
+            segments.erase(segments.begin() + segIndex);
+        } else if (offset + cut == segLen) {
+            seg.end -= cut;
+            ++segIndex;
+            offset = 0;
+        } else if (offset == 0) {
+            seg.start += cut;
+        } else if (seg.shared) {
+            Segment rest = seg;
+            rest.start = seg.start + offset + cut;
+            seg.end = seg.start + offset;
+            seg.shared->retain();
+            segments.insert(segments.begin() + segIndex + 1, rest);
+        } else {
+            std::memmove(seg.block + seg.start + offset, seg.block + seg.start + offset + cut,
+                         segLen - offset - cut);
+            seg.end -= cut;
+        }
+    }
+}
+
+void BufferChain::locate(size_t pos, size_t& segIndex, size_t& offset) const {
+    segIndex = 0;
+    while (segIndex < segments.size()) {
+        size_t segLen = segments[segIndex].end - segments[segIndex].start;
+        if (pos < segLen)
+            break;
+        pos -= segLen;
+        ++segIndex;
+    }
+    offset = pos;
+}
+
+bool BufferChain::matchesAt(size_t segIndex, size_t offset, const std::string& needle) const {
+    size_t matched = 0;
+    while (matched < needle.size() && segIndex < segments.size()) {
+        const Segment& seg = segments[segIndex];
+        size_t segLen = seg.end - seg.start;
+        size_t chunk = segLen - offset;
+        if (chunk > needle.size() - matched)
+            chunk = needle.size() - matched;
+        if (std::memcmp(seg.block + seg.start + offset, needle.data() + matched, chunk) != 0)
+            return false;
+        matched += chunk;
+        ++segIndex;
+        offset = 0;
+    }
+    return matched == needle.size();
+}
+
+size_t BufferChain::find(const std::string& needle, size_t from) const {
+    if (needle.empty() || from >= length || needle.size() > length - from)
+        return npos;
+
+    size_t segIndex, offset;
+    locate(from, segIndex, offset);
+    size_t pos = from;
+
+    for (; segIndex < segments.size(); ++segIndex, offset = 0) {
+        const Segment& seg = segments[segIndex];
+        const char* base = seg.block + seg.start;
+        size_t segLen = seg.end - seg.start;
+
+        while (offset < segLen) {
+            const char* hit = static_cast<const char*>(std::memchr(base + offset, needle[0], segLen - offset));
+            if (!hit) {
+                pos += segLen - offset;
+                break;
+            }
+            size_t hitOffset = hit - base;
+            pos += hitOffset - offset;
+            if (length - pos < needle.size())
+                return npos;
+            if (matchesAt(segIndex, hitOffset, needle))
+                return pos;
+            offset = hitOffset + 1;
+            ++pos;
+        }
+    }
+    return npos;
+}
+
+char BufferChain::at(size_t pos) const {
+    size_t segIndex, offset;
+    locate(pos, segIndex, offset);
+    return segments[segIndex].block[segments[segIndex].start + offset];
+}
+
+// Points data at the bytes from pos to the end of the block holding pos and returns
+// how many there are (0 at the end of the chain), so callers can walk the chain in place.
+size_t BufferChain::contiguous(size_t pos, const char*& data) const {
+    if (pos >= length)
+        return 0;
+    size_t segIndex, offset;
+    locate(pos, segIndex, offset);
+    const Segment& seg = segments[segIndex];
+    data = seg.block + seg.start + offset;
+    return seg.end - seg.start - offset;
+}
+
+std::string BufferChain::substr(size_t pos, size_t count) const {
+    std::string result;
+    if (pos >= length)
+        return result;
+    if (count > length - pos)
+        count = length - pos;
+    result.reserve(count);
+
+    size_t segIndex, offset;
+    locate(pos, segIndex, offset);
+    for (; count > 0 && segIndex < segments.size(); ++segIndex, offset = 0) {
+        const Segment& seg = segments[segIndex];
+        size_t chunk = seg.end - seg.start - offset;
+        if (chunk > count)
+            chunk = count;
+        result.append(seg.block + seg.start + offset, chunk);
+        count -= chunk;
+    }
+    return result;
+}
+
+// One readv() into the tail block plus enough fresh pool blocks to offer maxBytes of
+// space; blocks the kernel did not fill go straight back to the pool.
+// A non-negative offset reads with preadv() and leaves the file position alone.
+ssize_t BufferChain::readFrom(int fd, size_t maxBytes, off_t offset) {
+    struct iovec iov[MAX_IOV];
+    char* fresh[MAX_IOV];
+    int iovCount = 0;
+    int freshCount = 0;
+    size_t capacity = 0;
+
+    bool useTail = tailWritable();
+    if (useTail) {
+        Segment& tail = segments.back();
+        iov[0].iov_base = tail.block + tail.end;
+        iov[0].iov_len = BufferPool::BLOCK_SIZE - tail.end;
+        capacity = iov[0].iov_len;
+        iovCount = 1;
+    }
+    while (capacity < maxBytes && iovCount < MAX_IOV) {
+        fresh[freshCount] = pool->acquire();
+        iov[iovCount].iov_base = fresh[freshCount];
+        iov[iovCount].iov_len = BufferPool::BLOCK_SIZE;
+        capacity += BufferPool::BLOCK_SIZE;
+        ++iovCount;
+        ++freshCount;
+    }
+    if (capacity > maxBytes)
+        iov[iovCount - 1].iov_len -= capacity - maxBytes;
+
+    ssize_t bytesRead = (offset >= 0) ? preadv(fd, iov, iovCount, offset) : readv(fd, iov, iovCount);
+    size_t remaining = (bytesRead > 0) ? static_cast<size_t>(bytesRead) : 0;
+    length += remaining;
+
+    if (useTail) {
+        size_t chunk = (remaining < iov[0].iov_len) ? remaining : iov[0].iov_len;
+        segments.back().end += chunk;
+        remaining -= chunk;
+    }
+    for (int i = 0; i < freshCount; ++i) {
+        if (remaining == 0) {
+            pool->release(fresh[i]);
+            continue;
+        }
+        Segment seg;
+        seg.block = fresh[i];
+        seg.shared = NULL;
+        seg.start = 0;
+        seg.end = (remaining < BufferPool::BLOCK_SIZE) ? remaining : BufferPool::BLOCK_SIZE;
+        remaining -= seg.end;
+        segments.push_back(seg);
+    }
+    return bytesRead;
+}
+
+// Sends as many leading blocks as fit in one sendmsg() and consumes what was sent.
+// attempted receives the byte count offered, so callers can spot a short write.
+int BufferChain::fillIov(struct iovec* iov, size_t& attempted) const {
+    int iovCount = 0;
+    attempted = 0;
+    for (size_t i = 0; i < segments.size() && iovCount < MAX_IOV; ++i, ++iovCount) {
+        iov[iovCount].iov_base = segments[i].block + segments[i].start;
+        iov[iovCount].iov_len = segments[i].end - segments[i].start;
+        attempted += iov[iovCount].iov_len;
+    }
+    return iovCount;
+}
+
+ssize_t BufferChain::sendTo(int socketFd, size_t& attempted, int flags) {
+    struct iovec iov[MAX_IOV];
+    int iovCount = fillIov(iov, attempted);
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovCount;
+
+    ssize_t sent = sendmsg(socketFd, &msg, MSG_NOSIGNAL | flags);
+    if (sent > 0)
+        consume(static_cast<size_t>(sent));
+    return sent;
+}
+
+// writev() for descriptors that are not sockets, such as a CGI's stdin pipe.
+ssize_t BufferChain::writeTo(int fd, size_t& attempted) {
+    struct iovec iov[MAX_IOV];
+    int iovCount = fillIov(iov, attempted);
+
+    ssize_t written = writev(fd, iov, iovCount);
+    if (written > 0)
+        consume(static_cast<size_t>(written));
+    return written;
+}
@@ -0,0 +1,69 @@
+#include "../include/BufferPool.hpp"
+#include <new>
+#include <sys/mman.h>
+
+BufferPool::BufferPool() : idleSlabs(0), inUse(0) {}
+
+BufferPool::~BufferPool() {
+    for (std::map<char*, std::vector<char*> >::iterator it = slabs.begin(); it != slabs.end(); ++it)
+        munmap(it->first, BLOCK_SIZE * BLOCKS_PER_SLAB);
+}
+
+// Slabs are mapped directly rather than taken from the heap, so unmapping one always
+// gives its memory back.
+void BufferPool::addSlab() {
+    void* mapped = mmap(NULL, BLOCK_SIZE * BLOCKS_PER_SLAB, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+        throw std::bad_alloc();
+    char* slab = static_cast<char*>(mapped);
+    std::vector<char*>& freeBlocks = slabs[slab];
+    freeBlocks.reserve(BLOCKS_PER_SLAB);
+    for (size_t i = BLOCKS_PER_SLAB; i > 0; --i)
+        freeBlocks.push_back(slab + (i - 1) * BLOCK_SIZE);
+    available.insert(slab);
+    idleSlabs++;
+}
+
+char* BufferPool::acquire() {
+    if (available.empty())
+        addSlab();
+    char* slab = *available.begin();
+    std::vector<char*>& freeBlocks = slabs[slab];
+    if (freeBlocks.size() == BLOCKS_PER_SLAB)
+        idleSlabs--;
+    char* block = freeBlocks.back();
+    freeBlocks.pop_back();
+    if (freeBlocks.empty())
+        available.erase(slab);
+    inUse++;
+    return block;
+}
+
+void BufferPool::release(char* block) {
+    std::map<char*, std::vector<char*> >::iterator it = slabs.upper_bound(block);
+    --it;
+    std::vector<char*>& freeBlocks = it->second;
+    freeBlocks.push_back(block);
+    inUse--;
+    if (freeBlocks.size() == 1)
+        available.insert(it->first);
+    if (freeBlocks.size() < BLOCKS_PER_SLAB)
+        return;
+
+    if (idleSlabs < MAX_IDLE_SLABS) {
+        idleSlabs++;
+        return;
+    }
+    available.erase(it->first);
+    munmap(it->first, BLOCK_SIZE * BLOCKS_PER_SLAB);
+    slabs.erase(it);
+}
+
+size_t BufferPool::blocksInUse() const {
+    return inUse;
+}
+
+size_t BufferPool::slabCount() const {
+    return slabs.size();
+}
@@ -0,0 +1,236 @@
+#include "../include/ByteScan.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+# define BYTESCAN_X86 1
+# include <immintrin.h>
+#endif
+
+namespace ByteScan {
+
+namespace {
+    typedef size_t (*FirstOfFn)(const char*, size_t, char, char, char);
+    typedef size_t (*FindFn)(const char*, size_t, const char*, size_t);
+
+    size_t firstOfScalar(const char* data, size_t size, char a, char b, char c) {
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i] == a || data[i] == b || data[i] == c)
+                return i;
+        }
+        return size;
+    }
+
+    // memchr() on the first byte, then a compare of the rest.
+    size_t findScalar(const char* data, size_t size, const char* needle, size_t needleSize) {
+        size_t pos = 0;
+        while (size - pos >= needleSize) {
+            const char* hit = static_cast<const char*>(std::memchr(data + pos, needle[0], size - pos - needleSize + 1));
+            if (!hit)
+                return npos;
+            pos = hit - data;
+            if (std::memcmp(hit + 1, needle + 1, needleSize - 1) == 0)
+                return pos;
+            ++pos;
+        }
+        return npos;
+    }
+
+#ifdef BYTESCAN_X86
+    size_t firstOfSse2(const char* data, size_t size, char a, char b, char c) {
+        const __m128i va = _mm_set1_epi8(a);
+        const __m128i vb = _mm_set1_epi8(b);
+        const __m128i vc = _mm_set1_epi8(c);
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)),
+                                        _mm_cmpeq_epi8(block, vc));
+            unsigned mask = _mm_movemask_epi8(hits);
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + firstOfScalar(data + i, size - i, a, b, c);
+    }
+
+    // Candidates are the positions where both the first and the last byte of the needle
+    // match; only those are compared in full. Boundaries and CRLF sequences rarely pass.
+    size_t findSse2(const char* data, size_t size, const char* needle, size_t needleSize) {
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[needleSize - 1]);
+        size_t i = 0;
+        for (; size >= needleSize + 15 && i <= size - needleSize - 15; i += 16) {
+            __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + needleSize - 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+            while (mask) {
+                size_t candidate = i + __builtin_ctz(mask);
+                if (std::memcmp(data + candidate + 1, needle + 1, needleSize - 1) == 0)
+                    return candidate;
+                mask &= mask - 1;
+            }
+        }
+        size_t rest = findScalar(data + i, size - i, needle, needleSize);
+        return (rest == npos) ? npos : i + rest;
+    }
+
+    __attribute__((target("avx2")))
+    size_t firstOfAvx2(const char* data, size_t size, char a, char b, char c) {
+        const __m256i va = _mm256_set1_epi8(a);
+        const __m256i vb = _mm256_set1_epi8(b);
+        const __m256i vc = _mm256_set1_epi8(c);
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, va), _mm256_cmpeq_epi8(block, vb)),
+                                           _mm256_cmpeq_epi8(block, vc));
+            unsigned mask = _mm256_movemask_epi8(hits);
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + firstOfSse2(data + i, size - i, a, b, c);
+    }
+
+    __attribute__((target("avx2")))
+    size_t findAvx2(const char* data, size_t size, const char* needle, size_t needleSize) {
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[needleSize - 1]);
+        size_t i = 0;
+        for (; size >= needleSize + 31 && i <= size - needleSize - 31; i += 32) {
+            __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + needleSize - 1));
+            unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first),
+                                                                  _mm256_cmpeq_epi8(tail, last)));
+            while (mask) {
+                size_t candidate = i + __builtin_ctz(mask);
+                if (std::memcmp(data + candidate + 1, needle + 1, needleSize - 1) == 0)
+                    return candidate;
+                mask &= mask - 1;
+            }
+        }
+        size_t rest = findSse2(data + i, size - i, needle, needleSize);
+        return (rest == npos) ? npos : i + rest;
+    }
+#endif
+
+    Kernel detect() {
+#ifdef BYTESCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return AVX2;
+        return SSE2;
+#else
+        return SCALAR;
+#endif
+    }
+
+    Kernel current = SCALAR;
+    FirstOfFn firstOfKernel = firstOfScalar;
+    FindFn findKernel = findScalar;
+
+    struct Dispatch {
+        Dispatch() {
+            use(detect());
+        }
+    };
+    Dispatch dispatch;
+}
+
+Kernel best() {
+    return detect();
+}
+
+Kernel active() {
+    return current;
+}
+
+// Anything the CPU lacks falls back to the best it has; the benchmark uses this to
+// compare kernels.
+void use(Kernel kernel) {
+    if (kernel > best())
+        kernel = best();
+    current = kernel;
+    firstOfKernel = firstOfScalar;
+    findKernel = findScalar;
+#ifdef BYTESCAN_X86
+    if (kernel == SSE2) {
+        firstOfKernel = firstOfSse2;
+        findKernel = findSse2;
+    } else if (kernel == AVX2) {
+        firstOfKernel = firstOfAvx2;
+        findKernel = findAvx2;
+    }
+#endif
+}
+
+const char* name(Kernel kernel) {
+    if (kernel == AVX2)
+        return "avx2";
+    return (kernel == SSE2) ? "sse2" : "scalar";
+}
+
+// Index of the first byte equal to a, b or c, or size when there is none.
+size_t firstOf(const char* data, size_t size, char a, char b, char c) {
+    return firstOfKernel(data, size, a, b, c);
+}
+
+size_t find(const char* data, size_t size, const char* needle, size_t needleSize) {
+    if (needleSize == 0)
+        return 0;
+    if (needleSize > size)
+        return npos;
+    if (needleSize == 1) {
+        const char* hit = static_cast<const char*>(std::memchr(data, needle[0], size));
+        return hit ? static_cast<size_t>(hit - data) : npos;
+    }
+    return findKernel(data, size, needle, needleSize);
+}
+
+// std::string::find with the same result.
+size_t find(const std::string& haystack, const std::string& needle, size_t from) {
+    if (from > haystack.size())
+        return std::string::npos;
+    size_t pos = find(haystack.data() + from, haystack.size() - from, needle.data(), needle.size());
+    return (pos == npos) ? std::string::npos : from + pos;
+}
+
+Horspool::Horspool() {
+    assign("");
+}
+
+Horspool::Horspool(const std::string& needle) {
+    assign(needle);
+}
+
+// A byte that does not occur in the needle (last byte aside) moves the window its full
+// length; the others line up with their last occurrence.
+void Horspool::assign(const std::string& needle) {
+    pattern = needle;
+    for (size_t i = 0; i < 256; ++i)
+        shift[i] = pattern.size();
+    for (size_t i = 0; i + 1 < pattern.size(); ++i)
+        shift[static_cast<unsigned char>(pattern[i])] = pattern.size() - 1 - i;
+}
+
+const std::string& Horspool::needle() const {
+    return pattern;
+}
+
+// The vector kernels outrun the shift table when the CPU has them; without, the shift
+// table beats memchr() on the needle's first byte, which text bodies full of CRLF defeat.
+size_t Horspool::find(const char* data, size_t size) const {
+    size_t length = pattern.size();
+    if (current != SCALAR || length < 2)
+        return ByteScan::find(data, size, pattern.data(), length);
+    if (length > size)
+        return npos;
+    const char last = pattern[length - 1];
+    for (size_t pos = 0; pos <= size - length; ) {
+        char tail = data[pos + length - 1];
+        if (tail == last && std::memcmp(data + pos, pattern.data(), length - 1) == 0)
+            return pos;
+        pos += shift[static_cast<unsigned char>(tail)];
+    }
+    return npos;
+}
+
+}
@@ -0,0 +1,68 @@
+#include "../include/CgiCache.hpp"
+
+namespace {
+    size_t headerBytes(const CgiHeaders& headers) {
+        return headers.statusText.size() + headers.contentType.size() + headers.location.size()
+            + headers.contentLength.size() + headers.additional.size();
+    }
+}
+
+void CgiCache::Entry::release() {
+    response.body->release();
+    for (std::map<Compression::Coding, SharedBuffer*>::iterator variant = variants.begin();
+         variant != variants.end(); ++variant)
+        variant->second->release();
+}
+
+CgiCache::CgiCache(size_t capacityBytes) : entries(capacityBytes), expiredCount(0) {}
+
+// The returned response is borrowed; append its body with appendShared() before the
+// next insert() or addVariant().
+const CgiCache::Response* CgiCache::lookup(const std::string& key, unsigned long nowMs, bool& expired) {
+    Entry* stale = entries.peek(key);
+    expired = stale && nowMs >= stale->response.expiresAtMs;
+    if (expired) {
+        entries.remove(key);
+        expiredCount++;
+    }
+    Entry* entry = entries.lookup(key);
+    return entry ? &entry->response : NULL;
+}
+
+void CgiCache::insert(const std::string& key, const CgiHeaders& headers, SharedBuffer* body,
+                      unsigned long nowMs, unsigned long expiresAtMs) {
+    Entry entry;
+    entry.response.headers = headers;
+    entry.response.body = body;
+    entry.response.storedAtMs = nowMs;
+    entry.response.expiresAtMs = expiresAtMs;
+    if (entries.insert(key, entry, key.size() + headerBytes(headers) + body->size()))
+        body->retain();
+}
+
+SharedBuffer* CgiCache::findVariant(const std::string& key, Compression::Coding coding) {
+    Entry* entry = entries.peek(key);
+    if (!entry)
+        return NULL;
+    std::map<Compression::Coding, SharedBuffer*>::iterator variant = entry->variants.find(coding);
+    return (variant != entry->variants.end()) ? variant->second : NULL;
+}
+
+// Other entries may be evicted to fit the variant, never the one it belongs to.
+void CgiCache::addVariant(const std::string& key, Compression::Coding coding, SharedBuffer* body) {
+    Entry* entry = entries.peek(key);
+    if (!entry || entry->variants.count(coding) || !entries.grow(key, body->size()))
+        return;
+
+    body->retain();
+    entry->variants[coding] = body;
+}
+
+CgiCacheStats CgiCache::getStats() const {
+    CgiCacheStats stats;
+    stats.hits = entries.hits();
+    stats.misses = entries.misses();
+    stats.expired = expiredCount;
+    stats.evictions = entries.evictions();
+    return stats;
+}
@@ -1,16 +1,22 @@
 #include "../include/CgiHandler.hpp"
 #include "../include/HttpResponse.hpp"
 #include "../include/StringUtils.hpp"
+#include "../include/Compression.hpp"
+#include "../include/FastCgi.hpp"
+#include "../include/CgiCache.hpp"
+#include "../include/TimerWheel.hpp"
 #include <sstream>
 #include <iostream>
-#include <ctime>
 #include <sys/stat.h>
-#include <limits.h>
 #include <stdlib.h>
 
-CgiHandler::CgiHandler(Config& cfg) : config(cfg) {}
+CgiHandler::CgiHandler(Config& cfg, OpenFileCache& files, CgiLauncher& processLauncher)
+    : config(cfg), openFiles(files), launcher(processLauncher) {}
 
-CgiHandler::~CgiHandler() {}
+CgiHandler::~CgiHandler() {
+    for (std::map<const LocationConfig*, CgiCache*>::iterator it = caches.begin(); it != caches.end(); ++it)
+        delete it->second;
+}
 
 std::string CgiHandler::getCgiExtension(const std::string& path, const LocationConfig* location) {
     if (!location || location->cgiExt.empty())
@@ -54,28 +60,6 @@ bool CgiHandler::isCgiRequest(const std::string& path, const LocationConfig* loc
     return !getCgiExtension(path, location).empty();
 }
 
-std::string CgiHandler::getHeaderValue(const std::string& headers, const std::string& headerName) {
-    std::string searchKey = headerName + ":";
-    std::string headersLower = StringUtils::toLower(headers);
-    std::string keyLower = StringUtils::toLower(searchKey);
-    
-    size_t pos = headersLower.find(keyLower);
-    if (pos == std::string::npos)
-        return "";
-    
-    size_t valueStart = pos + searchKey.length();
-    while (valueStart < headers.size() && (headers[valueStart] == ' ' || headers[valueStart] == '\t'))
-        valueStart++;
-    
-    size_t valueEnd = headers.find("\r\n", valueStart);
-    if (valueEnd == std::string::npos)
-        valueEnd = headers.find("\n", valueStart);
-    if (valueEnd == std::string::npos)
-        valueEnd = headers.length();
-    
-    return headers.substr(valueStart, valueEnd - valueStart);
-}
-
 std::string CgiHandler::convertHeaderToEnvName(const std::string& headerName) {
     std::string envName = "HTTP_";
     for (size_t i = 0; i < headerName.size(); ++i) {
@@ -90,50 +74,22 @@ std::string CgiHandler::convertHeaderToEnvName(const std::string& headerName) {
     return envName;
 }
 
-std::vector<std::string> CgiHandler::buildHttpHeaderVars(const std::string& headers) {
+// Trailer fields of a chunked body are passed on like headers, unless a header of the
+// same name was sent or the server itself interprets that field.
+std::vector<std::string> CgiHandler::buildHttpHeaderVars(const ParsedRequest& request,
+                                                         const std::vector<RequestHeader>& trailers) {
     std::vector<std::string> vars;
-    size_t pos = 0;
-    
-    size_t lineEnd = headers.find("\r\n", pos);
-    if (lineEnd != std::string::npos)
-        pos = lineEnd + 2;
-    
-    while (pos < headers.length()) {
-        lineEnd = headers.find("\r\n", pos);
-        if (lineEnd == std::string::npos) {
-            lineEnd = headers.find("\n", pos);
-            if (lineEnd == std::string::npos)
-                break;
-        }
-        
-        std::string line = headers.substr(pos, lineEnd - pos);
-        if (line.empty())
-            break;
-        
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string name = line.substr(0, colonPos);
-            std::string value = StringUtils::trim(line.substr(colonPos + 1));
-            
-            std::string nameLower = StringUtils::toLower(name);
-            if (nameLower != "content-type" && nameLower != "content-length") {
-                vars.push_back(convertHeaderToEnvName(name) + "=" + value);
-            }
-        }
-        pos = lineEnd + 2;
+    for (size_t i = 0; i < request.headers.size(); ++i) {
+        const RequestHeader& header = request.headers[i];
+        if (header.id != ParsedRequest::CONTENT_TYPE && header.id != ParsedRequest::CONTENT_LENGTH)
+            vars.push_back(convertHeaderToEnvName(header.name) + "=" + header.value);
     }
-    return vars;
-}
-
-void CgiHandler::splitPathAndQuery(const std::string& fullPath, std::string& path, std::string& query) {
-    size_t queryPos = fullPath.find('?');
-    if (queryPos != std::string::npos) {
-        path = fullPath.substr(0, queryPos);
-        query = fullPath.substr(queryPos + 1);
-    } else {
-        path = fullPath;
-        query = "";
+    for (size_t i = 0; i < trailers.size(); ++i) {
+        const RequestHeader& trailer = trailers[i];
+        if (trailer.id == ParsedRequest::OTHER_HEADER && !request.find(trailer.name))
+            vars.push_back(convertHeaderToEnvName(trailer.name) + "=" + trailer.value);
     }
+    return vars;
 }
 
 std::string CgiHandler::extractPathInfo(const std::string& path, const std::string& scriptPath) {
@@ -161,10 +117,10 @@ void CgiHandler::addServerEnvVars(std::vector<std::string>& envVars, const Serve
 }
 
 void CgiHandler::addRequestEnvVars(std::vector<std::string>& envVars, ClientConnection* client,
-                                   const std::string& method, const std::string& absScriptPath,
+                                   const ParsedRequest& request, const std::string& absScriptPath,
                                    const std::string& pathInfo, const std::string& queryString,
-                                   const std::string& headers, size_t contentLength) {
-    envVars.push_back("REQUEST_METHOD=" + method);
+                                   size_t contentLength) {
+    envVars.push_back("REQUEST_METHOD=" + request.methodName);
     envVars.push_back("SCRIPT_NAME=" + client->cgiScriptName);
     envVars.push_back("SCRIPT_FILENAME=" + absScriptPath);
     
@@ -185,7 +141,7 @@ void CgiHandler::addRequestEnvVars(std::vector<std::string>& envVars, ClientConn
     if (contentLength > 0)
         envVars.push_back("CONTENT_LENGTH=" + StringUtils::sizeToString(contentLength));
     
-    std::string contentType = getHeaderValue(headers, "Content-Type");
+    const std::string& contentType = request.header(ParsedRequest::CONTENT_TYPE);
     if (!contentType.empty())
         envVars.push_back("CONTENT_TYPE=" + contentType);
     
@@ -194,51 +150,35 @@ void CgiHandler::addRequestEnvVars(std::vector<std::string>& envVars, ClientConn
     envVars.push_back("REDIRECT_STATUS=200");
 }
 
-char** CgiHandler::buildEnvironment(ClientConnection* client, const std::string& scriptPath,
-                                    const std::string& pathInfo, const std::string& queryString,
-                                    const std::string& method, const std::string& headers,
-                                    size_t contentLength) {
+std::vector<std::string> CgiHandler::buildEnvVars(ClientConnection* client, const std::string& scriptPath,
+                                                  const std::string& pathInfo, const std::string& queryString,
+                                                  const ParsedRequest& request, size_t contentLength) {
     std::vector<std::string> envVars;
     const ServerConfig& serverConfig = config.getServer(client->serverIndex);
     
-    char absolutePath[PATH_MAX];
-    std::string absScriptPath = scriptPath;
-    if (realpath(scriptPath.c_str(), absolutePath) != NULL)
-        absScriptPath = absolutePath;
+    const FileInfo& scriptInfo = openFiles.resolve(scriptPath);
+    std::string absScriptPath = scriptInfo.realPath.empty() ? scriptPath : scriptInfo.realPath;
     
     addServerEnvVars(envVars, serverConfig);
-    addRequestEnvVars(envVars, client, method, absScriptPath, pathInfo, queryString, headers, contentLength);
+    addRequestEnvVars(envVars, client, request, absScriptPath, pathInfo, queryString, contentLength);
     
     if (!pathInfo.empty())
         envVars.push_back("PATH_TRANSLATED=" + serverConfig.root + pathInfo);
     
-    std::vector<std::string> httpVars = buildHttpHeaderVars(headers);
+    std::vector<std::string> httpVars = buildHttpHeaderVars(request, client->chunked.trailers());
     for (size_t i = 0; i < httpVars.size(); ++i)
         envVars.push_back(httpVars[i]);
-    
-    char** env = new char*[envVars.size() + 1];
-    for (size_t i = 0; i < envVars.size(); ++i) {
-        env[i] = new char[envVars[i].size() + 1];
-        std::strcpy(env[i], envVars[i].c_str());
-    }
-    env[envVars.size()] = NULL;
-    return env;
-}
-
-void CgiHandler::freeEnvironment(char** env) {
-    if (!env)
-        return;
-    for (size_t i = 0; env[i] != NULL; ++i)
-        delete[] env[i];
-    delete[] env;
+    return envVars;
 }
 
+// Close-on-exec, so that no script inherits another one's pipes: a stray copy of a
+// stdin write end would keep that script from ever seeing EOF.
 bool CgiHandler::createPipes(int inputPipe[2], int outputPipe[2]) {
-    if (pipe(inputPipe) < 0) {
+    if (pipe2(inputPipe, O_CLOEXEC) < 0) {
         std::cerr << "CGI: Failed to create input pipe" << std::endl;
         return false;
     }
-    if (pipe(outputPipe) < 0) {
+    if (pipe2(outputPipe, O_CLOEXEC) < 0) {
         std::cerr << "CGI: Failed to create output pipe" << std::endl;
         close(inputPipe[0]);
         close(inputPipe[1]);
@@ -247,27 +187,6 @@ bool CgiHandler::createPipes(int inputPipe[2], int outputPipe[2]) {
     return true;
 }
 
-void CgiHandler::setupChildProcess(int inputPipe[2], int outputPipe[2], const std::string& scriptFilePath) {
-    close(inputPipe[1]);
-    close(outputPipe[0]);
-    
-    if (dup2(inputPipe[0], STDIN_FILENO) < 0) {
-        std::cerr << "CGI: dup2 stdin failed" << std::endl;
-        _exit(1);
-    }
-    close(inputPipe[0]);
-    
-    if (dup2(outputPipe[1], STDOUT_FILENO) < 0) {
-        std::cerr << "CGI: dup2 stdout failed" << std::endl;
-        _exit(1);
-    }
-    close(outputPipe[1]);
-    
-    std::string scriptDir = getScriptDirectory(scriptFilePath);
-    if (chdir(scriptDir.c_str()) < 0)
-        std::cerr << "CGI: chdir failed to " << scriptDir << std::endl;
-}
-
 bool CgiHandler::isStandaloneCgi(const std::string& interpreter) {
     return interpreter.find("php") == std::string::npos &&
            interpreter.find("python") == std::string::npos &&
@@ -275,29 +194,12 @@ bool CgiHandler::isStandaloneCgi(const std::string& interpreter) {
            interpreter.find("ruby") == std::string::npos;
 }
 
-void CgiHandler::executeChild(const std::string& interpreter, const std::string& scriptFilePath, char** env) {
-    std::string scriptName = scriptFilePath;
-    size_t lastSlash = scriptName.rfind('/');
-    if (lastSlash != std::string::npos)
-        scriptName = scriptName.substr(lastSlash + 1);
-    
-    char* argv[3];
-    argv[0] = const_cast<char*>(interpreter.c_str());
-    
-    if (isStandaloneCgi(interpreter)) {
-        argv[1] = NULL;
-    } else {
-        argv[1] = const_cast<char*>(scriptName.c_str());
-        argv[2] = NULL;
-    }
-    
-    execve(interpreter.c_str(), argv, env);
-    std::cerr << "CGI: execve failed for " << interpreter << std::endl;
-    _exit(1);
+std::string CgiHandler::getScriptBaseName(const std::string& scriptPath) {
+    size_t lastSlash = scriptPath.rfind('/');
+    return (lastSlash != std::string::npos) ? scriptPath.substr(lastSlash + 1) : scriptPath;
 }
 
-void CgiHandler::setupParentProcess(ClientConnection* client, int inputPipe[2], int outputPipe[2],
-                                    pid_t pid, const std::string& body) {
+void CgiHandler::setupParentProcess(ClientConnection* client, int inputPipe[2], int outputPipe[2], pid_t pid) {
     close(inputPipe[0]);
     close(outputPipe[1]);
     
@@ -312,11 +214,9 @@ void CgiHandler::setupParentProcess(ClientConnection* client, int inputPipe[2],
     client->cgiPid = pid;
     client->cgiInputFd = inputPipe[1];
     client->cgiOutputFd = outputPipe[0];
-    client->cgiBody = body;
-    client->cgiBodyOffset = 0;
+    client->cgiInput.clear();
+    client->cgiInputComplete = false;
     client->cgiOutputBuffer.clear();
-    client->cgiStartTime = std::time(NULL);
-    client->state = ClientConnection::CGI_RUNNING;
 }
 
 bool CgiHandler::validateCgiSetup(const std::string& path, const LocationConfig* location,
@@ -329,16 +229,16 @@ bool CgiHandler::validateCgiSetup(const std::string& path, const LocationConfig*
         return false;
     }
     
-    char interpreterAbsPath[PATH_MAX];
-    if (realpath(interpreter.c_str(), interpreterAbsPath) != NULL)
-        interpreter = interpreterAbsPath;
+    const FileInfo& interpreterInfo = openFiles.resolve(interpreter);
+    if (!interpreterInfo.realPath.empty())
+        interpreter = interpreterInfo.realPath;
     
-    if (access(interpreter.c_str(), X_OK) != 0) {
+    if (!interpreterInfo.executable) {
         std::cerr << "CGI: Interpreter not found or not executable: " << interpreter << std::endl;
         return false;
     }
     
-    if (access(scriptFilePath.c_str(), F_OK) != 0) {
+    if (openFiles.lookup(scriptFilePath).type == FileInfo::MISSING) {
         std::cerr << "CGI: Script not found: " << scriptFilePath << std::endl;
         return false;
     }
@@ -357,16 +257,17 @@ void CgiHandler::setScriptName(ClientConnection* client, const std::string& clea
     }
 }
 
-bool CgiHandler::startCgi(ClientConnection* client, const std::string& method,
-                         const std::string& path, const std::string& headers,
-                         const std::string& body, const LocationConfig* location,
+// Starts the script with its stdin and stdout pipes (see CgiLauncher); the caller feeds
+// the body into client->cgiInput, which may still be arriving, and says when it is complete.
+bool CgiHandler::startCgi(ClientConnection* client, const ParsedRequest& request,
+                         size_t contentLength, const LocationConfig* location,
                          const std::string& scriptFilePath) {
     std::string interpreter;
-    if (!validateCgiSetup(path, location, scriptFilePath, interpreter))
+    if (!validateCgiSetup(request.target, location, scriptFilePath, interpreter))
         return false;
     
-    std::string cleanPath, queryString;
-    splitPathAndQuery(path, cleanPath, queryString);
+    const std::string& cleanPath = request.path;
+    const std::string& queryString = request.query;
     
     std::string pathInfo = extractPathInfo(cleanPath, scriptFilePath);
     setScriptName(client, cleanPath);
@@ -375,12 +276,15 @@ bool CgiHandler::startCgi(ClientConnection* client, const std::string& method,
     if (!createPipes(inputPipe, outputPipe))
         return false;
     
-    char** env = buildEnvironment(client, scriptFilePath, pathInfo, queryString, method, headers, body.size());
+    CgiCommand command;
+    command.argv.push_back(interpreter);
+    if (!isStandaloneCgi(interpreter))
+        command.argv.push_back(getScriptBaseName(scriptFilePath));
+    command.env = buildEnvVars(client, scriptFilePath, pathInfo, queryString, request, contentLength);
+    command.directory = getScriptDirectory(scriptFilePath);
     
-    pid_t pid = fork();
+    pid_t pid = launcher.launch(command, inputPipe[0], outputPipe[1]);
     if (pid < 0) {
-        std::cerr << "CGI: Fork failed" << std::endl;
-        freeEnvironment(env);
         close(inputPipe[0]);
         close(inputPipe[1]);
         close(outputPipe[0]);
@@ -388,49 +292,55 @@ bool CgiHandler::startCgi(ClientConnection* client, const std::string& method,
         return false;
     }
     
-    if (pid == 0) {
-        setupChildProcess(inputPipe, outputPipe, scriptFilePath);
-        executeChild(interpreter, scriptFilePath, env);
-    }
-    
-    freeEnvironment(env);
-    setupParentProcess(client, inputPipe, outputPipe, pid, body);
+    setupParentProcess(client, inputPipe, outputPipe, pid);
+    client->cgiTimeout = location ? location->cgiTimeout : LocationConfig::DEFAULT_CGI_TIMEOUT;
+    client->cgiLocation = location;
+    client->cgiAcceptEncoding = request.header(ParsedRequest::ACCEPT_ENCODING);
     std::cout << "CGI: Started process " << pid << " for " << scriptFilePath << std::endl;
     return true;
 }
 
-ssize_t CgiHandler::writeToCgi(ClientConnection* client) {
-    if (client->cgiInputFd < 0)
-        return 0;
+// fastcgi_pass: no process of our own. The environment a forked script would get is
+// encoded as the request's FCGI_PARAMS; WebServer hands the request to the backend pool.
+void CgiHandler::startFastCgi(ClientConnection* client, const ParsedRequest& request,
+                              size_t contentLength, const LocationConfig* location,
+                              const std::string& scriptFilePath) {
+    std::string pathInfo = extractPathInfo(request.path, scriptFilePath);
+    setScriptName(client, request.path);
+    
+    std::vector<std::string> envVars = buildEnvVars(client, scriptFilePath, pathInfo, request.query,
+                                                    request, contentLength);
+    client->fastcgiParams.clear();
+    for (size_t i = 0; i < envVars.size(); ++i) {
+        size_t equals = envVars[i].find('=');
+        FastCgi::appendParam(client->fastcgiParams, envVars[i].substr(0, equals), envVars[i].substr(equals + 1));
+    }
     
-    if (client->cgiBodyOffset >= client->cgiBody.size())
+    client->cgiInput.clear();
+    client->cgiInputComplete = false;
+    client->cgiOutputBuffer.clear();
+    client->cgiTimeout = location->cgiTimeout;
+    client->cgiLocation = location;
+    client->cgiAcceptEncoding = request.header(ParsedRequest::ACCEPT_ENCODING);
+    std::cout << "FastCGI: Passing " << scriptFilePath << " to " << location->fastcgiPass << std::endl;
+}
+
+ssize_t CgiHandler::writeToCgi(ClientConnection* client) {
+    if (client->cgiInputFd < 0 || client->cgiInput.empty())
         return 0;
     
-    size_t remaining = client->cgiBody.size() - client->cgiBodyOffset;
-    size_t chunkSize = (remaining > 65536) ? 65536 : remaining;
-    ssize_t written = write(client->cgiInputFd, client->cgiBody.c_str() + client->cgiBodyOffset, chunkSize);
-    
-    if (written > 0)
-        client->cgiBodyOffset += written;
-    
-    return written;
+    size_t attempted;
+    return client->cgiInput.writeTo(client->cgiInputFd, attempted);
 }
 
 ssize_t CgiHandler::readFromCgi(ClientConnection* client) {
     if (client->cgiOutputFd < 0)
         return 0;
     
-    char buffer[1000000];
-    ssize_t bytesRead = read(client->cgiOutputFd, buffer, sizeof(buffer));
-    
-    if (bytesRead > 0)
-        client->cgiOutputBuffer.append(buffer, bytesRead);
-    
-    return bytesRead;
+    return client->cgiOutputBuffer.readFrom(client->cgiOutputFd, READ_CHUNK);
 }
 
-void CgiHandler::parseCgiHeader(const std::string& line, int& statusCode, std::string& statusText,
-                                std::string& contentType, std::string& location, std::string& additionalHeaders) {
+void CgiHandler::parseCgiHeader(const std::string& line, CgiHeaders& headers) {
     size_t colonPos = line.find(':');
     if (colonPos == std::string::npos)
         return;
@@ -442,48 +352,40 @@ void CgiHandler::parseCgiHeader(const std::string& line, int& statusCode, std::s
     if (nameLower == "status") {
         size_t spacePos = value.find(' ');
         if (spacePos != std::string::npos) {
-            statusCode = std::atoi(value.substr(0, spacePos).c_str());
-            statusText = value.substr(spacePos + 1);
+            headers.statusCode = std::atoi(value.substr(0, spacePos).c_str());
+            headers.statusText = value.substr(spacePos + 1);
         } else {
-            statusCode = std::atoi(value.c_str());
-            statusText = HttpResponse::getStatusText(statusCode);
+            headers.statusCode = std::atoi(value.c_str());
+            headers.statusText = HttpResponse::getStatusText(headers.statusCode);
         }
     } else if (nameLower == "content-type") {
-        contentType = value;
+        headers.contentType = value;
     } else if (nameLower == "location") {
-        location = value;
-        if (statusCode == 200) {
-            statusCode = 302;
-            statusText = "Found";
+        headers.location = value;
+        if (headers.statusCode == 200) {
+            headers.statusCode = 302;
+            headers.statusText = "Found";
         }
     } else if (nameLower == "content-length") {
-        return;
+        headers.contentLength = value;
     } else {
-        additionalHeaders += name + ": " + value + "\r\n";
+        headers.additional += name + ": " + value + "\r\n";
     }
 }
 
-void CgiHandler::buildResponse(ClientConnection* client) {
-    std::string& output = client->cgiOutputBuffer;
-    
+// Parses the script's header block off the front of its output. False while the
+// block is incomplete.
+bool CgiHandler::takeHeaders(BufferChain& output, CgiHeaders& headers) {
     size_t headerEnd = output.find("\r\n\r\n");
-    if (headerEnd == std::string::npos) {
+    if (headerEnd == BufferChain::npos) {
         headerEnd = output.find("\n\n");
-        if (headerEnd == std::string::npos) {
-            client->responseBuffer = HttpResponse::build500("CGI Error: Invalid output format", NULL);
-            return;
-        }
+        if (headerEnd == BufferChain::npos)
+            return false;
     }
     
-    size_t separatorLen = (output[headerEnd] == '\r') ? 4 : 2;
+    size_t separatorLen = (output.at(headerEnd) == '\r') ? 4 : 2;
     std::string cgiHeaders = output.substr(0, headerEnd);
-    std::string body = output.substr(headerEnd + separatorLen);
-    
-    int statusCode = 200;
-    std::string statusText = "OK";
-    std::string contentType = "text/html";
-    std::string location;
-    std::string additionalHeaders;
+    output.consume(headerEnd + separatorLen);
     
     size_t pos = 0;
     while (pos < cgiHeaders.length()) {
@@ -500,62 +402,332 @@ void CgiHandler::buildResponse(ClientConnection* client) {
         
         std::string line = cgiHeaders.substr(pos, lineEnd - pos);
         if (!line.empty())
-            parseCgiHeader(line, statusCode, statusText, contentType, location, additionalHeaders);
+            parseCgiHeader(line, headers);
         
         if (lineEnd >= cgiHeaders.length())
             break;
         pos = lineEnd + (hasCR ? 2 : 1);
     }
-    
+    return true;
+}
+
+// The status line and headers, up to the body framing the caller adds.
+std::string CgiHandler::responseHead(const CgiHeaders& headers) {
     std::ostringstream response;
-    response << "HTTP/1.1 " << statusCode << " " << statusText << "\r\n"
-             << "Content-Type: " << contentType << "\r\n"
-             << "Content-Length: " << body.size() << "\r\n";
+    response << "HTTP/1.1 " << headers.statusCode << " " << headers.statusText << "\r\n"
+             << "Content-Type: " << headers.contentType << "\r\n";
+    if (!headers.location.empty())
+        response << "Location: " << headers.location << "\r\n";
+    response << headers.additional;
+    return response.str();
+}
+
+// Adds Vary and picks the coding the body goes out in. Scripts that encode their own
+// output (Content-Encoding set) are left alone.
+Compression::Coding CgiHandler::chooseCoding(const LocationConfig* location, const std::string& acceptEncoding,
+                                             CgiHeaders& headers, size_t size) {
+    if (!Compression::appliesTo(location, headers.contentType)
+        || StringUtils::toLower(headers.additional).find("content-encoding:") != std::string::npos)
+        return Compression::IDENTITY;
+    headers.additional += "Vary: Accept-Encoding\r\n";
+    return Compression::negotiate(location, acceptEncoding, headers.contentType, size);
+}
+
+void CgiHandler::buildResponse(ClientConnection* client) {
+    BufferChain& output = client->cgiOutputBuffer;
+    
+    CgiHeaders headers;
+    if (!takeHeaders(output, headers)) {
+        client->responseBuffer.assign(HttpResponse::build500("CGI Error: Invalid output format", NULL));
+        return;
+    }
+    
+    const LocationConfig* location = client->cgiLocation;
+    if (location && location->cgiCache > 0 && location->cgiBuffering) {
+        int lifetime = client->cgiCacheKey.empty() ? 0 : cacheLifetime(headers, location);
+        if (lifetime > 0) {
+            CgiCache* cache = cacheFor(location);
+            SharedBuffer* body = new SharedBuffer(output.substr(0, output.size()));
+            unsigned long now = TimerWheel::monotonicMs();
+            output.clear();
+            cache->insert(client->cgiCacheKey, headers, body, now, now + lifetime * 1000UL);
+            headers.additional += "X-Cache-Status: " + client->cgiCacheStatus + "\r\n";
+            sendStored(client, location, client->cgiAcceptEncoding, cache, client->cgiCacheKey, headers, body);
+            body->release();
+            return;
+        }
+        headers.additional += "X-Cache-Status: "
+            + (client->cgiCacheStatus.empty() ? std::string("BYPASS") : client->cgiCacheStatus) + "\r\n";
+    }
+    
+    std::string packed;
+    bool compressed = false;
+    Compression::Coding coding = chooseCoding(location, client->cgiAcceptEncoding, headers, output.size());
+    if (coding != Compression::IDENTITY) {
+        std::string body = output.substr(0, output.size());
+        compressed = Compression::compress(body.data(), body.size(), coding, location->gzipCompLevel, packed);
+        if (compressed)
+            headers.additional += std::string("Content-Encoding: ") + Compression::name(coding) + "\r\n";
+    }
+    
+    client->responseBuffer.assign(responseHead(headers) + "Content-Length: "
+                                  + StringUtils::sizeToString(compressed ? packed.size() : output.size()) + "\r\n\r\n");
+    if (compressed) {
+        client->responseBuffer.append(packed);
+        output.clear();
+        return;
+    }
+    // The body blocks move over as they are, without being copied.
+    client->responseBuffer.splice(output);
+}
+
+// cgi_cache: a GET whose key is stored and fresh is answered here, without starting the
+// script. Otherwise the key is left on the client, and buildResponse stores the script's
+// response under it if the script allows.
+bool CgiHandler::serveCached(ClientConnection* client, const ParsedRequest& request,
+                             const LocationConfig* location) {
+    client->cgiCacheKey.clear();
+    client->cgiCacheStatus.clear();
+    if (!location || location->cgiCache == 0 || !location->cgiBuffering
+        || request.method != ParsedRequest::METHOD_GET)
+        return false;
+    
+    CgiCache* cache = cacheFor(location);
+    std::string key = cacheKey(request, location);
+    unsigned long now = TimerWheel::monotonicMs();
+    bool expired;
+    const CgiCache::Response* cached = cache->lookup(key, now, expired);
+    if (!cached) {
+        client->cgiCacheKey = key;
+        client->cgiCacheStatus = expired ? "EXPIRED" : "MISS";
+        return false;
+    }
+    
+    CgiHeaders headers = cached->headers;
+    headers.additional += "X-Cache-Status: HIT\r\nAge: "
+        + StringUtils::sizeToString((now - cached->storedAtMs) / 1000) + "\r\n";
+    SharedBuffer* body = cached->body;
+    body->retain();
+    sendStored(client, location, request.header(ParsedRequest::ACCEPT_ENCODING), cache, key, headers, body);
+    body->release();
+    std::cout << "CGI: Cache hit for " << key << std::endl;
+    return true;
+}
+
+// A stored body, compressed for this client if gzip applies. The encoded copy is kept
+// with the entry, so each coding is compressed once per stored response.
+void CgiHandler::sendStored(ClientConnection* client, const LocationConfig* location, const std::string& acceptEncoding,
+                            CgiCache* cache, const std::string& key, CgiHeaders headers, SharedBuffer* body) {
+    SharedBuffer* sent = body;
+    sent->retain();
+    Compression::Coding coding = chooseCoding(location, acceptEncoding, headers, body->size());
+    if (coding != Compression::IDENTITY) {
+        SharedBuffer* packed = cache->findVariant(key, coding);
+        std::string encoded;
+        if (packed) {
+            packed->retain();
+        } else if (Compression::compress(body->data(), body->size(), coding, location->gzipCompLevel, encoded)) {
+            packed = new SharedBuffer(encoded);
+            cache->addVariant(key, coding, packed);
+        }
+        if (packed) {
+            sent->release();
+            sent = packed;
+            headers.additional += std::string("Content-Encoding: ") + Compression::name(coding) + "\r\n";
+        }
+    }
     
-    if (!location.empty())
-        response << "Location: " << location << "\r\n";
+    client->responseBuffer.assign(responseHead(headers) + "Content-Length: "
+                                  + StringUtils::sizeToString(sent->size()) + "\r\n\r\n");
+    client->responseBuffer.appendShared(sent);
+    sent->release();
+}
+
+CgiCache* CgiHandler::cacheFor(const LocationConfig* location) {
+    CgiCache*& cache = caches[location];
+    if (!cache)
+        cache = new CgiCache(location->cgiCache);
+    return cache;
+}
+
+// cgi_cache_key with its variables filled in from the request; the parts are joined
+// with spaces.
+std::string CgiHandler::cacheKey(const ParsedRequest& request, const LocationConfig* location) {
+    std::string key;
+    for (size_t i = 0; i < location->cgiCacheKey.size(); ++i) {
+        const std::string& part = location->cgiCacheKey[i];
+        if (i > 0)
+            key += ' ';
+        size_t pos = 0;
+        size_t dollar;
+        while ((dollar = part.find('$', pos)) != std::string::npos) {
+            key.append(part, pos, dollar - pos);
+            size_t end = part.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789_", dollar + 1);
+            if (end == std::string::npos)
+                end = part.size();
+            std::string name = part.substr(dollar + 1, end - dollar - 1);
+            if (name == "request_method") {
+                key += request.methodName;
+            } else if (name == "uri") {
+                key += request.path;
+            } else if (name == "args") {
+                key += request.query;
+            } else if (name == "host") {
+                key += request.header(ParsedRequest::HOST);
+            } else {
+                std::string header = name.substr(5);
+                for (size_t j = 0; j < header.size(); ++j) {
+                    if (header[j] == '_')
+                        header[j] = '-';
+                }
+                const std::string* value = request.find(header);
+                if (value)
+                    key += *value;
+            }
+            pos = end;
+        }
+        key.append(part, pos, std::string::npos);
+    }
+    return key;
+}
+
+// Seconds the script's response may be served from cgi_cache, 0 if it may not be kept.
+// Only 200, 301 and 302 are, and never with Set-Cookie, Vary: * or Cache-Control
+// no-store, no-cache or private. s-maxage, then max-age, replaces cgi_cache_valid.
+int CgiHandler::cacheLifetime(const CgiHeaders& headers, const LocationConfig* location) {
+    if (headers.statusCode != 200 && headers.statusCode != 301 && headers.statusCode != 302)
+        return 0;
     
-    response << additionalHeaders << "\r\n" << body;
-    client->responseBuffer = response.str();
+    int maxAge = -1;
+    int sMaxAge = -1;
+    std::vector<std::string> lines = StringUtils::split(StringUtils::toLower(headers.additional), '\n');
+    for (size_t i = 0; i < lines.size(); ++i) {
+        size_t colon = lines[i].find(':');
+        if (colon == std::string::npos)
+            continue;
+        std::string name = StringUtils::trim(lines[i].substr(0, colon));
+        std::string value = StringUtils::trim(lines[i].substr(colon + 1));
+        if (name == "set-cookie" || (name == "vary" && value == "*"))
+            return 0;
+        if (name != "cache-control")
+            continue;
+        std::vector<std::string> directives = StringUtils::split(value, ',');
+        for (size_t j = 0; j < directives.size(); ++j) {
+            std::string directive = StringUtils::trim(directives[j]);
+            if (directive == "no-store" || directive == "no-cache" || directive == "private")
+                return 0;
+            if (directive.compare(0, 8, "max-age=") == 0)
+                maxAge = std::atoi(directive.c_str() + 8);
+            else if (directive.compare(0, 9, "s-maxage=") == 0)
+                sMaxAge = std::atoi(directive.c_str() + 9);
+        }
+    }
+    if (sMaxAge >= 0)
+        return sMaxAge;
+    if (maxAge >= 0)
+        return maxAge;
+    return location->cgiCacheValid;
+}
+
+// Sums the counters of every location's cache; false if no location has one yet.
+bool CgiHandler::getCacheStats(CgiCacheStats& total) const {
+    for (std::map<const LocationConfig*, CgiCache*>::const_iterator it = caches.begin(); it != caches.end(); ++it) {
+        const CgiCacheStats& stats = it->second->getStats();
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        total.expired += stats.expired;
+        total.evictions += stats.evictions;
+    }
+    return !caches.empty();
 }
 
-bool CgiHandler::hasTimedOut(ClientConnection* client, int timeoutSeconds) {
-    if (client->cgiStartTime == 0)
+// cgi_buffering off: once the header block is in, the response head goes out with the
+// script's own Content-Length, or chunked framing (close-delimited for HTTP/1.0), and
+// the body follows as it is read. False while the header block is incomplete.
+bool CgiHandler::beginStream(ClientConnection* client) {
+    CgiHeaders headers;
+    if (!takeHeaders(client->cgiOutputBuffer, headers))
         return false;
-    return (std::time(NULL) - client->cgiStartTime) >= timeoutSeconds;
+    
+    const ParsedRequest& request = client->parser.request();
+    std::string framing;
+    char* end = NULL;
+    unsigned long length = std::strtoul(headers.contentLength.c_str(), &end, 10);
+    client->cgiChunked = false;
+    client->cgiBodyLeft = BufferChain::npos;
+    if (headers.statusCode == 204 || headers.statusCode == 304) {
+        client->cgiBodyLeft = 0;
+    } else if (!headers.contentLength.empty() && *end == '\0' && headers.contentLength[0] != '-') {
+        client->cgiBodyLeft = length;
+        framing = "Content-Length: " + StringUtils::sizeToString(length) + "\r\n";
+    } else if (request.versionMajor == 1 && request.versionMinor >= 1) {
+        client->cgiChunked = true;
+        framing = "Transfer-Encoding: chunked\r\n";
+    } else {
+        client->closeAfterResponse = true;
+        framing = "Connection: close\r\n";
+    }
+    
+    client->responseBuffer.assign(responseHead(headers) + framing + "\r\n");
+    client->cgiStreaming = true;
+    relayOutput(client);
+    return true;
+}
+
+// Moves what the script wrote since the last call into the response, framed.
+void CgiHandler::relayOutput(ClientConnection* client) {
+    BufferChain& output = client->cgiOutputBuffer;
+    if (client->cgiBodyLeft != BufferChain::npos) {
+        // Anything past the announced length is dropped.
+        if (output.size() > client->cgiBodyLeft)
+            output.erase(client->cgiBodyLeft, output.size() - client->cgiBodyLeft);
+        client->cgiBodyLeft -= output.size();
+    }
+    if (output.empty())
+        return;
+    if (client->cgiChunked) {
+        std::ostringstream size;
+        size << std::hex << output.size() << "\r\n";
+        client->responseBuffer.append(size.str());
+        client->responseBuffer.splice(output);
+        client->responseBuffer.append("\r\n", 2);
+        return;
+    }
+    client->responseBuffer.splice(output);
+}
+
+// The script's output ended. A body shorter than its Content-Length can only be
+// signalled by closing the connection.
+void CgiHandler::endStream(ClientConnection* client) {
+    relayOutput(client);
+    if (client->cgiChunked)
+        client->responseBuffer.append("0\r\n\r\n", 5);
+    else if (client->cgiBodyLeft != 0)
+        client->closeAfterResponse = true;
+    client->cgiStreaming = false;
 }
 
 void CgiHandler::killCgi(ClientConnection* client) {
     if (client->cgiPid > 0) {
-        kill(client->cgiPid, SIGKILL);
-        int status;
-        waitpid(client->cgiPid, &status, WNOHANG);
+        launcher.kill(client->cgiPid);
         client->cgiPid = -1;
     }
     cleanup(client);
 }
 
 void CgiHandler::cleanup(ClientConnection* client) {
-    client->cgiBody.clear();
+    client->cgiCacheKey.clear();
+    client->cgiCacheStatus.clear();
+    client->cgiInput.clear();
+    client->cgiInputComplete = false;
     client->cgiOutputBuffer.clear();
-    client->cgiBodyOffset = 0;
-    client->cgiStartTime = 0;
+    client->cgiStreaming = false;
+    client->cgiChunked = false;
 }
 
-bool CgiHandler::checkCgiComplete(ClientConnection* client) {
-    if (client->cgiPid <= 0)
-        return true;
-    
-    int status;
-    pid_t result = waitpid(client->cgiPid, &status, WNOHANG);
-    
-    if (result > 0) {
-        if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
-            std::cerr << "CGI: Process exited with code " << WEXITSTATUS(status) << std::endl;
-        else if (WIFSIGNALED(status))
-            std::cerr << "CGI: Process killed by signal " << WTERMSIG(status) << std::endl;
+void CgiHandler::checkCgiComplete(ClientConnection* client) {
+    if (client->cgiPid > 0) {
+        launcher.reap(client->cgiPid);
         client->cgiPid = -1;
-        return true;
     }
-    return false;
 }
@@ -0,0 +1,502 @@
+#include "../include/CgiLauncher.hpp"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+namespace {
+    // Only there so that a child exit interrupts ppoll() in the helper.
+    void onChildExit(int) {}
+}
+
+bool CgiLauncher::parseMode(const std::string& value, Mode& mode) {
+    if (value == "fork")
+        mode = FORK;
+    else if (value == "spawn")
+        mode = SPAWN;
+    else if (value == "zygote")
+        mode = ZYGOTE;
+    else
+        return false;
+    return true;
+}
+
+const char* CgiLauncher::modeName(Mode mode) {
+    if (mode == SPAWN)
+        return "spawn";
+    if (mode == ZYGOTE)
+        return "zygote";
+    return "fork";
+}
+
+CgiLauncher::CgiLauncher() : mode(FORK), zygotePid(-1), zygoteFd(-1) {}
+
+CgiLauncher::~CgiLauncher() {
+    stop();
+}
+
+// Must run before the worker starts any threads: the helper is a plain fork() that
+// goes on running C++ code.
+bool CgiLauncher::start(Mode launchMode) {
+    mode = launchMode;
+    if (mode != ZYGOTE)
+        return true;
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        std::cerr << "CGI: Failed to create launcher socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "CGI: Failed to fork launcher: " << strerror(errno) << std::endl;
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        zygoteFd = fds[1];
+        runZygote();
+        _exit(0);
+    }
+
+    close(fds[1]);
+    zygoteFd = fds[0];
+    zygotePid = pid;
+    std::cout << "CGI: Launcher process " << pid << " started" << std::endl;
+    return true;
+}
+
+// The helper exits once its end of the socket reports EOF.
+void CgiLauncher::stop() {
+    if (zygoteFd >= 0) {
+        close(zygoteFd);
+        zygoteFd = -1;
+    }
+    if (zygotePid > 0) {
+        waitpid(zygotePid, NULL, 0);
+        zygotePid = -1;
+    }
+}
+
+CgiLauncher::Mode CgiLauncher::getMode() const {
+    return mode;
+}
+
+// Returns the script's pid, or -1 if it could not be started. The caller keeps its
+// own copies of stdinFd and stdoutFd and closes them afterwards.
+pid_t CgiLauncher::launch(const CgiCommand& command, int stdinFd, int stdoutFd) {
+    collect();
+    if (mode == ZYGOTE)
+        return askZygote(command, stdinFd, stdoutFd);
+    if (mode == SPAWN)
+        return spawnChild(command, stdinFd, stdoutFd);
+    return forkChild(command, stdinFd, stdoutFd);
+}
+
+void CgiLauncher::kill(pid_t pid) {
+    if (mode == ZYGOTE) {
+        MessageHeader header;
+        header.type = KILL;
+        header.length = 0;
+        header.pid = pid;
+        if (writeFully(zygoteFd, &header, sizeof(header)))
+            return;
+        zygoteGone();
+    }
+
+    ::kill(pid, SIGKILL);
+    exiting.push_back(pid);
+    collect();
+}
+
+// Called once the script's output has ended; it usually exits a moment later, and is
+// then waited for by a later call. The helper waits for its own children.
+void CgiLauncher::reap(pid_t pid) {
+    if (mode == ZYGOTE)
+        return;
+    exiting.push_back(pid);
+    collect();
+}
+
+// Waits for the scripts handed to kill() or reap() that had not exited yet. The worker
+// calls it once per event loop pass, so a killed script is not left as a zombie until
+// the next one is started.
+void CgiLauncher::collect() {
+    size_t kept = 0;
+    for (size_t i = 0; i < exiting.size(); ++i) {
+        int status;
+        pid_t result = waitpid(exiting[i], &status, WNOHANG);
+        if (result == 0)
+            exiting[kept++] = exiting[i];
+        else if (result > 0)
+            logExit(status);
+    }
+    exiting.resize(kept);
+}
+
+// Everything the child needs is prepared here: in multi-threaded mode only
+// async-signal-safe calls are allowed between fork() and execve().
+pid_t CgiLauncher::forkChild(const CgiCommand& command, int stdinFd, int stdoutFd) {
+    char** argv = buildVector(command.argv);
+    char** env = buildVector(command.env);
+
+    pid_t pid = fork();
+    if (pid == 0)
+        execChild(argv, env, command.directory, stdinFd, stdoutFd);
+    if (pid < 0)
+        std::cerr << "CGI: Fork failed" << std::endl;
+
+    freeVector(argv);
+    freeVector(env);
+    return pid;
+}
+
+pid_t CgiLauncher::spawnChild(const CgiCommand& command, int stdinFd, int stdoutFd) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    posix_spawn_file_actions_adddup2(&actions, stdinFd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, stdoutFd, STDOUT_FILENO);
+    posix_spawn_file_actions_addchdir_np(&actions, command.directory.c_str());
+
+    // The server ignores SIGPIPE and worker threads block signals; scripts get the
+    // defaults back.
+    sigset_t defaults, mask;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGCHLD);
+    sigemptyset(&mask);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &mask);
+
+    char** argv = buildVector(command.argv);
+    char** env = buildVector(command.env);
+    pid_t pid;
+    int err = posix_spawn(&pid, argv[0], &actions, &attr, argv, env);
+    freeVector(argv);
+    freeVector(env);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (err != 0) {
+        std::cerr << "CGI: posix_spawn failed for " << command.argv[0] << ": " << strerror(err) << std::endl;
+        return -1;
+    }
+    return pid;
+}
+
+pid_t CgiLauncher::askZygote(const CgiCommand& command, int stdinFd, int stdoutFd) {
+    std::string payload = encode(command);
+    MessageHeader header;
+    header.type = LAUNCH;
+    header.length = static_cast<uint32_t>(payload.size());
+    header.pid = 0;
+
+    struct iovec iov;
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    std::memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = { stdinFd, stdoutFd };
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(zygoteFd, &msg, 0);
+    } while (sent < 0 && errno == EINTR);
+
+    int32_t pid;
+    if (sent == static_cast<ssize_t>(sizeof(header))
+        && writeFully(zygoteFd, payload.data(), payload.size())
+        && readFully(zygoteFd, &pid, sizeof(pid)))
+        return pid;
+
+    zygoteGone();
+    return spawnChild(command, stdinFd, stdoutFd);
+}
+
+void CgiLauncher::zygoteGone() {
+    std::cerr << "CGI: Launcher process " << zygotePid << " is gone, spawning directly" << std::endl;
+    stop();
+    mode = SPAWN;
+}
+
+void CgiLauncher::runZygote() {
+    closeInheritedFds();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    // SIGCHLD is only let through while waiting, so no exit slips in between the
+    // reaping and the wait.
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &onChildExit;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    sigset_t blocked, waiting;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting);
+    sigdelset(&waiting, SIGCHLD);
+
+    while (true) {
+        reapZygoteChildren();
+        struct pollfd pfd;
+        pfd.fd = zygoteFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = ppoll(&pfd, 1, NULL, &waiting);
+        if (ready < 0 && errno != EINTR)
+            break;
+        if (ready > 0 && !serveZygoteRequest())
+            break;
+    }
+    reapZygoteChildren();
+}
+
+// Returns false once the worker has closed its end.
+bool CgiLauncher::serveZygoteRequest() {
+    MessageHeader header;
+    struct iovec iov;
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do {
+        received = recvmsg(zygoteFd, &msg, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0)
+        return false;
+    if (static_cast<size_t>(received) < sizeof(header)
+        && !readFully(zygoteFd, reinterpret_cast<char*>(&header) + received, sizeof(header) - received))
+        return false;
+
+    int fds[2] = { -1, -1 };
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+        && cmsg->cmsg_len == CMSG_LEN(sizeof(fds)))
+        std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    if (header.type == KILL) {
+        if (std::find(zygoteChildren.begin(), zygoteChildren.end(), header.pid) != zygoteChildren.end())
+            ::kill(header.pid, SIGKILL);
+        return true;
+    }
+
+    std::string payload(header.length, '\0');
+    if (header.length > 0 && !readFully(zygoteFd, &payload[0], payload.size()))
+        return false;
+
+    CgiCommand command;
+    int32_t pid = -1;
+    if (header.type == LAUNCH && fds[0] >= 0 && decode(payload, command)) {
+        char** argv = buildVector(command.argv);
+        char** env = buildVector(command.env);
+        pid = fork();
+        if (pid == 0)
+            execChild(argv, env, command.directory, fds[0], fds[1]);
+        if (pid < 0)
+            std::cerr << "CGI: Fork failed" << std::endl;
+        else
+            zygoteChildren.push_back(pid);
+        freeVector(argv);
+        freeVector(env);
+    }
+    if (fds[0] >= 0)
+        close(fds[0]);
+    if (fds[1] >= 0)
+        close(fds[1]);
+    return writeFully(zygoteFd, &pid, sizeof(pid));
+}
+
+void CgiLauncher::reapZygoteChildren() {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        std::vector<pid_t>::iterator it = std::find(zygoteChildren.begin(), zygoteChildren.end(), pid);
+        if (it != zygoteChildren.end())
+            zygoteChildren.erase(it);
+        logExit(status);
+    }
+}
+
+// The helper is forked from a worker that has its listeners, its epoll instance and,
+// with worker_threads, the other workers' launcher sockets open.
+void CgiLauncher::closeInheritedFds() {
+    std::vector<int> fds;
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir) {
+        int own = dirfd(dir);
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int fd = std::atoi(entry->d_name);
+            if (entry->d_name[0] != '.' && fd != own)
+                fds.push_back(fd);
+        }
+        closedir(dir);
+    } else {
+        long maxFd = sysconf(_SC_OPEN_MAX);
+        for (int fd = 0; fd < maxFd && fd < 65536; ++fd)
+            fds.push_back(fd);
+    }
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+        if (fds[i] > STDERR_FILENO && fds[i] != zygoteFd)
+            close(fds[i]);
+    }
+}
+
+char** CgiLauncher::buildVector(const std::vector<std::string>& strings) {
+    char** vector = new char*[strings.size() + 1];
+    for (size_t i = 0; i < strings.size(); ++i) {
+        vector[i] = new char[strings[i].size() + 1];
+        std::strcpy(vector[i], strings[i].c_str());
+    }
+    vector[strings.size()] = NULL;
+    return vector;
+}
+
+void CgiLauncher::freeVector(char** vector) {
+    for (size_t i = 0; vector[i] != NULL; ++i)
+        delete[] vector[i];
+    delete[] vector;
+}
+
+// Runs in the forked child. The pipe ends are close-on-exec, except where dup2()
+// puts them.
+void CgiLauncher::execChild(char** argv, char** env, const std::string& directory,
+                            int stdinFd, int stdoutFd) {
+    if (dup2(stdinFd, STDIN_FILENO) < 0 || dup2(stdoutFd, STDOUT_FILENO) < 0) {
+        std::cerr << "CGI: dup2 failed" << std::endl;
+        _exit(1);
+    }
+    if (stdinFd == STDIN_FILENO)
+        fcntl(STDIN_FILENO, F_SETFD, 0);
+    if (stdoutFd == STDOUT_FILENO)
+        fcntl(STDOUT_FILENO, F_SETFD, 0);
+
+    // The server ignores SIGPIPE; scripts get the default disposition back.
+    signal(SIGPIPE, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+
+    if (chdir(directory.c_str()) < 0)
+        std::cerr << "CGI: chdir failed to " << directory << std::endl;
+
+    execve(argv[0], argv, env);
+    std::cerr << "CGI: execve failed for " << argv[0] << std::endl;
+    _exit(1);
+}
+
+// directory, argv, an empty string, env; each NUL-terminated.
+std::string CgiLauncher::encode(const CgiCommand& command) {
+    std::string payload;
+    payload.append(command.directory).push_back('\0');
+    for (size_t i = 0; i < command.argv.size(); ++i)
+        payload.append(command.argv[i]).push_back('\0');
+    payload.push_back('\0');
+    for (size_t i = 0; i < command.env.size(); ++i)
+        payload.append(command.env[i]).push_back('\0');
+    return payload;
+}
+
+bool CgiLauncher::decode(const std::string& payload, CgiCommand& command) {
+    std::vector<std::string>* target = NULL;
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        size_t end = payload.find('\0', pos);
+        if (end == std::string::npos)
+            return false;
+        std::string value = payload.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (!target) {
+            command.directory = value;
+            target = &command.argv;
+        } else if (value.empty() && target == &command.argv) {
+            target = &command.env;
+        } else {
+            target->push_back(value);
+        }
+    }
+    return !command.argv.empty() && target == &command.env;
+}
+
+bool CgiLauncher::readFully(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool CgiLauncher::writeFully(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+void CgiLauncher::logExit(int status) {
+    if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+        std::cerr << "CGI: Process exited with code " << WEXITSTATUS(status) << std::endl;
+    else if (WIFSIGNALED(status))
+        std::cerr << "CGI: Process killed by signal " << WTERMSIG(status) << std::endl;
+}
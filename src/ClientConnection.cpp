@@ -1,46 +1,128 @@
 #include "../include/ClientConnection.hpp"
 #include <unistd.h>
 
-ClientConnection::ClientConnection(int socket, size_t servIdx)
+ClientConnection::ClientConnection(int socket, size_t servIdx, BufferPool& pool)
 	: fd(socket)
 	, serverIndex(servIdx)
 	, state(READING_REQUEST)
+	, slot(0)
+	, closed(false)
+	, readable(false)
+	, writable(false)
+	, handle(EventHandle::CLIENT, this, servIdx)
+	, cgiInputHandle(EventHandle::CGI_STDIN, this, servIdx)
+	, cgiOutputHandle(EventHandle::CGI_STDOUT, this, servIdx)
+	, timer(this)
+	, requestBuffer(pool)
+	, pipelineBuffer(pool)
+	, pipelinedResponses(pool)
+	, pipelinedCount(0)
+	, responseBuffer(pool)
 	, bytesSent(0)
+	, fileFd(-1)
+	, fileOffset(0)
+	, fileRemaining(0)
+	, closeAfterResponse(false)
 	, headersComplete(false)
-	, headerEndOffset(0)
 	, bodyBytesReceived(0)
 	, maxBodySize(0)
+	, requestBody(pool)
+	, bodyStreamed(0)
+	, bodyPaused(false)
 	, cgiPid(-1)
 	, cgiInputFd(-1)
 	, cgiOutputFd(-1)
-	, cgiBodyOffset(0)
-	, cgiStartTime(0)
-{}
+	, cgiInput(pool)
+	, cgiInputComplete(false)
+	, cgiOutputBuffer(pool)
+	, cgiStreaming(false)
+	, cgiChunked(false)
+	, cgiBodyLeft(BufferChain::npos)
+	, cgiTimeout(0)
+	, cgiLocation(NULL)
+	, fastcgi(NULL)
+	, fastcgiId(0)
+{
+	handle.fd = socket;
+}
 
 ClientConnection::~ClientConnection() {
+	closeFile();
 	if (cgiInputFd >= 0)
 		close(cgiInputFd);
 	if (cgiOutputFd >= 0)
 		close(cgiOutputFd);
 }
 
+// Drops the finished request and its response. pipelineBuffer is kept: it already
+// holds the start of the next request.
 void ClientConnection::clearBuffers() {
-	requestBuffer.clear();
+	resetRequest();
 	responseBuffer.clear();
+	responseStatus.clear();
 	bytesSent = 0;
+	closeFile();
+	closeAfterResponse = false;
+}
+
+void ClientConnection::resetRequest() {
+	requestBuffer.clear();
+	parser.reset();
 	headersComplete = false;
-	headerEndOffset = 0;
 	bodyBytesReceived = 0;
+	chunked.reset(0);
+	requestBody.clear();
+	upload.reset();
+	bodyStreamed = 0;
+	bodyPaused = false;
 }
 
 bool ClientConnection::isResponseComplete() const {
-	return bytesSent >= responseBuffer.length();
+	return !hasOutput() && !cgiStreaming;
+}
+
+bool ClientConnection::hasOutput() const {
+	return !responseBuffer.empty() || fileFd >= 0;
+}
+
+// A streamed CGI response has sent all it has; the rest depends on the script.
+bool ClientConnection::isWaitingForCgi() const {
+	return cgiStreaming && !hasOutput();
+}
+
+// The response body continues with [offset, offset + length) of fd once
+// responseBuffer has been sent; the connection owns fd from here on.
+void ClientConnection::attachFile(int fd, off_t offset, off_t length) {
+	closeFile();
+	fileFd = fd;
+	fileOffset = offset;
+	fileRemaining = length;
+}
+
+void ClientConnection::queueFileRange(const std::string& header, off_t offset, off_t length) {
+	fileRanges.push_back(FileRange(header, offset, length));
+}
+
+// Called once the current slice is sent: the next queued part's header goes into the
+// chain and its slice becomes current. The file is closed when nothing is left.
+void ClientConnection::nextFileRange() {
+	while (fileRemaining == 0 && !fileRanges.empty()) {
+		responseBuffer.append(fileRanges.front().header);
+		fileOffset = fileRanges.front().offset;
+		fileRemaining = fileRanges.front().length;
+		fileRanges.pop_front();
+	}
+	if (fileRemaining == 0)
+		closeFile();
 }
 
-size_t ClientConnection::getRemainingBytes() const {
-	if (bytesSent >= responseBuffer.length())
-		return 0;
-	return responseBuffer.length() - bytesSent;
+void ClientConnection::closeFile() {
+	if (fileFd >= 0)
+		close(fileFd);
+	fileFd = -1;
+	fileOffset = 0;
+	fileRemaining = 0;
+	fileRanges.clear();
 }
 
 void ClientConnection::resetCgiState() {
@@ -53,13 +135,20 @@ void ClientConnection::resetCgiState() {
 		cgiOutputFd = -1;
 	}
 	cgiPid = -1;
-	cgiBody.clear();
-	cgiBodyOffset = 0;
+	cgiInput.clear();
+	cgiInputComplete = false;
 	cgiOutputBuffer.clear();
+	cgiStreaming = false;
+	cgiChunked = false;
 	cgiScriptName.clear();
-	cgiStartTime = 0;
+	cgiTimeout = 0;
+	cgiLocation = NULL;
+	cgiAcceptEncoding.clear();
+	cgiCacheKey.clear();
+	cgiCacheStatus.clear();
+	fastcgiParams.clear();
 }
 
 bool ClientConnection::isCgiActive() const {
-	return cgiPid > 0 || cgiInputFd >= 0 || cgiOutputFd >= 0;
+	return cgiPid > 0 || cgiInputFd >= 0 || cgiOutputFd >= 0 || fastcgi != NULL;
 }
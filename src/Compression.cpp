@@ -0,0 +1,83 @@
+#include "../include/Compression.hpp"
+#include "../include/StringUtils.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+namespace Compression {
+
+// q-value Accept-Encoding gives coding, falling back to "*"; negative when not accepted at all.
+double quality(const std::string& acceptEncoding, const std::string& coding) {
+    double wildcard = -1;
+    std::vector<std::string> items = StringUtils::split(acceptEncoding, ',');
+    for (size_t i = 0; i < items.size(); ++i) {
+        size_t semicolon = items[i].find(';');
+        std::string itemName = StringUtils::toLower(StringUtils::trim(items[i].substr(0, semicolon)));
+        double value = 1.0;
+        if (semicolon != std::string::npos) {
+            std::string params = StringUtils::toLower(items[i].substr(semicolon + 1));
+            size_t q = params.find("q=");
+            if (q != std::string::npos)
+                value = std::atof(params.c_str() + q + 2);
+        }
+        if (itemName == coding || (coding == "gzip" && itemName == "x-gzip"))
+            return value;
+        if (itemName == "*")
+            wildcard = value;
+    }
+    return wildcard;
+}
+
+// Whether responses of this type vary by Accept-Encoding at all (parameters such as
+// charset are ignored).
+bool appliesTo(const LocationConfig* location, const std::string& contentType) {
+    if (!location || !location->gzip)
+        return false;
+    std::string type = StringUtils::toLower(StringUtils::trim(contentType.substr(0, contentType.find(';'))));
+    for (size_t i = 0; i < location->gzipTypes.size(); ++i) {
+        if (location->gzipTypes[i] == "*" || location->gzipTypes[i] == type)
+            return true;
+    }
+    return false;
+}
+
+Coding negotiate(const LocationConfig* location, const std::string& acceptEncoding,
+                 const std::string& contentType, size_t size) {
+    if (!appliesTo(location, contentType) || size < location->gzipMinLength || size > MAX_BODY_SIZE)
+        return IDENTITY;
+    double gzipQuality = quality(acceptEncoding, "gzip");
+    double deflateQuality = quality(acceptEncoding, "deflate");
+    if (gzipQuality > 0 && gzipQuality >= deflateQuality)
+        return GZIP;
+    if (deflateQuality > 0)
+        return DEFLATE;
+    return IDENTITY;
+}
+
+const char* name(Coding coding) {
+    return (coding == GZIP) ? "gzip" : (coding == DEFLATE) ? "deflate" : "identity";
+}
+
+// "deflate" is the zlib format (RFC 1950) that HTTP asks for, not a raw deflate stream.
+bool compress(const char* data, size_t size, Coding coding, int level, std::string& out) {
+    if (coding == IDENTITY || size > MAX_BODY_SIZE)
+        return false;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    int windowBits = (coding == GZIP) ? MAX_WBITS + 16 : MAX_WBITS;
+    if (deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    out.resize(deflateBound(&stream, size));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = size;
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = out.size();
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+}
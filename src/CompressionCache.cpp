@@ -0,0 +1,37 @@
+#include "../include/CompressionCache.hpp"
+
+CompressionCache::CompressionCache(size_t capacityBytes) : entries(capacityBytes) {}
+
+bool CompressionCache::isEnabled() const {
+    return entries.isEnabled();
+}
+
+// The returned body is borrowed; append it with appendShared() before the next insert().
+SharedBuffer* CompressionCache::lookup(const std::string& key, const std::string& etag) {
+    if (!isEnabled())
+        return NULL;
+    Entry* stale = entries.peek(key);
+    if (stale && stale->etag != etag)
+        entries.remove(key);
+    Entry* entry = entries.lookup(key);
+    return entry ? entry->body : NULL;
+}
+
+void CompressionCache::insert(const std::string& key, const std::string& etag, SharedBuffer* body) {
+    if (!isEnabled())
+        return;
+
+    Entry entry;
+    entry.body = body;
+    entry.etag = etag;
+    if (entries.insert(key, entry, body->size()))
+        body->retain();
+}
+
+CompressionCacheStats CompressionCache::getStats() const {
+    CompressionCacheStats stats;
+    stats.hits = entries.hits();
+    stats.misses = entries.misses();
+    stats.evictions = entries.evictions();
+    return stats;
+}
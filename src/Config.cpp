@@ -1,15 +1,31 @@
 #include "../include/Config.hpp"
 #include "../include/StringUtils.hpp"
+#include <cstdlib>
+#include <unistd.h>
 
 LocationConfig::LocationConfig() 
     : path("/"), root(""), alias(""), index(""), autoindex(false), hasAutoindex(false),
-      uploadStore(""), redirect(""), clientMaxBodySize(0), hasClientMaxBodySize(false) {}
+      uploadStore(""), redirect(""), clientMaxBodySize(0), hasClientMaxBodySize(false),
+      cgiTimeout(DEFAULT_CGI_TIMEOUT), cgiBuffering(true), fastcgiKeepalive(DEFAULT_FASTCGI_KEEPALIVE), cgiCache(0), cgiCacheValid(DEFAULT_CGI_CACHE_VALID),
+      expires(EXPIRES_OFF), expiresSeconds(0),
+      gzipStatic(false), gzip(false), gzipTypes(1, "text/html"),
+      gzipMinLength(DEFAULT_GZIP_MIN_LENGTH), gzipCompLevel(DEFAULT_GZIP_COMP_LEVEL) {
+    cgiCacheKey.push_back("$request_method");
+    cgiCacheKey.push_back("$uri?$args");
+}
 
 ServerConfig::ServerConfig() 
-    : host("127.0.0.1"), port(8080), root("./www"),
-      index("index.html"), autoindex(false), clientMaxBodySize(1048576) {}
+    : host("127.0.0.1"), port(8080), backlog(DEFAULT_BACKLOG), root("./www"),
+      index("index.html"), autoindex(false), clientMaxBodySize(1048576),
+      clientHeaderTimeout(DEFAULT_CLIENT_HEADER_TIMEOUT), clientBodyTimeout(DEFAULT_CLIENT_BODY_TIMEOUT),
+      keepaliveTimeout(DEFAULT_KEEPALIVE_TIMEOUT), sendTimeout(DEFAULT_SEND_TIMEOUT),
+      sendfileThreshold(DEFAULT_SENDFILE_THRESHOLD), staticCacheSize(0),
+      staticCacheMaxEntry(DEFAULT_STATIC_CACHE_MAX_ENTRY), gzipCacheSize(0), openFileCacheMax(0),
+      openFileCacheValid(DEFAULT_OPEN_FILE_CACHE_VALID), openFileCacheErrors(false),
+      pipelineDepth(DEFAULT_PIPELINE_DEPTH) {}
 
-Config::Config() : configFile("") {}
+Config::Config() : configFile(""), workerProcesses(1), workerThreads(1), workerCpuAffinity(false), edgeTriggered(false),
+    cgiLauncher(CgiLauncher::FORK) {}
 
 Config::~Config() {}
 
@@ -70,7 +86,196 @@ bool Config::parseLocationDirective(const std::string& directive, const std::vec
         }
         location.clientMaxBodySize = static_cast<size_t>(bodySize);
         location.hasClientMaxBodySize = true;
+    } else if (directive == "cgi_timeout" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 1, location.cgiTimeout);
+    } else if (directive == "cgi_buffering" && tokens.size() >= 2) {
+        location.cgiBuffering = (tokens[1] != "off");
+    } else if (directive == "fastcgi_pass" && tokens.size() >= 2) {
+        return parseFastCgiPass(tokens[1], location);
+    } else if (directive == "fastcgi_keepalive" && tokens.size() >= 2) {
+        return parseCount(directive, tokens[1], location.fastcgiKeepalive);
+    } else if (directive == "cgi_cache" && tokens.size() >= 2) {
+        if (tokens[1] == "off") {
+            location.cgiCache = 0;
+            return true;
+        }
+        return parseByteCount(directive, tokens[1], location.cgiCache);
+    } else if (directive == "cgi_cache_valid" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 1, location.cgiCacheValid);
+    } else if (directive == "cgi_cache_key" && tokens.size() >= 2) {
+        return parseCgiCacheKey(tokens, location);
+    } else if (directive == "expires" && tokens.size() >= 2) {
+        return parseExpires(tokens[1], location);
+    } else if (directive == "gzip_static" && tokens.size() >= 2) {
+        location.gzipStatic = (tokens[1] == "on");
+    } else if (directive == "gzip" && tokens.size() >= 2) {
+        location.gzip = (tokens[1] == "on");
+    } else if (directive == "gzip_types" && tokens.size() >= 2) {
+        location.gzipTypes.assign(1, "text/html");
+        for (size_t i = 1; i < tokens.size(); ++i)
+            location.gzipTypes.push_back(StringUtils::toLower(tokens[i]));
+    } else if (directive == "gzip_min_length" && tokens.size() >= 2) {
+        return parseByteCount(directive, tokens[1], location.gzipMinLength);
+    } else if (directive == "gzip_comp_level" && tokens.size() >= 2) {
+        return parseGzipCompLevel(tokens[1], location);
+    } else if (directive == "cache_control" && tokens.size() >= 2) {
+        location.cacheControl = "";
+        for (size_t i = 1; i < tokens.size(); ++i) {
+            if (i > 1) location.cacheControl += " ";
+            location.cacheControl += tokens[i];
+        }
+    }
+    return true;
+}
+
+// value as a number if it is nothing but decimal digits, at most maxDigits of them so
+// that it cannot overflow a long; -1 otherwise.
+long Config::parseDigits(const std::string& value, size_t maxDigits) {
+    if (value.empty() || value.length() > maxDigits || value.find_first_not_of("0123456789") != std::string::npos)
+        return -1;
+    return std::strtol(value.c_str(), NULL, 10);
+}
+
+// expires off | epoch | max | [-]N[s|m|h|d]
+bool Config::parseExpires(const std::string& value, LocationConfig& location) {
+    if (value == "off" || value == "epoch" || value == "max") {
+        location.expires = (value == "off") ? LocationConfig::EXPIRES_OFF
+                         : (value == "epoch") ? LocationConfig::EXPIRES_EPOCH
+                         : LocationConfig::EXPIRES_MAX;
+        return true;
+    }
+    
+    std::string digits = (!value.empty() && value[0] == '-') ? value.substr(1) : value;
+    long unit = 1;
+    if (!digits.empty()) {
+        char suffix = digits[digits.length() - 1];
+        unit = (suffix == 'm') ? 60 : (suffix == 'h') ? 3600 : (suffix == 'd') ? 86400 : 1;
+        if (suffix == 's' || unit > 1)
+            digits.erase(digits.length() - 1);
+    }
+    long seconds = parseDigits(digits);
+    if (seconds > 0)
+        seconds *= unit;
+    if (seconds < 0 || seconds > LocationConfig::MAX_EXPIRES) {
+        std::cerr << "Error: Invalid expires " << value
+                  << " (expected off, epoch, max or a time such as 30d)" << std::endl;
+        return false;
+    }
+    location.expires = LocationConfig::EXPIRES_AFTER;
+    location.expiresSeconds = (value[0] == '-') ? -seconds : seconds;
+    return true;
+}
+
+bool Config::parseGzipCompLevel(const std::string& value, LocationConfig& location) {
+    if (value.length() != 1 || value[0] < '1' || value[0] > '9') {
+        std::cerr << "Error: Invalid gzip_comp_level " << value << " (must be 1-9)" << std::endl;
+        return false;
+    }
+    location.gzipCompLevel = value[0] - '0';
+    return true;
+}
+
+// fastcgi_pass unix:/path | host:port
+bool Config::parseFastCgiPass(const std::string& value, LocationConfig& location) {
+    bool valid;
+    if (value.compare(0, 5, "unix:") == 0) {
+        valid = value.length() > 5;
+    } else {
+        size_t colonPos = value.rfind(':');
+        std::string port = (colonPos != std::string::npos) ? value.substr(colonPos + 1) : "";
+        long number = parseDigits(port, 5);
+        valid = colonPos > 0 && number >= 1 && number <= 65535;
+    }
+    if (!valid) {
+        std::cerr << "Error: Invalid fastcgi_pass " << value << " (expected unix:/path or host:port)" << std::endl;
+        return false;
+    }
+    location.fastcgiPass = value;
+    return true;
+}
+
+// cgi_cache_key part... where each part is literal text with $request_method, $uri, $args,
+// $host or $http_<header> in it
+bool Config::parseCgiCacheKey(const std::vector<std::string>& tokens, LocationConfig& location) {
+    location.cgiCacheKey.assign(tokens.begin() + 1, tokens.end());
+    for (size_t i = 1; i < tokens.size(); ++i) {
+        size_t pos = tokens[i].find('$');
+        while (pos != std::string::npos) {
+            size_t end = tokens[i].find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789_", pos + 1);
+            std::string name = tokens[i].substr(pos + 1, (end == std::string::npos) ? std::string::npos : end - pos - 1);
+            if (name != "request_method" && name != "uri" && name != "args" && name != "host"
+                && (name.compare(0, 5, "http_") != 0 || name.length() == 5)) {
+                std::cerr << "Error: Unknown variable $" << name << " in cgi_cache_key" << std::endl;
+                return false;
+            }
+            pos = tokens[i].find('$', pos + 1);
+        }
+    }
+    return true;
+}
+
+// Accepts seconds, optionally suffixed with 's' (e.g. "30" or "30s").
+bool Config::parseTimeout(const std::string& directive, const std::string& value, int minimum, int& seconds) {
+    std::string digits = value;
+    if (!digits.empty() && digits[digits.length() - 1] == 's')
+        digits.erase(digits.length() - 1);
+    
+    long parsed = parseDigits(digits);
+    if (parsed < minimum || parsed > MAX_TIMEOUT) {
+        std::cerr << "Error: Invalid " << directive << " " << value
+                  << " (must be " << minimum << "-" << MAX_TIMEOUT << " seconds)" << std::endl;
+        return false;
+    }
+    seconds = static_cast<int>(parsed);
+    return true;
+}
+
+bool Config::parseByteCount(const std::string& directive, const std::string& value, size_t& bytes) {
+    long parsed = parseDigits(value, 18);
+    if (parsed < 0) {
+        std::cerr << "Error: Invalid " << directive << " " << value
+                  << " (must be a byte count)" << std::endl;
+        return false;
+    }
+    bytes = static_cast<size_t>(parsed);
+    return true;
+}
+
+bool Config::parseCount(const std::string& directive, const std::string& value, size_t& count) {
+    long parsed = parseDigits(value);
+    if (parsed < 1) {
+        std::cerr << "Error: Invalid " << directive << " " << value
+                  << " (must be a positive integer)" << std::endl;
+        return false;
     }
+    count = static_cast<size_t>(parsed);
+    return true;
+}
+
+// open_file_cache off | max=N
+bool Config::parseOpenFileCache(const std::vector<std::string>& tokens, ServerConfig& server) {
+    if (tokens.size() == 2 && tokens[1] == "off") {
+        server.openFileCacheMax = 0;
+        return true;
+    }
+    std::string count = (tokens[1].compare(0, 4, "max=") == 0) ? tokens[1].substr(4) : "";
+    long max = parseDigits(count);
+    if (tokens.size() != 2 || max < 1) {
+        std::cerr << "Error: Invalid open_file_cache (expected off or max=N with N > 0)" << std::endl;
+        return false;
+    }
+    server.openFileCacheMax = static_cast<size_t>(max);
+    return true;
+}
+
+bool Config::parsePipelineDepth(const std::string& value, ServerConfig& server) {
+    long depth = parseDigits(value);
+    if (depth < 1 || depth > static_cast<long>(ServerConfig::MAX_PIPELINE_DEPTH)) {
+        std::cerr << "Error: Invalid pipeline_depth " << value
+                  << " (must be 1-" << ServerConfig::MAX_PIPELINE_DEPTH << ")" << std::endl;
+        return false;
+    }
+    server.pipelineDepth = static_cast<size_t>(depth);
     return true;
 }
 
@@ -130,6 +335,21 @@ bool Config::parseListenDirective(const std::vector<std::string>& tokens, Server
         std::cerr << "Error: Invalid port number " << server.port << " (must be 1-65535)" << std::endl;
         return false;
     }
+    
+    for (size_t i = 2; i < tokens.size(); ++i) {
+        if (tokens[i].compare(0, 8, "backlog=") != 0) {
+            std::cerr << "Error: Unknown listen parameter " << tokens[i] << std::endl;
+            return false;
+        }
+        std::string value = tokens[i].substr(8);
+        long backlog = parseDigits(value);
+        if (backlog < 1 || backlog > 65535) {
+            std::cerr << "Error: Invalid listen backlog " << value
+                      << " (must be 1-65535)" << std::endl;
+            return false;
+        }
+        server.backlog = static_cast<int>(backlog);
+    }
     return true;
 }
 
@@ -150,6 +370,30 @@ bool Config::parseServerDirective(const std::string& directive, const std::vecto
             return false;
         }
         server.clientMaxBodySize = static_cast<size_t>(bodySize);
+    } else if (directive == "client_header_timeout" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 1, server.clientHeaderTimeout);
+    } else if (directive == "client_body_timeout" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 1, server.clientBodyTimeout);
+    } else if (directive == "keepalive_timeout" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 0, server.keepaliveTimeout);
+    } else if (directive == "send_timeout" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 1, server.sendTimeout);
+    } else if (directive == "sendfile_threshold" && tokens.size() >= 2) {
+        return parseByteCount(directive, tokens[1], server.sendfileThreshold);
+    } else if (directive == "static_cache_size" && tokens.size() >= 2) {
+        return parseByteCount(directive, tokens[1], server.staticCacheSize);
+    } else if (directive == "static_cache_max_entry" && tokens.size() >= 2) {
+        return parseByteCount(directive, tokens[1], server.staticCacheMaxEntry);
+    } else if (directive == "gzip_cache_size" && tokens.size() >= 2) {
+        return parseByteCount(directive, tokens[1], server.gzipCacheSize);
+    } else if (directive == "open_file_cache" && tokens.size() >= 2) {
+        return parseOpenFileCache(tokens, server);
+    } else if (directive == "open_file_cache_valid" && tokens.size() >= 2) {
+        return parseTimeout(directive, tokens[1], 1, server.openFileCacheValid);
+    } else if (directive == "open_file_cache_errors" && tokens.size() >= 2) {
+        server.openFileCacheErrors = (tokens[1] == "on");
+    } else if (directive == "pipeline_depth" && tokens.size() >= 2) {
+        return parsePipelineDepth(tokens[1], server);
     } else if (directive == "error_page" && tokens.size() >= 3) {
         std::string errorPagePath = tokens[tokens.size() - 1];
         for (size_t i = 1; i < tokens.size() - 1; ++i) {
@@ -210,9 +454,52 @@ bool Config::parseServerBlock(std::ifstream& file, std::string& line) {
     return true;
 }
 
+bool Config::parseWorkerCount(const std::string& directive, const std::string& value, size_t& count) {
+    if (value == "auto") {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = (cpus > 0) ? static_cast<size_t>(cpus) : 1;
+        return true;
+    }
+    
+    long parsed = parseDigits(value);
+    if (parsed < 1 || parsed > MAX_WORKERS) {
+        std::cerr << "Error: Invalid " << directive << " " << value
+                  << " (must be 1-" << MAX_WORKERS << " or auto)" << std::endl;
+        return false;
+    }
+    count = static_cast<size_t>(parsed);
+    return true;
+}
+
+bool Config::parseGlobalDirective(const std::vector<std::string>& tokens) {
+    const std::string& directive = tokens[0];
+    
+    if (directive == "worker_processes" && tokens.size() >= 2) {
+        return parseWorkerCount(directive, tokens[1], workerProcesses);
+    } else if (directive == "worker_threads" && tokens.size() >= 2) {
+        return parseWorkerCount(directive, tokens[1], workerThreads);
+    } else if (directive == "worker_cpu_affinity" && tokens.size() >= 2) {
+        workerCpuAffinity = (tokens[1] == "on" || tokens[1] == "auto");
+    } else if (directive == "edge_triggered" && tokens.size() >= 2) {
+        edgeTriggered = (tokens[1] == "on");
+    } else if (directive == "cgi_launcher" && tokens.size() >= 2) {
+        if (!CgiLauncher::parseMode(tokens[1], cgiLauncher)) {
+            std::cerr << "Error: Invalid cgi_launcher " << tokens[1]
+                      << " (expected fork, spawn or zygote)" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
 bool Config::loadFromFile(const std::string& filename) {
     configFile = filename;
     servers.clear();
+    workerProcesses = 1;
+    workerThreads = 1;
+    workerCpuAffinity = false;
+    edgeTriggered = false;
+    cgiLauncher = CgiLauncher::FORK;
     
     std::ifstream file(filename.c_str());
     if (!file.is_open()) {
@@ -232,6 +519,14 @@ bool Config::loadFromFile(const std::string& filename) {
                 file.close();
                 return false;
             }
+            continue;
+        }
+        
+        line = removeSemicolon(removeInlineComment(line));
+        std::vector<std::string> tokens = split(line, ' ');
+        if (!tokens.empty() && !parseGlobalDirective(tokens)) {
+            file.close();
+            return false;
         }
     }
     
@@ -242,6 +537,11 @@ bool Config::loadFromFile(const std::string& filename) {
         return false;
     }
     
+    if (workerProcesses > 1 && workerThreads > 1) {
+        std::cerr << "Error: worker_processes and worker_threads cannot both be greater than 1" << std::endl;
+        return false;
+    }
+    
     return true;
 }
 
@@ -272,3 +572,23 @@ std::string Config::getRoot() const {
 std::string Config::getIndex() const {
     return servers.empty() ? "index.html" : servers[0].index;
 }
+
+size_t Config::getWorkerProcesses() const {
+    return workerProcesses;
+}
+
+size_t Config::getWorkerThreads() const {
+    return workerThreads;
+}
+
+bool Config::getWorkerCpuAffinity() const {
+    return workerCpuAffinity;
+}
+
+bool Config::getEdgeTriggered() const {
+    return edgeTriggered;
+}
+
+CgiLauncher::Mode Config::getCgiLauncher() const {
+    return cgiLauncher;
+}
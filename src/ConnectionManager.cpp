@@ -4,118 +4,166 @@
 #include <cstring>
 #include <cerrno>
 
-ConnectionManager::ConnectionManager(int epoll_fd) : epollFd(epoll_fd) {}
+ConnectionManager::ConnectionManager(int epoll_fd, BufferPool& pool, bool edge)
+	: epollFd(epoll_fd), bufferPool(pool), edgeTriggered(edge), fastcgiPool(epoll_fd, pool) {}
 
 ConnectionManager::~ConnectionManager() {
 	closeAllClients();
 }
 
-void ConnectionManager::addClient(int clientSocket, size_t serverIndex) {
-	ClientConnection* client = new ClientConnection(clientSocket, serverIndex);
-	clients.push_back(client);
+bool ConnectionManager::registerHandle(EventHandle& handle, int fd, uint32_t events) {
+	struct epoll_event ev;
+	ev.events = events;
+	ev.data.ptr = &handle;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return false;
+	handle.fd = fd;
+	return true;
 }
 
-void ConnectionManager::removeClient(int clientSocket) {
-	ClientConnection* client = findClient(clientSocket);
-	if (client)
-		removeCgiPipes(client);
-
-	epoll_ctl(epollFd, EPOLL_CTL_DEL, clientSocket, NULL);
-	close(clientSocket);
+void ConnectionManager::unregisterHandle(EventHandle& handle) {
+	if (handle.fd < 0)
+		return;
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, handle.fd, NULL);
+	handle.fd = -1;
+}
 
-	for (std::vector<ClientConnection*>::iterator it = clients.begin(); it != clients.end(); ++it) {
-		if ((*it)->fd == clientSocket) {
-			delete *it;
-			clients.erase(it);
-			break;
-		}
+ClientConnection* ConnectionManager::addClient(int clientSocket, size_t serverIndex) {
+	ClientConnection* client = new ClientConnection(clientSocket, serverIndex, bufferPool);
+	// Edge-triggered sockets are registered once for both directions; readiness is
+	// then tracked on the connection instead of being switched with EPOLL_CTL_MOD.
+	uint32_t events = edgeTriggered ? (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET) : (EPOLLIN | EPOLLRDHUP);
+	if (!registerHandle(client->handle, clientSocket, events)) {
+		std::cerr << "Failed to add fd to epoll: " << strerror(errno) << std::endl;
+		client->handle.fd = -1;
+		delete client;
+		return NULL;
 	}
-	std::cout << "Closed connection on socket " << clientSocket << std::endl;
+	client->slot = clients.size();
+	clients.push_back(client);
+	return client;
 }
 
-ClientConnection* ConnectionManager::findClient(int fd) {
-	for (size_t i = 0; i < clients.size(); ++i) {
-		if (clients[i]->fd == fd)
-			return clients[i];
-	}
-	return NULL;
+void ConnectionManager::removeClient(ClientConnection* client) {
+	if (!client || client->closed)
+		return;
+
+	removeCgiPipes(client);
+	unregisterHandle(client->handle);
+	close(client->fd);
+	client->closed = true;
+	client->timer.unlink();
+
+	ClientConnection* last = clients.back();
+	clients[client->slot] = last;
+	last->slot = client->slot;
+	clients.pop_back();
+
+	// Deletion is deferred until the current epoll batch has been dispatched,
+	// so queued events that still point at this client's handles stay valid.
+	closedClients.push_back(client);
+	std::cout << "Closed connection on socket " << client->fd << std::endl;
+}
+
+void ConnectionManager::releaseClosedClients() {
+	for (size_t i = 0; i < closedClients.size(); ++i)
+		delete closedClients[i];
+	closedClients.clear();
+	fastcgiPool.releaseClosed();
 }
 
 void ConnectionManager::closeAllClients() {
 	for (size_t i = 0; i < clients.size(); ++i) {
 		removeCgiPipes(clients[i]);
-		epoll_ctl(epollFd, EPOLL_CTL_DEL, clients[i]->fd, NULL);
+		unregisterHandle(clients[i]->handle);
 		close(clients[i]->fd);
 		delete clients[i];
 	}
 	clients.clear();
-	cgiPipeToClient.clear();
+	releaseClosedClients();
+	fastcgiPool.closeAll();
 }
 
-void ConnectionManager::prepareResponseMode(ClientConnection* client) {
+bool ConnectionManager::modifyClientEvents(ClientConnection* client, uint32_t events) {
 	struct epoll_event ev;
-	ev.events = EPOLLOUT | EPOLLRDHUP;
-	ev.data.fd = client->fd;
+	ev.events = events;
+	ev.data.ptr = &client->handle;
+	return epoll_ctl(epollFd, EPOLL_CTL_MOD, client->fd, &ev) == 0;
+}
 
-	if (epoll_ctl(epollFd, EPOLL_CTL_MOD, client->fd, &ev) < 0) {
+// False when the socket could not be switched to writing; the caller closes it.
+bool ConnectionManager::prepareResponseMode(ClientConnection* client) {
+	if (edgeTriggered)
+		return true;
+	if (!modifyClientEvents(client, EPOLLOUT | EPOLLRDHUP)) {
 		std::cerr << "Failed to modify epoll for writing: " << strerror(errno) << std::endl;
-		removeClient(client->fd);
+		return false;
 	}
+	return true;
 }
 
+// The output pipe is watched from the start; a CGI started before its body was read
+// already has it registered. The input pipe is only watched while full (watchCgiInput).
 void ConnectionManager::addCgiPipes(ClientConnection* client) {
-	if (client->cgiInputFd >= 0) {
-		struct epoll_event ev;
-		ev.events = EPOLLOUT;
-		ev.data.fd = client->cgiInputFd;
-		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client->cgiInputFd, &ev) < 0)
-			std::cerr << "Failed to add CGI input pipe to epoll: " << strerror(errno) << std::endl;
-		else
-			cgiPipeToClient[client->cgiInputFd] = client;
-	}
+	watchCgiOutput(client);
+}
+
+void ConnectionManager::removeCgiPipes(ClientConnection* client) {
+	fastcgiPool.abort(client);
+	closeCgiInput(client);
 
 	if (client->cgiOutputFd >= 0) {
-		struct epoll_event ev;
-		ev.events = EPOLLIN;
-		ev.data.fd = client->cgiOutputFd;
-		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client->cgiOutputFd, &ev) < 0)
-			std::cerr << "Failed to add CGI output pipe to epoll: " << strerror(errno) << std::endl;
-		else
-			cgiPipeToClient[client->cgiOutputFd] = client;
+		unregisterHandle(client->cgiOutputHandle);
+		close(client->cgiOutputFd);
+		client->cgiOutputFd = -1;
 	}
 }
 
-void ConnectionManager::removeCgiPipes(ClientConnection* client) {
+void ConnectionManager::closeCgiInput(ClientConnection* client) {
 	if (client->cgiInputFd >= 0) {
-		epoll_ctl(epollFd, EPOLL_CTL_DEL, client->cgiInputFd, NULL);
-		cgiPipeToClient.erase(client->cgiInputFd);
+		unregisterHandle(client->cgiInputHandle);
 		close(client->cgiInputFd);
 		client->cgiInputFd = -1;
 	}
+}
 
-	if (client->cgiOutputFd >= 0) {
-		epoll_ctl(epollFd, EPOLL_CTL_DEL, client->cgiOutputFd, NULL);
-		cgiPipeToClient.erase(client->cgiOutputFd);
-		close(client->cgiOutputFd);
-		client->cgiOutputFd = -1;
+void ConnectionManager::watchCgiInput(ClientConnection* client) {
+	uint32_t edge = edgeTriggered ? static_cast<uint32_t>(EPOLLET) : 0;
+
+	if (client->cgiInputFd >= 0 && client->cgiInputHandle.fd < 0) {
+		if (!registerHandle(client->cgiInputHandle, client->cgiInputFd, EPOLLOUT | edge))
+			std::cerr << "Failed to add CGI input pipe to epoll: " << strerror(errno) << std::endl;
 	}
 }
 
-void ConnectionManager::removeSingleCgiPipe(int pipeFd) {
-	cgiPipeToClient.erase(pipeFd);
+void ConnectionManager::unwatchCgiInput(ClientConnection* client) {
+	unregisterHandle(client->cgiInputHandle);
 }
 
-ClientConnection* ConnectionManager::findClientByCgiPipe(int pipeFd) {
-	std::map<int, ClientConnection*>::iterator it = cgiPipeToClient.find(pipeFd);
-	if (it != cgiPipeToClient.end())
-		return it->second;
-	return NULL;
+// Unwatched while a streamed response has enough queued for the client.
+void ConnectionManager::watchCgiOutput(ClientConnection* client) {
+	fastcgiPool.pauseOutput(client, false);
+	uint32_t edge = edgeTriggered ? static_cast<uint32_t>(EPOLLET) : 0;
+
+	if (client->cgiOutputFd >= 0 && client->cgiOutputHandle.fd < 0) {
+		if (!registerHandle(client->cgiOutputHandle, client->cgiOutputFd, EPOLLIN | edge))
+			std::cerr << "Failed to add CGI output pipe to epoll: " << strerror(errno) << std::endl;
+	}
 }
 
-bool ConnectionManager::isCgiPipe(int fd) {
-	return cgiPipeToClient.find(fd) != cgiPipeToClient.end();
+void ConnectionManager::unwatchCgiOutput(ClientConnection* client) {
+	fastcgiPool.pauseOutput(client, true);
+	unregisterHandle(client->cgiOutputHandle);
 }
 
 std::vector<ClientConnection*>& ConnectionManager::getClients() {
 	return clients;
 }
+
+FastCgiPool& ConnectionManager::getFastCgiPool() {
+	return fastcgiPool;
+}
+
+bool ConnectionManager::isEdgeTriggered() const {
+	return edgeTriggered;
+}
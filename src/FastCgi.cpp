@@ -0,0 +1,477 @@
+#include "../include/FastCgi.hpp"
+#include "../include/ClientConnection.hpp"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace {
+    const int VERSION = 1;
+    const int RESPONDER = 1;
+    const int KEEP_CONN = 1;
+    const int REQUEST_COMPLETE = 0;
+    const int CANT_MPX_CONN = 1;
+
+    void appendLength(std::string& out, size_t length) {
+        if (length < 128) {
+            out += static_cast<char>(length);
+            return;
+        }
+        out += static_cast<char>(((length >> 24) & 0x7f) | 0x80);
+        out += static_cast<char>((length >> 16) & 0xff);
+        out += static_cast<char>((length >> 8) & 0xff);
+        out += static_cast<char>(length & 0xff);
+    }
+
+    bool readLength(const std::string& data, size_t& pos, size_t& length) {
+        if (pos >= data.size())
+            return false;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data()) + pos;
+        if (bytes[0] < 128) {
+            length = bytes[0];
+            pos += 1;
+            return true;
+        }
+        if (data.size() - pos < 4)
+            return false;
+        length = (static_cast<size_t>(bytes[0] & 0x7f) << 24) | (static_cast<size_t>(bytes[1]) << 16)
+               | (static_cast<size_t>(bytes[2]) << 8) | bytes[3];
+        pos += 4;
+        return true;
+    }
+
+    void copyRange(const BufferChain& from, size_t pos, size_t count, BufferChain& to) {
+        while (count > 0) {
+            const char* data;
+            size_t available = from.contiguous(pos, data);
+            if (available > count)
+                available = count;
+            to.append(data, available);
+            pos += available;
+            count -= available;
+        }
+    }
+
+    // Starts a non-blocking connect; -1 with errno set if it failed at once.
+    int connectTo(const std::string& address, bool& pending) {
+        int fd = -1;
+        int result = -1;
+        if (address.compare(0, 5, "unix:") == 0) {
+            struct sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::string path = address.substr(5);
+            if (path.size() >= sizeof(addr.sun_path)) {
+                errno = ENAMETOOLONG;
+                return -1;
+            }
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd >= 0)
+                result = connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        } else {
+            size_t colonPos = address.rfind(':');
+            struct addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_NUMERICSERV;
+            struct addrinfo* info = NULL;
+            if (getaddrinfo(address.substr(0, colonPos).c_str(), address.substr(colonPos + 1).c_str(),
+                            &hints, &info) != 0 || !info) {
+                errno = EHOSTUNREACH;
+                return -1;
+            }
+            fd = socket(info->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd >= 0) {
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                result = connect(fd, info->ai_addr, info->ai_addrlen);
+            }
+            int saved = errno;
+            freeaddrinfo(info);
+            errno = saved;
+        }
+        if (fd >= 0 && result < 0 && errno != EINPROGRESS) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        pending = (result < 0);
+        return fd;
+    }
+}
+
+void FastCgi::appendRecord(BufferChain& out, int type, unsigned short id, const char* data, size_t size) {
+    char header[HEADER_SIZE];
+    header[0] = static_cast<char>(VERSION);
+    header[1] = static_cast<char>(type);
+    header[2] = static_cast<char>(id >> 8);
+    header[3] = static_cast<char>(id & 0xff);
+    header[4] = static_cast<char>(size >> 8);
+    header[5] = static_cast<char>(size & 0xff);
+    header[6] = 0;
+    header[7] = 0;
+    out.append(header, HEADER_SIZE);
+    if (size > 0)
+        out.append(data, size);
+}
+
+// A stream is any number of records, ended by an empty one.
+void FastCgi::appendStream(BufferChain& out, int type, unsigned short id, const std::string& data) {
+    for (size_t pos = 0; pos < data.size(); pos += MAX_CONTENT) {
+        size_t size = (data.size() - pos < MAX_CONTENT) ? data.size() - pos : MAX_CONTENT;
+        appendRecord(out, type, id, data.data() + pos, size);
+    }
+    appendRecord(out, type, id, NULL, 0);
+}
+
+void FastCgi::appendStream(BufferChain& out, int type, unsigned short id, const BufferChain& data) {
+    for (size_t pos = 0; pos < data.size(); ) {
+        const char* bytes;
+        size_t size = data.contiguous(pos, bytes);
+        if (size > MAX_CONTENT)
+            size = MAX_CONTENT;
+        appendRecord(out, type, id, bytes, size);
+        pos += size;
+    }
+    appendRecord(out, type, id, NULL, 0);
+}
+
+void FastCgi::appendParam(std::string& out, const std::string& name, const std::string& value) {
+    appendLength(out, name.size());
+    appendLength(out, value.size());
+    out += name;
+    out += value;
+}
+
+bool FastCgi::readParam(const std::string& data, size_t& pos, std::string& name, std::string& value) {
+    size_t nameLength, valueLength;
+    if (!readLength(data, pos, nameLength) || !readLength(data, pos, valueLength)
+        || data.size() - pos < nameLength + valueLength)
+        return false;
+    name = data.substr(pos, nameLength);
+    value = data.substr(pos + nameLength, valueLength);
+    pos += nameLength + valueLength;
+    return true;
+}
+
+FastCgiConnection::FastCgiConnection(const std::string& addr, size_t limit, BufferPool& pool)
+    : handle(EventHandle::FASTCGI), address(addr), idleLimit(limit), capacity(1),
+      connecting(false), paused(false), events(0), output(pool), input(pool) {
+    handle.backend = this;
+}
+
+FastCgiPool::FastCgiPool(int epoll_fd, BufferPool& pool) : epollFd(epoll_fd), bufferPool(pool) {}
+
+FastCgiPool::~FastCgiPool() {
+    closeAll();
+}
+
+// The backend is asked at once how many requests it takes on one connection.
+FastCgiConnection* FastCgiPool::open(const std::string& address, size_t idleLimit) {
+    bool pending = false;
+    int fd = connectTo(address, pending);
+    if (fd < 0) {
+        std::cerr << "FastCGI: Cannot connect to " << address << ": " << strerror(errno) << std::endl;
+        return NULL;
+    }
+
+    FastCgiConnection* conn = new FastCgiConnection(address, idleLimit, bufferPool);
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = &conn->handle;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::cerr << "Failed to add FastCGI connection to epoll: " << strerror(errno) << std::endl;
+        ::close(fd);
+        delete conn;
+        return NULL;
+    }
+    conn->handle.fd = fd;
+    conn->events = ev.events;
+    conn->connecting = pending;
+
+    std::string query;
+    FastCgi::appendParam(query, "FCGI_MPXS_CONNS", "");
+    FastCgi::appendParam(query, "FCGI_MAX_REQS", "");
+    FastCgi::appendRecord(conn->output, FastCgi::GET_VALUES, 0, query.data(), query.size());
+    connections.push_back(conn);
+    return conn;
+}
+
+// A connection to address with a free request slot; a paused one is left alone so
+// that its client's backpressure does not hold up anyone else.
+FastCgiConnection* FastCgiPool::find(const std::string& address) {
+    for (size_t i = 0; i < connections.size(); ++i) {
+        FastCgiConnection* conn = connections[i];
+        if (conn->address == address && !conn->paused && conn->requests.size() < conn->capacity)
+            return conn;
+    }
+    return NULL;
+}
+
+unsigned short FastCgiPool::nextId(const FastCgiConnection* conn) const {
+    unsigned short id = 1;
+    while (conn->requests.count(id))
+        ++id;
+    return id;
+}
+
+// Queues the whole request, params and body (which has fully arrived by now), on a
+// pooled connection, opening one if none has room. False if none can be opened.
+bool FastCgiPool::submit(ClientConnection* client, const std::string& address, size_t idleLimit) {
+    FastCgiConnection* conn = find(address);
+    if (!conn)
+        conn = open(address, idleLimit);
+    if (!conn)
+        return false;
+
+    unsigned short id = nextId(conn);
+    conn->requests[id] = client;
+    client->fastcgi = conn;
+    client->fastcgiId = id;
+
+    char begin[8];
+    std::memset(begin, 0, sizeof(begin));
+    begin[1] = static_cast<char>(RESPONDER);
+    begin[2] = static_cast<char>(KEEP_CONN);
+    FastCgi::appendRecord(conn->output, FastCgi::BEGIN_REQUEST, id, begin, sizeof(begin));
+    FastCgi::appendStream(conn->output, FastCgi::PARAMS, id, client->fastcgiParams);
+    FastCgi::appendStream(conn->output, FastCgi::STDIN, id, client->cgiInput);
+    client->fastcgiParams.clear();
+    client->cgiInput.clear();
+
+    // A write error shows up as EPOLLERR / EPOLLHUP on the next wait.
+    if (!conn->connecting)
+        flush(conn);
+    updateEvents(conn);
+    return true;
+}
+
+bool FastCgiPool::flush(FastCgiConnection* conn) {
+    while (!conn->output.empty()) {
+        size_t attempted;
+        ssize_t written = conn->output.writeTo(conn->handle.fd, attempted);
+        if (written < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        if (static_cast<size_t>(written) < attempted)
+            break;
+    }
+    return true;
+}
+
+void FastCgiPool::handleEvent(FastCgiConnection* conn, uint32_t activeEvents, std::vector<FastCgiEvent>& results) {
+    if (conn->connecting && (activeEvents & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(conn->handle.fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            std::cerr << "FastCGI: Cannot connect to " << conn->address << ": "
+                      << strerror(error ? error : errno) << std::endl;
+            closeConnection(conn, &results);
+            return;
+        }
+        conn->connecting = false;
+    }
+
+    // A hangup is read through even while paused: what is left is bounded by the socket buffer.
+    if ((activeEvents & (EPOLLIN | EPOLLERR | EPOLLHUP)) && !receive(conn, results)) {
+        closeConnection(conn, &results);
+        return;
+    }
+    if (conn->handle.fd < 0)
+        return;
+    if ((activeEvents & EPOLLOUT) && !flush(conn)) {
+        std::cerr << "FastCGI: Write to " << conn->address << " failed: " << strerror(errno) << std::endl;
+        closeConnection(conn, &results);
+        return;
+    }
+    updateEvents(conn);
+}
+
+// Reads what the backend sent and hands every complete record on. False once the
+// connection is unusable: closed by the backend, a read error or a malformed record.
+bool FastCgiPool::receive(FastCgiConnection* conn, std::vector<FastCgiEvent>& results) {
+    ssize_t bytesRead = conn->input.readFrom(conn->handle.fd, READ_CHUNK);
+    if (bytesRead < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if (bytesRead == 0) {
+        if (!conn->requests.empty())
+            std::cerr << "FastCGI: " << conn->address << " closed the connection" << std::endl;
+        return false;
+    }
+
+    while (conn->input.size() >= FastCgi::HEADER_SIZE) {
+        std::string header = conn->input.substr(0, FastCgi::HEADER_SIZE);
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(header.data());
+        if (bytes[0] != VERSION) {
+            std::cerr << "FastCGI: Malformed record from " << conn->address << std::endl;
+            return false;
+        }
+        size_t size = (static_cast<size_t>(bytes[4]) << 8) | bytes[5];
+        size_t total = FastCgi::HEADER_SIZE + size + bytes[6];
+        if (conn->input.size() < total)
+            break;
+        if (!dispatch(conn, bytes[1], static_cast<unsigned short>((bytes[2] << 8) | bytes[3]), size, results))
+            return false;
+        if (conn->handle.fd < 0)
+            return true;
+        conn->input.consume(total);
+    }
+    return true;
+}
+
+// The record's content is the size bytes after its header at the front of conn->input.
+bool FastCgiPool::dispatch(FastCgiConnection* conn, int type, unsigned short id, size_t size,
+                           std::vector<FastCgiEvent>& results) {
+    std::map<unsigned short, ClientConnection*>::iterator it = conn->requests.find(id);
+    ClientConnection* client = (it != conn->requests.end()) ? it->second : NULL;
+
+    if (type == FastCgi::STDOUT && client && size > 0) {
+        copyRange(conn->input, FastCgi::HEADER_SIZE, size, client->cgiOutputBuffer);
+        if (results.empty() || results.back().client != client || results.back().kind != FastCgiEvent::OUTPUT)
+            results.push_back(FastCgiEvent(client, FastCgiEvent::OUTPUT));
+    } else if (type == FastCgi::STDERR && size > 0) {
+        std::string message = conn->input.substr(FastCgi::HEADER_SIZE, size);
+        while (!message.empty() && (message[message.size() - 1] == '\n' || message[message.size() - 1] == '\r'))
+            message.erase(message.size() - 1);
+        std::cerr << "FastCGI: " << message << std::endl;
+    } else if (type == FastCgi::END_REQUEST && it != conn->requests.end()) {
+        int protocolStatus = (size >= 5) ? static_cast<unsigned char>(conn->input.at(FastCgi::HEADER_SIZE + 4))
+                                         : REQUEST_COMPLETE;
+        if (protocolStatus == CANT_MPX_CONN)
+            conn->capacity = 1;
+        if (client) {
+            client->fastcgi = NULL;
+            results.push_back(FastCgiEvent(client, (protocolStatus == REQUEST_COMPLETE)
+                                                   ? FastCgiEvent::ENDED : FastCgiEvent::FAILED));
+        }
+        finishRequest(conn, id);
+    } else if (type == FastCgi::GET_VALUES_RESULT) {
+        readCapacity(conn, conn->input.substr(FastCgi::HEADER_SIZE, size));
+    }
+    return true;
+}
+
+void FastCgiPool::readCapacity(FastCgiConnection* conn, const std::string& values) {
+    bool multiplexed = false;
+    size_t maxRequests = MAX_REQUESTS;
+    std::string name, value;
+    for (size_t pos = 0; FastCgi::readParam(values, pos, name, value); ) {
+        if (name == "FCGI_MPXS_CONNS") {
+            multiplexed = (value == "1");
+        } else if (name == "FCGI_MAX_REQS") {
+            long count = std::atol(value.c_str());
+            if (count > 0 && static_cast<size_t>(count) < maxRequests)
+                maxRequests = static_cast<size_t>(count);
+        }
+    }
+    conn->capacity = multiplexed ? maxRequests : 1;
+}
+
+// An idle connection stays open for the next request unless the address already has
+// fastcgi_keepalive idle ones.
+void FastCgiPool::finishRequest(FastCgiConnection* conn, unsigned short id) {
+    conn->requests.erase(id);
+    conn->paused = false;
+    if (!conn->requests.empty())
+        return;
+
+    size_t idle = 0;
+    for (size_t i = 0; i < connections.size(); ++i) {
+        if (connections[i]->address == conn->address && connections[i]->requests.empty())
+            ++idle;
+    }
+    if (idle > conn->idleLimit)
+        closeConnection(conn, NULL);
+}
+
+// Level-triggered: EPOLLIN unless paused (idle connections too, to notice the backend
+// closing them), EPOLLOUT while connecting or records are waiting.
+void FastCgiPool::updateEvents(FastCgiConnection* conn) {
+    uint32_t wanted = (conn->paused ? 0 : static_cast<uint32_t>(EPOLLIN))
+                    | ((conn->connecting || !conn->output.empty()) ? static_cast<uint32_t>(EPOLLOUT) : 0);
+    if (conn->handle.fd < 0 || wanted == conn->events)
+        return;
+
+    struct epoll_event ev;
+    ev.events = wanted;
+    ev.data.ptr = &conn->handle;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->handle.fd, &ev) == 0)
+        conn->events = wanted;
+}
+
+// Requests still on the connection fail; deletion waits for releaseClosed().
+void FastCgiPool::closeConnection(FastCgiConnection* conn, std::vector<FastCgiEvent>* results) {
+    std::map<unsigned short, ClientConnection*>::iterator it;
+    for (it = conn->requests.begin(); it != conn->requests.end(); ++it) {
+        if (!it->second)
+            continue;
+        it->second->fastcgi = NULL;
+        if (results)
+            results->push_back(FastCgiEvent(it->second, FastCgiEvent::FAILED));
+    }
+    conn->requests.clear();
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->handle.fd, NULL);
+    ::close(conn->handle.fd);
+    conn->handle.fd = -1;
+
+    for (size_t i = 0; i < connections.size(); ++i) {
+        if (connections[i] == conn) {
+            connections[i] = connections.back();
+            connections.pop_back();
+            break;
+        }
+    }
+    closedConnections.push_back(conn);
+}
+
+// The client went away or timed out. A connection carrying nothing else is closed,
+// which stops the backend too; otherwise the request is aborted and its id stays
+// taken until the backend ends it.
+void FastCgiPool::abort(ClientConnection* client) {
+    FastCgiConnection* conn = client->fastcgi;
+    if (!conn)
+        return;
+    client->fastcgi = NULL;
+    if (conn->requests.size() == 1) {
+        closeConnection(conn, NULL);
+        return;
+    }
+
+    conn->requests[client->fastcgiId] = NULL;
+    FastCgi::appendRecord(conn->output, FastCgi::ABORT_REQUEST, client->fastcgiId, NULL, 0);
+    if (!conn->connecting)
+        flush(conn);
+    updateEvents(conn);
+}
+
+// Backpressure for a streamed response: only a connection that carries nothing else
+// can stop being read.
+void FastCgiPool::pauseOutput(ClientConnection* client, bool paused) {
+    FastCgiConnection* conn = client->fastcgi;
+    if (!conn || conn->requests.size() != 1 || conn->paused == paused)
+        return;
+    conn->paused = paused;
+    updateEvents(conn);
+}
+
+void FastCgiPool::releaseClosed() {
+    for (size_t i = 0; i < closedConnections.size(); ++i)
+        delete closedConnections[i];
+    closedConnections.clear();
+}
+
+void FastCgiPool::closeAll() {
+    while (!connections.empty())
+        closeConnection(connections.back(), NULL);
+    releaseClosed();
+}
@@ -0,0 +1,131 @@
+#include "../include/OpenFileCache.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+OpenFileCache::OpenFileCache(size_t maxCount, int ttlSeconds, bool keepErrors)
+    : maxEntries(maxCount), validSeconds(ttlSeconds), cacheErrors(keepErrors) {
+    scratch.fd = -1;
+    scratch.resolved = false;
+    scratch.validUntil = 0;
+}
+
+OpenFileCache::~OpenFileCache() {
+    while (!entries.empty())
+        erase(entries.begin());
+    resetEntry(scratch);
+}
+
+bool OpenFileCache::isEnabled() const {
+    return maxEntries > 0;
+}
+
+void OpenFileCache::resetEntry(Entry& entry) {
+    if (entry.fd >= 0)
+        close(entry.fd);
+    entry.fd = -1;
+    entry.resolved = false;
+    entry.info = FileInfo();
+}
+
+void OpenFileCache::load(Entry& entry, const std::string& path) {
+    resetEntry(entry);
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) {
+        entry.info.error = errno;
+        return;
+    }
+    if (S_ISREG(fileStat.st_mode))
+        entry.info.type = FileInfo::REGULAR;
+    else if (S_ISDIR(fileStat.st_mode))
+        entry.info.type = FileInfo::DIRECTORY;
+    else
+        entry.info.type = FileInfo::OTHER;
+    entry.info.size = fileStat.st_size;
+    entry.info.mtime = fileStat.st_mtime;
+    entry.info.inode = fileStat.st_ino;
+}
+
+void OpenFileCache::erase(std::map<std::string, Entry>::iterator it) {
+    resetEntry(it->second);
+    lru.erase(it->second.lruPos);
+    entries.erase(it);
+}
+
+OpenFileCache::Entry& OpenFileCache::fetch(const std::string& path) {
+    if (!isEnabled()) {
+        load(scratch, path);
+        return scratch;
+    }
+
+    time_t now = time(NULL);
+    std::map<std::string, Entry>::iterator it = entries.find(path);
+    if (it != entries.end()) {
+        if (now < it->second.validUntil) {
+            lru.splice(lru.begin(), lru, it->second.lruPos);
+            return it->second;
+        }
+        erase(it);
+    }
+
+    load(scratch, path);
+    if (scratch.info.type == FileInfo::MISSING && !cacheErrors)
+        return scratch;
+
+    if (entries.size() >= maxEntries)
+        erase(entries.find(lru.back()));
+
+    lru.push_front(path);
+    Entry& entry = entries[path];
+    entry.info = scratch.info;
+    entry.fd = -1;
+    entry.resolved = false;
+    entry.validUntil = now + validSeconds;
+    entry.lruPos = lru.begin();
+    return entry;
+}
+
+const FileInfo& OpenFileCache::lookup(const std::string& path) {
+    return fetch(path).info;
+}
+
+// Adds the canonical path and the execute permission, which only the CGI path needs.
+const FileInfo& OpenFileCache::resolve(const std::string& path) {
+    Entry& entry = fetch(path);
+    if (!entry.resolved && entry.info.type != FileInfo::MISSING) {
+        char absolutePath[PATH_MAX];
+        if (realpath(path.c_str(), absolutePath) != NULL)
+            entry.info.realPath = absolutePath;
+        entry.info.executable = (access(path.c_str(), X_OK) == 0);
+        entry.resolved = true;
+    }
+    return entry.info;
+}
+
+// Returns a read-only fd the caller owns, or -1 with errno set. Cached entries hand out
+// duplicates of their own fd; reads must use explicit offsets since the file position is shared.
+int OpenFileCache::openFile(const std::string& path) {
+    Entry& entry = fetch(path);
+    if (entry.info.type != FileInfo::REGULAR) {
+        errno = (entry.info.type == FileInfo::MISSING) ? entry.info.error : EISDIR;
+        return -1;
+    }
+    if (&entry == &scratch)
+        return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (entry.fd < 0) {
+        entry.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (entry.fd < 0)
+            return -1;
+    }
+    return fcntl(entry.fd, F_DUPFD_CLOEXEC, 0);
+}
+
+void OpenFileCache::invalidate(const std::string& path) {
+    std::map<std::string, Entry>::iterator it = entries.find(path);
+    if (it != entries.end())
+        erase(it);
+}
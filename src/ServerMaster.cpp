@@ -0,0 +1,320 @@
+#include "../include/ServerMaster.hpp"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sched.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+ServerMaster::ServerMaster() : stopping(0) {}
+
+ServerMaster::~ServerMaster() {
+    destroyWorkers();
+}
+
+bool ServerMaster::initialize(const std::string& configFile) {
+    if (!config.loadFromFile(configFile))
+        return false;
+
+    if (config.getServerCount() == 0) {
+        std::cerr << "Error: No server blocks defined in configuration" << std::endl;
+        return false;
+    }
+
+    if (config.getWorkerProcesses() > 1) {
+        WebServer* listeners = new WebServer(config, 0);
+        workers.push_back(listeners);
+        if (!listeners->openListeners(false)) {
+            destroyWorkers();
+            return false;
+        }
+        return true;
+    }
+
+    return initializeWorkers(config.getWorkerThreads());
+}
+
+bool ServerMaster::initializeWorkers(size_t count) {
+    bool reusePort = count > 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        WebServer* worker = new WebServer(config, i);
+        workers.push_back(worker);
+        if (!worker->initialize(reusePort)) {
+            destroyWorkers();
+            return false;
+        }
+    }
+
+    if (reusePort)
+        std::cout << "Started " << count << " event-loop workers (SO_REUSEPORT)" << std::endl;
+    return true;
+}
+
+void ServerMaster::run() {
+    if (config.getWorkerProcesses() > 1) {
+        runProcesses();
+        return;
+    }
+    if (workers.size() == 1) {
+        workers[0]->run();
+        return;
+    }
+    runThreads();
+}
+
+void* ServerMaster::workerThreadMain(void* arg) {
+    WebServer* worker = static_cast<WebServer*>(arg);
+    worker->run();
+    return NULL;
+}
+
+void ServerMaster::runThreads() {
+    // Signals are handled by the main thread only; stop() wakes each worker's epoll_wait
+    // through its eventfd.
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        pthread_t thread;
+        int err = pthread_create(&thread, NULL, &ServerMaster::workerThreadMain, workers[i]);
+        if (err != 0) {
+            std::cerr << "Failed to start worker thread " << i << ": " << strerror(err) << std::endl;
+            stop();
+            break;
+        }
+        threads.push_back(thread);
+        if (config.getWorkerCpuAffinity())
+            pinToCpu(thread, i);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        pthread_join(threads[i], NULL);
+    threads.clear();
+
+    logWorkerStats();
+}
+
+void ServerMaster::pinToCpu(pthread_t thread, size_t workerId) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0)
+        return;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(workerId % cpus, &cpuSet);
+    int err = pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet);
+    if (err != 0)
+        std::cerr << "Failed to pin worker " << workerId << ": " << strerror(err) << std::endl;
+}
+
+void ServerMaster::logWorkerStats() {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const WorkerStats& stats = workers[i]->getStats();
+        std::cout << "Worker " << workers[i]->getWorkerId() << ": "
+                  << stats.connectionsAccepted << " connections, "
+                  << stats.requestsProcessed << " requests, "
+                  << stats.bytesReceived << " bytes in, "
+                  << stats.bytesSent << " bytes out" << std::endl;
+    }
+}
+
+void ServerMaster::stop() {
+    stopping = 1;
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i]->stop();
+}
+
+void ServerMaster::destroyWorkers() {
+    for (size_t i = 0; i < workers.size(); ++i)
+        delete workers[i];
+    workers.clear();
+}
+
+void ServerMaster::onChildExit(int) {}
+
+void ServerMaster::runProcesses() {
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &ServerMaster::onChildExit;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    // Signals stay blocked except while waiting in waitForSignal(), so a worker exit or
+    // a stop request can never slip in between the checks below and going to sleep.
+    sigset_t blocked, originalMask;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_BLOCK, &blocked, &originalMask);
+
+    processes.resize(config.getWorkerProcesses());
+    std::cout << "Master process " << getpid() << " starting "
+              << processes.size() << " worker processes" << std::endl;
+
+    while (!stopping) {
+        reapWorkerProcesses();
+        if (!respawnWorkerProcesses(originalMask))
+            return;
+        if (stopping)
+            break;
+        waitForSignal(originalMask);
+    }
+
+    terminateWorkerProcesses();
+    sigprocmask(SIG_SETMASK, &originalMask, NULL);
+    std::cout << "Master process stopped." << std::endl;
+}
+
+// Returns 0 in the child once its event loop has finished, the child pid in the
+// master, or -1 if fork() failed; the slot is then tried again later.
+pid_t ServerMaster::spawnWorkerProcess(size_t slot, const sigset_t& originalMask) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Failed to fork worker process " << slot << ": " << strerror(errno)
+                  << ", retrying in " << RESPAWN_THROTTLE_SECONDS << "s" << std::endl;
+        processes[slot].respawnAtMs = TimerWheel::monotonicMs() + RESPAWN_THROTTLE_SECONDS * 1000UL;
+        return -1;
+    }
+
+    if (pid == 0) {
+        runWorkerProcess(slot, originalMask);
+        return 0;
+    }
+
+    processes[slot].pid = pid;
+    processes[slot].startedAtMs = TimerWheel::monotonicMs();
+    std::cout << "Started worker process " << slot << " (pid " << pid << ")" << std::endl;
+    return pid;
+}
+
+void ServerMaster::runWorkerProcess(size_t slot, const sigset_t& originalMask) {
+    signal(SIGCHLD, SIG_DFL);
+    sigprocmask(SIG_SETMASK, &originalMask, NULL);
+    processes.clear();
+
+    WebServer* worker = workers[0];
+    worker->setWorkerId(slot);
+    if (!worker->startEventLoop())
+        return;
+
+    worker->run();
+    logWorkerStats();
+}
+
+// Empties the slots of exited workers and sets when each is forked again.
+void ServerMaster::reapWorkerProcesses() {
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        int slot = findProcessSlot(pid);
+        if (slot < 0)
+            continue;
+
+        if (WIFSIGNALED(status))
+            std::cerr << "Worker process " << slot << " (pid " << pid
+                      << ") killed by signal " << WTERMSIG(status) << std::endl;
+        else
+            std::cerr << "Worker process " << slot << " (pid " << pid
+                      << ") exited with code " << WEXITSTATUS(status) << std::endl;
+
+        unsigned long now = TimerWheel::monotonicMs();
+        processes[slot].pid = -1;
+        processes[slot].respawnAtMs = now;
+        if (now - processes[slot].startedAtMs < RESPAWN_THROTTLE_SECONDS * 1000UL && !stopping) {
+            std::cerr << "Worker process " << slot << " died right after start, "
+                      << "delaying respawn" << std::endl;
+            processes[slot].respawnAtMs = now + RESPAWN_THROTTLE_SECONDS * 1000UL;
+        }
+    }
+}
+
+// Forks a worker into every empty slot whose respawn time has come. False in a child
+// whose event loop has finished.
+bool ServerMaster::respawnWorkerProcesses(const sigset_t& originalMask) {
+    unsigned long now = TimerWheel::monotonicMs();
+    for (size_t i = 0; i < processes.size() && !stopping; ++i) {
+        if (processes[i].pid < 0 && processes[i].respawnAtMs <= now
+            && spawnWorkerProcess(i, originalMask) == 0)
+            return false;
+    }
+    return true;
+}
+
+// Sleeps with the original signal mask until a signal arrives, or until the earliest
+// pending respawn is due.
+void ServerMaster::waitForSignal(const sigset_t& originalMask) {
+    bool pending = false;
+    unsigned long wakeAt = 0;
+    for (size_t i = 0; i < processes.size(); ++i) {
+        if (processes[i].pid < 0 && (!pending || processes[i].respawnAtMs < wakeAt)) {
+            wakeAt = processes[i].respawnAtMs;
+            pending = true;
+        }
+    }
+    if (!pending) {
+        sigsuspend(&originalMask);
+        return;
+    }
+    unsigned long now = TimerWheel::monotonicMs();
+    unsigned long delay = (wakeAt > now) ? wakeAt - now : 0;
+    struct timespec timeout;
+    timeout.tv_sec = delay / 1000;
+    timeout.tv_nsec = (delay % 1000) * 1000000L;
+    ppoll(NULL, 0, &timeout, &originalMask);
+}
+
+void ServerMaster::terminateWorkerProcesses() {
+    for (size_t i = 0; i < processes.size(); ++i) {
+        if (processes[i].pid > 0)
+            kill(processes[i].pid, SIGTERM);
+    }
+
+    const int GRACE_PERIOD_MS = 5000;
+    for (int waited = 0; waited < GRACE_PERIOD_MS; waited += 10) {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            int slot = findProcessSlot(pid);
+            if (slot >= 0)
+                processes[slot].pid = -1;
+        }
+        if (!hasLiveWorkerProcesses())
+            break;
+        usleep(10000);
+    }
+
+    for (size_t i = 0; i < processes.size(); ++i) {
+        if (processes[i].pid > 0) {
+            std::cerr << "Worker process " << i << " did not stop, killing it" << std::endl;
+            kill(processes[i].pid, SIGKILL);
+            waitpid(processes[i].pid, NULL, 0);
+            processes[i].pid = -1;
+        }
+    }
+}
+
+bool ServerMaster::hasLiveWorkerProcesses() const {
+    for (size_t i = 0; i < processes.size(); ++i) {
+        if (processes[i].pid > 0)
+            return true;
+    }
+    return false;
+}
+
+int ServerMaster::findProcessSlot(pid_t pid) const {
+    for (size_t i = 0; i < processes.size(); ++i) {
+        if (processes[i].pid == pid)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
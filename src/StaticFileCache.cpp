@@ -0,0 +1,197 @@
+#include "../include/StaticFileCache.hpp"
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+#include <vector>
+#include <sys/inotify.h>
+
+namespace {
+    const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+                              | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    std::string directoryOf(const std::string& path) {
+        size_t slash = path.rfind('/');
+        if (slash == std::string::npos)
+            return ".";
+        return (slash == 0) ? "/" : path.substr(0, slash);
+    }
+
+    bool sameFile(const struct stat& a, const struct stat& b) {
+        return a.st_ino == b.st_ino && a.st_size == b.st_size
+            && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec
+            && a.st_ctim.tv_sec == b.st_ctim.tv_sec && a.st_ctim.tv_nsec == b.st_ctim.tv_nsec;
+    }
+
+    std::string baseNameOf(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return (slash == std::string::npos) ? path : path.substr(slash + 1);
+    }
+}
+
+StaticFileCache::StaticFileCache(size_t capacityBytes, size_t maxEntryBytes, size_t serverIndex)
+    : capacity(capacityBytes), maxEntrySize(maxEntryBytes), usedBytes(0), inotifyFd(-1),
+      handle(EventHandle::FILE_WATCH, NULL, serverIndex) {
+    if (capacity == 0)
+        return;
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "Static cache disabled: inotify_init1 failed" << std::endl;
+        capacity = 0;
+    }
+}
+
+StaticFileCache::~StaticFileCache() {
+    clear();
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+}
+
+bool StaticFileCache::isEnabled() const {
+    return capacity > 0;
+}
+
+bool StaticFileCache::accepts(size_t responseSize) const {
+    return isEnabled() && responseSize <= maxEntrySize && responseSize <= capacity;
+}
+
+int StaticFileCache::getWatchFd() const {
+    return inotifyFd;
+}
+
+const CachedResponse* StaticFileCache::lookup(const std::string& key) {
+    std::map<std::string, Entry>::iterator it = entries.find(key);
+    if (it == entries.end()) {
+        stats.misses++;
+        return NULL;
+    }
+    stats.hits++;
+    lru.splice(lru.begin(), lru, it->second.lruPos);
+    return &it->second.cached;
+}
+
+int StaticFileCache::watchDirectory(const std::string& directory) {
+    std::map<std::string, int>::iterator known = watchByDirectory.find(directory);
+    if (known != watchByDirectory.end())
+        return known->second;
+
+    int watch = inotify_add_watch(inotifyFd, directory.c_str(), WATCH_MASK);
+    if (watch < 0)
+        return -1;
+    watchByDirectory[directory] = watch;
+    watches[watch].directory = directory;
+    return watch;
+}
+
+// readStat is the fstat() taken when the file was read. The watch may only be added now,
+// so the file is stat()ed again once it is in place: a change that landed in between shows
+// up as a different inode, size or timestamp and the response is not cached.
+void StaticFileCache::insert(const std::string& key, const std::string& path, const CachedResponse& cached,
+                             const struct stat& readStat) {
+    SharedBuffer* response = cached.response;
+    if (!accepts(response->size()))
+        return;
+
+    std::map<std::string, Entry>::iterator existing = entries.find(key);
+    if (existing != entries.end())
+        erase(existing);
+
+    int watch = watchDirectory(directoryOf(path));
+    struct stat current;
+    if (watch < 0 || stat(path.c_str(), &current) != 0 || !sameFile(current, readStat)) {
+        if (watch >= 0 && watches[watch].keys.empty())
+            unwatch(watch);
+        return;
+    }
+
+    // Claimed before evicting, so dropping the last other file of this directory keeps its watch.
+    watches[watch].keys.insert(key);
+    while (usedBytes + response->size() > capacity && !lru.empty()) {
+        erase(entries.find(lru.back()));
+        stats.evictions++;
+    }
+
+    response->retain();
+    lru.push_front(key);
+    Entry entry;
+    entry.cached = cached;
+    entry.path = path;
+    entry.lruPos = lru.begin();
+    entry.watch = watch;
+    entries[key] = entry;
+    usedBytes += response->size();
+}
+
+void StaticFileCache::erase(std::map<std::string, Entry>::iterator it) {
+    std::map<int, Watch>::iterator watch = watches.find(it->second.watch);
+    if (watch != watches.end()) {
+        watch->second.keys.erase(it->first);
+        if (watch->second.keys.empty())
+            unwatch(watch->first);
+    }
+    usedBytes -= it->second.cached.response->size();
+    it->second.cached.response->release();
+    lru.erase(it->second.lruPos);
+    entries.erase(it);
+}
+
+void StaticFileCache::unwatch(int watch) {
+    std::map<int, Watch>::iterator it = watches.find(watch);
+    if (it == watches.end())
+        return;
+    inotify_rm_watch(inotifyFd, watch);
+    watchByDirectory.erase(it->second.directory);
+    watches.erase(it);
+}
+
+// An empty name stands for the directory itself: every entry under the watch goes.
+void StaticFileCache::invalidateWatch(int watch, const std::string& name) {
+    std::map<int, Watch>::iterator keys = watches.find(watch);
+    if (keys == watches.end())
+        return;
+
+    std::vector<std::string> stale;
+    const std::set<std::string>& cachedKeys = keys->second.keys;
+    for (std::set<std::string>::const_iterator it = cachedKeys.begin(); it != cachedKeys.end(); ++it) {
+        if (name.empty() || baseNameOf(entries[*it].path) == name)
+            stale.push_back(*it);
+    }
+    for (size_t i = 0; i < stale.size(); ++i) {
+        erase(entries.find(stale[i]));
+        stats.invalidations++;
+    }
+}
+
+void StaticFileCache::processWatchEvents() {
+    long buffer[1024];
+
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0)
+            return;
+
+        const char* cursor = reinterpret_cast<const char*>(buffer);
+        const char* end = cursor + length;
+        while (cursor < end) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(cursor);
+            cursor += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                stats.invalidations += entries.size();
+                clear();
+            } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                invalidateWatch(event->wd, "");
+            } else if (event->len > 0) {
+                invalidateWatch(event->wd, event->name);
+            }
+        }
+    }
+}
+
+void StaticFileCache::clear() {
+    while (!entries.empty())
+        erase(entries.begin());
+}
+
+const StaticCacheStats& StaticFileCache::getStats() const {
+    return stats;
+}
@@ -1,5 +1,6 @@
 #include "../include/StringUtils.hpp"
 #include <sstream>
+#include <cstring>
 
 namespace StringUtils {
 
@@ -44,4 +45,11 @@ std::string sizeToString(size_t value) {
     return oss.str();
 }
 
+// tchar of RFC 9110, section 5.6.2: what a method or a field name is made of.
+bool isTokenChar(char c) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+        return true;
+    return c != '\0' && std::strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
 }
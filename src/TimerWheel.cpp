@@ -0,0 +1,116 @@
+#include "../include/TimerWheel.hpp"
+#include <ctime>
+
+TimerNode::TimerNode(ClientConnection* owner)
+    : prev(NULL), next(NULL), expires(0), client(owner) {}
+
+TimerNode::~TimerNode() {
+    unlink();
+}
+
+void TimerNode::unlink() {
+    if (!prev)
+        return;
+    prev->next = next;
+    next->prev = prev;
+    prev = NULL;
+    next = NULL;
+}
+
+TimerWheel::TimerWheel() : currentTick(0) {
+    for (int level = 0; level < LEVELS; ++level) {
+        for (int i = 0; i < SLOTS; ++i) {
+            slots[level][i].prev = &slots[level][i];
+            slots[level][i].next = &slots[level][i];
+        }
+    }
+}
+
+void TimerWheel::start(unsigned long nowMs) {
+    currentTick = nowMs / TICK_MS + 1;
+}
+
+void TimerWheel::schedule(TimerNode& node, unsigned long timeoutMs) {
+    node.unlink();
+    // Rounded up and counted from the next tick, so a timer never fires early.
+    node.expires = currentTick + (timeoutMs + TICK_MS - 1) / TICK_MS;
+    insert(node);
+}
+
+void TimerWheel::insert(TimerNode& node) {
+    unsigned long delta = (node.expires > currentTick) ? node.expires - currentTick : 0;
+    unsigned long maxDelta = (1UL << (SLOT_BITS * LEVELS)) - 1;
+    if (delta > maxDelta) {
+        delta = maxDelta;
+        node.expires = currentTick + maxDelta;
+    }
+    if (delta == 0)
+        node.expires = currentTick;
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1UL << (SLOT_BITS * (level + 1))))
+        ++level;
+
+    TimerNode& head = slots[level][(node.expires >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+}
+
+// Re-files every timer of the level's current slot one level down (or into level 0).
+void TimerWheel::cascade(int level) {
+    TimerNode& head = slots[level][(currentTick >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    while (head.next != &head) {
+        TimerNode* node = head.next;
+        node->unlink();
+        insert(*node);
+    }
+}
+
+void TimerWheel::expireSlot(TimerNode& head, std::vector<TimerNode*>& expired) {
+    while (head.next != &head) {
+        TimerNode* node = head.next;
+        node->unlink();
+        expired.push_back(node);
+    }
+}
+
+void TimerWheel::advance(unsigned long nowMs, std::vector<TimerNode*>& expired) {
+    unsigned long nowTick = nowMs / TICK_MS;
+
+    while (currentTick <= nowTick) {
+        for (int level = 1; level < LEVELS; ++level) {
+            if ((currentTick & ((1UL << (SLOT_BITS * level)) - 1)) != 0)
+                break;
+            cascade(level);
+        }
+        expireSlot(slots[0][currentTick & (SLOTS - 1)], expired);
+        ++currentTick;
+    }
+}
+
+// Milliseconds until the next non-empty level-0 slot or the next cascade, capped at
+// maxMs; used as the epoll_wait timeout.
+int TimerWheel::nextTimeout(unsigned long nowMs, int maxMs) const {
+    unsigned long tick = currentTick;
+    for (int i = 0; i < SLOTS; ++i, ++tick) {
+        if (i > 0 && (tick & (SLOTS - 1)) == 0)
+            break;
+        const TimerNode& head = slots[0][tick & (SLOTS - 1)];
+        if (head.next != &head)
+            break;
+    }
+
+    unsigned long dueMs = tick * TICK_MS;
+    if (dueMs <= nowMs)
+        return 0;
+    unsigned long waitMs = dueMs - nowMs;
+    return (waitMs < static_cast<unsigned long>(maxMs)) ? static_cast<int>(waitMs) : maxMs;
+}
+
+unsigned long TimerWheel::monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long>(ts.tv_sec) * 1000UL + ts.tv_nsec / 1000000;
+}
@@ -1,13 +1,21 @@
 #include "../include/WebServer.hpp"
 #include "../include/HttpResponse.hpp"
 #include "../include/StringUtils.hpp"
+#include "../include/CgiCache.hpp"
 #include <sstream>
 #include <cctype>
+#include <stdint.h>
+#include <sys/eventfd.h>
 
-WebServer::WebServer() : epollFd(-1), running(false), connManager(NULL) {}
+WebServer::WebServer(Config& cfg, size_t id)
+    : config(cfg), workerId(id), epollFd(-1), running(0), wakeFd(-1), wakeHandle(EventHandle::WAKEUP),
+      edgeTriggered(false), connManager(NULL), nowMs(0) {}
 
 WebServer::~WebServer() {
-    stop();
+    shutdown();
+    // Closed only here: stop() may still be called from another thread until then.
+    if (wakeFd >= 0)
+        close(wakeFd);
     for (size_t i = 0; i < httpHandlers.size(); ++i) {
         if (httpHandlers[i])
             delete httpHandlers[i];
@@ -20,18 +28,21 @@ WebServer::~WebServer() {
     }
 }
 
-bool WebServer::initialize(const std::string& configFile) {
-    if (!config.loadFromFile(configFile))
+bool WebServer::initialize(bool reusePort) {
+    if (!openListeners(reusePort))
         return false;
-    
-    if (config.getServerCount() == 0) {
-        std::cerr << "Error: No server blocks defined in configuration" << std::endl;
+    if (!startEventLoop())
         return false;
-    }
     
+    std::cout << "Initialized " << serverSockets.size() << " server(s)";
+    if (reusePort)
+        std::cout << " for worker " << workerId;
+    std::cout << std::endl;
+    return true;
+}
+
+bool WebServer::openListeners(bool reusePort) {
     try {
-        setupEpoll();
-        
         for (size_t i = 0; i < config.getServerCount(); ++i) {
             const ServerConfig& serverConfig = config.getServer(i);
             
@@ -41,20 +52,50 @@ bool WebServer::initialize(const std::string& configFile) {
                 throw std::runtime_error("Duplicate server binding");
             }
             
-            if (!setupServerSocket(serverConfig, i))
+            if (!setupServerSocket(serverConfig, i, reusePort))
                 throw std::runtime_error("Failed to setup server socket");
-            
-            httpHandlers.push_back(new HttpRequest(config));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing server: " << e.what() << std::endl;
+        cleanupOnError();
+        return false;
+    }
+    return true;
+}
+
+bool WebServer::startEventLoop() {
+    // The zygote launcher is forked first, while this worker holds as little as it will.
+    if (!cgiLauncher.start(config.getCgiLauncher())) {
+        cleanupOnError();
+        return false;
+    }
+    
+    try {
+        setupEpoll();
+        
+        for (size_t i = 0; i < serverSockets.size(); ++i) {
+            if (!addToEpoll(serverSockets[i].fd, EPOLLIN, serverSockets[i].handle))
+                throw std::runtime_error("Failed to register server socket");
         }
         
-        connManager = new ConnectionManager(epollFd);
-        std::cout << "Initialized " << serverSockets.size() << " server(s)" << std::endl;
+        for (size_t i = 0; i < config.getServerCount(); ++i) {
+            httpHandlers.push_back(new HttpRequest(config, i, cgiLauncher));
+            StaticFileCache* cache = httpHandlers[i]->getFileCache();
+            if (cache->getWatchFd() >= 0 && !addToEpoll(cache->getWatchFd(), EPOLLIN, &cache->handle))
+                throw std::runtime_error("Failed to register static cache watch");
+        }
         
+        edgeTriggered = config.getEdgeTriggered();
+        connManager = new ConnectionManager(epollFd, bufferPool, edgeTriggered);
+        eventBuffer.resize(INITIAL_EVENT_BATCH);
+        nowMs = TimerWheel::monotonicMs();
+        timers.start(nowMs);
     } catch (const std::exception& e) {
         std::cerr << "Error initializing server: " << e.what() << std::endl;
         cleanupOnError();
         return false;
     }
+    running = 1;
     return true;
 }
 
@@ -63,11 +104,8 @@ void WebServer::cleanupOnError() {
         delete httpHandlers[i];
     httpHandlers.clear();
     
-    for (size_t i = 0; i < serverSockets.size(); ++i) {
-        if (serverSockets[i].fd >= 0)
-            close(serverSockets[i].fd);
-    }
-    serverSockets.clear();
+    closeServerSockets();
+    cgiLauncher.stop();
     
     if (epollFd >= 0) {
         close(epollFd);
@@ -83,7 +121,7 @@ bool WebServer::isDuplicateBinding(const std::string& host, int port) const {
     return false;
 }
 
-bool WebServer::setupServerSocket(const ServerConfig& serverConfig, size_t index) {
+bool WebServer::setupServerSocket(const ServerConfig& serverConfig, size_t index, bool reusePort) {
     int sockFd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockFd < 0) {
         std::cerr << "Failed to create socket for " << serverConfig.host 
@@ -103,6 +141,13 @@ bool WebServer::setupServerSocket(const ServerConfig& serverConfig, size_t index
         return false;
     }
     
+    // Every worker binds its own listener; the kernel load-balances accepts between them.
+    if (reusePort && setsockopt(sockFd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        std::cerr << "Failed to set SO_REUSEPORT: " << strerror(errno) << std::endl;
+        close(sockFd);
+        return false;
+    }
+    
     struct sockaddr_in serverAddr;
     std::memset(&serverAddr, 0, sizeof(serverAddr));
     serverAddr.sin_family = AF_INET;
@@ -120,28 +165,24 @@ bool WebServer::setupServerSocket(const ServerConfig& serverConfig, size_t index
         return false;
     }
     
-    if (listen(sockFd, 128) < 0) {
+    if (listen(sockFd, serverConfig.backlog) < 0) {
         std::cerr << "Failed to listen on socket" << std::endl;
         close(sockFd);
         return false;
     }
     
-    if (!addToEpoll(sockFd, EPOLLIN)) {
-        close(sockFd);
-        return false;
-    }
-    
     ServerSocket serverSock;
     serverSock.fd = sockFd;
     serverSock.host = serverConfig.host;
     serverSock.port = serverConfig.port;
     serverSock.serverIndex = index;
+    serverSock.handle = new EventHandle(EventHandle::LISTENER, NULL, index);
     
     serverSockets.push_back(serverSock);
-    fdToServerIndex[sockFd] = index;
     
-    std::cout << "Server listening on " << serverConfig.host 
-              << ":" << serverConfig.port << std::endl;
+    if (!reusePort || workerId == 0)
+        std::cout << "Server listening on " << serverConfig.host 
+                  << ":" << serverConfig.port << std::endl;
     return true;
 }
 
@@ -154,17 +195,30 @@ bool WebServer::setNonBlocking(int fd) {
     return true;
 }
 
-bool WebServer::addToEpoll(int fd, uint32_t events) {
+bool WebServer::addToEpoll(int fd, uint32_t events, EventHandle* handle) {
     struct epoll_event ev;
     ev.events = events;
-    ev.data.fd = fd;
+    ev.data.ptr = handle;
     if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
         std::cerr << "Failed to add fd to epoll: " << strerror(errno) << std::endl;
         return false;
     }
+    handle->fd = fd;
     return true;
 }
 
+void WebServer::closeServerSockets() {
+    for (size_t i = 0; i < serverSockets.size(); ++i) {
+        if (serverSockets[i].fd >= 0) {
+            if (epollFd >= 0)
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, serverSockets[i].fd, NULL);
+            close(serverSockets[i].fd);
+        }
+        delete serverSockets[i].handle;
+    }
+    serverSockets.clear();
+}
+
 void WebServer::setupEpoll() {
     epollFd = epoll_create(1);
     if (epollFd < 0)
@@ -173,79 +227,119 @@ void WebServer::setupEpoll() {
     int flags = fcntl(epollFd, F_GETFD);
     if (flags >= 0)
         fcntl(epollFd, F_SETFD, flags | FD_CLOEXEC);
+    
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0 || !addToEpoll(wakeFd, EPOLLIN, &wakeHandle))
+        throw std::runtime_error("Failed to create wakeup eventfd");
 }
 
 void WebServer::run() {
-    running = true;
-    const int MAX_EVENTS = 10;
-    struct epoll_event events[MAX_EVENTS];
-    
-    std::cout << "Server running with epoll..." << std::endl;
+    std::cout << "Server running with epoll" << (edgeTriggered ? " (edge-triggered)" : "")
+              << "..." << std::endl;
     
     while (running) {
-        int numEvents = epoll_wait(epollFd, events, MAX_EVENTS, 1000);
+        int numEvents = epoll_wait(epollFd, &eventBuffer[0], eventBuffer.size(),
+                                   timers.nextTimeout(nowMs, EPOLL_TIMEOUT_MS));
         
         if (numEvents < 0) {
+            if (errno == EINTR)
+                continue;
             std::cerr << "Error in epoll_wait: " << strerror(errno) << std::endl;
             break;
         }
         
-        checkCgiTimeouts();
-        
-        if (numEvents == 0)
-            continue;
+        // The only clock read of the iteration; timers scheduled below count from it.
+        nowMs = TimerWheel::monotonicMs();
+        expireTimers();
+        processEvents(&eventBuffer[0], numEvents);
+        cgiLauncher.collect();
         
-        processEvents(events, numEvents);
+        // A full batch means more events were probably left pending; take more next time.
+        if (static_cast<size_t>(numEvents) == eventBuffer.size() && eventBuffer.size() < MAX_EVENT_BATCH)
+            eventBuffer.resize(eventBuffer.size() * 2);
     }
+    shutdown();
     std::cout << "Server stopped." << std::endl;
 }
 
 void WebServer::processEvents(struct epoll_event* events, int numEvents) {
     for (int i = 0; i < numEvents; ++i) {
-        int fd = events[i].data.fd;
+        EventHandle* handle = static_cast<EventHandle*>(events[i].data.ptr);
         uint32_t activeEvents = events[i].events;
         
-        if (connManager->isCgiPipe(fd)) {
-            handleCgiPipeEvent(fd, activeEvents);
+        // Closed earlier in this batch: the owner is kept alive until
+        // releaseClosedClients(), but the fd must not be touched again.
+        if (handle->isStale())
             continue;
-        }
         
-        if (activeEvents & (EPOLLERR | EPOLLHUP)) {
-            handleErrorEvent(fd);
-            continue;
-        }
-        
-        if (isServerSocket(fd)) {
-            handleNewConnection(fd);
-            continue;
+        switch (handle->type) {
+            case EventHandle::LISTENER:
+                if (activeEvents & (EPOLLERR | EPOLLHUP))
+                    std::cerr << "Error/Hangup on listening socket " << handle->fd << std::endl;
+                else
+                    handleNewConnection(handle);
+                break;
+            case EventHandle::CLIENT:
+                if (activeEvents & (EPOLLERR | EPOLLHUP)) {
+                    std::cerr << "Error/Hangup on FD " << handle->fd << std::endl;
+                    closeClient(handle->client);
+                } else {
+                    handleClientEvent(handle->client, activeEvents);
+                }
+                break;
+            case EventHandle::CGI_STDIN:
+            case EventHandle::CGI_STDOUT:
+                handleCgiPipeEvent(handle, activeEvents);
+                break;
+            case EventHandle::FILE_WATCH:
+                httpHandlers[handle->serverIndex]->getFileCache()->processWatchEvents();
+                break;
+            case EventHandle::FASTCGI:
+                handleFastCgiEvent(handle, activeEvents);
+                break;
+            case EventHandle::WAKEUP: {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {}
+                break;
+            }
         }
-        
-        handleClientEvent(fd, activeEvents);
     }
+    connManager->releaseClosedClients();
 }
 
-bool WebServer::isServerSocket(int fd) {
-    for (size_t j = 0; j < serverSockets.size(); ++j) {
-        if (fd == serverSockets[j].fd)
-            return true;
-    }
-    return false;
+void WebServer::handleCgiPipeEvent(EventHandle* handle, uint32_t activeEvents) {
+    ClientConnection* client = handle->client;
+    
+    // A script that closed its stdin shows up as EPIPE on the next write.
+    if (handle->type == EventHandle::CGI_STDIN && (activeEvents & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+        flushCgiInput(client);
+    else if (activeEvents & (EPOLLERR | EPOLLHUP))
+        completeCgiRequest(client, handle->fd);
+    else if (handle->type == EventHandle::CGI_STDOUT && (activeEvents & EPOLLIN))
+        handleCgiPipeRead(client);
+    
+    if (edgeTriggered)
+        driveClient(client);
 }
 
-void WebServer::handleCgiPipeEvent(int fd, uint32_t activeEvents) {
-    if (activeEvents & (EPOLLERR | EPOLLHUP)) {
-        ClientConnection* client = connManager->findClientByCgiPipe(fd);
-        if (client) {
-            completeCgiRequest(client, fd);
-        }
-        return;
+// A backend connection may carry several clients' requests; each one it moved along is
+// handled like its CGI pipe would have been.
+void WebServer::handleFastCgiEvent(EventHandle* handle, uint32_t activeEvents) {
+    connManager->getFastCgiPool().handleEvent(handle->backend, activeEvents, fastcgiEvents);
+    for (size_t i = 0; i < fastcgiEvents.size(); ++i) {
+        ClientConnection* client = fastcgiEvents[i].client;
+        if (client->closed)
+            continue;
+        if (fastcgiEvents[i].kind == FastCgiEvent::OUTPUT)
+            relayCgiOutput(client);
+        else if (fastcgiEvents[i].kind == FastCgiEvent::ENDED)
+            completeCgiRequest(client, -1);
+        else
+            failFastCgi(client);
+        if (edgeTriggered)
+            driveClient(client);
     }
-    
-    if (activeEvents & EPOLLIN)
-        handleCgiPipeRead(fd);
-    
-    if (activeEvents & EPOLLOUT)
-        handleCgiPipeWrite(fd);
+    fastcgiEvents.clear();
 }
 
 void WebServer::completeCgiRequest(ClientConnection* client, int fd) {
@@ -255,69 +349,88 @@ void WebServer::completeCgiRequest(ClientConnection* client, int fd) {
             if (fd == client->cgiOutputFd)
                 cgiHandler->readFromCgi(client);
             cgiHandler->checkCgiComplete(client);
-            cgiHandler->buildResponse(client);
+            if (client->cgiStreaming)
+                cgiHandler->endStream(client);
+            else
+                cgiHandler->buildResponse(client);
             cgiHandler->cleanup(client);
         }
     }
     connManager->removeCgiPipes(client);
-    client->state = ClientConnection::SENDING_RESPONSE;
-    connManager->prepareResponseMode(client);
+    beginResponse(client);
 }
 
-void WebServer::handleErrorEvent(int fd) {
-    std::cerr << "Error/Hangup on FD " << fd << std::endl;
-    if (!isServerSocket(fd))
-        connManager->removeClient(fd);
-}
-
-void WebServer::handleClientEvent(int fd, uint32_t activeEvents) {
+void WebServer::handleClientEvent(ClientConnection* client, uint32_t activeEvents) {
     if (activeEvents & EPOLLRDHUP) {
-        std::cout << "Client " << fd << " disconnected" << std::endl;
-        connManager->removeClient(fd);
+        std::cout << "Client " << client->fd << " disconnected" << std::endl;
+        closeClient(client);
+        return;
+    }
+    
+    if (edgeTriggered) {
+        if (activeEvents & EPOLLIN)
+            client->readable = true;
+        if (activeEvents & EPOLLOUT)
+            client->writable = true;
+        driveClient(client);
         return;
     }
     
     if (activeEvents & EPOLLIN)
-        handleClientRead(fd);
+        handleClientRead(client);
     
-    if (activeEvents & EPOLLOUT)
-        handleClientWrite(fd);
+    if ((activeEvents & EPOLLOUT) && !client->closed)
+        handleClientWrite(client);
 }
 
-void WebServer::handleNewConnection(int serverFd) {
-    struct sockaddr_in clientAddr;
-    socklen_t clientLen = sizeof(clientAddr);
-    
-    int clientSocket = accept(serverFd, (struct sockaddr*)&clientAddr, &clientLen);
-    if (clientSocket < 0) {
-        std::cerr << "Error accepting connection: " << strerror(errno) << std::endl;
-        return;
+// Edge-triggered mode: an edge is reported once, so after every state change the
+// connection keeps going for as long as its recorded readiness allows.
+void WebServer::driveClient(ClientConnection* client) {
+    while (!client->closed) {
+        if (client->state == ClientConnection::READING_REQUEST && client->readable && !client->bodyPaused)
+            handleClientRead(client);
+        else if (client->state == ClientConnection::SENDING_RESPONSE && client->writable
+                 && !client->isWaitingForCgi())
+            handleClientWrite(client);
+        else
+            break;
     }
-    
-    if (!setNonBlocking(clientSocket)) {
-        close(clientSocket);
-        return;
+}
+
+// Drains the accept queue up to ACCEPT_BATCH connections per wakeup; the listener is
+// level-triggered, so anything left over is reported again on the next epoll_wait.
+void WebServer::handleNewConnection(EventHandle* listener) {
+    for (size_t accepted = 0; accepted < ACCEPT_BATCH; ++accepted) {
+        struct sockaddr_in clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+        
+        int clientSocket = accept4(listener->fd, (struct sockaddr*)&clientAddr, &clientLen,
+                                   SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                std::cerr << "Error accepting connection: " << strerror(errno) << std::endl;
+            return;
+        }
+        registerClient(clientSocket, clientAddr, listener->serverIndex);
     }
-    
-    int flags = fcntl(clientSocket, F_GETFD);
-    if (flags >= 0)
-        fcntl(clientSocket, F_SETFD, flags | FD_CLOEXEC);
-    
-    if (!addToEpoll(clientSocket, EPOLLIN | EPOLLRDHUP)) {
+}
+
+void WebServer::registerClient(int clientSocket, const struct sockaddr_in& clientAddr, size_t serverIndex) {
+    ClientConnection* client = connManager->addClient(clientSocket, serverIndex);
+    if (!client) {
         close(clientSocket);
         return;
     }
     
+    const ServerConfig& serverConfig = config.getServer(serverIndex);
+    armTimer(client, serverConfig.clientHeaderTimeout);
+    
     char clientIP[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
     
-    size_t serverIndex = 0;
-    if (fdToServerIndex.find(serverFd) != fdToServerIndex.end())
-        serverIndex = fdToServerIndex[serverFd];
-    
-    connManager->addClient(clientSocket, serverIndex);
-    
-    const ServerConfig& serverConfig = config.getServer(serverIndex);
+    stats.connectionsAccepted++;
     std::cout << "New connection from " << clientIP 
               << ":" << ntohs(clientAddr.sin_port) 
               << " on socket " << clientSocket 
@@ -325,68 +438,130 @@ void WebServer::handleNewConnection(int serverFd) {
               << std::endl;
 }
 
-void WebServer::handleClientRead(int clientSocket) {
-    ClientConnection* client = connManager->findClient(clientSocket);
-    if (!client) {
-        std::cerr << "Client not found: " << clientSocket << std::endl;
-        return;
-    }
-    
-    if (client->state == ClientConnection::CGI_RUNNING)
-        return;
-    
-    char buffer[1000000];
-    ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+void WebServer::handleClientRead(ClientConnection* client) {
+    int clientSocket = client->fd;
     
-    if (bytesRead < 0) {
-        std::cerr << "recv error on fd=" << clientSocket << std::endl;
-        connManager->removeClient(clientSocket);
+    if (client->state == ClientConnection::CGI_RUNNING || client->bodyPaused)
         return;
-    }
     
-    if (bytesRead == 0) {
-        std::cout << "Client " << clientSocket << " closed connection" << std::endl;
-        connManager->removeClient(clientSocket);
-        return;
-    }
+    do {
+        ssize_t bytesRead = client->requestBuffer.readFrom(clientSocket, READ_CHUNK);
+        
+        if (bytesRead < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                client->readable = false;
+                return;
+            }
+            std::cerr << "recv error on fd=" << clientSocket << std::endl;
+            closeClient(client);
+            return;
+        }
+        
+        if (bytesRead == 0) {
+            std::cout << "Client " << clientSocket << " closed connection" << std::endl;
+            closeClient(client);
+            return;
+        }
+        
+        // A short read emptied the receive queue; new data raises a fresh edge.
+        if (static_cast<size_t>(bytesRead) < READ_CHUNK)
+            client->readable = false;
+        
+        consumeRequestData(client, bytesRead);
+    } while (edgeTriggered && client->readable && !client->closed
+             && client->state == ClientConnection::READING_REQUEST && !client->bodyPaused);
+}
+
+void WebServer::consumeRequestData(ClientConnection* client, size_t bytesRead) {
+    stats.bytesReceived += bytesRead;
+    parseRequestData(client, bytesRead);
+}
+
+// newBytes at the end of requestBuffer have not been looked at yet; for a pipelined
+// request taken over from pipelineBuffer that is the whole buffer.
+void WebServer::parseRequestData(ClientConnection* client, size_t newBytes) {
+    size_t oldBufferSize = client->requestBuffer.size() - newBytes;
     
-    size_t oldBufferSize = client->requestBuffer.size();
-    client->requestBuffer.append(buffer, bytesRead);
+    const ServerConfig& server = config.getServer(client->serverIndex);
     
     if (!client->headersComplete) {
-        if (!parseHeaders(client, oldBufferSize))
+        if (!parseHeaders(client)) {
+            // The header timer covers the whole header, so it is armed on the first byte only.
+            if (oldBufferSize == 0 && client->state == ClientConnection::READING_REQUEST)
+                armTimer(client, server.clientHeaderTimeout);
             return;
+        }
     } else {
-        client->bodyBytesReceived += bytesRead;
+        client->bodyBytesReceived += newBytes;
+        if (!decodeChunkedBody(client) || !streamUploadBody(client) || !streamCgiBody(client))
+            return;
     }
     
     if (!checkBodySize(client))
         return;
     
-    if (!waitForCompleteBody(client))
+    if (!waitForCompleteBody(client)) {
+        if (client->state == ClientConnection::READING_REQUEST && !client->bodyPaused)
+            armTimer(client, server.clientBodyTimeout);
         return;
+    }
     
     processRequest(client);
 }
 
-bool WebServer::parseHeaders(ClientConnection* client, size_t oldBufferSize) {
-    size_t searchStart = (oldBufferSize > 3) ? (oldBufferSize - 3) : 0;
-    size_t headerEnd = client->requestBuffer.find("\r\n\r\n", searchStart);
+// The parser resumes where the previous read left it. Returns false until the header
+// block is complete and within limits; a rejected request already has its response.
+bool WebServer::parseHeaders(ClientConnection* client) {
+    RequestParser::Status status = client->parser.parse(client->requestBuffer);
+    if (status == RequestParser::INCOMPLETE)
+        return false;
     
-    if (headerEnd == std::string::npos)
+    if (status == RequestParser::FAILED) {
+        const ServerConfig& server = config.getServer(client->serverIndex);
+        std::cout << "Malformed request on socket " << client->fd
+                  << " (" << client->parser.error() << ")" << std::endl;
+        if (client->parser.error() == 501)
+            client->responseBuffer.assign(HttpResponse::build501(&server));
+        else if (client->parser.error() == 431)
+            client->responseBuffer.assign(HttpResponse::build431(&server));
+        else
+            client->responseBuffer.assign(HttpResponse::build400(&server));
+        beginResponse(client);
         return false;
+    }
     
+    const ParsedRequest& request = client->parser.request();
     client->headersComplete = true;
-    client->headerEndOffset = headerEnd + 4;
-    
-    if (client->requestBuffer.length() > client->headerEndOffset)
-        client->bodyBytesReceived = client->requestBuffer.length() - client->headerEndOffset;
+    client->bodyBytesReceived = client->requestBuffer.size() - request.headerEnd;
     
     determineMaxBodySize(client);
     
     if (!checkContentLengthHeader(client))
         return false;
     
+    if (request.framing == ParsedRequest::BODY_CHUNKED) {
+        client->chunked.reset(client->maxBodySize);
+        if (!decodeChunkedBody(client))
+            return false;
+    }
+    
+    if (client->serverIndex < httpHandlers.size()) {
+        HttpRequest* handler = httpHandlers[client->serverIndex];
+        if (handler->beginUpload(client)) {
+            if (!streamUploadBody(client))
+                return false;
+        } else if (handler->beginCgi(client)) {
+            connManager->addCgiPipes(client);
+            if (!streamCgiBody(client))
+                return false;
+        }
+    }
+    
+    // The client holds the body back until told to go on (or until it tires of waiting).
+    if (request.expectsContinue() && messageLength(client) == BufferChain::npos) {
+        static const char interim[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        send(client->fd, interim, sizeof(interim) - 1, MSG_NOSIGNAL);
+    }
     return true;
 }
 
@@ -395,7 +570,7 @@ void WebServer::determineMaxBodySize(ClientConnection* client) {
         return;
     
     const ServerConfig& server = config.getServer(client->serverIndex);
-    std::string requestPath = extractRequestPath(client);
+    const std::string& requestPath = client->parser.request().path;
     
     size_t bestMatchLen = 0;
     size_t locationMaxBodySize = 0;
@@ -419,21 +594,6 @@ void WebServer::determineMaxBodySize(ClientConnection* client) {
     client->maxBodySize = locationHasBodySizeLimit ? locationMaxBodySize : server.clientMaxBodySize;
 }
 
-std::string WebServer::extractRequestPath(ClientConnection* client) {
-    std::string requestPath;
-    size_t firstSpace = client->requestBuffer.find(' ');
-    if (firstSpace != std::string::npos) {
-        size_t secondSpace = client->requestBuffer.find(' ', firstSpace + 1);
-        if (secondSpace != std::string::npos) {
-            requestPath = client->requestBuffer.substr(firstSpace + 1, secondSpace - firstSpace - 1);
-            size_t queryPos = requestPath.find('?');
-            if (queryPos != std::string::npos)
-                requestPath = requestPath.substr(0, queryPos);
-        }
-    }
-    return requestPath;
-}
-
 bool WebServer::isValidPathMatch(const std::string& requestPath, const std::string& locPath) {
     if (requestPath.length() == locPath.length())
         return true;
@@ -445,43 +605,169 @@ bool WebServer::isValidPathMatch(const std::string& requestPath, const std::stri
 }
 
 bool WebServer::checkContentLengthHeader(ClientConnection* client) {
-    if (client->maxBodySize == 0)
+    const ParsedRequest& request = client->parser.request();
+    if (client->maxBodySize == 0 || request.framing != ParsedRequest::BODY_LENGTH
+        || request.contentLength <= client->maxBodySize)
         return true;
     
-    std::string headers = client->requestBuffer.substr(0, client->headerEndOffset);
-    std::string headersLower = StringUtils::toLower(headers);
-    
-    size_t pos = headersLower.find("content-length:");
-    if (pos != std::string::npos) {
-        size_t valueStart = headers.find_first_not_of(" \t", pos + 15);
-        size_t valueEnd = headers.find("\r\n", valueStart);
-        if (valueStart != std::string::npos && valueEnd != std::string::npos) {
-            std::string lengthStr = headers.substr(valueStart, valueEnd - valueStart);
-            size_t declaredLength = std::atoi(lengthStr.c_str());
-            if (declaredLength > client->maxBodySize) {
-                std::cout << "Content-Length " << declaredLength 
-                          << " exceeds limit " << client->maxBodySize 
-                          << " (early rejection)" << std::endl;
-                const ServerConfig& server = config.getServer(client->serverIndex);
-                client->responseBuffer = HttpResponse::build413(&server);
-                client->state = ClientConnection::SENDING_RESPONSE;
-                connManager->prepareResponseMode(client);
-                return false;
-            }
+    std::cout << "Content-Length " << request.contentLength 
+              << " exceeds limit " << client->maxBodySize 
+              << " (early rejection)" << std::endl;
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    client->responseBuffer.assign(HttpResponse::build413(&server));
+    beginResponse(client);
+    return false;
+}
+
+// Chunks that arrived since the last call are decoded into requestBody and dropped from
+// requestBuffer, so a chunked upload is scanned once and not held twice. The decoder
+// applies the body size limit to the decoded size. False once an error response is set.
+bool WebServer::decodeChunkedBody(ClientConnection* client) {
+    const ParsedRequest& request = client->parser.request();
+    if (request.framing != ParsedRequest::BODY_CHUNKED || client->chunked.status() != ChunkedDecoder::INCOMPLETE)
+        return true;
+    
+    size_t used = client->chunked.decode(client->requestBuffer, request.headerEnd, client->requestBody);
+    client->requestBuffer.erase(request.headerEnd, used);
+    client->bodyBytesReceived = client->chunked.size();
+    if (client->chunked.status() != ChunkedDecoder::FAILED)
+        return true;
+    
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    if (client->chunked.error() == 413) {
+        std::cout << "Chunked body exceeds limit " << client->maxBodySize << std::endl;
+        client->responseBuffer.assign(HttpResponse::build413(&server));
+    } else {
+        std::cout << "Malformed chunked body on socket " << client->fd
+                  << " (" << client->chunked.error() << ")" << std::endl;
+        client->responseBuffer.assign((client->chunked.error() == 431)
+            ? HttpResponse::build431(&server)
+            : HttpResponse::build400(&server));
+    }
+    beginResponse(client);
+    return false;
+}
+
+// An upload in progress takes the body bytes that arrived since the last call, decoded
+// ones for a chunked body; they leave the buffers at once, so an upload of any size
+// holds no more than a read. False once an error response is set.
+bool WebServer::streamUploadBody(ClientConnection* client) {
+    const ParsedRequest& request = client->parser.request();
+    MultipartUpload& upload = client->upload;
+    if (upload.status() == MultipartUpload::INCOMPLETE) {
+        if (request.framing == ParsedRequest::BODY_CHUNKED) {
+            upload.write(client->requestBody, 0, client->requestBody.size());
+            client->bodyStreamed += client->requestBody.size();
+            client->requestBody.clear();
+        } else {
+            size_t count = client->requestBuffer.size() - request.headerEnd;
+            if (count > request.contentLength - client->bodyStreamed)
+                count = request.contentLength - client->bodyStreamed;
+            upload.write(client->requestBuffer, request.headerEnd, count);
+            client->requestBuffer.erase(request.headerEnd, count);
+            client->bodyStreamed += count;
+        }
+    }
+    if (upload.status() != MultipartUpload::FAILED)
+        return true;
+    
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    std::cout << "Upload failed on socket " << client->fd << " (" << upload.error() << ")" << std::endl;
+    client->responseBuffer.assign((upload.error() == 400)
+        ? HttpResponse::build400(&server)
+        : HttpResponse::build500("Failed to save uploaded file.", &server));
+    beginResponse(client);
+    return false;
+}
+
+// A CGI started early (see HttpRequest::beginCgi) takes the body bytes that arrived
+// since the last call, and the script gets as many of them as its pipe holds at once.
+// Bytes past the body stay behind for the next request. False once an error response is set.
+bool WebServer::streamCgiBody(ClientConnection* client) {
+    if (client->state != ClientConnection::READING_REQUEST || client->cgiOutputFd < 0 || client->cgiInputComplete)
+        return true;
+    
+    const ParsedRequest& request = client->parser.request();
+    size_t count = client->requestBuffer.size() - request.headerEnd;
+    if (count > request.contentLength - client->bodyStreamed)
+        count = request.contentLength - client->bodyStreamed;
+    client->requestBuffer.moveTail(request.headerEnd + count, client->pipelineBuffer);
+    if (client->cgiInputFd >= 0)
+        client->requestBuffer.moveTail(request.headerEnd, client->cgiInput);
+    else
+        client->requestBuffer.erase(request.headerEnd, count);
+    client->bodyStreamed += count;
+    client->cgiInputComplete = (client->bodyStreamed == request.contentLength);
+    return flushCgiInput(client);
+}
+
+// Writes cgiInput to the script until its pipe is full, and closes the pipe after the
+// last body byte. Bytes the script has not taken yet keep the body paused, so a slow
+// script holds the client back instead of the body piling up here. A script that stops
+// reading just loses the rest of the body. False once an error response is set.
+bool WebServer::flushCgiInput(ClientConnection* client) {
+    if (client->serverIndex >= httpHandlers.size() || !httpHandlers[client->serverIndex]->getCgiHandler())
+        return true;
+    CgiHandler* cgiHandler = httpHandlers[client->serverIndex]->getCgiHandler();
+    
+    ssize_t bytesWritten = 0;
+    while (!client->cgiInput.empty()) {
+        bytesWritten = cgiHandler->writeToCgi(client);
+        if (bytesWritten <= 0 && !(bytesWritten < 0 && errno == EINTR))
+            break;
+    }
+    
+    if (bytesWritten < 0 && errno == EPIPE) {
+        client->cgiInput.clear();
+        connManager->closeCgiInput(client);
+    } else if (bytesWritten < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        std::cerr << "CGI: Error writing to CGI for client " << client->fd << std::endl;
+        cgiHandler->killCgi(client);
+        connManager->removeCgiPipes(client);
+        
+        // A streamed response has already sent its head.
+        if (client->state == ClientConnection::SENDING_RESPONSE) {
+            closeClient(client);
+            return false;
         }
+        const ServerConfig& server = config.getServer(client->serverIndex);
+        client->responseBuffer.assign(HttpResponse::build500("CGI execution error", &server));
+        beginResponse(client);
+        return false;
     }
+    
+    if (!client->cgiInput.empty()) {
+        connManager->watchCgiInput(client);
+    } else {
+        connManager->unwatchCgiInput(client);
+        if (client->cgiInputComplete)
+            connManager->closeCgiInput(client);
+    }
+    pauseBody(client, !client->cgiInput.empty());
     return true;
 }
 
+// A paused body is not read from the socket; cgi_timeout instead of the body timeout
+// bounds how long the script may take to catch up.
+void WebServer::pauseBody(ClientConnection* client, bool paused) {
+    if (client->state != ClientConnection::READING_REQUEST || client->bodyPaused == paused)
+        return;
+    
+    client->bodyPaused = paused;
+    armTimer(client, paused ? client->cgiTimeout : config.getServer(client->serverIndex).clientBodyTimeout);
+    if (!edgeTriggered && !connManager->modifyClientEvents(client, paused ? EPOLLRDHUP : (EPOLLIN | EPOLLRDHUP)))
+        closeClient(client);
+}
+
 bool WebServer::checkBodySize(ClientConnection* client) {
     if (!client->headersComplete || client->maxBodySize == 0)
         return true;
+    // Bytes past a complete message belong to the next pipelined request.
+    const ParsedRequest& request = client->parser.request();
+    if (messageLength(client) != BufferChain::npos)
+        return true;
     
-    std::string headers = client->requestBuffer.substr(0, client->headerEndOffset);
-    std::string headersLower = StringUtils::toLower(headers);
-    bool isChunked = headersLower.find("transfer-encoding: chunked") != std::string::npos;
-    
-    if (!isChunked && client->bodyBytesReceived > client->maxBodySize) {
+    if (request.framing != ParsedRequest::BODY_CHUNKED && client->bodyBytesReceived > client->maxBodySize) {
         std::cout << "Body size " << client->bodyBytesReceived 
                   << " exceeds limit " << client->maxBodySize 
                   << " during reading (progressive check)" << std::endl;
@@ -490,9 +776,8 @@ bool WebServer::checkBodySize(ClientConnection* client) {
         if (client->serverIndex < config.getServerCount())
             serverConfig = &config.getServer(client->serverIndex);
         
-        client->responseBuffer = HttpResponse::build413(serverConfig);
-        client->state = ClientConnection::SENDING_RESPONSE;
-        connManager->prepareResponseMode(client);
+        client->responseBuffer.assign(HttpResponse::build413(serverConfig));
+        beginResponse(client);
         return false;
     }
     return true;
@@ -502,152 +787,298 @@ bool WebServer::waitForCompleteBody(ClientConnection* client) {
     if (!client->headersComplete)
         return false;
     
-    std::string headers = client->requestBuffer.substr(0, client->headerEndOffset);
-    std::string method = extractMethod(headers);
-    
-    if (method != "POST" && method != "PUT")
-        return true;
-    
-    std::string headersLower = StringUtils::toLower(headers);
-    bool isChunked = headersLower.find("transfer-encoding: chunked") != std::string::npos;
-    
-    if (isChunked) {
-        std::string body = client->requestBuffer.substr(client->headerEndOffset);
-        return body.find("0\r\n\r\n") != std::string::npos;
-    }
-    
-    size_t pos = headersLower.find("content-length:");
-    if (pos == std::string::npos) {
+    const ParsedRequest& request = client->parser.request();
+    if ((request.method == ParsedRequest::METHOD_POST || request.method == ParsedRequest::METHOD_PUT)
+        && request.framing == ParsedRequest::BODY_NONE) {
         std::cout << "Rejecting POST/PUT without Content-Length (not chunked)" << std::endl;
-        client->responseBuffer = HttpResponse::build411();
-        client->state = ClientConnection::SENDING_RESPONSE;
-        connManager->prepareResponseMode(client);
+        client->responseBuffer.assign(HttpResponse::build411());
+        beginResponse(client);
         return false;
     }
     
-    size_t valueStart = headers.find_first_not_of(" \t", pos + 15);
-    size_t valueEnd = headers.find("\r\n", valueStart);
-    std::string lengthStr = headers.substr(valueStart, valueEnd - valueStart);
-    size_t contentLength = std::atoi(lengthStr.c_str());
-    
-    return contentLength == 0 || client->bodyBytesReceived >= contentLength;
+    return messageLength(client) != BufferChain::npos;
 }
 
-std::string WebServer::extractMethod(const std::string& headers) {
-    size_t firstSpace = headers.find(' ');
-    return (firstSpace != std::string::npos) ? headers.substr(0, firstSpace) : "";
+// Where the current request ends in requestBuffer, or npos while its body is incomplete.
+// A chunked body has been decoded out of the buffer, so once complete the request ends
+// with its header block; so does the part of an upload already streamed to disk.
+size_t WebServer::messageLength(ClientConnection* client) {
+    const ParsedRequest& request = client->parser.request();
+    if (request.framing == ParsedRequest::BODY_CHUNKED)
+        return (client->chunked.status() == ChunkedDecoder::COMPLETE) ? request.headerEnd : BufferChain::npos;
+    if (request.framing == ParsedRequest::BODY_LENGTH && client->bodyStreamed > 0) {
+        size_t remaining = request.contentLength - client->bodyStreamed;
+        return (client->requestBuffer.size() - request.headerEnd >= remaining)
+            ? request.headerEnd + remaining : BufferChain::npos;
+    }
+    return messageLength(client->requestBuffer, request);
+}
+
+// Where the request parsed from the front of buffer ends, or npos while its body is
+// still incomplete. Any method may carry a body; it has to be skipped for the next
+// pipelined request to be found. Chunked bodies are only decoded for the current
+// request (see decodeChunkedBody), so they count as incomplete here.
+size_t WebServer::messageLength(const BufferChain& buffer, const ParsedRequest& request) {
+    size_t headerEnd = request.headerEnd;
+    
+    if (request.framing == ParsedRequest::BODY_CHUNKED)
+        return BufferChain::npos;
+    if (request.framing == ParsedRequest::BODY_NONE)
+        return headerEnd;
+    return (buffer.size() - headerEnd >= request.contentLength)
+        ? headerEnd + request.contentLength : BufferChain::npos;
 }
 
 void WebServer::processRequest(ClientConnection* client) {
+    // Whatever arrived after this request belongs to the next one.
+    size_t end = messageLength(client);
+    client->requestBuffer.moveTail(end, client->pipelineBuffer);
+    if (client->parser.request().framing != ParsedRequest::BODY_CHUNKED)
+        client->bodyBytesReceived = end - client->parser.request().headerEnd + client->bodyStreamed;
+    
+    stats.requestsProcessed++;
     if (client->serverIndex < httpHandlers.size())
         httpHandlers[client->serverIndex]->handleRequest(client);
     
+    if (client->state == ClientConnection::CGI_RUNNING && client->cgiLocation
+        && !client->cgiLocation->fastcgiPass.empty()) {
+        passToFastCgi(client);
+        return;
+    }
+    
     if (client->state == ClientConnection::CGI_RUNNING) {
         connManager->addCgiPipes(client);
+        armTimer(client, client->cgiTimeout);
+        if (flushCgiInput(client))
+            relayCgiOutput(client);
         return;
     }
     
-    if (!client->responseBuffer.empty()) {
-        client->state = ClientConnection::SENDING_RESPONSE;
-        connManager->prepareResponseMode(client);
-    }
+    if (!client->responseBuffer.empty() && !pipelineNextRequest(client))
+        beginResponse(client);
+}
+
+// A response held in memory is not sent yet while the next pipelined request has fully
+// arrived: that request is handled at once and its response queued behind, so up to
+// pipeline_depth responses leave in one write. A response streamed from a file, a CGI
+// request or a closing connection ends the batch.
+bool WebServer::pipelineNextRequest(ClientConnection* client) {
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    if (client->fileFd >= 0 || client->pipelinedCount + 1 >= server.pipelineDepth || !shouldKeepAlive(client))
+        return false;
+    
+    RequestParser next;
+    if (next.parse(client->pipelineBuffer) != RequestParser::COMPLETE
+        || messageLength(client->pipelineBuffer, next.request()) == BufferChain::npos)
+        return false;
+    
+    client->pipelinedResponses.splice(client->responseBuffer);
+    client->pipelinedCount++;
+    client->resetRequest();
+    client->parser = next;
+    client->requestBuffer.splice(client->pipelineBuffer);
+    parseRequestData(client, client->requestBuffer.size());
+    if (!client->closed && client->state == ClientConnection::READING_REQUEST)
+        beginResponse(client);
+    return true;
 }
 
+// A request answered before its body was read (413, bad chunks, a failed upload) leaves
+// the rest of the body unread on the socket, so that connection is closed.
 bool WebServer::shouldKeepAlive(ClientConnection* client) {
-    std::string reqHeaders;
-    if (client->headerEndOffset > 0 && client->requestBuffer.length() >= client->headerEndOffset)
-        reqHeaders = client->requestBuffer.substr(0, client->headerEndOffset);
-    
-    std::string version;
-    size_t firstLineEnd = reqHeaders.find("\r\n");
-    if (firstLineEnd != std::string::npos) {
-        std::string firstLine = reqHeaders.substr(0, firstLineEnd);
-        std::istringstream fls(firstLine);
-        std::string method, path;
-        fls >> method >> path >> version;
-    }
-    
-    std::string headersLower = StringUtils::toLower(reqHeaders);
-    bool hasConnClose = headersLower.find("connection: close") != std::string::npos;
-    bool hasConnKeepAlive = headersLower.find("connection: keep-alive") != std::string::npos;
-    
-    if (version == "HTTP/1.1")
-        return !hasConnClose;
-    if (version == "HTTP/1.0")
-        return hasConnKeepAlive;
-    return false;
+    if (config.getServer(client->serverIndex).keepaliveTimeout == 0
+        || client->parser.status() != RequestParser::COMPLETE
+        || messageLength(client) == BufferChain::npos
+        || client->upload.status() == MultipartUpload::FAILED || client->closeAfterResponse)
+        return false;
+    return client->parser.request().keepAlive();
 }
 
-void WebServer::prepareForNextRequest(ClientConnection* client, int clientSocket) {
+void WebServer::prepareForNextRequest(ClientConnection* client) {
     client->clearBuffers();
+    client->requestBuffer.splice(client->pipelineBuffer);
     client->state = ClientConnection::READING_REQUEST;
+    armTimer(client, config.getServer(client->serverIndex).keepaliveTimeout);
     
-    struct epoll_event ev;
-    ev.events = EPOLLIN | EPOLLRDHUP;
-    ev.data.fd = clientSocket;
-    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, clientSocket, &ev) < 0)
-        connManager->removeClient(clientSocket);
+    // A pipelined request that is already here does not wait for the socket.
+    if (!client->requestBuffer.empty()) {
+        parseRequestData(client, client->requestBuffer.size());
+        if (client->closed || client->state == ClientConnection::SENDING_RESPONSE)
+            return;
+    }
+    
+    if (edgeTriggered)
+        return;
+    
+    if (!connManager->modifyClientEvents(client, EPOLLIN | EPOLLRDHUP))
+        closeClient(client);
 }
 
-void WebServer::handleClientWrite(int clientSocket) {
-    ClientConnection* client = connManager->findClient(clientSocket);
-    if (!client) {
-        std::cerr << "Client not found: " << clientSocket << std::endl;
-        return;
-    }
+void WebServer::handleClientWrite(ClientConnection* client) {
+    int clientSocket = client->fd;
     
     if (client->isResponseComplete()) {
         if (shouldKeepAlive(client))
-            prepareForNextRequest(client, clientSocket);
+            prepareForNextRequest(client);
         else
-            connManager->removeClient(clientSocket);
+            closeClient(client);
         return;
     }
     
-    size_t remaining = client->getRemainingBytes();
-    ssize_t sent = send(clientSocket, client->responseBuffer.c_str() + client->bytesSent, remaining, 0);
-    
-    if (sent < 0) {
-        connManager->removeClient(clientSocket);
+    if (!client->hasOutput()) {
+        waitForCgiOutput(client);
         return;
     }
     
-    client->bytesSent += sent;
-    
-    if (client->isResponseComplete()) {
-        std::string statusLine;
+    // The chain is consumed as it is sent, so keep the status line for the log.
+    if (client->bytesSent == 0) {
         size_t endOfLine = client->responseBuffer.find("\r\n");
-        if (endOfLine != std::string::npos)
-            statusLine = client->responseBuffer.substr(0, endOfLine);
+        if (endOfLine != BufferChain::npos)
+            client->responseStatus = client->responseBuffer.substr(0, endOfLine);
+    }
+    
+    do {
+        size_t attempted = 0;
+        ssize_t sent = sendResponseData(client, attempted);
+        
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                client->writable = false;
+                return;
+            }
+            closeClient(client);
+            return;
+        }
         
+        client->bytesSent += sent;
+        stats.bytesSent += sent;
+        if (sent > 0)
+            armTimer(client, config.getServer(client->serverIndex).sendTimeout);
+        if (static_cast<size_t>(sent) < attempted)
+            client->writable = false;
+    } while (edgeTriggered && client->writable && client->hasOutput());
+    
+    if (client->isResponseComplete()) {
         std::cout << "Response sent to socket " << clientSocket 
-                  << " [" << statusLine << "]" << std::endl;
+                  << " [" << client->responseStatus << "]" << std::endl;
         
         if (shouldKeepAlive(client))
-            prepareForNextRequest(client, clientSocket);
+            prepareForNextRequest(client);
         else
-            connManager->removeClient(clientSocket);
+            closeClient(client);
+    } else if (client->cgiStreaming) {
+        if (!client->hasOutput())
+            waitForCgiOutput(client);
+        if (client->responseBuffer.size() < CGI_STREAM_BUFFER / 2)
+            connManager->watchCgiOutput(client);
     }
 }
 
+// Everything the script wrote so far is sent: in level-triggered mode the socket stops
+// reporting EPOLLOUT until it writes more, and cgi_timeout bounds the wait.
+void WebServer::waitForCgiOutput(ClientConnection* client) {
+    armTimer(client, client->cgiTimeout);
+    if (!edgeTriggered && !connManager->modifyClientEvents(client, EPOLLRDHUP))
+        closeClient(client);
+}
+
+// Headers and in-memory bodies leave from the chain first; an attached file follows
+// with sendfile(). MSG_MORE lets the kernel pack the headers with the first file pages.
+ssize_t WebServer::sendResponseData(ClientConnection* client, size_t& attempted) {
+    if (!client->responseBuffer.empty()) {
+        int flags = (client->fileFd >= 0) ? MSG_MORE : 0;
+        return client->responseBuffer.sendTo(client->fd, attempted, flags);
+    }
+    
+    attempted = static_cast<size_t>(client->fileRemaining);
+    if (attempted > SENDFILE_CHUNK)
+        attempted = SENDFILE_CHUNK;
+    ssize_t sent = sendfile(client->fd, client->fileFd, &client->fileOffset, attempted);
+    if (sent == 0) {
+        // The file shrank after its Content-Length was sent; the response cannot be completed.
+        errno = EIO;
+        return -1;
+    }
+    if (sent > 0) {
+        client->fileRemaining -= sent;
+        if (client->fileRemaining == 0)
+            client->nextFileRange();
+    }
+    return sent;
+}
+
+// Safe from a signal handler or another thread: only the flag and a write() to the
+// eventfd, which ends the worker's epoll_wait at once.
 void WebServer::stop() {
-    if (!running)
+    running = 0;
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+size_t WebServer::getWorkerId() const {
+    return workerId;
+}
+
+const WorkerStats& WebServer::getStats() const {
+    return stats;
+}
+
+void WebServer::setWorkerId(size_t id) {
+    workerId = id;
+}
+
+void WebServer::shutdown() {
+    if (epollFd < 0 && serverSockets.empty())
         return;
-    running = false;
     
     for (size_t i = 0; i < serverSockets.size(); ++i) {
         if (serverSockets[i].fd >= 0) {
-            epoll_ctl(epollFd, EPOLL_CTL_DEL, serverSockets[i].fd, NULL);
-            close(serverSockets[i].fd);
             std::cout << "Server socket closed: " << serverSockets[i].host 
                       << ":" << serverSockets[i].port << std::endl;
         }
     }
-    serverSockets.clear();
-    fdToServerIndex.clear();
+    closeServerSockets();
     
     if (connManager)
         connManager->closeAllClients();
+    cgiLauncher.stop();
+    
+    for (size_t i = 0; i < httpHandlers.size(); ++i) {
+        const StaticFileCache* cache = httpHandlers[i]->getFileCache();
+        if (!cache->isEnabled())
+            continue;
+        const StaticCacheStats& cacheStats = cache->getStats();
+        const ServerConfig& server = config.getServer(i);
+        std::cout << "Static cache " << server.host << ":" << server.port << ": "
+                  << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+                  << cacheStats.evictions << " evictions, "
+                  << cacheStats.invalidations << " invalidations" << std::endl;
+    }
+    
+    for (size_t i = 0; i < httpHandlers.size(); ++i) {
+        const CompressionCache* cache = httpHandlers[i]->getCompressionCache();
+        if (!cache->isEnabled())
+            continue;
+        const CompressionCacheStats& cacheStats = cache->getStats();
+        const ServerConfig& server = config.getServer(i);
+        std::cout << "Compression cache " << server.host << ":" << server.port << ": "
+                  << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+                  << cacheStats.evictions << " evictions" << std::endl;
+    }
+    
+    for (size_t i = 0; i < httpHandlers.size(); ++i) {
+        CgiCacheStats cacheStats;
+        const CgiHandler* cgiHandler = httpHandlers[i]->getCgiHandler();
+        if (!cgiHandler || !cgiHandler->getCacheStats(cacheStats))
+            continue;
+        const ServerConfig& server = config.getServer(i);
+        std::cout << "CGI cache " << server.host << ":" << server.port << ": "
+                  << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+                  << cacheStats.expired << " expired, " << cacheStats.evictions << " evictions" << std::endl;
+    }
     
     if (epollFd >= 0) {
         close(epollFd);
@@ -658,98 +1089,157 @@ void WebServer::stop() {
     std::cout << "Server shutdown complete" << std::endl;
 }
 
-void WebServer::handleCgiPipeRead(int pipeFd) {
-    ClientConnection* client = connManager->findClientByCgiPipe(pipeFd);
-    if (!client) {
-        std::cerr << "CGI: No client found for pipe " << pipeFd << std::endl;
-        return;
-    }
-    
-    if (client->state != ClientConnection::CGI_RUNNING || client->serverIndex >= httpHandlers.size())
+void WebServer::handleCgiPipeRead(ClientConnection* client) {
+    // A CGI started early may answer while its body is still being read.
+    if (client->cgiOutputFd < 0 || client->serverIndex >= httpHandlers.size())
         return;
     
     CgiHandler* cgiHandler = httpHandlers[client->serverIndex]->getCgiHandler();
     if (!cgiHandler)
         return;
     
-    ssize_t bytesRead = cgiHandler->readFromCgi(client);
+    // Relaying may stop reading (output handle unregistered) while the client catches up.
+    ssize_t bytesRead;
+    do {
+        bytesRead = cgiHandler->readFromCgi(client);
+        if (bytesRead > 0)
+            relayCgiOutput(client);
+    } while (edgeTriggered && bytesRead > 0 && !client->closed && client->cgiOutputHandle.fd >= 0);
     
-    if (bytesRead == 0 || bytesRead < 0) {
-        std::cout << "CGI: Output complete for client " << client->fd << std::endl;
-        cgiHandler->checkCgiComplete(client);
-        cgiHandler->buildResponse(client);
-        connManager->removeCgiPipes(client);
-        cgiHandler->cleanup(client);
-        client->state = ClientConnection::SENDING_RESPONSE;
-        connManager->prepareResponseMode(client);
-    }
+    if (client->closed || bytesRead > 0 || (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+        return;
+    
+    std::cout << "CGI: Output complete for client " << client->fd << std::endl;
+    completeCgiRequest(client, -1);
 }
 
-void WebServer::handleCgiPipeWrite(int pipeFd) {
-    ClientConnection* client = connManager->findClientByCgiPipe(pipeFd);
-    if (!client) {
-        std::cerr << "CGI: No client found for pipe " << pipeFd << std::endl;
+// cgi_buffering off: the response starts once the script's header block is in and its
+// body is passed on as it is read. With CGI_STREAM_BUFFER bytes waiting for the client,
+// the script's output is left in the pipe until the client catches up.
+void WebServer::relayCgiOutput(ClientConnection* client) {
+    const LocationConfig* location = client->cgiLocation;
+    if (client->state == ClientConnection::READING_REQUEST || !location || location->cgiBuffering)
         return;
+    
+    CgiHandler* cgiHandler = httpHandlers[client->serverIndex]->getCgiHandler();
+    if (client->cgiStreaming) {
+        bool waiting = !client->hasOutput();
+        cgiHandler->relayOutput(client);
+        if (waiting && client->hasOutput())
+            beginResponse(client);
+    } else if (cgiHandler->beginStream(client)) {
+        beginResponse(client);
     }
     
-    if (client->serverIndex >= httpHandlers.size())
+    if (!client->closed && client->responseBuffer.size() >= CGI_STREAM_BUFFER)
+        connManager->unwatchCgiOutput(client);
+}
+
+// fastcgi_pass: the request goes out on a pooled backend connection; cgi_timeout
+// bounds the wait for the backend as it does for a script.
+void WebServer::passToFastCgi(ClientConnection* client) {
+    const LocationConfig* location = client->cgiLocation;
+    if (!connManager->getFastCgiPool().submit(client, location->fastcgiPass, location->fastcgiKeepalive)) {
+        failFastCgi(client);
         return;
-    
+    }
+    armTimer(client, client->cgiTimeout);
+}
+
+// The backend could not be reached or dropped the request: 502, unless a streamed
+// response has already sent its head.
+void WebServer::failFastCgi(ClientConnection* client) {
+    bool streaming = client->cgiStreaming;
     CgiHandler* cgiHandler = httpHandlers[client->serverIndex]->getCgiHandler();
-    if (!cgiHandler)
+    cgiHandler->cleanup(client);
+    connManager->removeCgiPipes(client);
+    if (streaming) {
+        closeClient(client);
         return;
-    
-    if (client->cgiBodyOffset >= client->cgiBody.size()) {
-        epoll_ctl(epollFd, EPOLL_CTL_DEL, pipeFd, NULL);
-        connManager->removeSingleCgiPipe(pipeFd);
-        close(pipeFd);
-        client->cgiInputFd = -1;
+    }
+    client->responseBuffer.assign(HttpResponse::build502(&config.getServer(client->serverIndex)));
+    beginResponse(client);
+}
+
+void WebServer::armTimer(ClientConnection* client, int seconds) {
+    timers.schedule(client->timer, static_cast<unsigned long>(seconds) * 1000UL);
+}
+
+void WebServer::beginResponse(ClientConnection* client) {
+    // Responses built earlier for pipelined requests go out first.
+    if (!client->pipelinedResponses.empty()) {
+        client->pipelinedResponses.splice(client->responseBuffer);
+        client->responseBuffer.splice(client->pipelinedResponses);
+    }
+    client->pipelinedCount = 0;
+    client->state = ClientConnection::SENDING_RESPONSE;
+    if (!connManager->prepareResponseMode(client)) {
+        closeClient(client);
         return;
     }
-    
-    ssize_t bytesWritten = cgiHandler->writeToCgi(client);
-    
-    if (bytesWritten < 0) {
-        std::cerr << "CGI: Error writing to CGI for client " << client->fd << std::endl;
-        cgiHandler->killCgi(client);
-        connManager->removeCgiPipes(client);
-        
-        const ServerConfig& server = config.getServer(client->serverIndex);
-        client->responseBuffer = HttpResponse::build500("CGI execution error", &server);
-        
-        client->state = ClientConnection::SENDING_RESPONSE;
-        connManager->prepareResponseMode(client);
-    } else if (bytesWritten == 0 || (bytesWritten > 0 && client->cgiBodyOffset >= client->cgiBody.size())) {
-        epoll_ctl(epollFd, EPOLL_CTL_DEL, pipeFd, NULL);
-        connManager->removeSingleCgiPipe(pipeFd);
-        close(pipeFd);
-        client->cgiInputFd = -1;
+    armTimer(client, config.getServer(client->serverIndex).sendTimeout);
+}
+
+// Every connection ends here. A script still attached to it (started before its body
+// was in, or relaying its output) is killed and waited for rather than left to run on
+// closed pipes: it never sees a cut body as complete and never lingers as a zombie.
+void WebServer::closeClient(ClientConnection* client) {
+    if (!client->closed && client->cgiPid > 0 && client->serverIndex < httpHandlers.size()) {
+        CgiHandler* cgiHandler = httpHandlers[client->serverIndex]->getCgiHandler();
+        if (cgiHandler)
+            cgiHandler->killCgi(client);
     }
+    connManager->removeClient(client);
 }
 
-void WebServer::checkCgiTimeouts() {
-    std::vector<ClientConnection*>& clients = connManager->getClients();
+void WebServer::expireTimers() {
+    timers.advance(nowMs, expiredTimers);
+    for (size_t i = 0; i < expiredTimers.size(); ++i)
+        handleTimeout(expiredTimers[i]->client);
+    expiredTimers.clear();
+}
+
+// Reading: header timeout (whole header), body timeout (between reads) or keep-alive idle.
+// Sending: send timeout between writes. CGI: per-location cgi_timeout, answered with 504,
+// also while a body waits for the script to read it; a streamed response is cut off.
+void WebServer::handleTimeout(ClientConnection* client) {
+    if (client->closed)
+        return;
     
-    for (size_t i = 0; i < clients.size(); ++i) {
-        ClientConnection* client = clients[i];
-        
-        if (client->state != ClientConnection::CGI_RUNNING || client->serverIndex >= httpHandlers.size())
-            continue;
-        
+    if (client->state == ClientConnection::READING_REQUEST && !client->bodyPaused) {
+        if (client->requestBuffer.empty())
+            std::cout << "Idle timeout on socket " << client->fd << std::endl;
+        else if (!client->headersComplete)
+            std::cout << "Client header timeout on socket " << client->fd << std::endl;
+        else
+            std::cout << "Client body timeout on socket " << client->fd << std::endl;
+        closeClient(client);
+        return;
+    }
+    
+    if (client->state == ClientConnection::SENDING_RESPONSE && !client->isWaitingForCgi()) {
+        std::cout << "Send timeout on socket " << client->fd << std::endl;
+        closeClient(client);
+        return;
+    }
+    
+    std::cerr << "CGI: Timeout for client " << client->fd << std::endl;
+    if (client->serverIndex < httpHandlers.size()) {
         CgiHandler* cgiHandler = httpHandlers[client->serverIndex]->getCgiHandler();
-        if (!cgiHandler)
-            continue;
-        
-        if (cgiHandler->hasTimedOut(client, CgiHandler::DEFAULT_CGI_TIMEOUT)) {
-            std::cerr << "CGI: Timeout for client " << client->fd << std::endl;
+        if (cgiHandler)
             cgiHandler->killCgi(client);
-            connManager->removeCgiPipes(client);
-            
-            const ServerConfig& server = config.getServer(client->serverIndex);
-            client->responseBuffer = HttpResponse::build504(&server);
-            
-            client->state = ClientConnection::SENDING_RESPONSE;
-            connManager->prepareResponseMode(client);
-        }
     }
+    connManager->removeCgiPipes(client);
+    
+    // A streamed response has already sent its head.
+    if (client->state == ClientConnection::SENDING_RESPONSE) {
+        closeClient(client);
+        return;
+    }
+    
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    client->responseBuffer.assign(HttpResponse::build504(&server));
+    beginResponse(client);
+    if (edgeTriggered)
+        driveClient(client);
 }
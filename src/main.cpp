@@ -1,7 +1,7 @@
-#include "../include/WebServer.hpp"
+#include "../include/ServerMaster.hpp"
 #include <signal.h>
 
-WebServer* g_server = NULL;
+ServerMaster* g_server = NULL;
 
 void signalHandler(int) {
     if (g_server) {
@@ -16,12 +16,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    WebServer server;
+    ServerMaster server;
     g_server = &server;
     
     // Set up signal handler for graceful shutdown
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+    // sendfile() has no MSG_NOSIGNAL; a peer reset must surface as EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
     
     if (!server.initialize(argv[1])) {
         std::cerr << "Failed to initialize server" << std::endl;
@@ -0,0 +1,203 @@
+#include "../../include/ChunkedDecoder.hpp"
+#include "../../include/StringUtils.hpp"
+#include "../../include/ByteScan.hpp"
+
+namespace {
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+}
+
+ChunkedDecoder::ChunkedDecoder() {
+    reset(0);
+}
+
+// maxSize bounds the decoded body; 0 means no limit.
+void ChunkedDecoder::reset(size_t maxSize) {
+    state = SIZE_START;
+    chunkRemaining = 0;
+    decoded = 0;
+    limit = maxSize;
+    errorStatus = 0;
+    trailerFields.clear();
+}
+
+// Decodes input from offset from up to its end (or the end of the body) and returns how
+// many bytes were used; they are never looked at again. Whatever follows a COMPLETE body
+// belongs to the next request.
+size_t ChunkedDecoder::decode(const BufferChain& input, size_t from, BufferChain& output) {
+    size_t pos = from;
+    const char* data;
+    size_t count;
+    while (state != DONE && state != ERROR && (count = input.contiguous(pos, data)) > 0) {
+        size_t i = 0;
+        while (i < count && state != DONE && state != ERROR) {
+            if (state == DATA) {
+                size_t run = (count - i < chunkRemaining) ? count - i : chunkRemaining;
+                output.append(data + i, run);
+                chunkRemaining -= run;
+                i += run;
+                if (chunkRemaining == 0)
+                    state = DATA_END;
+                continue;
+            }
+            if (state == SIZE || state == EXTENSION || state == TRAILER_NAME || state == TRAILER_VALUE) {
+                i += scanRun(data + i, count - i);
+                if (i == count)
+                    break;
+            }
+            state = step(data[i++]);
+        }
+        pos += i;
+    }
+    return pos - from;
+}
+
+ChunkedDecoder::Status ChunkedDecoder::status() const {
+    if (state == DONE)
+        return COMPLETE;
+    return (state == ERROR) ? FAILED : INCOMPLETE;
+}
+
+// The status code to answer a FAILED body with: 413 over the limit, 431 for too many
+// trailer fields, 400 otherwise.
+int ChunkedDecoder::error() const {
+    return errorStatus;
+}
+
+size_t ChunkedDecoder::size() const {
+    return decoded;
+}
+
+const std::vector<RequestHeader>& ChunkedDecoder::trailers() const {
+    return trailerFields;
+}
+
+ChunkedDecoder::State ChunkedDecoder::fail(int status) {
+    errorStatus = status;
+    return ERROR;
+}
+
+// Takes the rest of a size, extension or trailer line up to its delimiter in one go;
+// step() then handles the delimiter (or the byte that stopped a size or name).
+size_t ChunkedDecoder::scanRun(const char* data, size_t size) {
+    if (state == EXTENSION)
+        return ByteScan::firstOf(data, size, '\r', '\n', '\0');
+    if (state == TRAILER_VALUE) {
+        size_t length = ByteScan::firstOf(data, size, '\r', '\n', '\0');
+        trailerFields.back().value.append(data, length);
+        return length;
+    }
+
+    size_t length = ByteScan::firstOf(data, size, (state == SIZE) ? ';' : ':', '\r', '\n');
+    for (size_t i = 0; i < length; ++i) {
+        if (state == SIZE) {
+            int digit = hexValue(data[i]);
+            if (digit < 0 || chunkRemaining > (static_cast<size_t>(-1) >> 4))
+                return i;
+            chunkRemaining = chunkRemaining * 16 + digit;
+        } else {
+            if (!StringUtils::isTokenChar(data[i]))
+                return i;
+            trailerFields.back().name += data[i];
+        }
+    }
+    return length;
+}
+
+ChunkedDecoder::State ChunkedDecoder::step(char c) {
+    switch (state) {
+    case SIZE_START:
+        if (hexValue(c) < 0)
+            return fail(400);
+        chunkRemaining = hexValue(c);
+        return SIZE;
+    case SIZE:
+        if (hexValue(c) >= 0) {
+            if (chunkRemaining > (static_cast<size_t>(-1) >> 4))
+                return fail(400);
+            chunkRemaining = chunkRemaining * 16 + hexValue(c);
+            return SIZE;
+        }
+        // Chunk extensions are ignored.
+        if (c == ';' || c == ' ' || c == '\t')
+            return EXTENSION;
+        if (c == '\r')
+            return SIZE_LF;
+        if (c != '\n')
+            return fail(400);
+        state = SIZE_LF;
+        return step(c);
+    case SIZE_LF:
+        if (c != '\n')
+            return fail(400);
+        if (chunkRemaining == 0)
+            return TRAILER_START;
+        if (limit > 0 && chunkRemaining > limit - decoded)
+            return fail(413);
+        decoded += chunkRemaining;
+        return DATA;
+    case EXTENSION:
+        if (c == '\r')
+            return SIZE_LF;
+        if (c == '\n') {
+            state = SIZE_LF;
+            return step(c);
+        }
+        return (c == '\0') ? fail(400) : EXTENSION;
+    case DATA_END:
+        if (c == '\r')
+            return DATA_LF;
+        return (c == '\n') ? SIZE_START : fail(400);
+    case DATA_LF:
+        return (c == '\n') ? SIZE_START : fail(400);
+    case TRAILER_START:
+        if (c == '\r')
+            return BLANK_LF;
+        if (c == '\n')
+            return DONE;
+        if (!StringUtils::isTokenChar(c))
+            return fail(400);
+        if (trailerFields.size() == ParsedRequest::MAX_HEADERS)
+            return fail(431);
+        trailerFields.push_back(RequestHeader());
+        trailerFields.back().name += c;
+        return TRAILER_NAME;
+    case TRAILER_NAME: {
+        RequestHeader& field = trailerFields.back();
+        if (c == ':') {
+            field.name = StringUtils::toLower(field.name);
+            field.id = ParsedRequest::lookup(field.name.data(), field.name.size());
+            return TRAILER_VALUE;
+        }
+        if (!StringUtils::isTokenChar(c))
+            return fail(400);
+        field.name += c;
+        return TRAILER_NAME;
+    }
+    case TRAILER_VALUE:
+        // scanRun() has taken the value; only its delimiter or a NUL gets here.
+        if (c == '\r')
+            return TRAILER_LF;
+        if (c == '\n') {
+            state = TRAILER_LF;
+            return step(c);
+        }
+        return fail(400);
+    case TRAILER_LF:
+        if (c != '\n')
+            return fail(400);
+        trailerFields.back().value = StringUtils::trim(trailerFields.back().value);
+        return TRAILER_START;
+    case BLANK_LF:
+        return (c == '\n') ? DONE : fail(400);
+    default:
+        return state;
+    }
+}
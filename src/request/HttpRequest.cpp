@@ -1,13 +1,18 @@
 #include "../../include/HttpRequest.hpp"
 #include "../../include/HttpResponse.hpp"
 #include "../../include/CgiHandler.hpp"
-#include "../../include/StringUtils.hpp"
 #include <sstream>
 #include <iostream>
 #include <sys/stat.h>
 
-HttpRequest::HttpRequest(Config& cfg) : config(cfg), cgiHandler(NULL) {
-    cgiHandler = new CgiHandler(config);
+HttpRequest::HttpRequest(Config& cfg, size_t serverIndex, CgiLauncher& launcher)
+    : config(cfg), cgiHandler(NULL), fileCache(NULL), openFiles(NULL),
+      compressedFiles(NULL), rangeResponses(0) {
+    const ServerConfig& server = config.getServer(serverIndex);
+    openFiles = new OpenFileCache(server.openFileCacheMax, server.openFileCacheValid, server.openFileCacheErrors);
+    cgiHandler = new CgiHandler(config, *openFiles, launcher);
+    fileCache = new StaticFileCache(server.staticCacheSize, server.staticCacheMaxEntry, serverIndex);
+    compressedFiles = new CompressionCache(server.gzipCacheSize);
 }
 
 HttpRequest::~HttpRequest() {
@@ -15,49 +20,30 @@ HttpRequest::~HttpRequest() {
         delete cgiHandler;
         cgiHandler = NULL;
     }
+    if (fileCache) {
+        delete fileCache;
+        fileCache = NULL;
+    }
+    if (compressedFiles) {
+        delete compressedFiles;
+        compressedFiles = NULL;
+    }
+    if (openFiles) {
+        delete openFiles;
+        openFiles = NULL;
+    }
 }
 
 CgiHandler* HttpRequest::getCgiHandler() const {
     return cgiHandler;
 }
 
-bool HttpRequest::isRequestComplete(const std::string& buffer) {
-    return buffer.find("\r\n\r\n") != std::string::npos;
-}
-
-std::string HttpRequest::extractMethod(const std::string& headers) {
-    std::istringstream iss(headers);
-    std::string method;
-    iss >> method;
-    return method;
+StaticFileCache* HttpRequest::getFileCache() const {
+    return fileCache;
 }
 
-std::string HttpRequest::extractPath(const std::string& headers) {
-    std::istringstream iss(headers);
-    std::string method, path;
-    iss >> method >> path;
-    return path;
-}
-
-bool HttpRequest::isMethodImplemented(const std::string& method) {
-    return method == "GET" || method == "HEAD" || method == "POST" || 
-           method == "PUT" || method == "DELETE";
-}
-
-bool HttpRequest::validateRequestLine(const std::string& method, const std::string& path,
-                                       const std::string& version, ClientConnection* client) {
-    const ServerConfig& server = config.getServer(client->serverIndex);
-    
-    if (method.empty() || path.empty() || version.empty()) {
-        client->responseBuffer = HttpResponse::build400(&server);
-        return false;
-    }
-    
-    if (version.find("HTTP/") != 0) {
-        client->responseBuffer = HttpResponse::build400(&server);
-        return false;
-    }
-    return true;
+CompressionCache* HttpRequest::getCompressionCache() const {
+    return compressedFiles;
 }
 
 const LocationConfig* HttpRequest::findBestLocation(const std::string& path, const ServerConfig& server) {
@@ -126,79 +112,123 @@ bool HttpRequest::checkRedirect(const std::string& path, size_t serverIndex,
     return false;
 }
 
-bool HttpRequest::checkHostHeader(const std::string& headers, const std::string& version) {
-    if (version != "HTTP/1.1")
-        return true;
-    
-    std::string headersLower = StringUtils::toLower(headers);
-    return headersLower.find("host:") != std::string::npos;
+bool HttpRequest::checkHostHeader(const ParsedRequest& request) {
+    return !request.isHttp11() || request.find(ParsedRequest::HOST) != NULL;
 }
 
+// The request line and headers were parsed and validated as they arrived
+// (see RequestParser); the body, if any, starts at request.headerEnd.
 void HttpRequest::handleRequest(ClientConnection* client) {
     if (client->state == ClientConnection::CGI_RUNNING)
         return;
     
-    size_t headerEnd = client->requestBuffer.find("\r\n\r\n");
-    if (headerEnd == std::string::npos)
-        return;
-    
-    std::string headers = client->requestBuffer.substr(0, headerEnd);
-    size_t bodyStart = headerEnd + 4;
-    
-    std::istringstream iss(headers);
-    std::string method, path, version;
-    iss >> method >> path >> version;
+    const ParsedRequest& request = client->parser.request();
+    const std::string& method = request.methodName;
+    const std::string& path = request.path;
     
-    std::cout << "Request: " << method << " " << path << " " << version << std::endl;
+    std::cout << "Request: " << method << " " << request.target << " " << request.version << std::endl;
     
-    if (!validateRequestLine(method, path, version, client))
-        return;
-    
-    if (!checkHostHeader(headers, version)) {
+    if (!checkHostHeader(request)) {
         const ServerConfig& server = config.getServer(client->serverIndex);
-        client->responseBuffer = HttpResponse::build400(&server);
+        client->responseBuffer.assign(HttpResponse::build400(&server));
         return;
     }
     
     std::string redirectUrl;
     int statusCode;
     if (checkRedirect(path, client->serverIndex, redirectUrl, statusCode)) {
-        client->responseBuffer = (statusCode == 301) 
+        client->responseBuffer.assign((statusCode == 301) 
             ? HttpResponse::build301(redirectUrl) 
-            : HttpResponse::build302(redirectUrl);
+            : HttpResponse::build302(redirectUrl));
         return;
     }
     
-    if (!isMethodImplemented(method)) {
+    if (request.method == ParsedRequest::METHOD_OTHER) {
         const ServerConfig& server = config.getServer(client->serverIndex);
-        client->responseBuffer = HttpResponse::build501(&server);
+        client->responseBuffer.assign(HttpResponse::build501(&server));
         return;
     }
     
     if (!isMethodAllowed(method, path, client->serverIndex)) {
         const ServerConfig& server = config.getServer(client->serverIndex);
-        client->responseBuffer = HttpResponse::build405(&server);
+        client->responseBuffer.assign(HttpResponse::build405(&server));
         return;
     }
     
-    if ((method == "POST" || method == "PUT") && !checkBodySizeLimit(client, method, path, headers, bodyStart))
+    bool hasBody = request.method == ParsedRequest::METHOD_POST || request.method == ParsedRequest::METHOD_PUT;
+    if (hasBody && !checkBodySizeLimit(client, request))
         return;
     
-    if ((method == "GET" || method == "POST") && handleCgiRequest(client, method, path, headers, bodyStart))
+    if ((request.method == ParsedRequest::METHOD_GET || request.method == ParsedRequest::METHOD_POST)
+        && handleCgiRequest(client, request))
         return;
     
-    if (method == "GET") handleGet(client, path);
-    else if (method == "HEAD") handleHead(client, path);
-    else if (method == "POST") handlePost(client, path, headers, bodyStart);
-    else if (method == "PUT") handlePut(client, path, headers, bodyStart);
-    else if (method == "DELETE") handleDelete(client, path);
+    switch (request.method) {
+    case ParsedRequest::METHOD_GET: handleGet(client, request); break;
+    case ParsedRequest::METHOD_HEAD: handleHead(client, request); break;
+    case ParsedRequest::METHOD_POST: handlePost(client, request); break;
+    case ParsedRequest::METHOD_PUT: handlePut(client, request); break;
+    case ParsedRequest::METHOD_DELETE: handleDelete(client, request); break;
+    default: break;
+    }
+}
+
+// True if handleRequest will pass this POST, body and all, on to a handler: the checks
+// it makes first cannot fail.
+bool HttpRequest::reachesHandler(ClientConnection* client) {
+    const ParsedRequest& request = client->parser.request();
+    if (request.method != ParsedRequest::METHOD_POST || request.framing == ParsedRequest::BODY_NONE
+        || !checkHostHeader(request) || !isMethodAllowed(request.methodName, request.path, client->serverIndex))
+        return false;
+    
+    std::string redirectUrl;
+    int statusCode;
+    return !checkRedirect(request.path, client->serverIndex, redirectUrl, statusCode);
 }
 
-bool HttpRequest::checkBodySizeLimit(ClientConnection* client, const std::string& method,
-                                     const std::string& path, const std::string& headers, size_t bodyStart) {
-    (void)method;
+// Called once the headers are in: a POST that handleRequest would pass on to
+// handlePostUpload starts writing its body to the upload directory now, so the body
+// never has to be held. Anything else is left to handleRequest with a buffered body.
+bool HttpRequest::beginUpload(ClientConnection* client) {
+    const ParsedRequest& request = client->parser.request();
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
-    const LocationConfig* location = findBestLocation(path, server);
+    if (!reachesHandler(client) || cgiHandler->isCgiRequest(path, findBestLocation(path, server)))
+        return false;
+    
+    std::string uploadDir;
+    struct stat dirStat;
+    if (!findUploadLocation(path, uploadDir, client->serverIndex)
+        || stat(uploadDir.c_str(), &dirStat) != 0 || !S_ISDIR(dirStat.st_mode))
+        return false;
+    
+    client->upload.begin(uploadDir, getBoundary(request), extractFilename(request, path));
+    return true;
+}
+
+// Likewise a POST with a Content-Length to a CGI script starts the script at once, and
+// WebServer pipes the body into it as it arrives. A chunked body is still read first:
+// its length and trailer fields belong in the script's environment. So is a body for a
+// fastcgi_pass backend, which gets the whole request in one go.
+bool HttpRequest::beginCgi(ClientConnection* client) {
+    const ParsedRequest& request = client->parser.request();
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    const LocationConfig* location = findBestLocation(request.path, server);
+    if (request.framing != ParsedRequest::BODY_LENGTH || !reachesHandler(client)
+        || !cgiHandler->isCgiRequest(request.path, location) || !location->fastcgiPass.empty())
+        return false;
+    
+    std::string scriptPath = cgiScriptPath(request.path, server, location);
+    if (openFiles->lookup(scriptPath).type == FileInfo::MISSING
+        || !cgiHandler->startCgi(client, request, request.contentLength, location, scriptPath))
+        return false;
+    std::cout << "CGI request detected for: " << request.path << " (body streamed)" << std::endl;
+    return true;
+}
+
+bool HttpRequest::checkBodySizeLimit(ClientConnection* client, const ParsedRequest& request) {
+    const ServerConfig& server = config.getServer(client->serverIndex);
+    const LocationConfig* location = findBestLocation(request.path, server);
     
     size_t maxBodySize = (location && location->hasClientMaxBodySize) 
         ? location->clientMaxBodySize 
@@ -207,40 +237,72 @@ bool HttpRequest::checkBodySizeLimit(ClientConnection* client, const std::string
     if (maxBodySize == 0)
         return true;
     
-    size_t actualBodySize = 0;
-    size_t contentLength;
-    
-    if (isChunkedTransferEncoding(headers)) {
-        std::string body = client->requestBuffer.substr(bodyStart);
-        actualBodySize = unchunkBody(body).length();
-    } else if (getContentLength(headers, contentLength)) {
-        actualBodySize = contentLength;
-    }
+    size_t actualBodySize = request.contentLength;
+    if (request.framing == ParsedRequest::BODY_CHUNKED)
+        actualBodySize = client->chunked.size();
     
     if (actualBodySize > maxBodySize) {
         std::cout << "Body size " << actualBodySize << " exceeds limit " << maxBodySize << std::endl;
-        client->responseBuffer = HttpResponse::build413(&server);
+        client->responseBuffer.assign(HttpResponse::build413(&server));
         return false;
     }
     return true;
 }
 
-bool HttpRequest::handleCgiRequest(ClientConnection* client, const std::string& method,
-                                   const std::string& path, const std::string& headers,
-                                   size_t bodyStart) {
+bool HttpRequest::handleCgiRequest(ClientConnection* client, const ParsedRequest& request) {
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
     const LocationConfig* location = findBestLocation(path, server);
     
     if (!cgiHandler->isCgiRequest(path, location))
         return false;
     
+    // Started while its body was arriving (see beginCgi).
+    if (client->cgiOutputFd >= 0) {
+        client->state = ClientConnection::CGI_RUNNING;
+        return true;
+    }
+    
+    if (cgiHandler->serveCached(client, request, location))
+        return true;
+    
     std::cout << "CGI request detected for: " << path << std::endl;
     
-    std::string scriptPath = buildFilePath(path, server, location);
+    std::string scriptPath = cgiScriptPath(path, server, location);
+    if (openFiles->lookup(scriptPath).type == FileInfo::MISSING) {
+        std::cerr << "CGI script not found: " << scriptPath << std::endl;
+        client->responseBuffer.assign(HttpResponse::build404(&server));
+        return true;
+    }
     
-    size_t queryPos = scriptPath.find('?');
-    if (queryPos != std::string::npos)
-        scriptPath = scriptPath.substr(0, queryPos);
+    bool hasBody = request.method == ParsedRequest::METHOD_POST;
+    size_t contentLength = 0;
+    if (hasBody)
+        contentLength = (request.framing == ParsedRequest::BODY_CHUNKED) ? client->chunked.size() : request.contentLength;
+    
+    if (!location->fastcgiPass.empty()) {
+        cgiHandler->startFastCgi(client, request, contentLength, location, scriptPath);
+    } else if (!cgiHandler->startCgi(client, request, contentLength, location, scriptPath)) {
+        client->responseBuffer.assign(HttpResponse::build500("CGI execution failed", &server));
+        return true;
+    }
+    
+    // The body blocks move over to the script's input without being copied.
+    if (hasBody && request.framing == ParsedRequest::BODY_CHUNKED) {
+        client->cgiInput.splice(client->requestBody);
+    } else if (hasBody) {
+        client->requestBuffer.moveTail(request.headerEnd, client->cgiInput);
+        client->bodyStreamed = request.contentLength;
+    }
+    client->cgiInputComplete = true;
+    client->state = ClientConnection::CGI_RUNNING;
+    return true;
+}
+
+// The script for a CGI path: whatever follows the extension is PATH_INFO.
+std::string HttpRequest::cgiScriptPath(const std::string& path, const ServerConfig& server,
+                                       const LocationConfig* location) {
+    std::string scriptPath = buildFilePath(path, server, location);
     
     if (location) {
         for (size_t i = 0; i < location->cgiExt.size(); ++i) {
@@ -253,93 +315,14 @@ bool HttpRequest::handleCgiRequest(ClientConnection* client, const std::string&
             }
         }
     }
-    
-    struct stat fileStat;
-    if (stat(scriptPath.c_str(), &fileStat) != 0) {
-        std::cerr << "CGI script not found: " << scriptPath << std::endl;
-        client->responseBuffer = HttpResponse::build404(&server);
-        return true;
-    }
-    
-    std::string body;
-    if (method == "POST") {
-        body = extractCgiBody(client, headers, bodyStart);
-        if (body.empty() && bodyStart < client->requestBuffer.length())
-            return true;
-    }
-    
-    if (!cgiHandler->startCgi(client, method, path, headers, body, location, scriptPath)) {
-        client->responseBuffer = HttpResponse::build500("CGI execution failed", &server);
-        return true;
-    }
-    return true;
+    return scriptPath;
 }
 
-std::string HttpRequest::extractCgiBody(ClientConnection* client, const std::string& headers, size_t bodyStart) {
-    size_t contentLength = 0;
-    bool hasContentLength = getContentLength(headers, contentLength);
-    bool isChunked = isChunkedTransferEncoding(headers);
-    
-    if (isChunked) {
-        size_t chunkEnd = client->requestBuffer.find("0\r\n\r\n", bodyStart);
-        if (chunkEnd == std::string::npos)
-            return "";
-        return unchunkBody(client->requestBuffer.substr(bodyStart, chunkEnd + 5 - bodyStart));
-    }
-    
-    if (hasContentLength) {
-        size_t bodyReceived = client->requestBuffer.length() - bodyStart;
-        if (bodyReceived < contentLength)
-            return "";
-        return client->requestBuffer.substr(bodyStart, contentLength);
-    }
+// The whole body, which has fully arrived by now: decoded for chunked requests.
+std::string HttpRequest::readBody(ClientConnection* client, const ParsedRequest& request) {
+    if (request.framing == ParsedRequest::BODY_CHUNKED)
+        return client->requestBody.substr(0);
+    if (request.framing == ParsedRequest::BODY_LENGTH)
+        return client->requestBuffer.substr(request.headerEnd, request.contentLength);
     return "";
 }
-
-bool HttpRequest::isChunkedTransferEncoding(const std::string& headers) {
-    std::string headersLower = StringUtils::toLower(headers);
-    size_t pos = headersLower.find("transfer-encoding:");
-    if (pos == std::string::npos)
-        return false;
-    
-    size_t lineEnd = headersLower.find("\r\n", pos + 18);
-    if (lineEnd == std::string::npos)
-        lineEnd = headersLower.length();
-    
-    return headersLower.substr(pos + 18, lineEnd - pos - 18).find("chunked") != std::string::npos;
-}
-
-std::string HttpRequest::unchunkBody(const std::string& chunkedBody) {
-    std::string result;
-    size_t pos = 0;
-    
-    while (pos < chunkedBody.length()) {
-        size_t lineEnd = chunkedBody.find("\r\n", pos);
-        if (lineEnd == std::string::npos)
-            break;
-        
-        std::string sizeStr = chunkedBody.substr(pos, lineEnd - pos);
-        size_t semicolon = sizeStr.find(';');
-        if (semicolon != std::string::npos)
-            sizeStr = sizeStr.substr(0, semicolon);
-        
-        char* endPtr;
-        unsigned long chunkSize = strtoul(sizeStr.c_str(), &endPtr, 16);
-        
-        if (chunkSize == 0)
-            break;
-        
-        pos = lineEnd + 2;
-        
-        if (pos + chunkSize <= chunkedBody.length()) {
-            result.append(chunkedBody, pos, chunkSize);
-            pos += chunkSize;
-        } else {
-            break;
-        }
-        
-        if (pos + 2 <= chunkedBody.length())
-            pos += 2;
-    }
-    return result;
-}
@@ -1,11 +1,198 @@
 #include "../../include/HttpRequest.hpp"
 #include "../../include/HttpResponse.hpp"
+#include "../../include/Compression.hpp"
+#include "../../include/MultipartUpload.hpp"
 #include <sstream>
 #include <iostream>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 
-void HttpRequest::handleGet(ClientConnection* client, const std::string& path) {
+// Reads [offset, offset + length) of fd into the response chain. The fd may be shared with
+// the open-file cache, so it is only ever read at explicit offsets.
+bool HttpRequest::readFileInto(ClientConnection* client, int fd, off_t offset, size_t length) {
+    size_t remaining = length;
+    while (remaining > 0) {
+        ssize_t bytesRead = client->responseBuffer.readFrom(fd, remaining, offset + (length - remaining));
+        if (bytesRead <= 0)
+            return false;
+        remaining -= (static_cast<size_t>(bytesRead) < remaining) ? bytesRead : remaining;
+    }
+    return true;
+}
+
+// Shares the cached bytes, with the Expires header of this request spliced in before the blank line.
+void HttpRequest::appendCachedResponse(ClientConnection* client, const CachedResponse& cached,
+                                       const std::string& expires) {
+    client->responseBuffer.clear();
+    if (expires.empty()) {
+        client->responseBuffer.appendShared(cached.response);
+        return;
+    }
+    client->responseBuffer.appendShared(cached.response, 0, cached.headerEnd);
+    client->responseBuffer.append(expires);
+    client->responseBuffer.appendShared(cached.response, cached.headerEnd,
+                                        cached.response->size() - cached.headerEnd);
+}
+
+// gzip on: the file is compressed in memory, once per coding and level while it stays in the
+// compression cache. The variant gets a weak ETag, as its bytes differ from the file's.
+// HEAD (headersOnly) gets the same headers, so its Content-Length is the compressed size.
+// Returns false when the identity response should be sent instead.
+bool HttpRequest::serveCompressed(ClientConnection* client, const std::string& fullPath,
+                                  const LocationConfig* location, const ParsedRequest& request,
+                                  const std::string& extraHeaders, bool headersOnly) {
+    std::string contentType = HttpResponse::getContentType(fullPath);
+    const std::string& acceptEncoding = request.header(ParsedRequest::ACCEPT_ENCODING);
+    if (acceptEncoding.empty() || !Compression::appliesTo(location, contentType))
+        return false;
+    
+    int fd = openFiles->openFile(fullPath);
+    struct stat fileStat;
+    if (fd < 0 || fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    Compression::Coding coding = Compression::negotiate(location, acceptEncoding, contentType, fileSize);
+    if (coding == Compression::IDENTITY) {
+        close(fd);
+        return false;
+    }
+    
+    std::string etag = HttpResponse::buildETag(fileStat.st_ino, fileStat.st_size, fileStat.st_mtime);
+    std::string headers = std::string("Content-Encoding: ") + Compression::name(coding) + "\r\n"
+        + HttpResponse::buildValidatorHeaders("W/" + etag, fileStat.st_mtime) + extraHeaders;
+    if (isNotModified(request, etag, fileStat.st_mtime)) {
+        close(fd);
+        client->responseBuffer.assign(HttpResponse::build304(headers));
+        return true;
+    }
+    
+    std::ostringstream key;
+    key << fullPath << '\n' << Compression::name(coding) << '\n' << location->gzipCompLevel;
+    SharedBuffer* body = compressedFiles->lookup(key.str(), etag);
+    if (body) {
+        body->retain();
+    } else {
+        std::string plain(fileSize, '\0');
+        std::string packed;
+        ssize_t bytesRead = (fileSize > 0) ? pread(fd, &plain[0], fileSize, 0) : 0;
+        if (bytesRead != static_cast<ssize_t>(fileSize)
+            || !Compression::compress(plain.data(), fileSize, coding, location->gzipCompLevel, packed)) {
+            close(fd);
+            return false;
+        }
+        body = new SharedBuffer(packed);
+        compressedFiles->insert(key.str(), etag, body);
+    }
+    close(fd);
+    
+    client->responseBuffer.assign(HttpResponse::buildEncodedHeaders(contentType, body->size(), headers));
+    if (!headersOnly)
+        client->responseBuffer.appendShared(body);
+    body->release();
+    return true;
+}
+
+// The body comes from a precompressed sibling (gzip_static), on-the-fly gzip, the static
+// cache or the file itself, while Content-Type always follows the requested name. Range
+// requests skip on-the-fly gzip and the cache. Files below sendfile_threshold are read into
+// the chain, larger ones are streamed with sendfile().
+void HttpRequest::serveFile(ClientConnection* client, const std::string& fullPath, const ServerConfig& server,
+                            const LocationConfig* location, const ParsedRequest& request) {
+    std::string filePath = fullPath;
+    std::string encoding = negotiateEncoding(fullPath, location, request, filePath);
+    std::string fixedHeaders = encoding + buildVary(location, HttpResponse::getContentType(fullPath))
+        + HttpResponse::buildCacheControl(location);
+    std::string expires = HttpResponse::buildExpires(location, time(NULL));
+    bool wantsRange = !request.header(ParsedRequest::RANGE).empty();
+    
+    if (encoding.empty() && !wantsRange
+        && serveCompressed(client, fullPath, location, request, fixedHeaders + expires, false))
+        return;
+    
+    // The stored headers follow the requested name (Content-Type), the negotiated coding and
+    // the location, so all of them go into the key, not just the file on disk.
+    std::string cacheKey = fullPath + "\n" + fixedHeaders;
+    bool cacheable = fileCache->isEnabled() && !wantsRange;
+    if (cacheable) {
+        const CachedResponse* cached = fileCache->lookup(cacheKey);
+        if (cached && isNotModified(request, cached->etag, cached->lastModified)) {
+            client->responseBuffer.assign(HttpResponse::build304(
+                HttpResponse::buildValidatorHeaders(cached->etag, cached->lastModified) + fixedHeaders + expires));
+            return;
+        }
+        if (cached) {
+            appendCachedResponse(client, *cached, expires);
+            return;
+        }
+        // What goes into the static cache must be current, not an fd kept open by the open-file cache.
+        openFiles->invalidate(filePath);
+    }
+    
+    int fd = openFiles->openFile(filePath);
+    struct stat fileStat;
+    if (fd < 0 || fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) {
+        if (fd >= 0)
+            close(fd);
+        client->responseBuffer.assign(HttpResponse::build404(&server));
+        return;
+    }
+    
+    std::string etag = HttpResponse::buildETag(fileStat.st_ino, fileStat.st_size, fileStat.st_mtime);
+    std::string validators = HttpResponse::buildValidatorHeaders(etag, fileStat.st_mtime);
+    if (isNotModified(request, etag, fileStat.st_mtime)) {
+        close(fd);
+        client->responseBuffer.assign(HttpResponse::build304(validators + fixedHeaders + expires));
+        return;
+    }
+    if (wantsRange && serveRanges(client, fd, fileStat, fullPath, server, request,
+                                  validators + fixedHeaders + expires))
+        return;
+    
+    std::string headers = HttpResponse::buildFileHeaders(fullPath, fileStat.st_size, validators + fixedHeaders);
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    
+    if (cacheable && fileCache->accepts(headers.size() + fileSize)) {
+        std::string response = headers;
+        response.resize(headers.size() + fileSize);
+        ssize_t bytesRead = (fileSize > 0) ? pread(fd, &response[headers.size()], fileSize, 0) : 0;
+        close(fd);
+        if (bytesRead != static_cast<ssize_t>(fileSize)) {
+            client->responseBuffer.assign(HttpResponse::build500("Failed to read file.", &server));
+            return;
+        }
+        CachedResponse cached;
+        cached.response = new SharedBuffer(response);
+        cached.headerEnd = headers.size() - 2;
+        cached.etag = etag;
+        cached.lastModified = fileStat.st_mtime;
+        fileCache->insert(cacheKey, filePath, cached, fileStat);
+        appendCachedResponse(client, cached, expires);
+        cached.response->release();
+        return;
+    }
+    
+    if (!expires.empty())
+        headers.insert(headers.size() - 2, expires);
+    client->responseBuffer.assign(headers);
+    
+    if (fileSize < server.sendfileThreshold) {
+        bool complete = readFileInto(client, fd, 0, fileSize);
+        close(fd);
+        if (!complete)
+            client->responseBuffer.assign(HttpResponse::build500("Failed to read file.", &server));
+        return;
+    }
+    
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    client->attachFile(fd, 0, fileStat.st_size);
+}
+
+void HttpRequest::handleGet(ClientConnection* client, const ParsedRequest& request) {
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
     const LocationConfig* bestMatch = findBestLocation(path, server);
     
@@ -21,30 +208,51 @@ void HttpRequest::handleGet(ClientConnection* client, const std::string& path) {
     
     std::string fullPath = buildFilePath(path, server, bestMatch);
     
-    struct stat pathStat;
-    if (stat(fullPath.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode)) {
+    if (openFiles->lookup(fullPath).type == FileInfo::DIRECTORY) {
         std::string indexPath = fullPath;
         if (indexPath[indexPath.length() - 1] != '/')
             indexPath += "/";
         indexPath += indexFile;
         
-        struct stat indexStat;
-        if (stat(indexPath.c_str(), &indexStat) == 0 && S_ISREG(indexStat.st_mode)) {
-            client->responseBuffer = HttpResponse::buildFileResponse(indexPath, &server);
+        if (openFiles->lookup(indexPath).type == FileInfo::REGULAR) {
+            serveFile(client, indexPath, server, bestMatch, request);
             return;
         }
         
         if (autoindex)
-            client->responseBuffer = HttpResponse::buildDirectoryListing(fullPath, path);
+            serveListing(client, fullPath, path, bestMatch, request);
         else
-            client->responseBuffer = HttpResponse::build404(&server);
+            client->responseBuffer.assign(HttpResponse::build404(&server));
         return;
     }
     
-    client->responseBuffer = HttpResponse::buildFileResponse(fullPath, &server);
+    serveFile(client, fullPath, server, bestMatch, request);
 }
 
-void HttpRequest::handleHead(ClientConnection* client, const std::string& path) {
+void HttpRequest::serveListing(ClientConnection* client, const std::string& fullPath, const std::string& path,
+                               const LocationConfig* location, const ParsedRequest& request) {
+    std::string response = HttpResponse::buildDirectoryListing(fullPath, path);
+    if (response.compare(0, 12, "HTTP/1.1 200") != 0 || !Compression::appliesTo(location, "text/html")) {
+        client->responseBuffer.assign(response);
+        return;
+    }
+    
+    size_t bodyStart = response.find("\r\n\r\n") + 4;
+    Compression::Coding coding = Compression::negotiate(location, request.header(ParsedRequest::ACCEPT_ENCODING),
+                                                        "text/html", response.size() - bodyStart);
+    std::string packed;
+    if (Compression::compress(response.data() + bodyStart, response.size() - bodyStart, coding,
+                              location->gzipCompLevel, packed)) {
+        response = HttpResponse::buildEncodedHeaders("text/html", packed.size(), std::string("Content-Encoding: ")
+            + Compression::name(coding) + "\r\nVary: Accept-Encoding\r\n") + packed;
+    } else {
+        response.insert(bodyStart - 2, "Vary: Accept-Encoding\r\n");
+    }
+    client->responseBuffer.assign(response);
+}
+
+void HttpRequest::handleHead(ClientConnection* client, const ParsedRequest& request) {
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
     const LocationConfig* bestMatch = findBestLocation(path, server);
     
@@ -54,111 +262,119 @@ void HttpRequest::handleHead(ClientConnection* client, const std::string& path)
     
     std::string fullPath = buildFilePath(path, server, bestMatch);
     
-    struct stat pathStat;
-    if (stat(fullPath.c_str(), &pathStat) == 0 && S_ISDIR(pathStat.st_mode)) {
+    if (openFiles->lookup(fullPath).type == FileInfo::DIRECTORY) {
         std::string indexPath = fullPath;
         if (indexPath[indexPath.length() - 1] != '/')
             indexPath += "/";
         indexPath += indexFile;
         
-        struct stat indexStat;
-        if (stat(indexPath.c_str(), &indexStat) == 0 && S_ISREG(indexStat.st_mode)) {
+        if (openFiles->lookup(indexPath).type == FileInfo::REGULAR) {
             fullPath = indexPath;
         } else {
-            client->responseBuffer = HttpResponse::build404(&server);
+            client->responseBuffer.assign(HttpResponse::build404(&server));
             return;
         }
     }
     
-    client->responseBuffer = HttpResponse::buildHeadResponse(fullPath, &server);
+    if (openFiles->lookup(fullPath).type != FileInfo::REGULAR) {
+        client->responseBuffer.assign(HttpResponse::buildHeadNotFound());
+        return;
+    }
+    
+    std::string filePath = fullPath;
+    std::string encodingHeaders = negotiateEncoding(fullPath, bestMatch, request, filePath);
+    std::string fixedHeaders = buildVary(bestMatch, HttpResponse::getContentType(fullPath))
+        + HttpResponse::buildCacheControl(bestMatch) + HttpResponse::buildExpires(bestMatch, time(NULL));
+    if (encodingHeaders.empty() && serveCompressed(client, fullPath, bestMatch, request, fixedHeaders, true))
+        return;
+    
+    const FileInfo& info = openFiles->lookup(filePath);
+    std::string etag = HttpResponse::buildETag(info.inode, info.size, info.mtime);
+    std::string extraHeaders = HttpResponse::buildValidatorHeaders(etag, info.mtime) + encodingHeaders + fixedHeaders;
+    if (isNotModified(request, etag, info.mtime))
+        client->responseBuffer.assign(HttpResponse::build304(extraHeaders));
+    else
+        client->responseBuffer.assign(HttpResponse::buildFileHeaders(fullPath, info.size, extraHeaders));
 }
 
-void HttpRequest::handlePost(ClientConnection* client, const std::string& path, 
-                              const std::string& headers, size_t bodyStart) {
+void HttpRequest::handlePost(ClientConnection* client, const ParsedRequest& request) {
     std::string uploadDir;
-    if (findUploadLocation(path, uploadDir, client->serverIndex))
-        handlePostUpload(client, path, headers, bodyStart);
+    if (findUploadLocation(request.path, uploadDir, client->serverIndex))
+        handlePostUpload(client, request);
     else
-        client->responseBuffer = HttpResponse::build200("text/html",
-            "<html><body><h1>403 Forbidden</h1><p>POST not allowed for this location.</p></body></html>");
+        client->responseBuffer.assign(HttpResponse::build200("text/html",
+            "<html><body><h1>403 Forbidden</h1><p>POST not allowed for this location.</p></body></html>"));
 }
 
-void HttpRequest::handlePostUpload(ClientConnection* client, const std::string& path,
-                                  const std::string& headers, size_t bodyStart) {
+void HttpRequest::handlePostUpload(ClientConnection* client, const ParsedRequest& request) {
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
     
-    size_t contentLength;
-    if (!getContentLength(headers, contentLength)) {
-        client->responseBuffer = HttpResponse::build411();
-        return;
-    }
-    
-    size_t bodyReceived = (client->requestBuffer.length() > bodyStart) 
-        ? client->requestBuffer.length() - bodyStart 
-        : 0;
-    
-    if (bodyReceived < contentLength) {
-        std::cout << "POST body incomplete: " << bodyReceived << "/" << contentLength << " bytes received" << std::endl;
+    if (request.framing == ParsedRequest::BODY_NONE) {
+        client->responseBuffer.assign(HttpResponse::build411());
         return;
     }
     
-    std::cout << "POST upload request complete (" << contentLength << " bytes)" << std::endl;
+    std::cout << "POST upload request complete (" << client->bodyBytesReceived << " bytes)" << std::endl;
     
     std::string uploadDir;
     if (!findUploadLocation(path, uploadDir, client->serverIndex)) {
-        client->responseBuffer = HttpResponse::build403("File upload not allowed for this location.", &server);
+        client->responseBuffer.assign(HttpResponse::build403("File upload not allowed for this location.", &server));
         return;
     }
     
     struct stat dirStat;
     if (stat(uploadDir.c_str(), &dirStat) != 0 || !S_ISDIR(dirStat.st_mode)) {
         std::cerr << "Upload directory does not exist: " << uploadDir << std::endl;
-        client->responseBuffer = HttpResponse::build404(&server);
+        client->responseBuffer.assign(HttpResponse::build404(&server));
         return;
     }
     
-    std::string rawBody = client->requestBuffer.substr(bodyStart, contentLength);
-    std::string extractedFilename;
-    std::string fileContent = extractMultipartBody(rawBody, headers, extractedFilename);
-    
-    std::string filename = extractedFilename.empty() ? extractFilename(headers, path) : extractedFilename;
-    filename = generateUniqueFilename(uploadDir, filename);
-    
-    std::string fullPath = uploadDir;
-    if (fullPath[fullPath.length() - 1] != '/')
-        fullPath += "/";
-    fullPath += filename;
+    // The body was written out as it arrived (see beginUpload).
+    MultipartUpload& upload = client->upload;
+    upload.finish();
+    if (upload.status() == MultipartUpload::FAILED || upload.status() == MultipartUpload::IDLE) {
+        client->responseBuffer.assign((upload.error() == 400)
+            ? HttpResponse::build400(&server)
+            : HttpResponse::build500("Failed to save uploaded file.", &server));
+        return;
+    }
     
-    if (!saveUploadedFile(fullPath, fileContent)) {
-        client->responseBuffer = HttpResponse::build500("Failed to save uploaded file.", &server);
+    const std::vector<UploadedFile>& files = upload.files();
+    if (files.empty()) {
+        std::cout << "Multipart upload carried no file" << std::endl;
+        client->responseBuffer.assign(HttpResponse::build400(&server));
         return;
     }
     
     std::ostringstream successBody;
-    successBody << "<html><body><h1>Upload Successful</h1>"
-                << "<p>File uploaded: " << filename << "</p>"
-                << "<p>Size: " << fileContent.length() << " bytes</p></body></html>";
-    client->responseBuffer = HttpResponse::build201(successBody.str());
+    successBody << "<html><body><h1>Upload Successful</h1>";
+    for (size_t i = 0; i < files.size(); ++i) {
+        openFiles->invalidate(files[i].path);
+        successBody << "<p>File uploaded: " << files[i].name << "</p>"
+                    << "<p>Size: " << files[i].size << " bytes</p>";
+    }
+    successBody << "</body></html>";
+    client->responseBuffer.assign(HttpResponse::build201(successBody.str()));
 }
 
-void HttpRequest::handlePut(ClientConnection* client, const std::string& path,
-                            const std::string& headers, size_t bodyStart) {
+void HttpRequest::handlePut(ClientConnection* client, const ParsedRequest& request) {
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
-    (void)headers;
     
     std::string uploadDir;
     if (!findUploadLocation(path, uploadDir, client->serverIndex)) {
-        client->responseBuffer = HttpResponse::build403("PUT not allowed for this location.", &server);
+        client->responseBuffer.assign(HttpResponse::build403("PUT not allowed for this location.", &server));
         return;
     }
     
     std::string filename;
     size_t lastSlash = path.find_last_of('/');
     if (lastSlash != std::string::npos && lastSlash < path.length() - 1)
-        filename = sanitizeFilename(path.substr(lastSlash + 1));
+        filename = MultipartUpload::sanitizeFilename(path.substr(lastSlash + 1));
     
     if (filename.empty()) {
-        client->responseBuffer = HttpResponse::build400(&server);
+        client->responseBuffer.assign(HttpResponse::build400(&server));
         return;
     }
     
@@ -170,22 +386,24 @@ void HttpRequest::handlePut(ClientConnection* client, const std::string& path,
     struct stat fileStat;
     bool fileExists = (stat(fullPath.c_str(), &fileStat) == 0);
     
-    std::string body = client->requestBuffer.substr(bodyStart, client->bodyBytesReceived);
+    std::string body = readBody(client, request);
     if (!saveUploadedFile(fullPath, body)) {
-        client->responseBuffer = HttpResponse::build500("Failed to save file.", &server);
+        client->responseBuffer.assign(HttpResponse::build500("Failed to save file.", &server));
         return;
     }
+    openFiles->invalidate(fullPath);
     
     if (fileExists) {
-        client->responseBuffer = HttpResponse::build204();
+        client->responseBuffer.assign(HttpResponse::build204());
     } else {
         std::ostringstream successBody;
         successBody << "<html><body><h1>Created</h1><p>File created: " << filename << "</p></body></html>";
-        client->responseBuffer = HttpResponse::build201(successBody.str());
+        client->responseBuffer.assign(HttpResponse::build201(successBody.str()));
     }
 }
 
-void HttpRequest::handleDelete(ClientConnection* client, const std::string& path) {
+void HttpRequest::handleDelete(ClientConnection* client, const ParsedRequest& request) {
+    const std::string& path = request.path;
     const ServerConfig& server = config.getServer(client->serverIndex);
     const LocationConfig* bestMatch = findBestLocation(path, server);
     
@@ -193,21 +411,22 @@ void HttpRequest::handleDelete(ClientConnection* client, const std::string& path
     
     struct stat fileStat;
     if (stat(filePath.c_str(), &fileStat) != 0) {
-        client->responseBuffer = HttpResponse::build404(&server);
+        client->responseBuffer.assign(HttpResponse::build404(&server));
         return;
     }
     
     if (!S_ISREG(fileStat.st_mode)) {
-        client->responseBuffer = HttpResponse::build405(&server);
+        client->responseBuffer.assign(HttpResponse::build405(&server));
         return;
     }
     
     if (unlink(filePath.c_str()) != 0) {
-        client->responseBuffer = HttpResponse::build500("Failed to delete file.", &server);
+        client->responseBuffer.assign(HttpResponse::build500("Failed to delete file.", &server));
         return;
     }
+    openFiles->invalidate(filePath);
     
     std::ostringstream successBody;
     successBody << "<html><body><h1>Delete Successful</h1><p>File deleted: " << path << "</p></body></html>";
-    client->responseBuffer = HttpResponse::build200("text/html", successBody.str());
+    client->responseBuffer.assign(HttpResponse::build200("text/html", successBody.str()));
 }
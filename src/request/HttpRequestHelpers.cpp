@@ -1,5 +1,8 @@
 #include "../../include/HttpRequest.hpp"
 #include "../../include/StringUtils.hpp"
+#include "../../include/HttpResponse.hpp"
+#include "../../include/Compression.hpp"
+#include "../../include/MultipartUpload.hpp"
 #include <sstream>
 #include <iostream>
 #include <fstream>
@@ -7,58 +10,82 @@
 #include <sys/stat.h>
 #include <cstdlib>
 
-bool HttpRequest::getContentLength(const std::string& headers, size_t& contentLength) {
-    std::string headersLower = StringUtils::toLower(headers);
-    size_t pos = headersLower.find("content-length:");
-    
-    if (pos == std::string::npos)
-        return false;
+// gzip_static: picks the precompressed sibling (br preferred on equal q) the client accepts
+// and that exists, and points filePath at it. Returns the headers the choice implies.
+std::string HttpRequest::negotiateEncoding(const std::string& fullPath, const LocationConfig* location,
+                                           const ParsedRequest& request, std::string& filePath) {
+    static const char* const codings[] = { "br", "gzip" };
+    static const char* const suffixes[] = { ".br", ".gz" };
+    
+    if (!location || !location->gzipStatic)
+        return "";
     
-    size_t valueStart = headers.find_first_not_of(" \t", pos + 15);
-    size_t valueEnd = headers.find("\r\n", valueStart);
-    std::string lengthStr = headers.substr(valueStart, valueEnd - valueStart);
-    contentLength = std::atoi(lengthStr.c_str());
-    return true;
+    const std::string& acceptEncoding = request.header(ParsedRequest::ACCEPT_ENCODING);
+    double bestQuality = 0;
+    int best = -1;
+    for (int i = 0; i < 2; ++i) {
+        double quality = Compression::quality(acceptEncoding, codings[i]);
+        if (quality > bestQuality && openFiles->lookup(fullPath + suffixes[i]).type == FileInfo::REGULAR) {
+            bestQuality = quality;
+            best = i;
+        }
+    }
+    if (best < 0)
+        return "";
+    filePath = fullPath + suffixes[best];
+    return std::string("Content-Encoding: ") + codings[best] + "\r\n";
 }
 
-std::string HttpRequest::getContentType(const std::string& headers) {
-    std::string headersLower = StringUtils::toLower(headers);
-    size_t pos = headersLower.find("content-type:");
-    
-    if (pos == std::string::npos)
-        return "";
-    
-    size_t valueStart = headers.find_first_not_of(" \t", pos + 13);
-    size_t valueEnd = headers.find("\r\n", valueStart);
-    return headers.substr(valueStart, valueEnd - valueStart);
+// Responses that may be encoded differently depending on Accept-Encoding say so, whatever
+// this particular client asked for.
+std::string HttpRequest::buildVary(const LocationConfig* location, const std::string& contentType) {
+    if ((location && location->gzipStatic) || Compression::appliesTo(location, contentType))
+        return "Vary: Accept-Encoding\r\n";
+    return "";
 }
 
-std::string HttpRequest::getBoundary(const std::string& headers) {
-    std::string headersLower = StringUtils::toLower(headers);
-    size_t contentTypePos = headersLower.find("content-type:");
-    if (contentTypePos == std::string::npos)
-        return "";
+// If-None-Match wins over If-Modified-Since. Tags are compared weakly, as RFC 9110 asks for GET and HEAD.
+bool HttpRequest::isNotModified(const ParsedRequest& request, const std::string& etag, time_t mtime) {
+    const std::string& noneMatch = request.header(ParsedRequest::IF_NONE_MATCH);
+    if (!noneMatch.empty()) {
+        if (noneMatch == "*")
+            return true;
+        std::vector<std::string> tags = StringUtils::split(noneMatch, ',');
+        for (size_t i = 0; i < tags.size(); ++i) {
+            std::string tag = (tags[i].compare(0, 2, "W/") == 0) ? tags[i].substr(2) : tags[i];
+            if (tag == etag)
+                return true;
+        }
+        return false;
+    }
     
-    size_t boundaryPos = headersLower.find("boundary=", contentTypePos);
+    const std::string& modifiedSince = request.header(ParsedRequest::IF_MODIFIED_SINCE);
+    time_t since;
+    return !modifiedSince.empty() && HttpResponse::parseHttpDate(modifiedSince, since) && mtime <= since;
+}
+
+std::string HttpRequest::getBoundary(const ParsedRequest& request) {
+    const std::string& contentType = request.header(ParsedRequest::CONTENT_TYPE);
+    size_t boundaryPos = StringUtils::toLower(contentType).find("boundary=");
     if (boundaryPos == std::string::npos)
         return "";
     
     size_t boundaryStart = boundaryPos + 9;
-    if (boundaryStart < headers.length() && headers[boundaryStart] == '"')
+    if (boundaryStart < contentType.length() && contentType[boundaryStart] == '"')
         boundaryStart++;
     
-    size_t boundaryEnd = headers.find_first_of("\"\r\n; ", boundaryStart);
+    size_t boundaryEnd = contentType.find_first_of("\"; ", boundaryStart);
     if (boundaryEnd == std::string::npos)
-        boundaryEnd = headers.length();
+        boundaryEnd = contentType.length();
     
-    return headers.substr(boundaryStart, boundaryEnd - boundaryStart);
+    return contentType.substr(boundaryStart, boundaryEnd - boundaryStart);
 }
 
-bool HttpRequest::isUploadRequest(const std::string& headers) {
-    if (headers.find("Content-Disposition:") != std::string::npos)
+bool HttpRequest::isUploadRequest(const ParsedRequest& request) {
+    if (request.find(ParsedRequest::CONTENT_DISPOSITION))
         return true;
     
-    std::string contentType = getContentType(headers);
+    const std::string& contentType = request.header(ParsedRequest::CONTENT_TYPE);
     return contentType.find("multipart/form-data") != std::string::npos ||
            contentType.find("application/octet-stream") != std::string::npos;
 }
@@ -95,18 +122,10 @@ bool HttpRequest::findUploadLocation(const std::string& path, std::string& uploa
     return false;
 }
 
-std::string HttpRequest::extractFilename(const std::string& headers, const std::string& path) {
-    size_t dispositionPos = headers.find("Content-Disposition:");
-    if (dispositionPos != std::string::npos) {
-        size_t filenamePos = headers.find("filename=", dispositionPos);
-        if (filenamePos != std::string::npos) {
-            size_t nameStart = filenamePos + 9;
-            if (headers[nameStart] == '"') nameStart++;
-            size_t nameEnd = headers.find_first_of("\"\r\n", nameStart);
-            if (nameEnd != std::string::npos)
-                return sanitizeFilename(headers.substr(nameStart, nameEnd - nameStart));
-        }
-    }
+std::string HttpRequest::extractFilename(const ParsedRequest& request, const std::string& path) {
+    std::string disposition = MultipartUpload::dispositionFilename(request.header(ParsedRequest::CONTENT_DISPOSITION));
+    if (!disposition.empty())
+        return disposition;
     
     std::string extension = ".bin";
     size_t lastSlash = path.find_last_of('/');
@@ -121,111 +140,6 @@ std::string HttpRequest::extractFilename(const std::string& headers, const std::
     return oss.str();
 }
 
-std::string HttpRequest::sanitizeFilename(const std::string& filename) {
-    std::string result;
-    
-    size_t lastSlash = filename.find_last_of("/\\");
-    std::string baseName = (lastSlash != std::string::npos) ? filename.substr(lastSlash + 1) : filename;
-    
-    for (size_t i = 0; i < baseName.length(); ++i) {
-        char c = baseName[i];
-        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || 
-            (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-')
-            result += c;
-    }
-    
-    while (!result.empty() && result[0] == '.')
-        result = result.substr(1);
-    
-    if (result.empty()) {
-        std::ostringstream oss;
-        oss << "upload_" << time(NULL) << ".bin";
-        result = oss.str();
-    }
-    return result;
-}
-
-std::string HttpRequest::generateUniqueFilename(const std::string& directory, const std::string& filename) {
-    std::string fullPath = directory;
-    if (!fullPath.empty() && fullPath[fullPath.length() - 1] != '/')
-        fullPath += "/";
-    fullPath += filename;
-    
-    struct stat fileStat;
-    if (stat(fullPath.c_str(), &fileStat) != 0)
-        return filename;
-    
-    std::string base = filename;
-    std::string ext;
-    size_t dotPos = filename.find_last_of('.');
-    if (dotPos != std::string::npos && dotPos > 0) {
-        base = filename.substr(0, dotPos);
-        ext = filename.substr(dotPos);
-    }
-    
-    for (int counter = 1; counter < 10000; ++counter) {
-        std::ostringstream oss;
-        oss << base << "_" << counter << ext;
-        std::string newName = oss.str();
-        
-        fullPath = directory;
-        if (!fullPath.empty() && fullPath[fullPath.length() - 1] != '/')
-            fullPath += "/";
-        fullPath += newName;
-        
-        if (stat(fullPath.c_str(), &fileStat) != 0)
-            return newName;
-    }
-    
-    std::ostringstream oss;
-    oss << base << "_" << time(NULL) << ext;
-    return oss.str();
-}
-
-std::string HttpRequest::extractMultipartBody(const std::string& body, const std::string& headers, 
-                                               std::string& extractedFilename) {
-    std::string boundary = getBoundary(headers);
-    if (boundary.empty())
-        return body;
-    
-    std::string delimiter = "--" + boundary;
-    
-    size_t partStart = body.find(delimiter);
-    if (partStart == std::string::npos)
-        return body;
-    
-    partStart = body.find("\r\n", partStart);
-    if (partStart == std::string::npos)
-        return body;
-    partStart += 2;
-    
-    size_t headersEnd = body.find("\r\n\r\n", partStart);
-    if (headersEnd == std::string::npos)
-        return body;
-    
-    std::string partHeaders = body.substr(partStart, headersEnd - partStart);
-    
-    size_t filenamePos = partHeaders.find("filename=");
-    if (filenamePos != std::string::npos) {
-        size_t nameStart = filenamePos + 9;
-        if (nameStart < partHeaders.length() && partHeaders[nameStart] == '"')
-            nameStart++;
-        size_t nameEnd = partHeaders.find_first_of("\"\r\n", nameStart);
-        if (nameEnd != std::string::npos)
-            extractedFilename = sanitizeFilename(partHeaders.substr(nameStart, nameEnd - nameStart));
-    }
-    
-    size_t contentStart = headersEnd + 4;
-    size_t contentEnd = body.find(delimiter, contentStart);
-    if (contentEnd == std::string::npos)
-        return body;
-    
-    if (contentEnd >= 2 && body[contentEnd - 2] == '\r' && body[contentEnd - 1] == '\n')
-        contentEnd -= 2;
-    
-    return body.substr(contentStart, contentEnd - contentStart);
-}
-
 bool HttpRequest::saveUploadedFile(const std::string& fullPath, const std::string& body) {
     std::cout << "Attempting to save file to: " << fullPath << std::endl;
     
@@ -0,0 +1,155 @@
+#include "../../include/HttpRequest.hpp"
+#include "../../include/HttpResponse.hpp"
+#include "../../include/StringUtils.hpp"
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace {
+    // More ranges than this is not a media player seeking; the whole file is sent instead.
+    const size_t MAX_RANGES = 16;
+
+    bool parseOffset(const std::string& text, off_t& value) {
+        if (text.empty() || text.length() > 18 || text.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        value = static_cast<off_t>(std::strtoll(text.c_str(), NULL, 10));
+        return true;
+    }
+
+    bool startsBefore(const ByteRange& a, const ByteRange& b) {
+        return a.first < b.first;
+    }
+}
+
+// Returns false when the header must be ignored (other unit, bad syntax, too many ranges).
+// Otherwise ranges holds the satisfiable ranges, clamped to the file, sorted and with
+// overlapping or adjacent ones merged, so no byte is sent twice; empty means 416.
+bool HttpRequest::parseRanges(const std::string& rangeHeader, off_t fileSize, std::vector<ByteRange>& ranges) {
+    if (StringUtils::toLower(rangeHeader.substr(0, 6)) != "bytes=")
+        return false;
+
+    std::vector<std::string> specs = StringUtils::split(rangeHeader.substr(6), ',');
+    if (specs.empty() || specs.size() > MAX_RANGES)
+        return false;
+
+    for (size_t i = 0; i < specs.size(); ++i) {
+        size_t dash = specs[i].find('-');
+        if (dash == std::string::npos)
+            return false;
+        std::string firstText = StringUtils::trim(specs[i].substr(0, dash));
+        std::string lastText = StringUtils::trim(specs[i].substr(dash + 1));
+
+        ByteRange range;
+        if (firstText.empty()) {
+            off_t suffix;
+            if (!parseOffset(lastText, suffix))
+                return false;
+            if (suffix == 0 || fileSize == 0)
+                continue;
+            range.first = (suffix < fileSize) ? fileSize - suffix : 0;
+            range.last = fileSize - 1;
+        } else {
+            if (!parseOffset(firstText, range.first))
+                return false;
+            range.last = fileSize - 1;
+            if (!lastText.empty()) {
+                off_t last;
+                if (!parseOffset(lastText, last) || last < range.first)
+                    return false;
+                if (last < range.last)
+                    range.last = last;
+            }
+            if (range.first >= fileSize)
+                continue;
+        }
+        ranges.push_back(range);
+    }
+
+    std::sort(ranges.begin(), ranges.end(), startsBefore);
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (ranges[i].first <= ranges[merged].last + 1)
+            ranges[merged].last = std::max(ranges[merged].last, ranges[i].last);
+        else
+            ranges[++merged] = ranges[i];
+    }
+    if (!ranges.empty())
+        ranges.resize(merged + 1);
+    return true;
+}
+
+// If-Range carries either an entity tag or the Last-Modified date; the Range only applies
+// on a strong tag match or an exact date match. Without If-Range it always applies.
+bool HttpRequest::ifRangeMatches(const ParsedRequest& request, const std::string& etag, time_t mtime) {
+    const std::string& validator = request.header(ParsedRequest::IF_RANGE);
+    if (validator.empty())
+        return true;
+    if (validator[0] == '"')
+        return validator == etag;
+    return validator == HttpResponse::formatHttpDate(mtime);
+}
+
+// Single ranges below sendfile_threshold are read into the chain; anything else is sent
+// from the file with sendfile(), multipart bodies as a queue of slices with their part
+// headers in between. Returns false, leaving fd open, when a full response should be
+// sent instead (including ranges that add up to the whole file); otherwise fd has been
+// consumed.
+bool HttpRequest::serveRanges(ClientConnection* client, int fd, const struct stat& fileStat,
+                              const std::string& fullPath, const ServerConfig& server,
+                              const ParsedRequest& request, const std::string& extraHeaders) {
+    std::string etag = HttpResponse::buildETag(fileStat.st_ino, fileStat.st_size, fileStat.st_mtime);
+    std::vector<ByteRange> ranges;
+    if (!ifRangeMatches(request, etag, fileStat.st_mtime)
+        || !parseRanges(request.header(ParsedRequest::RANGE), fileStat.st_size, ranges))
+        return false;
+
+    if (ranges.empty()) {
+        close(fd);
+        client->responseBuffer.assign(HttpResponse::build416(fileStat.st_size, &server));
+        return true;
+    }
+
+    if (ranges.size() == 1 && ranges[0].first == 0 && ranges[0].last == fileStat.st_size - 1)
+        return false;
+
+    if (ranges.size() == 1) {
+        const ByteRange& range = ranges[0];
+        size_t length = static_cast<size_t>(range.last - range.first + 1);
+        client->responseBuffer.assign(HttpResponse::buildRangeHeaders(fullPath, range.first, range.last,
+                                                                      fileStat.st_size, extraHeaders));
+        if (length < server.sendfileThreshold) {
+            bool complete = readFileInto(client, fd, range.first, length);
+            close(fd);
+            if (!complete)
+                client->responseBuffer.assign(HttpResponse::build500("Failed to read file.", &server));
+            return true;
+        }
+        posix_fadvise(fd, range.first, length, POSIX_FADV_SEQUENTIAL);
+        client->attachFile(fd, range.first, length);
+        return true;
+    }
+
+    std::ostringstream boundaryText;
+    boundaryText << std::setfill('0') << std::setw(10) << time(NULL) << std::setw(10) << ++rangeResponses;
+    std::string boundary = boundaryText.str();
+
+    std::vector<std::string> partHeaders;
+    std::string closing = "\r\n--" + boundary + "--\r\n";
+    off_t contentLength = closing.size();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        partHeaders.push_back(HttpResponse::buildPartHeader(fullPath, boundary, ranges[i].first,
+                                                            ranges[i].last, fileStat.st_size));
+        contentLength += partHeaders[i].size() + (ranges[i].last - ranges[i].first + 1);
+    }
+
+    client->responseBuffer.assign(HttpResponse::buildMultipartHeaders(boundary, contentLength, extraHeaders));
+    client->attachFile(fd, 0, 0);
+    for (size_t i = 0; i < ranges.size(); ++i)
+        client->queueFileRange(partHeaders[i], ranges[i].first, ranges[i].last - ranges[i].first + 1);
+    client->queueFileRange(closing, 0, 0);
+    client->nextFileRange();
+    return true;
+}
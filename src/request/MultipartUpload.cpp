@@ -0,0 +1,327 @@
+#include "../../include/MultipartUpload.hpp"
+#include "../../include/StringUtils.hpp"
+#include <sstream>
+#include <iostream>
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+MultipartUpload::MultipartUpload()
+    : state(UNUSED), errorStatus(0), fileFd(-1) {
+}
+
+MultipartUpload::~MultipartUpload() {
+    reset();
+}
+
+// Files of an upload that did not complete are removed.
+void MultipartUpload::reset() {
+    closeFile();
+    if (state != DONE)
+        removeFiles();
+    written.clear();
+    state = UNUSED;
+    errorStatus = 0;
+    directory.clear();
+    tail.clear();
+    partHeaders.clear();
+}
+
+// An empty boundary stores the whole body as filename. False (with status FAILED) if
+// that file cannot be created.
+bool MultipartUpload::begin(const std::string& uploadDir, const std::string& boundary, const std::string& filename) {
+    reset();
+    directory = uploadDir;
+    if (!directory.empty() && directory[directory.length() - 1] != '/')
+        directory += "/";
+
+    if (boundary.empty()) {
+        state = RAW;
+        return openFile(filename);
+    }
+    // The first delimiter may open the body without the CRLF that precedes the others.
+    delimiter.assign("\r\n--" + boundary);
+    tail = "\r\n";
+    state = PREAMBLE;
+    return true;
+}
+
+// Feeds count body bytes of input, starting at from.
+void MultipartUpload::write(const BufferChain& input, size_t from, size_t count) {
+    const char* data;
+    size_t size;
+    while (count > 0 && (size = input.contiguous(from, data)) > 0) {
+        if (size > count)
+            size = count;
+        consume(data, size);
+        from += size;
+        count -= size;
+    }
+}
+
+// The body has ended: a multipart body must have reached its close delimiter.
+void MultipartUpload::finish() {
+    if (state == RAW || state == EPILOGUE) {
+        closeFile();
+        state = DONE;
+    } else if (state != DONE && state != ERROR && state != UNUSED) {
+        fail(400);
+    }
+}
+
+MultipartUpload::Status MultipartUpload::status() const {
+    if (state == UNUSED)
+        return IDLE;
+    if (state == DONE)
+        return COMPLETE;
+    return (state == ERROR) ? FAILED : INCOMPLETE;
+}
+
+// 400 for a malformed multipart body, 500 when a file could not be written.
+int MultipartUpload::error() const {
+    return errorStatus;
+}
+
+const std::vector<UploadedFile>& MultipartUpload::files() const {
+    return written;
+}
+
+void MultipartUpload::consume(const char* data, size_t size) {
+    size_t pos = 0;
+    while (pos < size && state != DONE && state != ERROR) {
+        switch (state) {
+        case RAW:
+            emit(data + pos, size - pos);
+            pos = size;
+            break;
+        case EPILOGUE:
+            pos = size;
+            break;
+        case PREAMBLE:
+        case PART_DATA:
+            pos += scanData(data + pos, size - pos);
+            break;
+        case PART_HEADERS:
+            partHeaders += data[pos++];
+            if (partHeaders.size() > MAX_PART_HEADERS)
+                fail(400);
+            else if (partHeaders == "\r\n" || (partHeaders.size() >= 4
+                     && partHeaders.compare(partHeaders.size() - 4, 4, "\r\n\r\n") == 0))
+                startPart();
+            break;
+        default:
+            step(data[pos++]);
+            break;
+        }
+    }
+}
+
+// Passes on the bytes before the next delimiter and returns how many were used. The
+// last delimiter-length - 1 bytes are held back in tail, as the next read may complete
+// a delimiter they begin.
+size_t MultipartUpload::scanData(const char* data, size_t size) {
+    const size_t length = delimiter.needle().size();
+    const size_t hold = length - 1;
+
+    if (!tail.empty()) {
+        size_t take = (size < hold) ? size : hold;
+        std::string joint = tail;
+        joint.append(data, take);
+        size_t hit = delimiter.find(joint.data(), joint.size());
+        if (hit != ByteScan::npos) {
+            size_t used = hit + length - tail.size();
+            emit(joint.data(), hit);
+            tail.clear();
+            endPart();
+            return used;
+        }
+        if (take < hold) {
+            size_t keep = (joint.size() < hold) ? joint.size() : hold;
+            emit(joint.data(), joint.size() - keep);
+            tail = joint.substr(joint.size() - keep);
+            return size;
+        }
+        // Any delimiter starting in tail would have ended inside joint.
+        emit(tail.data(), tail.size());
+        tail.clear();
+    }
+
+    size_t hit = delimiter.find(data, size);
+    if (hit != ByteScan::npos) {
+        emit(data, hit);
+        endPart();
+        return hit + length;
+    }
+    size_t keep = (size < hold) ? size : hold;
+    emit(data, size - keep);
+    tail.assign(data + size - keep, keep);
+    return size;
+}
+
+// After "--boundary": "--" closes the body, CRLF (after optional padding) opens a part.
+void MultipartUpload::step(char c) {
+    switch (state) {
+    case DELIMITER_END:
+        if (c == '-')
+            state = CLOSE_DASH;
+        else if (c == '\r')
+            state = DELIMITER_LF;
+        else if (c != ' ' && c != '\t')
+            fail(400);
+        break;
+    case DELIMITER_LF:
+        if (c != '\n') {
+            fail(400);
+            break;
+        }
+        partHeaders.clear();
+        state = PART_HEADERS;
+        break;
+    case CLOSE_DASH:
+        if (c == '-')
+            state = EPILOGUE;
+        else
+            fail(400);
+        break;
+    default:
+        break;
+    }
+}
+
+// A part's data goes to disk only while state is PART_DATA with a file open; preamble
+// and form fields are dropped.
+void MultipartUpload::emit(const char* data, size_t size) {
+    while (size > 0 && fileFd >= 0 && state != ERROR) {
+        ssize_t count = ::write(fileFd, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0) {
+            std::cerr << "Failed to write upload to " << written.back().path << std::endl;
+            fail(500);
+            return;
+        }
+        written.back().size += count;
+        data += count;
+        size -= count;
+    }
+}
+
+void MultipartUpload::endPart() {
+    if (state == ERROR)
+        return;
+    closeFile();
+    state = DELIMITER_END;
+}
+
+// Only parts whose Content-Disposition names a file are stored.
+void MultipartUpload::startPart() {
+    std::string filename;
+    std::vector<std::string> lines = StringUtils::split(partHeaders, '\n');
+    for (size_t i = 0; i < lines.size(); ++i) {
+        size_t colon = lines[i].find(':');
+        if (colon != std::string::npos
+            && StringUtils::toLower(StringUtils::trim(lines[i].substr(0, colon))) == "content-disposition")
+            filename = dispositionFilename(lines[i].substr(colon + 1));
+    }
+    partHeaders.clear();
+    state = PART_DATA;
+    if (!filename.empty())
+        openFile(filename);
+}
+
+// Creates the file under a sanitized name that is not taken yet: report.pdf, then
+// report_1.pdf, report_2.pdf and so on. O_EXCL keeps two uploads off the same file.
+bool MultipartUpload::openFile(const std::string& filename) {
+    std::string name = sanitizeFilename(filename);
+    std::string base = name;
+    std::string ext;
+    size_t dotPos = name.find_last_of('.');
+    if (dotPos != std::string::npos && dotPos > 0) {
+        base = name.substr(0, dotPos);
+        ext = name.substr(dotPos);
+    }
+
+    for (int counter = 0; counter < 10000; ++counter) {
+        if (counter > 0) {
+            std::ostringstream oss;
+            oss << base << "_" << counter << ext;
+            name = oss.str();
+        }
+        std::string path = directory + name;
+        fileFd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fileFd >= 0) {
+            UploadedFile file;
+            file.name = name;
+            file.path = path;
+            file.size = 0;
+            written.push_back(file);
+            std::cout << "Saving upload to: " << path << std::endl;
+            return true;
+        }
+        if (errno != EEXIST)
+            break;
+    }
+    std::cerr << "Failed to create upload file for " << filename << " in " << directory << std::endl;
+    fail(500);
+    return false;
+}
+
+void MultipartUpload::closeFile() {
+    if (fileFd >= 0)
+        close(fileFd);
+    fileFd = -1;
+}
+
+void MultipartUpload::removeFiles() {
+    for (size_t i = 0; i < written.size(); ++i)
+        unlink(written[i].path.c_str());
+    written.clear();
+}
+
+void MultipartUpload::fail(int status) {
+    closeFile();
+    removeFiles();
+    errorStatus = status;
+    state = ERROR;
+}
+
+// The filename parameter of a Content-Disposition value, unquoted, or "" if it has none.
+std::string MultipartUpload::dispositionFilename(const std::string& disposition) {
+    std::vector<std::string> params = StringUtils::split(disposition, ';');
+    for (size_t i = 0; i < params.size(); ++i) {
+        std::string param = StringUtils::trim(params[i]);
+        size_t equals = param.find('=');
+        if (equals == std::string::npos || StringUtils::toLower(StringUtils::trim(param.substr(0, equals))) != "filename")
+            continue;
+        std::string value = StringUtils::trim(param.substr(equals + 1));
+        if (value.length() >= 2 && value[0] == '"' && value[value.length() - 1] == '"')
+            value = value.substr(1, value.length() - 2);
+        return value;
+    }
+    return "";
+}
+
+std::string MultipartUpload::sanitizeFilename(const std::string& filename) {
+    std::string result;
+
+    size_t lastSlash = filename.find_last_of("/\\");
+    std::string baseName = (lastSlash != std::string::npos) ? filename.substr(lastSlash + 1) : filename;
+
+    for (size_t i = 0; i < baseName.length(); ++i) {
+        char c = baseName[i];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-')
+            result += c;
+    }
+
+    while (!result.empty() && result[0] == '.')
+        result = result.substr(1);
+
+    if (result.empty()) {
+        std::ostringstream oss;
+        oss << "upload_" << time(NULL) << ".bin";
+        result = oss.str();
+    }
+    return result;
+}
@@ -0,0 +1,386 @@
+#include "../../include/RequestParser.hpp"
+#include "../../include/StringUtils.hpp"
+#include "../../include/ByteScan.hpp"
+
+namespace {
+    bool isVisible(char c) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        return byte > ' ' && byte != 0x7f;
+    }
+
+    char lower(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    struct KnownHeader {
+        const char* name;
+        size_t length;
+        ParsedRequest::HeaderId id;
+    };
+
+    // Slot (4 * length + first + last) % 16 of each known name, all distinct, with
+    // the characters taken in lowercase. gperf-style: the positions are fixed here so
+    // no table is built at run time.
+    const KnownHeader knownHeaders[16] = {
+        { "", 0, ParsedRequest::OTHER_HEADER },
+        { "expect", 6, ParsedRequest::EXPECT },
+        { "if-modified-since", 17, ParsedRequest::IF_MODIFIED_SINCE },
+        { "content-length", 14, ParsedRequest::CONTENT_LENGTH },
+        { "accept-encoding", 15, ParsedRequest::ACCEPT_ENCODING },
+        { "if-none-match", 13, ParsedRequest::IF_NONE_MATCH },
+        { "", 0, ParsedRequest::OTHER_HEADER },
+        { "", 0, ParsedRequest::OTHER_HEADER },
+        { "content-type", 12, ParsedRequest::CONTENT_TYPE },
+        { "connection", 10, ParsedRequest::CONNECTION },
+        { "", 0, ParsedRequest::OTHER_HEADER },
+        { "range", 5, ParsedRequest::RANGE },
+        { "host", 4, ParsedRequest::HOST },
+        { "content-disposition", 19, ParsedRequest::CONTENT_DISPOSITION },
+        { "if-range", 8, ParsedRequest::IF_RANGE },
+        { "transfer-encoding", 17, ParsedRequest::TRANSFER_ENCODING }
+    };
+
+    const std::string noValue;
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    bool parseLength(const std::string& value, size_t& length) {
+        if (value.empty())
+            return false;
+        length = 0;
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (!isDigit(value[i]))
+                return false;
+            size_t digit = value[i] - '0';
+            if (length > (static_cast<size_t>(-1) - digit) / 10)
+                return false;
+            length = length * 10 + digit;
+        }
+        return true;
+    }
+}
+
+ParsedRequest::ParsedRequest() {
+    clear();
+}
+
+void ParsedRequest::clear() {
+    method = METHOD_OTHER;
+    methodName.clear();
+    target.clear();
+    path.clear();
+    query.clear();
+    version.clear();
+    versionMajor = 0;
+    versionMinor = 0;
+    headers.clear();
+    for (int i = 0; i < KNOWN_HEADERS; ++i)
+        known[i] = -1;
+    headerEnd = 0;
+    framing = BODY_NONE;
+    contentLength = 0;
+    connectionClose = false;
+    connectionKeepAlive = false;
+}
+
+// Case-insensitive; OTHER_HEADER for any name the server does not look up by id.
+ParsedRequest::HeaderId ParsedRequest::lookup(const char* name, size_t length) {
+    if (length == 0)
+        return OTHER_HEADER;
+    const KnownHeader& entry = knownHeaders[(4 * length + static_cast<unsigned char>(lower(name[0]))
+                                             + static_cast<unsigned char>(lower(name[length - 1]))) % 16];
+    if (entry.length != length)
+        return OTHER_HEADER;
+    for (size_t i = 0; i < length; ++i) {
+        if (lower(name[i]) != entry.name[i])
+            return OTHER_HEADER;
+    }
+    return entry.id;
+}
+
+// The first of repeated headers wins.
+const std::string* ParsedRequest::find(HeaderId id) const {
+    if (id == OTHER_HEADER || known[id] < 0)
+        return NULL;
+    return &headers[known[id]].value;
+}
+
+const std::string& ParsedRequest::header(HeaderId id) const {
+    const std::string* value = find(id);
+    return value ? *value : noValue;
+}
+
+// Any header by name, in any case.
+const std::string* ParsedRequest::find(const std::string& name) const {
+    HeaderId id = lookup(name.data(), name.size());
+    if (id != OTHER_HEADER)
+        return find(id);
+    std::string lowerName = StringUtils::toLower(name);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (headers[i].name == lowerName)
+            return &headers[i].value;
+    }
+    return NULL;
+}
+
+bool ParsedRequest::expectsContinue() const {
+    return isHttp11() && StringUtils::toLower(header(EXPECT)) == "100-continue";
+}
+
+bool ParsedRequest::isHttp11() const {
+    return versionMajor == 1 && versionMinor == 1;
+}
+
+bool ParsedRequest::keepAlive() const {
+    if (isHttp11())
+        return !connectionClose;
+    if (versionMajor == 1 && versionMinor == 0)
+        return connectionKeepAlive;
+    return false;
+}
+
+RequestParser::RequestParser() {
+    reset();
+}
+
+void RequestParser::reset() {
+    state = LINE_START;
+    offset = 0;
+    errorStatus = 0;
+    parsed.clear();
+}
+
+// buffer must start with the request; bytes before offset are never looked at again.
+RequestParser::Status RequestParser::parse(const BufferChain& buffer) {
+    const char* data;
+    size_t count;
+    while (state != DONE && state != ERROR && (count = buffer.contiguous(offset, data)) > 0) {
+        size_t i = 0;
+        while (i < count && state != DONE && state != ERROR) {
+            if (state == HEADER_NAME || state == VALUE) {
+                i += scanRun(data + i, count - i);
+                if (i == count)
+                    break;
+            }
+            state = step(data[i++]);
+        }
+        offset += i;
+    }
+    if (state == DONE)
+        parsed.headerEnd = offset;
+    return status();
+}
+
+RequestParser::Status RequestParser::status() const {
+    if (state == DONE)
+        return COMPLETE;
+    return (state == ERROR) ? FAILED : INCOMPLETE;
+}
+
+// The status code to answer a FAILED request with.
+int RequestParser::error() const {
+    return errorStatus;
+}
+
+const ParsedRequest& RequestParser::request() const {
+    return parsed;
+}
+
+RequestParser::State RequestParser::fail(int status) {
+    errorStatus = status;
+    return ERROR;
+}
+
+// Takes the rest of a header name or value up to its delimiter in one go; step() then
+// handles the delimiter (or the invalid byte that stopped a name).
+size_t RequestParser::scanRun(const char* data, size_t size) {
+    RequestHeader& header = parsed.headers.back();
+    if (state == VALUE) {
+        size_t length = ByteScan::firstOf(data, size, '\r', '\n', '\0');
+        header.value.append(data, length);
+        return length;
+    }
+    size_t length = ByteScan::firstOf(data, size, ':', '\r', '\n');
+    for (size_t i = 0; i < length; ++i) {
+        if (!StringUtils::isTokenChar(data[i]))
+            return i;
+        header.name += lower(data[i]);
+    }
+    return length;
+}
+
+RequestParser::State RequestParser::step(char c) {
+    switch (state) {
+    case LINE_START:
+        // Empty lines before a request line are skipped (RFC 9112, section 2.2).
+        if (c == '\r' || c == '\n')
+            return LINE_START;
+        state = METHOD;
+        return step(c);
+    case METHOD:
+        if (c == ' ' && !parsed.methodName.empty())
+            return TARGET_START;
+        if (!StringUtils::isTokenChar(c))
+            return fail(400);
+        parsed.methodName += c;
+        return METHOD;
+    case TARGET_START:
+        if (c == ' ')
+            return TARGET_START;
+        state = TARGET;
+        return step(c);
+    case TARGET:
+        if (c == ' ')
+            return VERSION_START;
+        if (!isVisible(c))
+            return fail(400);
+        parsed.target += c;
+        return TARGET;
+    case VERSION_START:
+        if (c == ' ')
+            return VERSION_START;
+        state = VERSION;
+        return step(c);
+    case VERSION:
+        if (c == ' ' || c == '\r' || c == '\n') {
+            if (!finishRequestLine())
+                return fail(400);
+            state = LINE_END;
+            return step(c);
+        }
+        if (!isVisible(c))
+            return fail(400);
+        parsed.version += c;
+        return VERSION;
+    case LINE_END:
+        if (c == ' ')
+            return LINE_END;
+        if (c == '\r')
+            return LINE_LF;
+        return (c == '\n') ? HEADER_START : fail(400);
+    case LINE_LF:
+        return (c == '\n') ? HEADER_START : fail(400);
+    case HEADER_START:
+        if (c == '\r')
+            return BLANK_LF;
+        if (c == '\n')
+            return finishHeaders();
+        // Also rejects obsolete line folding, which starts with whitespace.
+        if (!StringUtils::isTokenChar(c))
+            return fail(400);
+        if (parsed.headers.size() == ParsedRequest::MAX_HEADERS)
+            return fail(431);
+        parsed.headers.push_back(RequestHeader());
+        parsed.headers.back().name += lower(c);
+        return HEADER_NAME;
+    case HEADER_NAME:
+        if (c == ':') {
+            RequestHeader& header = parsed.headers.back();
+            header.id = ParsedRequest::lookup(header.name.data(), header.name.size());
+            if (header.id != ParsedRequest::OTHER_HEADER && parsed.known[header.id] < 0)
+                parsed.known[header.id] = parsed.headers.size() - 1;
+            return VALUE_START;
+        }
+        if (!StringUtils::isTokenChar(c))
+            return fail(400);
+        parsed.headers.back().name += lower(c);
+        return HEADER_NAME;
+    case VALUE_START:
+        if (c == ' ' || c == '\t')
+            return VALUE_START;
+        state = VALUE;
+        return step(c);
+    case VALUE:
+        if (c == '\r')
+            return HEADER_LF;
+        if (c == '\n')
+            return finishHeader();
+        if (c == '\0')
+            return fail(400);
+        parsed.headers.back().value += c;
+        return VALUE;
+    case HEADER_LF:
+        return (c == '\n') ? finishHeader() : fail(400);
+    case BLANK_LF:
+        return (c == '\n') ? finishHeaders() : fail(400);
+    default:
+        return state;
+    }
+}
+
+bool RequestParser::finishRequestLine() {
+    const std::string& version = parsed.version;
+    if (parsed.target.empty() || version.size() != 8 || version.compare(0, 5, "HTTP/") != 0
+        || !isDigit(version[5]) || version[6] != '.' || !isDigit(version[7]))
+        return false;
+    parsed.versionMajor = version[5] - '0';
+    parsed.versionMinor = version[7] - '0';
+
+    const std::string& name = parsed.methodName;
+    if (name == "GET") parsed.method = ParsedRequest::METHOD_GET;
+    else if (name == "HEAD") parsed.method = ParsedRequest::METHOD_HEAD;
+    else if (name == "POST") parsed.method = ParsedRequest::METHOD_POST;
+    else if (name == "PUT") parsed.method = ParsedRequest::METHOD_PUT;
+    else if (name == "DELETE") parsed.method = ParsedRequest::METHOD_DELETE;
+
+    size_t queryPos = parsed.target.find('?');
+    parsed.path = parsed.target.substr(0, queryPos);
+    if (queryPos != std::string::npos)
+        parsed.query = parsed.target.substr(queryPos + 1);
+    return true;
+}
+
+RequestParser::State RequestParser::finishHeader() {
+    std::string& value = parsed.headers.back().value;
+    size_t end = value.find_last_not_of(" \t");
+    value.erase(end == std::string::npos ? 0 : end + 1);
+    return HEADER_START;
+}
+
+// Works out the framing once for every later stage: Transfer-Encoding wins over
+// Content-Length, conflicting lengths are rejected and so is any transfer coding
+// other than a final chunked (RFC 9112, section 6).
+RequestParser::State RequestParser::finishHeaders() {
+    bool hasLength = false;
+    std::string lastCoding;
+    size_t hosts = 0;
+
+    for (size_t i = 0; i < parsed.headers.size(); ++i) {
+        const RequestHeader& header = parsed.headers[i];
+        if (header.id == ParsedRequest::CONTENT_LENGTH) {
+            size_t length;
+            if (!parseLength(header.value, length) || (hasLength && length != parsed.contentLength))
+                return fail(400);
+            hasLength = true;
+            parsed.contentLength = length;
+        } else if (header.id == ParsedRequest::TRANSFER_ENCODING) {
+            std::vector<std::string> codings = StringUtils::split(header.value, ',');
+            lastCoding = codings.empty() ? "-" : StringUtils::toLower(codings.back());
+        } else if (header.id == ParsedRequest::CONNECTION) {
+            std::vector<std::string> options = StringUtils::split(header.value, ',');
+            for (size_t j = 0; j < options.size(); ++j) {
+                std::string option = StringUtils::toLower(options[j]);
+                if (option == "close")
+                    parsed.connectionClose = true;
+                else if (option == "keep-alive")
+                    parsed.connectionKeepAlive = true;
+            }
+        } else if (header.id == ParsedRequest::HOST) {
+            ++hosts;
+        }
+    }
+
+    if (hosts > 1)
+        return fail(400);
+    if (!lastCoding.empty()) {
+        if (lastCoding != "chunked")
+            return fail(501);
+        parsed.framing = ParsedRequest::BODY_CHUNKED;
+        parsed.contentLength = 0;
+    } else if (hasLength) {
+        parsed.framing = ParsedRequest::BODY_LENGTH;
+    }
+    return DONE;
+}
@@ -0,0 +1,286 @@
+#!/bin/bash
+
+# CGI Cache Test Suite
+# Tests cgi_cache: hits answered without running the script, keys from the method, URI,
+# query and request headers, cgi_cache_valid expiry, Cache-Control / Set-Cookie / Status
+# from the script deciding what is kept, POST bypassing the cache, LRU eviction within
+# the byte budget, compressed variants of a stored response and config errors
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_cgi_cache.conf"
+ROOT_DIR="/tmp/webserv_cgi_cache_root"
+COUNTER="/tmp/webserv_cgi_cache_runs"
+PORT=8109
+URL="http://127.0.0.1:$PORT"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_cgi_cache"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# fetch <curl args...>: "<X-Cache-Status> <first body line>"
+fetch() {
+    local response
+    response=$(curl -s -i --max-time 5 "$@" | tr -d '\r')
+    echo "$(echo "$response" | sed -n 's/^X-Cache-Status: //p') $(echo "$response" | sed '1,/^$/d' | head -n 1)"
+}
+
+# header <name> <curl args...>: the values of the named response headers (name may
+# be several, as a\|b), space-separated
+header() {
+    local name=$1
+    shift
+    curl -s -D - -o /dev/null --max-time 5 "$@" | tr -d '\r' | sed -n "s/^\\($name\\): //p" | xargs
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$COUNTER"
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/cgi-bin"
+
+# Every run bumps the counter, so a response served from the cache repeats its number.
+# The query picks what else the script says about its response.
+cat > "$ROOT_DIR/cgi-bin/count.py" <<EOF
+import os
+try:
+    runs = int(open("$COUNTER").read()) + 1
+except Exception:
+    runs = 1
+open("$COUNTER", "w").write(str(runs))
+query = os.environ.get("QUERY_STRING", "")
+extra = {
+    "nostore": "Cache-Control: no-store",
+    "private": "Cache-Control: private, max-age=60",
+    "maxage": "Cache-Control: public, max-age=60",
+    "smaxage": "Cache-Control: max-age=60, s-maxage=0",
+    "cookie": "Set-Cookie: session=%d" % runs,
+    "missing": "Status: 404 Not Found",
+    "moved": "Location: /elsewhere",
+}.get(query.split("&")[0])
+print("Content-Type: text/plain")
+if extra:
+    print(extra)
+print()
+print("run=%d" % runs)
+size = query.startswith("size=") and int(query.split("&")[0][5:]) or 0
+print("x" * (size or 200))
+EOF
+
+write_config() {
+    cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET POST;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_cache 1048576;
+        cgi_cache_valid 2s;
+        $1
+    }
+
+    location /keyed {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_cache 1048576;
+        cgi_cache_valid 60;
+        cgi_cache_key \$request_method \$uri lang=\$http_x_lang;
+    }
+
+    location /small {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_cache 4000;
+        cgi_cache_valid 60;
+    }
+
+    location /packed {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_cache 1048576;
+        cgi_cache_valid 60;
+        gzip on;
+        gzip_types text/plain;
+    }
+
+    location /off {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+    }
+}
+EOF
+}
+
+runs() {
+    cat "$COUNTER"
+}
+
+echo "========================================"
+echo "  CGI Cache Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+write_config ""
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Hits"
+check_result "MISS run=1" "$(fetch "$URL/cgi-bin/count.py?a")" "First request runs the script"
+check_result "HIT run=1" "$(fetch "$URL/cgi-bin/count.py?a")" "Second is answered from the cache"
+check_result "1" "$(runs)" "Script ran once"
+check_result "MISS run=2" "$(fetch "$URL/cgi-bin/count.py?b")" "Other query, other entry"
+check_result "HIT run=2" "$(fetch -H "Accept-Language: fr" "$URL/cgi-bin/count.py?b")" "Other headers, same entry"
+check_result "0" "$(header Age "$URL/cgi-bin/count.py?a")" "Age of a fresh hit"
+check_result "yes" "$(grep -q "CGI: Cache hit for GET /cgi-bin/count.py?a" "$TEST_LOG_FILE" && echo yes)" "Hit logged"
+echo
+
+echo "[Test 2] POST"
+BASE=$(runs)
+check_result "BYPASS run=$((BASE + 1))" "$(fetch -d "x=1" "$URL/cgi-bin/count.py?a")" "POST runs the script"
+check_result "BYPASS run=$((BASE + 2))" "$(fetch -d "x=1" "$URL/cgi-bin/count.py?a")" "Every time"
+check_result "HIT run=1" "$(fetch "$URL/cgi-bin/count.py?a")" "GET entry untouched"
+echo
+
+echo "[Test 3] Key from request headers"
+BASE=$(runs)
+check_result "MISS run=$((BASE + 1))" "$(fetch -H "X-Lang: en" "$URL/keyed/count.py?a")" "X-Lang: en"
+check_result "MISS run=$((BASE + 2))" "$(fetch -H "X-Lang: de" "$URL/keyed/count.py?a")" "X-Lang: de, own entry"
+check_result "HIT run=$((BASE + 1))" "$(fetch -H "X-Lang: en" "$URL/keyed/count.py?zzz")" "Query not in this key"
+check_result "HIT run=$((BASE + 2))" "$(fetch -H "X-Lang: de" "$URL/keyed/count.py")" "X-Lang: de again"
+echo
+
+echo "[Test 4] What the script allows"
+BASE=$(runs)
+fetch "$URL/cgi-bin/count.py?nostore" > /dev/null
+check_result "MISS run=$((BASE + 2))" "$(fetch "$URL/cgi-bin/count.py?nostore")" "Cache-Control: no-store not kept"
+fetch "$URL/cgi-bin/count.py?private" > /dev/null
+check_result "MISS run=$((BASE + 4))" "$(fetch "$URL/cgi-bin/count.py?private")" "Cache-Control: private not kept"
+fetch "$URL/cgi-bin/count.py?smaxage" > /dev/null
+check_result "MISS run=$((BASE + 6))" "$(fetch "$URL/cgi-bin/count.py?smaxage")" "s-maxage=0 over max-age"
+fetch "$URL/cgi-bin/count.py?cookie" > /dev/null
+check_result "MISS run=$((BASE + 8))" "$(fetch "$URL/cgi-bin/count.py?cookie")" "Set-Cookie not kept"
+STATUS=$(curl -s -o /dev/null -w "%{http_code}" "$URL/cgi-bin/count.py?missing")
+check_result "404 MISS run=$((BASE + 10))" "$STATUS $(fetch "$URL/cgi-bin/count.py?missing")" "404 not kept"
+STATUS=$(curl -s -o /dev/null -w "%{http_code}" "$URL/cgi-bin/count.py?moved")
+check_result "302 HIT /elsewhere" "$STATUS $(fetch "$URL/cgi-bin/count.py?moved" | cut -d' ' -f1) $(header Location "$URL/cgi-bin/count.py?moved")" \
+    "302 kept with its Location"
+check_result "MISS run=$((BASE + 12))" "$(fetch "$URL/cgi-bin/count.py?maxage")" "max-age=60 stored"
+echo
+
+echo "[Test 5] cgi_cache_valid"
+sleep 2.2
+BASE=$(runs)
+check_result "EXPIRED run=$((BASE + 1))" "$(fetch "$URL/cgi-bin/count.py?a")" "Stale entry runs the script again"
+check_result "HIT run=$((BASE + 1))" "$(fetch "$URL/cgi-bin/count.py?a")" "Fresh entry served"
+AGE=$(header Age "$URL/cgi-bin/count.py?maxage")
+check_result "HIT aged" "$(fetch "$URL/cgi-bin/count.py?maxage" | cut -d' ' -f1) $([ "${AGE:-0}" -ge 2 ] && echo aged || echo "Age $AGE")" \
+    "max-age=60 outlives cgi_cache_valid"
+echo
+
+echo "[Test 6] Eviction"
+BASE=$(runs)
+fetch "$URL/small/count.py?size=1500&1" > /dev/null
+fetch "$URL/small/count.py?size=1500&2" > /dev/null
+check_result "HIT run=$((BASE + 1))" "$(fetch "$URL/small/count.py?size=1500&1")" "Both fit in 4000 bytes"
+fetch "$URL/small/count.py?size=1500&3" > /dev/null
+check_result "HIT run=$((BASE + 1))" "$(fetch "$URL/small/count.py?size=1500&1")" "Recently used kept"
+check_result "MISS run=$((BASE + 4))" "$(fetch "$URL/small/count.py?size=1500&2")" "Least recently used evicted"
+fetch "$URL/small/count.py?size=5000" > /dev/null
+check_result "MISS run=$((BASE + 6))" "$(fetch "$URL/small/count.py?size=5000")" "Larger than the cache, never stored"
+check_result "HIT run=$((BASE + 1))" "$(fetch "$URL/small/count.py?size=1500&1")" "Nothing evicted for it"
+echo
+
+echo "[Test 7] Compressed variants"
+BASE=$(runs)
+check_result "MISS gzip" "$(header 'X-Cache-Status\|Content-Encoding' -H "Accept-Encoding: gzip" "$URL/packed/count.py")" \
+    "Stored response compressed for the client"
+check_result "HIT run=$((BASE + 1))" "$(fetch --compressed "$URL/packed/count.py")" "gzip served from the cache"
+check_result "HIT run=$((BASE + 1))" "$(fetch "$URL/packed/count.py")" "Identity from the same entry"
+check_result "HIT Accept-Encoding deflate" "$(header 'Vary\|X-Cache-Status\|Content-Encoding' -H "Accept-Encoding: deflate" "$URL/packed/count.py")" \
+    "deflate added to the entry"
+check_result "$((BASE + 1))" "$(runs)" "Script ran once for every coding"
+echo
+
+echo "[Test 8] Without cgi_cache"
+check_result "" "$(header X-Cache-Status "$URL/off/count.py")" "No X-Cache-Status"
+kill -TERM $SERVER_PID
+wait $SERVER_PID 2>/dev/null
+check_result "1" "$(grep -c "CGI cache 127.0.0.1:$PORT: .* hits, .* misses, .* expired, .* evictions" "$TEST_LOG_FILE")" "Stats logged at shutdown"
+echo
+
+echo "[Test 9] Config errors"
+write_config "cgi_cache_key \$request_method \$cookie_id;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN "$CONFIG_FILE" 2>&1)
+check_result "1" "$(echo "$OUTPUT" | grep -c "Unknown variable \$cookie_id in cgi_cache_key")" "Unknown variable rejected"
+write_config "cgi_cache_valid 0;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN "$CONFIG_FILE" 2>&1)
+check_result "1" "$(echo "$OUTPUT" | grep -c "Invalid cgi_cache_valid 0")" "cgi_cache_valid 0 rejected"
+write_config "cgi_cache 1M;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN "$CONFIG_FILE" 2>&1)
+check_result "1" "$(echo "$OUTPUT" | grep -c "Invalid cgi_cache 1M")" "Size with a suffix rejected"
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
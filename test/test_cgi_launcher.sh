@@ -0,0 +1,266 @@
+#!/bin/bash
+
+# CGI Launcher Test Suite
+# Tests the cgi_launcher modes (fork, spawn, zygote): environment, working directory,
+# request body, concurrent scripts, cgi_timeout kills and exit codes in each; the zygote
+# helper owning the scripts and passing no other descriptors, falling back to spawn when
+# it dies, going away with its worker, and one helper per worker thread or process
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_cgi_launcher.conf"
+ROOT_DIR="/tmp/webserv_cgi_launcher_root"
+PID_FILE="/tmp/webserv_cgi_launcher_hang.pid"
+PORT=8108
+URL="http://127.0.0.1:$PORT"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_cgi_launcher"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# field <name> <info.py output>
+field() {
+    echo "$2" | sed -n "s/^$1=//p"
+}
+
+# Lines the server has logged since the mark was taken.
+log_since() {
+    tail -n +$((LOG_MARK + 1)) "$TEST_LOG_FILE"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    [ -f "$PID_FILE" ] && kill -9 "$(cat "$PID_FILE")" 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$PID_FILE" /tmp/webserv_cgi_launcher_body /tmp/webserv_cgi_launcher_out.*
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/cgi-bin"
+
+# What the script was started with; its descriptors are listed once the listing's own
+# has been closed again.
+cat > "$ROOT_DIR/cgi-bin/info.py" <<'EOF'
+import os
+fds = [fd for fd in sorted(int(n) for n in os.listdir("/proc/self/fd")) if os.path.exists("/proc/self/fd/%d" % fd)]
+print("Content-Type: text/plain")
+print()
+print("method=%s" % os.environ.get("REQUEST_METHOD"))
+print("cwd=%s" % os.path.basename(os.getcwd()))
+print("ppid=%d" % os.getppid())
+print("fds=%s" % ",".join(str(fd) for fd in fds))
+EOF
+
+cat > "$ROOT_DIR/cgi-bin/md5.py" <<'EOF'
+import hashlib, sys
+body = sys.stdin.buffer.read()
+print("Content-Type: text/plain")
+print()
+print("%s %d" % (hashlib.md5(body).hexdigest(), len(body)))
+EOF
+
+cat > "$ROOT_DIR/cgi-bin/hang.py" <<EOF
+import os, time
+open("$PID_FILE", "w").write(str(os.getpid()))
+time.sleep(30)
+EOF
+
+cat > "$ROOT_DIR/cgi-bin/exit3.py" <<'EOF'
+import sys
+print("Content-Type: text/plain")
+print()
+print("failing")
+sys.exit(3)
+EOF
+
+head -c $((1024 * 1024)) /dev/urandom > /tmp/webserv_cgi_launcher_body
+BODY_MD5="$(md5sum < /tmp/webserv_cgi_launcher_body | cut -d' ' -f1) 1048576"
+
+write_config() {
+    cat > "$CONFIG_FILE" <<EOF
+$1
+
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+    client_max_body_size 0;
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET POST;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_timeout 1;
+    }
+}
+EOF
+}
+
+start() {
+    write_config "$1"
+    LOG_MARK=$(wc -l < "$TEST_LOG_FILE")
+    start_server_with_logging "$CONFIG_FILE"
+    sleep 1
+
+    if ! ps -p $SERVER_PID > /dev/null; then
+        echo -e "${RED}✗ Server failed to start${NC}"
+        cat "$TEST_LOG_FILE"
+        exit 1
+    fi
+}
+
+stop() {
+    kill -TERM $SERVER_PID
+    wait $SERVER_PID 2>/dev/null
+}
+
+# The same requests through every mode.
+common() {
+    local mode=$1
+
+    EXIT_STATUS=$(curl -s -o /dev/null -w "%{http_code}" "$URL/cgi-bin/exit3.py")
+
+    INFO=$(curl -s "$URL/cgi-bin/info.py")
+    check_result "GET cgi-bin" "$(field method "$INFO") $(field cwd "$INFO")" "[$mode] Environment and working directory"
+
+    RESULT=$(curl -s --data-binary @/tmp/webserv_cgi_launcher_body "$URL/cgi-bin/md5.py")
+    check_result "$BODY_MD5" "$RESULT" "[$mode] 1 MB body on stdin"
+
+    for i in 1 2 3 4 5 6 7 8; do
+        curl -s -m 10 --data-binary @/tmp/webserv_cgi_launcher_body "$URL/cgi-bin/md5.py" \
+            > /tmp/webserv_cgi_launcher_out.$i &
+    done
+    wait $(jobs -p | grep -v "^$SERVER_PID$") 2>/dev/null
+    check_result "8" "$(cat /tmp/webserv_cgi_launcher_out.* | grep -cx "$BODY_MD5")" "[$mode] 8 scripts at once"
+    rm -f /tmp/webserv_cgi_launcher_out.*
+
+    rm -f "$PID_FILE"
+    STATUS=$(curl -s -o /dev/null -w "%{http_code}" -m 10 "$URL/cgi-bin/hang.py")
+    sleep 0.5
+    STATE=$(ps -o stat= -p "$(cat "$PID_FILE" 2>/dev/null)" 2>/dev/null | cut -c1)
+    check_result "504 stopped" "$STATUS $([ -z "$STATE" ] || [ "$STATE" = "Z" ] && echo stopped || echo "running")" \
+        "[$mode] Script killed after cgi_timeout"
+
+    check_result "200 1" "$EXIT_STATUS $(log_since | grep -c "CGI: Process exited with code 3")" "[$mode] Exit code logged"
+}
+
+echo "========================================"
+echo "  CGI Launcher Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+echo "[Test 1] fork (default)"
+start ""
+common fork
+INFO=$(curl -s "$URL/cgi-bin/info.py")
+check_result "$SERVER_PID" "$(field ppid "$INFO")" "[fork] Script is the worker's child"
+stop
+
+echo "[Test 2] spawn"
+start "cgi_launcher spawn;"
+common spawn
+INFO=$(curl -s "$URL/cgi-bin/info.py")
+check_result "$SERVER_PID" "$(field ppid "$INFO")" "[spawn] Script is the worker's child"
+stop
+
+echo "[Test 3] zygote"
+start "cgi_launcher zygote;"
+HELPERS=$(pgrep -P $SERVER_PID -x webserv)
+check_result "1" "$(echo "$HELPERS" | grep -c .)" "[zygote] One helper process"
+common zygote
+INFO=$(curl -s "$URL/cgi-bin/info.py")
+check_result "$HELPERS" "$(field ppid "$INFO")" "[zygote] Script is the helper's child"
+check_result "0,1,2" "$(field fds "$INFO")" "[zygote] Only stdin, stdout and stderr passed on"
+check_result "" "$(ps -o stat= --ppid "$HELPERS" | grep Z)" "[zygote] Exited scripts reaped"
+
+echo "[Test 4] Helper dies"
+kill -9 $HELPERS
+sleep 0.5
+LOG_MARK=$(wc -l < "$TEST_LOG_FILE")
+INFO=$(curl -s "$URL/cgi-bin/info.py")
+check_result "GET $SERVER_PID" "$(field method "$INFO") $(field ppid "$INFO")" "Spawned by the worker instead"
+check_result "1" "$(log_since | grep -c "is gone, spawning directly")" "Fallback logged"
+RESULT=$(curl -s --data-binary @/tmp/webserv_cgi_launcher_body "$URL/cgi-bin/md5.py")
+check_result "$BODY_MD5" "$RESULT" "Later requests served"
+stop
+
+echo "[Test 5] Helper lifetime"
+start "cgi_launcher zygote;"
+HELPERS=$(pgrep -P $SERVER_PID -x webserv)
+stop
+sleep 0.5
+check_result "gone" "$(ps -p "$HELPERS" > /dev/null && echo running || echo gone)" "Helper exits with its worker"
+
+start "worker_processes 2;
+cgi_launcher zygote;"
+WORKERS=$(pgrep -P $SERVER_PID -x webserv | wc -l)
+HELPERS=0
+for worker in $(pgrep -P $SERVER_PID -x webserv); do
+    HELPERS=$((HELPERS + $(pgrep -P $worker -x webserv | wc -l)))
+done
+check_result "2 2" "$WORKERS $HELPERS" "One helper per worker process"
+RESULT=$(curl -s --data-binary @/tmp/webserv_cgi_launcher_body "$URL/cgi-bin/md5.py")
+check_result "$BODY_MD5" "$RESULT" "Served by a worker's helper"
+stop
+
+start "worker_threads 2;
+cgi_launcher zygote;"
+check_result "2" "$(pgrep -P $SERVER_PID -x webserv | wc -l)" "One helper per worker thread"
+for i in 1 2 3 4; do
+    curl -s -m 10 --data-binary @/tmp/webserv_cgi_launcher_body "$URL/cgi-bin/md5.py" \
+        > /tmp/webserv_cgi_launcher_out.$i &
+done
+wait $(jobs -p | grep -v "^$SERVER_PID$") 2>/dev/null
+check_result "4" "$(cat /tmp/webserv_cgi_launcher_out.* | grep -cx "$BODY_MD5")" "Served by both workers' helpers"
+rm -f /tmp/webserv_cgi_launcher_out.*
+stop
+
+echo "[Test 6] Invalid mode"
+write_config "cgi_launcher vfork;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN "$CONFIG_FILE" 2>&1)
+check_result "1" "$(echo "$OUTPUT" | grep -c "Invalid cgi_launcher vfork")" "Rejected"
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,356 @@
+#!/bin/bash
+
+# Streamed CGI Response Test Suite
+# Tests cgi_buffering off: the head leaves before the script is done, the body is relayed
+# chunked (or with the script's Content-Length, or close-delimited for HTTP/1.0), a slow
+# client holds the script back instead of its output piling up, a script that stalls
+# past cgi_timeout has its response cut off, and a client that leaves mid-stream has its
+# script killed and waited for, in level- and edge-triggered mode
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_cgi_relay.conf"
+ROOT_DIR="/tmp/webserv_cgi_relay_root"
+CLIENT="/tmp/webserv_cgi_relay_client.py"
+PORT=8106
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_cgi_relay"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# fetch <path> [--http10] [--delay <seconds>] [--abort]
+# GETs path and prints "status framing first-byte-seconds length md5 complete closed",
+# where framing is chunked, length, close or none and closed tells whether the server
+# closed the connection after the response. --delay waits before reading anything;
+# --abort closes the connection once the head is in and prints "aborted".
+fetch() {
+    python3 "$CLIENT" "$PORT" "$@"
+}
+
+# field <n> <fetch output>
+field() {
+    echo "$2" | cut -d' ' -f"$1"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$CLIENT"
+}
+
+trap cleanup EXIT
+
+cat > "$CLIENT" <<'EOF'
+import hashlib, socket, sys, time
+
+port, path, options = int(sys.argv[1]), sys.argv[2], sys.argv[3:]
+version = "HTTP/1.0" if "--http10" in options else "HTTP/1.1"
+delay = float(options[options.index("--delay") + 1]) if "--delay" in options else 0
+
+sock = socket.create_connection(("127.0.0.1", port))
+sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 65536)
+start = time.time()
+sock.sendall(("GET %s %s\r\nHost: localhost\r\n\r\n" % (path, version)).encode())
+time.sleep(delay)
+sock.settimeout(10)
+
+buf = b""
+def more():
+    global buf
+    data = sock.recv(262144)
+    if not data:
+        raise EOFError
+    buf += data
+
+status, framing, first, total, complete = "none", "none", -1.0, 0, "no"
+digest = hashlib.md5()
+def body(data):
+    global first, total
+    if data and first < 0:
+        first = time.time() - start
+    total += len(data)
+    digest.update(data)
+
+try:
+    while b"\r\n\r\n" not in buf:
+        more()
+    head, buf = buf.split(b"\r\n\r\n", 1)
+    if "--abort" in options:
+        sock.close()
+        print("aborted")
+        sys.exit(0)
+    lines = head.split(b"\r\n")
+    status = lines[0].split(b" ")[1].decode()
+    fields = {}
+    for line in lines[1:]:
+        name, _, value = line.partition(b":")
+        fields[name.strip().lower()] = value.strip()
+    if status in ("204", "304"):
+        complete = "yes"
+    elif fields.get(b"transfer-encoding") == b"chunked":
+        framing = "chunked"
+        while True:
+            while b"\r\n" not in buf:
+                more()
+            line, buf = buf.split(b"\r\n", 1)
+            size = int(line, 16)
+            while size > 0:
+                if not buf:
+                    more()
+                piece = buf[:size]
+                body(piece)
+                size -= len(piece)
+                buf = buf[len(piece):]
+            while len(buf) < 2:
+                more()
+            buf = buf[2:]
+            if line == b"0":
+                complete = "yes"
+                break
+    elif b"content-length" in fields:
+        framing = "length"
+        length = int(fields[b"content-length"])
+        while len(buf) < length:
+            body(buf)
+            length -= len(buf)
+            buf = b""
+            more()
+        body(buf[:length])
+        complete = "yes"
+    else:
+        framing = "close"
+        while True:
+            body(buf)
+            buf = b""
+            more()
+except EOFError:
+    if framing == "close":
+        complete = "yes"
+except socket.timeout:
+    pass
+
+closed = "yes"
+if complete == "yes" and framing != "close":
+    sock.settimeout(0.5)
+    try:
+        closed = "yes" if not sock.recv(1) else "no"
+    except socket.timeout:
+        closed = "no"
+    except ConnectionResetError:
+        closed = "yes"
+print(status, framing, "%.1f" % first, total, digest.hexdigest(), complete, closed)
+EOF
+
+mkdir -p "$ROOT_DIR/cgi-bin" "$ROOT_DIR/buffered"
+
+# First line at once, the second 1.5 seconds later.
+cat > "$ROOT_DIR/cgi-bin/slow.py" <<'EOF'
+import sys, time
+sys.stdout.write("Content-Type: text/plain\r\n\r\nfirst\n")
+sys.stdout.flush()
+time.sleep(1.5)
+sys.stdout.write("second\n")
+EOF
+cp "$ROOT_DIR/cgi-bin/slow.py" "$ROOT_DIR/buffered/slow.py"
+
+# Announces 10 bytes and writes more.
+cat > "$ROOT_DIR/cgi-bin/sized.py" <<'EOF'
+import sys
+sys.stdout.write("Content-Type: text/plain\r\nContent-Length: 10\r\n\r\n0123456789EXTRA")
+EOF
+
+# Announces 100 bytes and writes 5.
+cat > "$ROOT_DIR/cgi-bin/short.py" <<'EOF'
+import sys
+sys.stdout.write("Content-Type: text/plain\r\nContent-Length: 100\r\n\r\nshort")
+EOF
+
+cat > "$ROOT_DIR/cgi-bin/empty.py" <<'EOF'
+import sys
+sys.stdout.write("Status: 204 No Content\r\n\r\n")
+EOF
+
+# 64 MB of a repeating pattern.
+cat > "$ROOT_DIR/cgi-bin/big.py" <<'EOF'
+import sys
+block = bytes(range(256)) * 4096
+sys.stdout.write("Content-Type: application/octet-stream\r\n\r\n")
+sys.stdout.flush()
+for i in range(64):
+    sys.stdout.buffer.write(block)
+EOF
+BIG_MD5=$(python3 -c "import hashlib; print(hashlib.md5(bytes(range(256)) * 4096 * 64).hexdigest())")
+
+# Sends its head, then hangs.
+cat > "$ROOT_DIR/cgi-bin/stall.py" <<'EOF'
+import sys, time
+sys.stdout.write("Content-Type: text/plain\r\n\r\npartial\n")
+sys.stdout.flush()
+time.sleep(30)
+EOF
+
+# A line every 0.2 seconds for 10 seconds.
+cat > "$ROOT_DIR/cgi-bin/ticker.py" <<'EOF'
+import sys, time
+sys.stdout.write("Content-Type: text/plain\r\n\r\n")
+for i in range(50):
+    sys.stdout.write("tick %d\n" % i)
+    sys.stdout.flush()
+    time.sleep(0.2)
+EOF
+
+write_config() {
+    cat > "$CONFIG_FILE" <<EOF
+edge_triggered $1;
+
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_timeout 2;
+        cgi_buffering off;
+    }
+
+    location /buffered {
+        root $ROOT_DIR/buffered;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+    }
+}
+EOF
+}
+
+start() {
+    write_config "$1"
+    start_server_with_logging "$CONFIG_FILE"
+    sleep 1
+
+    if ! ps -p $SERVER_PID > /dev/null; then
+        echo -e "${RED}✗ Server failed to start${NC}"
+        cat "$TEST_LOG_FILE"
+        exit 1
+    fi
+}
+
+first_byte() {
+    RESULT=$(fetch /cgi-bin/slow.py)
+    check_result "200 chunked" "$(field 1-2 "$RESULT")" "Relayed with chunked framing"
+    check_result "true" "$(awk -v t="$(field 3 "$RESULT")" 'BEGIN { print (t < 1.0) ? "true" : t "s" }')" \
+        "First line before the script is done"
+    check_result "$(printf 'first\nsecond\n' | md5sum | cut -d' ' -f1) yes no" "$(field 5-7 "$RESULT")" \
+        "Whole body, connection kept"
+}
+
+large_output() {
+    HWM_BEFORE=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+    RESULT=$(fetch /cgi-bin/big.py --delay 2)
+    HWM_AFTER=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+    check_result "67108864 $BIG_MD5 yes" "$(field 4-6 "$RESULT")" "64 MB to a client that starts late"
+    GROWTH=$(( (HWM_AFTER - HWM_BEFORE) / 1024 ))
+    check_result "true" "$([ $GROWTH -lt 8 ] && echo true || echo "${GROWTH} MB")" "Peak memory grows by less than 8 MB"
+}
+
+echo "========================================"
+echo "  Streamed CGI Response Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+start off
+
+echo "[Test 1] Time to first byte"
+first_byte
+RESULT=$(fetch /buffered/slow.py)
+check_result "200 length" "$(field 1-2 "$RESULT")" "Buffered by default"
+check_result "true" "$(awk -v t="$(field 3 "$RESULT")" 'BEGIN { print (t >= 1.0) ? "true" : t "s" }')" \
+    "Buffered response waits for the script"
+
+echo "[Test 2] Body framing"
+RESULT=$(fetch /cgi-bin/sized.py)
+check_result "200 length 10 $(printf 0123456789 | md5sum | cut -d' ' -f1) yes no" "$(field 1-2,4-7 "$RESULT")" \
+    "Script's Content-Length kept, excess dropped"
+RESULT=$(fetch /cgi-bin/short.py)
+check_result "length 5 no yes" "$(field 2,4,6-7 "$RESULT")" "Short body ends with the connection"
+RESULT=$(fetch /cgi-bin/slow.py --http10)
+check_result "200 close 13 yes" "$(field 1-2,4,6 "$RESULT")" "HTTP/1.0 body delimited by close"
+RESULT=$(fetch /cgi-bin/empty.py)
+check_result "204 none yes no" "$(field 1-2,6-7 "$RESULT")" "204 without a body"
+
+echo "[Test 3] Slow client"
+large_output
+
+echo "[Test 4] Script stalls after its head"
+START=$(date +%s)
+RESULT=$(fetch /cgi-bin/stall.py)
+ELAPSED=$(( $(date +%s) - START ))
+check_result "200 chunked 8 no yes" "$(field 1-2,4,6-7 "$RESULT")" "Response cut off by cgi_timeout"
+check_result "true" "$([ $ELAPSED -lt 6 ] && echo true || echo "${ELAPSED}s")" "Closed after cgi_timeout"
+
+# Nothing may be left of the script once its client is gone: not running, not a zombie.
+client_gone() {
+    check_result "aborted" "$(fetch /cgi-bin/ticker.py --abort)" "Client left after the head"
+    sleep 1
+    check_result "0" "$(ps -o pid= --ppid $SERVER_PID | wc -l)" "CGI processes left behind"
+}
+
+echo "[Test 5] Client gone mid-stream"
+client_gone
+
+echo "[Test 6] Edge-triggered mode"
+kill -TERM $SERVER_PID
+sleep 1
+start on
+first_byte
+large_output
+client_gone
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,301 @@
+#!/bin/bash
+
+# Streaming CGI Request Body Test Suite
+# Tests that a CGI starts before its body has arrived, a large body piped through a
+# slow script without being buffered, a script that never reads its stdin, a request
+# pipelined after a streamed body, cgi_timeout while the body waits for the script and
+# a client that gives up mid-body, in level- and edge-triggered mode
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_cgi_stream.conf"
+ROOT_DIR="/tmp/webserv_cgi_stream_root"
+CLIENT="/tmp/webserv_cgi_stream_client.py"
+PORT=8105
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_cgi_stream"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# post <script> <body size> [--marker <file>] [--then-get] [--background] [--abort <bytes>]
+# POSTs random bytes to /cgi-bin/<script> and prints "<status>:<first body line>" for
+# every response. --marker sends half the body, then reports whether <file> exists
+# before sending the rest; --then-get pipelines a GET behind the body; --background
+# keeps sending while the response is awaited; --abort closes the connection after
+# <bytes> of the body and prints "aborted". The body's md5 is printed last.
+post() {
+    python3 "$CLIENT" "$PORT" "$@"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$CLIENT"
+}
+
+trap cleanup EXIT
+
+cat > "$CLIENT" <<'EOF'
+import hashlib, os, socket, sys, threading, time
+
+port, script, size = int(sys.argv[1]), sys.argv[2], int(sys.argv[3])
+options = sys.argv[4:]
+body = os.urandom(size)
+head = b"POST /cgi-bin/%s HTTP/1.1\r\nHost: localhost\r\nContent-Length: %d\r\n\r\n" % (script.encode(), size)
+tail = b"GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n" if "--then-get" in options else b""
+
+sock = socket.create_connection(("127.0.0.1", port))
+results = []
+if "--abort" in options:
+    sock.sendall(head + body[:int(options[options.index("--abort") + 1])])
+    time.sleep(0.5)
+    sock.close()
+    print("aborted " + hashlib.md5(body).hexdigest())
+    sys.exit(0)
+if "--marker" in options:
+    marker = options[options.index("--marker") + 1]
+    sock.sendall(head + body[:size // 2])
+    time.sleep(0.5)
+    results.append("started" if os.path.exists(marker) else "waiting")
+    sock.sendall(body[size // 2:] + tail)
+elif "--background" in options:
+    def send():
+        try:
+            sock.sendall(head + body + tail)
+        except OSError:
+            pass
+    threading.Thread(target=send, daemon=True).start()
+else:
+    sock.sendall(head + body + tail)
+
+sock.settimeout(10)
+data = b""
+try:
+    while True:
+        part = sock.recv(65536)
+        if not part:
+            break
+        data += part
+        sock.settimeout(1)
+except (socket.timeout, ConnectionResetError):
+    pass
+
+while data:
+    head, _, rest = data.partition(b"\r\n\r\n")
+    lines = head.split(b"\r\n")
+    length = 0
+    for line in lines[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value)
+    content, data = rest[:length], rest[length:]
+    first = content.split(b"\n")[0].rstrip(b"\r").decode(errors="replace")[:60]
+    results.append("%s:%s" % (lines[0].split(b" ")[1].decode(), first))
+results.append(hashlib.md5(body).hexdigest())
+print(" ".join(results))
+EOF
+
+mkdir -p "$ROOT_DIR/cgi-bin"
+echo "<html><body>index</body></html>" > "$ROOT_DIR/index.html"
+
+# Marks its start, then reads the whole body.
+cat > "$ROOT_DIR/cgi-bin/started.py" <<'EOF'
+import sys
+open("started", "w").close()
+body = sys.stdin.buffer.read()
+print("Content-Type: text/plain")
+print()
+print(len(body))
+EOF
+
+# Reads its body slowly and prints its md5 and length.
+cat > "$ROOT_DIR/cgi-bin/md5.py" <<'EOF'
+import hashlib, os, sys, time
+digest = hashlib.md5()
+total = 0
+while True:
+    block = os.read(0, 65536)
+    if not block:
+        break
+    digest.update(block)
+    total += len(block)
+    time.sleep(0.0005)
+print("Content-Type: text/plain")
+print()
+print("%s %d" % (digest.hexdigest(), total))
+EOF
+
+# Answers without looking at its stdin.
+cat > "$ROOT_DIR/cgi-bin/ignore.py" <<'EOF'
+print("Content-Type: text/plain")
+print()
+print("ignored")
+EOF
+
+# Leaves a marker once its stdin reaches EOF; killed first if the body is cut short.
+cat > "$ROOT_DIR/cgi-bin/eof.py" <<'EOF'
+import sys
+body = sys.stdin.buffer.read()
+open("eof", "w").write(str(len(body)))
+print("Content-Type: text/plain")
+print()
+print(len(body))
+EOF
+
+# Never reads its stdin and never answers.
+cat > "$ROOT_DIR/cgi-bin/stuck.py" <<'EOF'
+import time
+time.sleep(30)
+EOF
+
+write_config() {
+    cat > "$CONFIG_FILE" <<EOF
+edge_triggered $1;
+
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+    client_max_body_size 0;
+
+    location / {
+        allow_methods GET;
+    }
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET POST;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_timeout 2;
+    }
+}
+EOF
+}
+
+start() {
+    write_config "$1"
+    start_server_with_logging "$CONFIG_FILE"
+    sleep 1
+
+    if ! ps -p $SERVER_PID > /dev/null; then
+        echo -e "${RED}✗ Server failed to start${NC}"
+        cat "$TEST_LOG_FILE"
+        exit 1
+    fi
+}
+
+# The body's md5 must come back from md5.py, and the server's peak memory must not
+# grow with the body.
+large_body() {
+    local size=$1
+    local label=$2
+    HWM_BEFORE=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+    RESULT=$(post md5.py "$size")
+    HWM_AFTER=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+    check_result "200:${RESULT##* } $size" "${RESULT% *}" "$label through a slow script"
+    GROWTH=$(( (HWM_AFTER - HWM_BEFORE) / 1024 ))
+    check_result "true" "$([ $GROWTH -lt 8 ] && echo true || echo "${GROWTH} MB")" "Peak memory grows by less than 8 MB"
+}
+
+echo "========================================"
+echo "  Streaming CGI Request Body Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+start off
+
+echo "[Test 1] Script starts before its body is in"
+RESULT=$(post started.py 200000 --marker "$ROOT_DIR/cgi-bin/started")
+check_result "started 200:200000" "${RESULT% *}" "Forked after the headers, whole body read"
+
+echo "[Test 2] Large body"
+large_body $((64 * 1024 * 1024)) "64 MB"
+
+echo "[Test 3] Script that ignores its stdin"
+RESULT=$(post ignore.py $((4 * 1024 * 1024)) --background)
+check_result "200:ignored" "${RESULT% *}" "Answered while the body is still arriving"
+RESULT=$(post ignore.py 10)
+check_result "200:ignored" "${RESULT% *}" "Small body left unread"
+
+echo "[Test 4] Request after a streamed body"
+RESULT=$(post started.py 100000 --then-get)
+check_result "200:100000 200:<html><body>index</body></html>" "${RESULT% *}" "Next request kept out of the body"
+
+echo "[Test 5] cgi_timeout while the body waits"
+START=$(date +%s)
+RESULT=$(post stuck.py $((4 * 1024 * 1024)) --background)
+ELAPSED=$(( $(date +%s) - START ))
+check_result "504" "${RESULT%%:*}" "Script not reading its stdin"
+check_result "true" "$([ $ELAPSED -lt 6 ] && echo true || echo "${ELAPSED}s")" "Answered after cgi_timeout"
+
+# The script must be killed and waited for, never handed a clean EOF on a cut body.
+aborted_body() {
+    rm -f "$ROOT_DIR/cgi-bin/eof"
+    post eof.py 100000 --abort 100 > /dev/null
+    sleep 1.5
+    check_result "absent" "$([ -e "$ROOT_DIR/cgi-bin/eof" ] && echo "read $(cat "$ROOT_DIR/cgi-bin/eof") bytes to EOF" || echo absent)" \
+        "Script killed before EOF"
+    ZOMBIES=$(ps -o stat= --ppid $SERVER_PID | grep -c '^Z')
+    check_result "0" "$ZOMBIES" "Zombie children"
+}
+
+echo "[Test 6] Client gone mid-body"
+aborted_body
+
+echo "[Test 7] Edge-triggered mode"
+kill -TERM $SERVER_PID
+sleep 1
+start on
+rm -f "$ROOT_DIR/cgi-bin/started"
+RESULT=$(post started.py 200000 --marker "$ROOT_DIR/cgi-bin/started")
+check_result "started 200:200000" "${RESULT% *}" "Forked after the headers"
+large_body $((32 * 1024 * 1024)) "32 MB"
+RESULT=$(post stuck.py $((4 * 1024 * 1024)) --background)
+check_result "504" "${RESULT%%:*}" "cgi_timeout while paused"
+aborted_body
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,232 @@
+#!/bin/bash
+
+# Chunked Request Body Test Suite
+# Tests chunked bodies split anywhere over reads, chunk extensions and trailers,
+# client_max_body_size applied to the decoded size, malformed chunks, a request
+# pipelined after a chunked body and a large chunked upload
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_chunked.conf"
+ROOT_DIR="/tmp/webserv_chunked_root"
+CLIENT="/tmp/webserv_chunked_client.py"
+PORT=8103
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_chunked"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# send <write> [<write> ...]
+# Sends each argument (with \r\n escapes) as one write, 0.1s apart, and prints
+# "<status>:<first body line>" for every response until the server closes or goes quiet.
+send() {
+    python3 "$CLIENT" "$PORT" "$@"
+}
+
+PUT() {
+    printf 'PUT /upload/%s HTTP/1.1\\r\\nHost: localhost\\r\\nTransfer-Encoding: chunked\\r\\n\\r\\n' "$1"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$CLIENT"
+}
+
+trap cleanup EXIT
+
+cat > "$CLIENT" <<'EOF'
+import socket, sys, time
+
+sock = socket.create_connection(("127.0.0.1", int(sys.argv[1])))
+for i, chunk in enumerate(sys.argv[2:]):
+    if i > 0:
+        time.sleep(0.1)
+    sock.sendall(chunk.encode().decode("unicode_escape").encode("latin-1"))
+
+sock.settimeout(2)
+data = b""
+try:
+    while True:
+        part = sock.recv(65536)
+        if not part:
+            break
+        data += part
+except socket.timeout:
+    pass
+
+results = []
+while data:
+    head, _, rest = data.partition(b"\r\n\r\n")
+    lines = head.split(b"\r\n")
+    length = 0
+    for line in lines[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value)
+    body, data = rest[:length], rest[length:]
+    first = body.split(b"\n")[0].rstrip(b"\r").decode(errors="replace")[:20]
+    results.append("%s:%s" % (lines[0].split(b" ")[1].decode(), first))
+print(" ".join(results))
+EOF
+
+mkdir -p "$ROOT_DIR/upload" "$ROOT_DIR/small" "$ROOT_DIR/cgi-bin"
+cat > "$ROOT_DIR/cgi-bin/echo.py" <<'EOF'
+import os, sys
+body = sys.stdin.read()
+print("Content-Type: text/plain")
+print()
+print("%s|%s|%s" % (body, os.environ.get("CONTENT_LENGTH", ""), os.environ.get("HTTP_X_CHECKSUM", "")))
+EOF
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+    client_max_body_size 0;
+
+    location / {
+        allow_methods GET;
+    }
+
+    location /upload {
+        root $ROOT_DIR/upload;
+        allow_methods GET PUT POST;
+        upload_store $ROOT_DIR/upload;
+    }
+
+    location /small {
+        root $ROOT_DIR/small;
+        allow_methods GET PUT;
+        upload_store $ROOT_DIR/small;
+        client_max_body_size 64;
+    }
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET POST;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Chunked Request Body Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Chunks split over reads"
+check_result "201:<html><body><h1>Crea" \
+    "$(send "$(PUT split.txt)5" '\r' '\nhel' 'lo\r\n6\r\n wor' 'ld\r\n0' '\r\n' '\r\n')" "Split inside every token"
+check_result "hello world" "$(cat "$ROOT_DIR/upload/split.txt" 2>/dev/null)" "Stored decoded"
+check_result "201:<html><body><h1>Crea" \
+    "$(send "$(PUT ext.txt)"'A;name=value\r\n0123456789\r\n1;a=b;c\r\n!\r\n0\r\n\r\n')" "Extensions and uppercase size"
+check_result "0123456789!" "$(cat "$ROOT_DIR/upload/ext.txt" 2>/dev/null)" "Extensions ignored"
+check_result "201:<html><body><h1>Crea" "$(send "$(PUT lf.txt)"'3\nabc\n0\n\n')" "Bare LF line endings"
+check_result "abc" "$(cat "$ROOT_DIR/upload/lf.txt" 2>/dev/null)" "Bare LF body"
+
+echo "[Test 2] Trailers"
+check_result "201:<html><body><h1>Crea" \
+    "$(send "$(PUT trailer.txt)"'4\r\ndata\r\n0\r\nX-Checksum: 1234\r\nX-Other:  two  \r\n\r\n')" "Trailer fields accepted"
+check_result "data" "$(cat "$ROOT_DIR/upload/trailer.txt" 2>/dev/null)" "Trailers kept out of the body"
+check_result "200:data|4|1234" \
+    "$(send 'POST /cgi-bin/echo.py HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nda\r\n2\r\nta\r\n0\r\nX-Checksum: 1234\r\n\r\n')" \
+    "Decoded body and trailer passed to CGI"
+
+echo "[Test 3] client_max_body_size on the decoded size"
+CHUNKS=""
+for i in 1 2 3 4 5 6 7 8; do CHUNKS="${CHUNKS}8;padding=xxxxxxxxxxxxxxxx\\r\\n12345678\\r\\n"; done
+check_result "201:<html><body><h1>Crea" "$(send "$(PUT fits.txt | sed 's/upload/small/')${CHUNKS}0\\r\\n\\r\\n")" \
+    "64 bytes in 8 chunks with larger framing"
+check_result "413:" "$(send "$(PUT over.txt | sed 's/upload/small/')${CHUNKS}1\\r\\nx\\r\\n0\\r\\n\\r\\n" | cut -c1-4)" \
+    "65 bytes rejected"
+check_result "413:" "$(send "$(PUT huge.txt | sed 's/upload/small/')ffffffff\\r\\n" | cut -c1-4)" \
+    "Oversized chunk rejected before its data"
+
+echo "[Test 4] Malformed chunks"
+check_result "400:" "$(send "$(PUT bad.txt)"'zz\r\nabc\r\n0\r\n\r\n' | cut -c1-4)" "Invalid chunk size"
+check_result "400:" "$(send "$(PUT bad.txt)"'3\r\nabcd\r\n0\r\n\r\n' | cut -c1-4)" "Chunk longer than its size"
+check_result "400:" "$(send "$(PUT bad.txt)"'10000000000000000\r\n' | cut -c1-4)" "Chunk size overflow"
+check_result "400:" "$(send "$(PUT bad.txt)"'1\r\na\r\n0\r\nBad Trailer\r\n\r\n' | cut -c1-4)" "Malformed trailer"
+
+echo "[Test 5] Request after a chunked body"
+check_result "201:<html><body><h1>Crea 200:pipelined" \
+    "$(send "$(PUT pipe.txt)"'9\r\npipelined\r\n0\r\n\r\nGET /upload/pipe.txt HTTP/1.1\r\nHost: localhost\r\n\r\n')" \
+    "Next request found after the last chunk"
+
+echo "[Test 6] Large chunked upload"
+RESULT=$(python3 - "$PORT" <<'EOF'
+import hashlib, os, socket, sys
+
+data = os.urandom(32 * 1024 * 1024)
+sock = socket.create_connection(("127.0.0.1", int(sys.argv[1])))
+sock.sendall(b"PUT /upload/large.bin HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n")
+for pos in range(0, len(data), 4096):
+    piece = data[pos:pos + 4096]
+    sock.sendall(b"%x\r\n" % len(piece) + piece + b"\r\n")
+sock.sendall(b"0\r\n\r\n")
+sock.settimeout(20)
+status = sock.recv(65536).split(b" ")[1].decode()
+print(status, hashlib.md5(data).hexdigest())
+EOF
+)
+STATUS=${RESULT%% *}
+check_result "201" "$STATUS" "32 MB in 4 KB chunks"
+check_result "${RESULT##* }" "$(md5sum "$ROOT_DIR/upload/large.bin" 2>/dev/null | cut -d' ' -f1)" "Stored intact"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
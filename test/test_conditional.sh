@@ -0,0 +1,221 @@
+#!/bin/bash
+
+# Conditional Request Test Suite
+# Tests ETag and Last-Modified validators, 304 responses to If-None-Match and
+# If-Modified-Since (with and without the static cache) and expires / cache_control
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_conditional.conf"
+ROOT_DIR="/tmp/webserv_conditional_root"
+BASE_URL="http://127.0.0.1:8097"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_conditional"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+header_value() {
+    grep -i "^$1:" "$2" | head -1 | cut -d' ' -f2- | tr -d '\r'
+}
+
+status_of() {
+    curl -s --max-time 5 -o /dev/null -w "%{http_code}" "$@"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_conditional_*.hdr /tmp/webserv_conditional_invalid.conf
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/assets" "$ROOT_DIR/fresh" "$ROOT_DIR/max"
+echo "<html><body>conditional</body></html>" > "$ROOT_DIR/index.html"
+echo "body { color: red; }" > "$ROOT_DIR/assets/site.css"
+echo "fresh" > "$ROOT_DIR/fresh/page.html"
+echo "forever" > "$ROOT_DIR/max/app.js"
+head -c 200000 /dev/urandom > "$ROOT_DIR/big.bin"
+touch -d "2024-01-02 03:04:05 UTC" "$ROOT_DIR/index.html"
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8097;
+    root $ROOT_DIR;
+    index index.html;
+    static_cache_size 1048576;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+
+    location /assets {
+        root $ROOT_DIR/assets;
+        allow_methods GET HEAD;
+        expires 1h;
+    }
+
+    location /fresh {
+        root $ROOT_DIR/fresh;
+        allow_methods GET HEAD;
+        expires epoch;
+    }
+
+    location /max {
+        root $ROOT_DIR/max;
+        allow_methods GET HEAD;
+        expires max;
+        cache_control public, max-age=31536000, immutable;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Conditional Request Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Validators on file responses"
+curl -s --max-time 5 -D /tmp/webserv_conditional_index.hdr -o /dev/null "$BASE_URL/index.html"
+ETAG=$(header_value ETag /tmp/webserv_conditional_index.hdr)
+LAST_MODIFIED=$(header_value Last-Modified /tmp/webserv_conditional_index.hdr)
+check_result "Tue, 02 Jan 2024 03:04:05 GMT" "$LAST_MODIFIED" "Last-Modified"
+if echo "$ETAG" | grep -qE '^"[0-9a-f]+-[0-9a-f]+-[0-9a-f]+"$'; then
+    check_result "strong tag" "strong tag" "ETag $ETAG"
+else
+    check_result "strong tag" "$ETAG" "ETag"
+fi
+curl -sI --max-time 5 "$BASE_URL/index.html" > /tmp/webserv_conditional_head.hdr
+check_result "$ETAG" "$(header_value ETag /tmp/webserv_conditional_head.hdr)" "Same ETag on HEAD"
+curl -s --max-time 5 -D /tmp/webserv_conditional_dir.hdr -o /dev/null "$BASE_URL/"
+check_result "$ETAG" "$(header_value ETag /tmp/webserv_conditional_dir.hdr)" "Same ETag for the index file"
+
+echo "[Test 2] If-None-Match"
+check_result "304" "$(status_of -H "If-None-Match: $ETAG" "$BASE_URL/index.html")" "Matching tag (cached)"
+check_result "304" "$(status_of -H "If-None-Match: \"x\", W/$ETAG" "$BASE_URL/index.html")" "Weak tag in a list"
+check_result "304" "$(status_of -H "If-None-Match: *" "$BASE_URL/index.html")" "Wildcard"
+check_result "200" "$(status_of -H 'If-None-Match: "other"' "$BASE_URL/index.html")" "Different tag"
+check_result "200" "$(status_of -H 'If-None-Match: "other"' -H "If-Modified-Since: $LAST_MODIFIED" \
+    "$BASE_URL/index.html")" "If-None-Match wins over If-Modified-Since"
+SIZE=$(curl -s --max-time 5 -H "If-None-Match: $ETAG" -D /tmp/webserv_conditional_304.hdr \
+    -w "%{size_download}" -o /dev/null "$BASE_URL/index.html")
+check_result "0" "$SIZE" "304 has no body"
+check_result "$LAST_MODIFIED" "$(header_value Last-Modified /tmp/webserv_conditional_304.hdr)" "304 keeps Last-Modified"
+
+echo "[Test 3] If-Modified-Since"
+check_result "304" "$(status_of -H "If-Modified-Since: $LAST_MODIFIED" "$BASE_URL/index.html")" "Same date"
+check_result "304" "$(status_of -H "If-Modified-Since: Wed, 01 Jan 2025 00:00:00 GMT" "$BASE_URL/index.html")" "Later date"
+check_result "200" "$(status_of -H "If-Modified-Since: Mon, 01 Jan 2024 00:00:00 GMT" "$BASE_URL/index.html")" "Earlier date"
+check_result "200" "$(status_of -H "If-Modified-Since: yesterday" "$BASE_URL/index.html")" "Invalid date"
+check_result "304" "$(status_of -I -H "If-Modified-Since: $LAST_MODIFIED" "$BASE_URL/index.html")" "HEAD"
+
+echo "[Test 4] Files outside the static cache"
+BIG_ETAG=$(curl -sI --max-time 5 "$BASE_URL/big.bin" | grep -i "^ETag" | cut -d' ' -f2- | tr -d '\r')
+check_result "304" "$(status_of -H "If-None-Match: $BIG_ETAG" "$BASE_URL/big.bin")" "Matching tag"
+check_result "206" "$(status_of -r 0-9 -H "If-Range: $BIG_ETAG" "$BASE_URL/big.bin")" "If-Range with the tag"
+
+echo "[Test 5] A changed file gets a new tag"
+echo "<html><body>changed content</body></html>" > "$ROOT_DIR/index.html"
+sleep 0.5
+check_result "200" "$(status_of -H "If-None-Match: $ETAG" "$BASE_URL/index.html")" "Old tag after an edit"
+
+echo "[Test 6] expires and cache_control"
+curl -s --max-time 5 -D /tmp/webserv_conditional_css.hdr -o /dev/null "$BASE_URL/assets/site.css"
+check_result "max-age=3600" "$(header_value Cache-Control /tmp/webserv_conditional_css.hdr)" "expires 1h Cache-Control"
+EXPIRES=$(header_value Expires /tmp/webserv_conditional_css.hdr)
+DELTA=$(( $(date -d "$EXPIRES" +%s) - $(date +%s) ))
+if [ "$DELTA" -ge 3590 ] && [ "$DELTA" -le 3600 ]; then
+    check_result "in one hour" "in one hour" "expires 1h Expires"
+else
+    check_result "in one hour" "in $DELTA seconds" "expires 1h Expires"
+fi
+curl -s --max-time 5 -D /tmp/webserv_conditional_css2.hdr -o /dev/null "$BASE_URL/assets/site.css"
+check_result "1" "$(grep -ci "^Expires:" /tmp/webserv_conditional_css2.hdr)" "Expires once on a cache hit"
+curl -s --max-time 5 -D /tmp/webserv_conditional_fresh.hdr -o /dev/null "$BASE_URL/fresh/page.html"
+check_result "no-cache" "$(header_value Cache-Control /tmp/webserv_conditional_fresh.hdr)" "expires epoch Cache-Control"
+check_result "Thu, 01 Jan 1970 00:00:01 GMT" "$(header_value Expires /tmp/webserv_conditional_fresh.hdr)" "expires epoch Expires"
+curl -s --max-time 5 -D /tmp/webserv_conditional_max.hdr -o /dev/null "$BASE_URL/max/app.js"
+check_result "public, max-age=31536000, immutable" "$(header_value Cache-Control /tmp/webserv_conditional_max.hdr)" \
+    "cache_control overrides expires"
+check_result "Thu, 31 Dec 2037 23:55:55 GMT" "$(header_value Expires /tmp/webserv_conditional_max.hdr)" "expires max Expires"
+CSS_ETAG=$(header_value ETag /tmp/webserv_conditional_css.hdr)
+curl -s --max-time 5 -H "If-None-Match: $CSS_ETAG" -D /tmp/webserv_conditional_css304.hdr -o /dev/null \
+    "$BASE_URL/assets/site.css"
+check_result "max-age=3600" "$(header_value Cache-Control /tmp/webserv_conditional_css304.hdr)" "304 keeps Cache-Control"
+check_result "" "$(header_value Cache-Control /tmp/webserv_conditional_index.hdr)" "No Cache-Control without expires"
+
+kill -TERM $SERVER_PID
+sleep 1
+
+echo "[Test 7] Invalid expires rejected"
+for value in "soon" "10x" "-" "99999999999d"; do
+    cat > /tmp/webserv_conditional_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:8097;
+    root ./www;
+
+    location / {
+        expires $value;
+    }
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_conditional_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid expires"; then
+        check_result "rejected" "rejected" "expires $value"
+    else
+        check_result "rejected" "accepted" "expires $value"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
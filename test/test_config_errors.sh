@@ -207,6 +207,83 @@ else
 fi
 echo
 
+# Test 11: Invalid listen backlog
+echo "[Test 11] Invalid listen backlog"
+cat > /tmp/invalid_backlog.conf << 'EOF'
+server {
+    listen 127.0.0.1:9005 backlog=0;
+    root ./www;
+    index index.html;
+}
+EOF
+OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/invalid_backlog.conf 2>&1)
+if echo "$OUTPUT" | grep -qi "invalid listen backlog"; then
+    echo -e "${GREEN}✓${NC} Invalid backlog detected"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo -e "${RED}✗${NC} Invalid backlog not detected"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+
+for value in "12abc" ""; do
+    sed -i "s/backlog=[^;]*/backlog=$value/" /tmp/invalid_backlog.conf
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/invalid_backlog.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid listen backlog $value"; then
+        echo -e "${GREEN}✓${NC} backlog=$value rejected"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} backlog=$value not rejected"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+done
+
+sed -i 's/backlog=[^;]*/reuse/' /tmp/invalid_backlog.conf
+OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/invalid_backlog.conf 2>&1)
+if echo "$OUTPUT" | grep -qi "unknown listen parameter"; then
+    echo -e "${GREEN}✓${NC} Unknown listen parameter detected"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo -e "${RED}✗${NC} Unknown listen parameter not detected"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+
+sed -i 's/reuse/backlog=4096/' /tmp/invalid_backlog.conf
+OUTPUT=$(timeout 1 $WEBSERV_BIN /tmp/invalid_backlog.conf 2>&1)
+if echo "$OUTPUT" | grep -qi "listening on 127.0.0.1:9005"; then
+    echo -e "${GREEN}✓${NC} Valid backlog accepted"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo -e "${RED}✗${NC} Valid backlog rejected"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+rm -f /tmp/invalid_backlog.conf
+echo
+
+# Test 12: Invalid fastcgi_keepalive
+echo "[Test 12] Invalid fastcgi_keepalive"
+for value in "4k" "0"; do
+    cat > /tmp/invalid_keepalive.conf << EOF
+server {
+    listen 127.0.0.1:9006;
+    root ./www;
+    location /app {
+        fastcgi_pass 127.0.0.1:9000;
+        fastcgi_keepalive $value;
+    }
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/invalid_keepalive.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid fastcgi_keepalive $value (must be a positive integer)"; then
+        echo -e "${GREEN}✓${NC} fastcgi_keepalive $value rejected"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} fastcgi_keepalive $value not rejected"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+done
+rm -f /tmp/invalid_keepalive.conf
+echo
+
 echo "========================================"
 echo "         TEST SUMMARY"
 echo "========================================"
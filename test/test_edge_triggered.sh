@@ -0,0 +1,165 @@
+#!/bin/bash
+
+# Edge-Triggered Mode Test Suite
+# Runs keep-alive, large transfer and CGI traffic with edge_triggered on, where
+# sockets and pipes must be drained until EAGAIN on every event
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_edge_triggered.conf"
+ROOT_DIR="/tmp/webserv_edge_root"
+BASE_URL="http://127.0.0.1:8091"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_edge_triggered"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_edge_*.out
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/cgi-bin"
+echo "<html><body>edge</body></html>" > "$ROOT_DIR/index.html"
+head -c 8388608 /dev/urandom > "$ROOT_DIR/big.bin"
+cat > "$ROOT_DIR/cgi-bin/echo.py" <<'EOF'
+import os, sys
+length = int(os.environ.get('CONTENT_LENGTH', '0') or '0')
+data = sys.stdin.buffer.read(length) if length > 0 else b''
+sys.stdout.write("Content-Type: text/plain\r\n\r\n")
+sys.stdout.write("received=%d\n" % len(data))
+sys.stdout.write("x" * 2097152)
+EOF
+
+cat > "$CONFIG_FILE" <<EOF
+edge_triggered on;
+
+server {
+    listen 127.0.0.1:8091;
+    root $ROOT_DIR;
+    index index.html;
+    client_max_body_size 0;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET POST;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Edge-Triggered Mode Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Server reports edge-triggered mode"
+MODE_LINES=$(grep -c "edge-triggered" "$TEST_LOG_FILE")
+check_result "1" "$MODE_LINES" "Edge-triggered startup lines"
+
+echo "[Test 2] Keep-alive requests on one connection"
+URLS=""
+for i in $(seq 1 50); do
+    URLS="$URLS $BASE_URL/"
+done
+BEFORE=$(grep -c "New connection" "$TEST_LOG_FILE")
+KEEPALIVE_OK=$(curl -s -o /dev/null -w "%{http_code}\n" --max-time 10 $URLS | grep -c "200")
+AFTER=$(grep -c "New connection" "$TEST_LOG_FILE")
+check_result "50" "$KEEPALIVE_OK" "Keep-alive responses out of 50"
+check_result "1" "$((AFTER - BEFORE))" "Connections opened"
+
+echo "[Test 3] Large response drained across EAGAIN"
+curl -s --max-time 20 -o /tmp/webserv_edge_big.out "$BASE_URL/big.bin"
+if cmp -s "$ROOT_DIR/big.bin" /tmp/webserv_edge_big.out; then
+    check_result "identical" "identical" "8MB download"
+else
+    check_result "identical" "different" "8MB download"
+fi
+
+echo "[Test 4] Concurrent large responses"
+CURL_PIDS=""
+for i in $(seq 1 8); do
+    curl -s --max-time 30 -o /tmp/webserv_edge_big_$i.out "$BASE_URL/big.bin" &
+    CURL_PIDS="$CURL_PIDS $!"
+done
+wait $CURL_PIDS
+INTACT=0
+for i in $(seq 1 8); do
+    cmp -s "$ROOT_DIR/big.bin" /tmp/webserv_edge_big_$i.out && INTACT=$((INTACT + 1))
+done
+check_result "8" "$INTACT" "Intact downloads out of 8"
+
+echo "[Test 5] CGI with large request and response bodies"
+head -c 1048576 /dev/zero | tr '\0' 'a' > /tmp/webserv_edge_body.out
+curl -s --max-time 20 -o /tmp/webserv_edge_cgi.out -X POST \
+    -H "Content-Type: application/octet-stream" \
+    --data-binary @/tmp/webserv_edge_body.out "$BASE_URL/cgi-bin/echo.py"
+check_result "received=1048576" "$(head -1 /tmp/webserv_edge_cgi.out)" "CGI request body"
+check_result "2097169" "$(wc -c < /tmp/webserv_edge_cgi.out | tr -d ' ')" "CGI response size"
+
+echo "[Test 6] Requests still served after the load"
+check_result "200" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/)" "Final request"
+
+kill -TERM $SERVER_PID
+sleep 1
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
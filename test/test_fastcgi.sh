@@ -0,0 +1,398 @@
+#!/bin/bash
+
+# FastCGI Test Suite
+# Tests fastcgi_pass against a small FastCGI backend over a unix socket and TCP: params
+# and body, backend connections kept open and reused, requests multiplexed on one
+# connection when the backend allows it, fastcgi_keepalive, streamed output, errors
+# reported on stderr, an unreachable backend, cgi_timeout and a client that gives up,
+# in level- and edge-triggered mode
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_fastcgi.conf"
+ROOT_DIR="/tmp/webserv_fastcgi_root"
+BACKEND="/tmp/webserv_fastcgi_backend.py"
+SOCKET="/tmp/webserv_fastcgi.sock"
+PORT=8107
+BACKEND_PORT=9107
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_fastcgi"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+fetch() {
+    curl -s --max-time 10 "http://127.0.0.1:$PORT$1"
+}
+
+status() {
+    curl -s -o /dev/null -w "%{http_code}" --max-time 10 "http://127.0.0.1:$PORT$1"
+}
+
+# value <name> <response body>: the value of a "name=value" line
+value() {
+    echo "$2" | sed -n "s/^$1=//p"
+}
+
+# parallel <count> <path>: fetches path count times at once and prints the number of
+# distinct backend connections that answered, then the seconds it all took
+parallel() {
+    local start=$(date +%s%N)
+    for i in $(seq "$1"); do
+        fetch "$2" > "$ROOT_DIR/out.$i" &
+    done
+    wait
+    local elapsed=$(awk -v ns=$(( $(date +%s%N) - start )) 'BEGIN { printf "%.1f", ns / 1e9 }')
+    echo "$(cat "$ROOT_DIR"/out.* | sed -n 's/^conn=//p' | sort -u | wc -l) $elapsed"
+    rm -f "$ROOT_DIR"/out.*
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    pkill -f "$BACKEND" 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$BACKEND" "$SOCKET"
+}
+
+trap cleanup EXIT
+
+# A FastCGI responder on a unix socket path or a TCP port. With --mpx it tells the
+# server it multiplexes and answers requests on one connection concurrently; without,
+# it answers them one after another. Every connection gets a serial number.
+cat > "$BACKEND" <<'EOF'
+import hashlib, os, socket, struct, sys, threading, time
+
+spec, mpx = sys.argv[1], "--mpx" in sys.argv
+if spec.startswith("/"):
+    listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    if os.path.exists(spec):
+        os.unlink(spec)
+    listener.bind(spec)
+else:
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(("127.0.0.1", int(spec)))
+listener.listen(64)
+
+counts = {"serial": 0, "open": 0}
+lock = threading.Lock()
+
+def record(kind, rid, content=b""):
+    return struct.pack("!BBHHBx", 1, kind, rid, len(content), 0) + content
+
+def length(n):
+    return bytes([n]) if n < 128 else struct.pack("!I", n | 0x80000000)
+
+def pair(name, value):
+    return length(len(name)) + length(len(value)) + name + value
+
+def pairs(data):
+    result, pos = {}, 0
+    def take():
+        nonlocal pos
+        if data[pos] < 128:
+            pos += 1
+            return data[pos - 1]
+        pos += 4
+        return struct.unpack("!I", data[pos - 4:pos])[0] & 0x7fffffff
+    while pos < len(data):
+        n, v = take(), take()
+        result[data[pos:pos + n].decode()] = data[pos + n:pos + n + v].decode()
+        pos += n + v
+    return result
+
+HEAD = b"Content-Type: text/plain\r\n\r\n"
+
+def respond(send, rid, params, body, number):
+    try:
+        answer(send, rid, params, body, number)
+    except OSError:
+        pass
+
+def answer(send, rid, params, body, number):
+    out = lambda data: send(record(6, rid, data))
+    script = os.path.basename(params.get("SCRIPT_FILENAME", ""))
+    if script == "info.php":
+        lines = ["method=" + params.get("REQUEST_METHOD", ""), "script=" + params.get("SCRIPT_FILENAME", ""),
+                 "query=" + params.get("QUERY_STRING", ""), "length=" + params.get("CONTENT_LENGTH", ""),
+                 "host=" + params.get("HTTP_HOST", ""), "md5=" + hashlib.md5(body).hexdigest(),
+                 "conn=%d" % number]
+        out(HEAD + "\n".join(lines).encode() + b"\n")
+    elif script == "sleep.php":
+        time.sleep(1)
+        out(HEAD + b"conn=%d\n" % number)
+    elif script == "stream.php":
+        out(HEAD + b"first\n")
+        time.sleep(1.5)
+        out(b"second\n")
+    elif script == "status.php":
+        send(record(7, rid, b"warning from status.php\n"))
+        out(b"Status: 404 Not Found\r\nContent-Type: text/plain\r\n\r\nmissing\n")
+    elif script == "big.php":
+        out(HEAD)
+        block = bytes(range(256)) * 128
+        for i in range(256):
+            out(block)
+    elif script == "hang.php":
+        time.sleep(3)
+        out(HEAD + b"late\n")
+    elif script == "stats.php":
+        out(HEAD + b"open=%d\n" % counts["open"])
+    send(record(6, rid) + record(3, rid, struct.pack("!IB3x", 0, 0)))
+
+def serve(conn, number):
+    wlock = threading.Lock()
+    def send(data):
+        with wlock:
+            conn.sendall(data)
+    requests, buf = {}, b""
+    try:
+        while True:
+            data = conn.recv(65536)
+            if not data:
+                break
+            buf += data
+            while len(buf) >= 8:
+                _, kind, rid, clen, plen = struct.unpack("!BBHHB", buf[:7])
+                if len(buf) < 8 + clen + plen:
+                    break
+                content, buf = buf[8:8 + clen], buf[8 + clen + plen:]
+                if kind == 9:
+                    send(record(10, 0, pair(b"FCGI_MPXS_CONNS", b"1" if mpx else b"0") + pair(b"FCGI_MAX_REQS", b"16")))
+                elif kind == 1:
+                    requests[rid] = [b"", b"", content[2] & 1]
+                elif kind == 4:
+                    requests[rid][0] += content
+                elif kind == 5 and content:
+                    requests[rid][1] += content
+                elif kind == 5:
+                    params, body, keep = requests.pop(rid)
+                    args = (send, rid, pairs(params), body, number)
+                    if mpx:
+                        threading.Thread(target=respond, args=args, daemon=True).start()
+                    else:
+                        respond(*args)
+                        if not keep:
+                            return
+    except OSError:
+        pass
+    finally:
+        with lock:
+            counts["open"] -= 1
+        conn.close()
+
+while True:
+    conn, _ = listener.accept()
+    with lock:
+        counts["serial"] += 1
+        counts["open"] += 1
+        number = counts["serial"]
+    threading.Thread(target=serve, args=(conn, number), daemon=True).start()
+EOF
+
+mkdir -p "$ROOT_DIR/app"
+for script in info sleep stream status big hang stats; do
+    touch "$ROOT_DIR/app/$script.php"
+done
+BIG_MD5=$(python3 -c "import hashlib; print(hashlib.md5(bytes(range(256)) * 128 * 256).hexdigest())")
+
+write_config() {
+    cat > "$CONFIG_FILE" <<EOF
+edge_triggered $1;
+
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+    client_max_body_size 0;
+
+    location /app {
+        root $ROOT_DIR/app;
+        allow_methods GET POST;
+        cgi_ext .php;
+        fastcgi_pass unix:$SOCKET;
+        fastcgi_keepalive 2;
+    }
+
+    location /mpx {
+        root $ROOT_DIR/app;
+        allow_methods GET;
+        cgi_ext .php;
+        fastcgi_pass 127.0.0.1:$BACKEND_PORT;
+    }
+
+    location /stream {
+        root $ROOT_DIR/app;
+        allow_methods GET;
+        cgi_ext .php;
+        fastcgi_pass unix:$SOCKET;
+        fastcgi_keepalive 2;
+        cgi_buffering off;
+    }
+
+    location /slow {
+        root $ROOT_DIR/app;
+        allow_methods GET;
+        cgi_ext .php;
+        fastcgi_pass unix:$SOCKET;
+        fastcgi_keepalive 2;
+        cgi_timeout 1;
+    }
+
+    location /down {
+        root $ROOT_DIR/app;
+        allow_methods GET;
+        cgi_ext .php;
+        fastcgi_pass unix:$ROOT_DIR/missing.sock;
+    }
+
+    location /refused {
+        root $ROOT_DIR/app;
+        allow_methods GET;
+        cgi_ext .php;
+        fastcgi_pass 127.0.0.1:$((BACKEND_PORT + 1));
+    }
+}
+EOF
+}
+
+start() {
+    write_config "$1"
+    start_server_with_logging "$CONFIG_FILE"
+    sleep 1
+
+    if ! ps -p $SERVER_PID > /dev/null; then
+        echo -e "${RED}✗ Server failed to start${NC}"
+        cat "$TEST_LOG_FILE"
+        exit 1
+    fi
+}
+
+# Streamed: the head and first line leave before the backend is done.
+streamed() {
+    TIMES=$(curl -s -o "$ROOT_DIR/stream.out" -w "%{http_code} %{time_starttransfer} %{time_total}" --max-time 10 \
+        "http://127.0.0.1:$PORT/stream/stream.php")
+    check_result "200" "${TIMES%% *}" "Streamed response"
+    check_result "true" "$(echo "$TIMES" | awk '{ print ($2 < 1.0 && $3 >= 1.4) ? "true" : $2 "s/" $3 "s" }')" \
+        "First line before the backend is done"
+    check_result "$(printf 'first\nsecond\n' | md5sum)" "$(md5sum < "$ROOT_DIR/stream.out")" "Whole body"
+}
+
+multiplexed() {
+    fetch /mpx/info.php > /dev/null
+    RESULT=$(parallel 8 /mpx/sleep.php)
+    check_result "1" "${RESULT%% *}" "8 requests at once on one connection"
+    check_result "true" "$(echo "$RESULT" | awk '{ print ($2 < 2.0) ? "true" : $2 "s" }')" "Answered concurrently"
+}
+
+echo "========================================"
+echo "  FastCGI Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+pkill -f "$BACKEND" 2>/dev/null
+sleep 1
+python3 "$BACKEND" "$SOCKET" &
+python3 "$BACKEND" "$BACKEND_PORT" --mpx &
+start off
+
+echo "[Test 1] Request params"
+RESULT=$(fetch "/app/info.php?a=1&b=two")
+check_result "GET" "$(value method "$RESULT")" "REQUEST_METHOD"
+check_result "$ROOT_DIR/app/info.php" "$(value script "$RESULT")" "SCRIPT_FILENAME"
+check_result "a=1&b=two" "$(value query "$RESULT")" "QUERY_STRING"
+check_result "127.0.0.1:$PORT" "$(value host "$RESULT")" "Request headers as HTTP_ params"
+
+echo "[Test 2] Request body"
+head -c 1048576 /dev/urandom > "$ROOT_DIR/body.bin"
+RESULT=$(curl -s --max-time 10 --data-binary "@$ROOT_DIR/body.bin" "http://127.0.0.1:$PORT/app/info.php")
+check_result "POST 1048576" "$(value method "$RESULT") $(value length "$RESULT")" "CONTENT_LENGTH"
+check_result "$(md5sum < "$ROOT_DIR/body.bin" | cut -d' ' -f1)" "$(value md5 "$RESULT")" "Body passed as FCGI_STDIN"
+
+echo "[Test 3] Connection reuse"
+CONNS=$(for i in $(seq 10); do value conn "$(fetch /app/info.php)"; done | sort -u | wc -l)
+check_result "1" "$CONNS" "10 requests over one backend connection"
+
+echo "[Test 4] Concurrent requests"
+RESULT=$(parallel 4 /app/sleep.php)
+check_result "4" "${RESULT%% *}" "One connection each without multiplexing"
+check_result "true" "$(echo "$RESULT" | awk '{ print ($2 < 2.0) ? "true" : $2 "s" }')" "Answered concurrently"
+sleep 0.3
+check_result "2" "$(value open "$(fetch /app/stats.php)")" "fastcgi_keepalive 2 idle connections kept"
+multiplexed
+
+echo "[Test 5] Backend output"
+check_result "404" "$(status /app/status.php)" "Status header from the backend"
+check_result "1" "$(grep -c "FastCGI: warning from status.php" "$TEST_LOG_FILE")" "FCGI_STDERR logged"
+check_result "$BIG_MD5" "$(fetch /app/big.php | md5sum | cut -d' ' -f1)" "8 MB over many records"
+check_result "$BIG_MD5" "$(fetch /stream/big.php | md5sum | cut -d' ' -f1)" "8 MB streamed"
+streamed
+
+echo "[Test 6] Errors"
+check_result "502" "$(status /down/info.php)" "No socket at the path"
+check_result "502" "$(status /refused/info.php)" "Connection refused"
+START=$(date +%s)
+check_result "504" "$(status /slow/hang.php)" "cgi_timeout"
+ELAPSED=$(( $(date +%s) - START ))
+check_result "true" "$([ $ELAPSED -lt 3 ] && echo true || echo "${ELAPSED}s")" "Answered after cgi_timeout"
+check_result "200" "$(status /app/info.php)" "Backend usable afterwards"
+BEFORE=$(value conn "$(fetch /mpx/info.php)")
+fetch /mpx/sleep.php > "$ROOT_DIR/kept.out" &
+KEPT_PID=$!
+sleep 0.2
+curl -s -o /dev/null --max-time 0.3 "http://127.0.0.1:$PORT/mpx/sleep.php"
+wait $KEPT_PID
+check_result "$BEFORE $BEFORE" "$(value conn "$(cat "$ROOT_DIR/kept.out")") $(value conn "$(fetch /mpx/info.php)")" \
+    "Client gone: its request aborted, the rest of the connection kept"
+
+echo "[Test 7] Edge-triggered mode"
+kill -TERM $SERVER_PID
+sleep 1
+start on
+RESULT=$(curl -s --max-time 10 --data-binary "@$ROOT_DIR/body.bin" "http://127.0.0.1:$PORT/app/info.php")
+check_result "$(md5sum < "$ROOT_DIR/body.bin" | cut -d' ' -f1)" "$(value md5 "$RESULT")" "Body passed as FCGI_STDIN"
+streamed
+multiplexed
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
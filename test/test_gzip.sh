@@ -0,0 +1,273 @@
+#!/bin/bash
+
+# On-the-fly Compression Test Suite
+# Tests gzip / deflate of static files, autoindex pages and CGI output, gzip_types and
+# gzip_min_length, validators of compressed variants and the compression cache
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_gzip.conf"
+ROOT_DIR="/tmp/webserv_gzip_root"
+BASE_URL="http://127.0.0.1:8099"
+PYTHON=$(command -v python3)
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_gzip"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+check_same() {
+    if cmp -s "$1" "$2"; then
+        check_result "identical" "identical" "$3"
+    else
+        check_result "identical" "different" "$3"
+    fi
+}
+
+header_value() {
+    grep -i "^$1:" "$2" | head -1 | cut -d' ' -f2- | tr -d '\r'
+}
+
+# Prints the Content-Encoding of a GET with the given Accept-Encoding; headers and the raw
+# body are left in /tmp/webserv_gzip.hdr and /tmp/webserv_gzip.out
+encoding_of() {
+    local accept=$1
+    local url=$2
+    curl -s --max-time 5 -H "Accept-Encoding: $accept" -D /tmp/webserv_gzip.hdr -o /tmp/webserv_gzip.out "$url"
+    local encoding=$(header_value Content-Encoding /tmp/webserv_gzip.hdr)
+    echo "${encoding:-identity}"
+}
+
+# Decodes /tmp/webserv_gzip.out (gzip or zlib format) into the given file
+decode_body() {
+    "$PYTHON" -c "import sys, zlib; sys.stdout.buffer.write(zlib.decompress(open('/tmp/webserv_gzip.out', 'rb').read(), 47))" > "$1"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_gzip.hdr /tmp/webserv_gzip.out /tmp/webserv_gzip_*
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/text" "$ROOT_DIR/listing/sub" "$ROOT_DIR/cgi"
+for i in $(seq 1 300); do echo "<p>Paragraph $i of a page that compresses well</p>"; done > "$ROOT_DIR/text/page.html"
+for i in $(seq 1 200); do echo "line $i"; done > "$ROOT_DIR/text/notes.txt"
+echo "tiny" > "$ROOT_DIR/text/small.txt"
+head -c 20000 /dev/urandom > "$ROOT_DIR/text/data.bin"
+cp "$ROOT_DIR/text/page.html" "$ROOT_DIR/page.html"
+for i in $(seq 1 40); do touch "$ROOT_DIR/listing/file_with_a_long_name_$i.txt"; done
+
+cat > "$ROOT_DIR/cgi/text.py" <<'EOF'
+print("Content-Type: text/plain")
+print()
+for i in range(200):
+    print("cgi line %d" % i)
+EOF
+cat > "$ROOT_DIR/cgi/encoded.py" <<'EOF'
+import sys
+print("Content-Type: text/plain")
+print("Content-Encoding: identity")
+print()
+for i in range(200):
+    print("already encoded %d" % i)
+EOF
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8099;
+    root $ROOT_DIR;
+    gzip_cache_size 1048576;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+
+    location /text {
+        root $ROOT_DIR/text;
+        allow_methods GET HEAD;
+        gzip on;
+        gzip_types text/plain application/javascript;
+        gzip_min_length 100;
+        gzip_comp_level 6;
+    }
+
+    location /listing {
+        root $ROOT_DIR/listing;
+        allow_methods GET;
+        autoindex on;
+        gzip on;
+    }
+
+    location /cgi {
+        root $ROOT_DIR/cgi;
+        allow_methods GET;
+        cgi_path $PYTHON;
+        cgi_ext .py;
+        gzip on;
+        gzip_types text/plain;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  On-the-fly Compression Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Static files"
+check_result "gzip" "$(encoding_of "gzip, deflate" "$BASE_URL/text/page.html")" "gzip preferred"
+check_result "Accept-Encoding" "$(header_value Vary /tmp/webserv_gzip.hdr)" "Vary"
+check_result "" "$(header_value Accept-Ranges /tmp/webserv_gzip.hdr)" "No Accept-Ranges on the variant"
+check_result "$(wc -c < /tmp/webserv_gzip.out | tr -d ' ')" "$(header_value Content-Length /tmp/webserv_gzip.hdr)" \
+    "Content-Length of the compressed body"
+decode_body /tmp/webserv_gzip_decoded.out
+check_same "$ROOT_DIR/text/page.html" /tmp/webserv_gzip_decoded.out "gzip body decodes to the file"
+GZ_ETAG=$(header_value ETag /tmp/webserv_gzip.hdr)
+check_result "deflate" "$(encoding_of "deflate" "$BASE_URL/text/notes.txt")" "deflate"
+decode_body /tmp/webserv_gzip_decoded.out
+check_same "$ROOT_DIR/text/notes.txt" /tmp/webserv_gzip_decoded.out "deflate body decodes to the file"
+check_result "gzip" "$(encoding_of "deflate;q=0.5, gzip" "$BASE_URL/text/notes.txt")" "Higher q for gzip"
+check_result "identity" "$(encoding_of "gzip;q=0, deflate;q=0" "$BASE_URL/text/notes.txt")" "Both refused"
+
+echo "[Test 2] Identity responses"
+check_result "identity" "$(encoding_of "" "$BASE_URL/text/page.html")" "No Accept-Encoding"
+check_result "Accept-Encoding" "$(header_value Vary /tmp/webserv_gzip.hdr)" "Vary on the identity response"
+check_result "bytes" "$(header_value Accept-Ranges /tmp/webserv_gzip.hdr)" "Accept-Ranges kept"
+check_result "identity" "$(encoding_of "gzip" "$BASE_URL/text/small.txt")" "Below gzip_min_length"
+check_result "identity" "$(encoding_of "gzip" "$BASE_URL/text/data.bin")" "Type not in gzip_types"
+check_result "" "$(header_value Vary /tmp/webserv_gzip.hdr)" "No Vary for other types"
+check_result "identity" "$(encoding_of "gzip" "$BASE_URL/page.html")" "Location without gzip"
+CODE=$(curl -s --max-time 5 -r 0-9 -H "Accept-Encoding: gzip" -D /tmp/webserv_gzip_range.hdr \
+    -o /tmp/webserv_gzip_range.out -w "%{http_code}" "$BASE_URL/text/page.html")
+check_result "206 identity" "$CODE $(header_value Content-Encoding /tmp/webserv_gzip_range.hdr)identity" \
+    "Range requests are served from the file"
+curl -sI --max-time 5 -H "Accept-Encoding: gzip" "$BASE_URL/text/page.html" > /tmp/webserv_gzip_head.hdr
+curl -s --max-time 5 -H "Accept-Encoding: gzip" -D /tmp/webserv_gzip_get.hdr -o /dev/null "$BASE_URL/text/page.html"
+check_result "gzip $(header_value Content-Length /tmp/webserv_gzip_get.hdr)" \
+    "$(header_value Content-Encoding /tmp/webserv_gzip_head.hdr) $(header_value Content-Length /tmp/webserv_gzip_head.hdr)" \
+    "HEAD reports the headers of GET"
+curl -sI --max-time 5 "$BASE_URL/text/page.html" > /tmp/webserv_gzip_head.hdr
+check_result "$(wc -c < "$ROOT_DIR/text/page.html" | tr -d ' ')" \
+    "$(header_value Content-Length /tmp/webserv_gzip_head.hdr)" "HEAD without Accept-Encoding describes the file"
+
+echo "[Test 3] Validators"
+if echo "$GZ_ETAG" | grep -q '^W/"'; then
+    check_result "weak" "weak" "ETag $GZ_ETAG"
+else
+    check_result "weak" "$GZ_ETAG" "ETag"
+fi
+curl -s --max-time 5 -H "Accept-Encoding: gzip" -H "If-None-Match: $GZ_ETAG" \
+    -D /tmp/webserv_gzip_304.hdr -o /dev/null "$BASE_URL/text/page.html"
+check_result "304" "$(head -1 /tmp/webserv_gzip_304.hdr | cut -d' ' -f2)" "304 for the compressed variant"
+check_result "gzip" "$(header_value Content-Encoding /tmp/webserv_gzip_304.hdr)" "304 keeps Content-Encoding"
+
+echo "[Test 4] Compressed variants are cached and revalidated"
+for i in 1 2 3; do
+    encoding_of "gzip" "$BASE_URL/text/page.html" > /dev/null
+done
+decode_body /tmp/webserv_gzip_decoded.out
+check_same "$ROOT_DIR/text/page.html" /tmp/webserv_gzip_decoded.out "Cached variant decodes to the file"
+sleep 1
+echo "<p>edited</p>" >> "$ROOT_DIR/text/page.html"
+encoding_of "gzip" "$BASE_URL/text/page.html" > /dev/null
+decode_body /tmp/webserv_gzip_decoded.out
+check_same "$ROOT_DIR/text/page.html" /tmp/webserv_gzip_decoded.out "Edited file compressed again"
+
+echo "[Test 5] Autoindex pages"
+check_result "gzip" "$(encoding_of "gzip" "$BASE_URL/listing/")" "Listing compressed"
+decode_body /tmp/webserv_gzip_decoded.out
+check_result "40" "$(grep -c "file_with_a_long_name_" /tmp/webserv_gzip_decoded.out)" "Listing entries"
+check_result "identity" "$(encoding_of "" "$BASE_URL/listing/")" "Listing without Accept-Encoding"
+check_result "Accept-Encoding" "$(header_value Vary /tmp/webserv_gzip.hdr)" "Vary on the identity listing"
+
+echo "[Test 6] CGI output"
+check_result "gzip" "$(encoding_of "gzip" "$BASE_URL/cgi/text.py")" "CGI output compressed"
+decode_body /tmp/webserv_gzip_decoded.out
+check_result "cgi line 199" "$(tail -1 /tmp/webserv_gzip_decoded.out)" "CGI body decodes"
+check_result "$(wc -c < /tmp/webserv_gzip.out | tr -d ' ')" "$(header_value Content-Length /tmp/webserv_gzip.hdr)" \
+    "CGI Content-Length"
+check_result "identity" "$(encoding_of "gzip" "$BASE_URL/cgi/encoded.py")" "Script's own Content-Encoding kept"
+check_result "already encoded 199" "$(tail -1 /tmp/webserv_gzip.out)" "Script body untouched"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+STATS=$(grep "Compression cache 127.0.0.1:8099" "$TEST_LOG_FILE")
+HITS=$(echo "$STATS" | sed -E 's/.*: ([0-9]+) hits.*/\1/')
+[ -n "$HITS" ] && [ "$HITS" -ge 3 ] && RESULT="yes" || RESULT="no ($STATS)"
+check_result "yes" "$RESULT" "Cache hits counted"
+
+echo "[Test 7] Invalid gzip_comp_level rejected"
+for value in "0" "10" "fast"; do
+    cat > /tmp/webserv_gzip_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:8099;
+    root ./www;
+
+    location / {
+        gzip_comp_level $value;
+    }
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_gzip_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid gzip_comp_level"; then
+        check_result "rejected" "rejected" "gzip_comp_level $value"
+    else
+        check_result "rejected" "accepted" "gzip_comp_level $value"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,213 @@
+#!/bin/bash
+
+# Precompressed Static File Test Suite
+# Tests gzip_static: Accept-Encoding negotiation between .br and .gz siblings,
+# Content-Encoding / Vary headers, HEAD, validators and the static cache
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_gzip_static.conf"
+ROOT_DIR="/tmp/webserv_gzip_static_root"
+BASE_URL="http://127.0.0.1:8098"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_gzip_static"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+header_value() {
+    grep -i "^$1:" "$2" | head -1 | cut -d' ' -f2- | tr -d '\r'
+}
+
+# Prints "<Content-Encoding> <body>" for a request with the given Accept-Encoding
+fetch() {
+    local accept=$1
+    local url=$2
+    local body
+    if [ -n "$accept" ]; then
+        body=$(curl -s --max-time 5 -H "Accept-Encoding: $accept" -D /tmp/webserv_gzip_static.hdr "$url" | head -c 40)
+    else
+        body=$(curl -s --max-time 5 -D /tmp/webserv_gzip_static.hdr "$url" | head -c 40)
+    fi
+    local encoding=$(header_value Content-Encoding /tmp/webserv_gzip_static.hdr)
+    echo "${encoding:-identity} $body" | head -1
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_gzip_static*.hdr /tmp/webserv_gzip_static_*.out
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/assets" "$ROOT_DIR/plain"
+for i in $(seq 1 200); do echo "function f$i() { return $i; }"; done > "$ROOT_DIR/assets/app.js"
+gzip -9 -c "$ROOT_DIR/assets/app.js" > "$ROOT_DIR/assets/app.js.gz"
+printf 'BROTLI-PAYLOAD' > "$ROOT_DIR/assets/app.js.br"
+echo "body { margin: 0; }" > "$ROOT_DIR/assets/site.css"
+gzip -9 -c "$ROOT_DIR/assets/site.css" > "$ROOT_DIR/assets/site.css.gz"
+echo "no siblings" > "$ROOT_DIR/assets/raw.txt"
+cp "$ROOT_DIR/assets/app.js" "$ROOT_DIR/assets/app.js.br" "$ROOT_DIR/plain/"
+for name in first second; do
+    cp "$ROOT_DIR/assets/app.js" "$ROOT_DIR/assets/$name.js"
+    cp "$ROOT_DIR/assets/app.js.gz" "$ROOT_DIR/assets/$name.js.gz"
+done
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8098;
+    root $ROOT_DIR;
+    static_cache_size 1048576;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+
+    location /assets {
+        root $ROOT_DIR/assets;
+        allow_methods GET HEAD;
+        gzip_static on;
+    }
+
+    location /plain {
+        root $ROOT_DIR/plain;
+        allow_methods GET HEAD;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Precompressed Static File Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Negotiation"
+check_result "identity function f1() { return 1; }" "$(fetch "" "$BASE_URL/assets/app.js")" "No Accept-Encoding"
+check_result "Accept-Encoding" "$(header_value Vary /tmp/webserv_gzip_static.hdr)" "Vary on the identity response"
+check_result "br BROTLI-PAYLOAD" "$(fetch "gzip, deflate, br" "$BASE_URL/assets/app.js")" "br preferred"
+check_result "Accept-Encoding" "$(header_value Vary /tmp/webserv_gzip_static.hdr)" "Vary on the encoded response"
+check_result "application/javascript" "$(header_value Content-Type /tmp/webserv_gzip_static.hdr)" "Content-Type of the original"
+check_result "br BROTLI-PAYLOAD" "$(fetch "*" "$BASE_URL/assets/app.js")" "Wildcard"
+check_result "gzip" "$(fetch "br;q=0.5, gzip" "$BASE_URL/assets/app.js" | cut -d' ' -f1)" "Higher q for gzip"
+check_result "gzip" "$(fetch "x-gzip" "$BASE_URL/assets/app.js" | cut -d' ' -f1)" "x-gzip alias"
+check_result "identity" "$(fetch "gzip;q=0" "$BASE_URL/assets/app.js" | cut -d' ' -f1)" "gzip;q=0"
+check_result "identity" "$(fetch "deflate" "$BASE_URL/assets/app.js" | cut -d' ' -f1)" "Unsupported coding"
+check_result "gzip" "$(fetch "br, gzip" "$BASE_URL/assets/site.css" | cut -d' ' -f1)" "Only a .gz sibling"
+check_result "identity" "$(fetch "br, gzip" "$BASE_URL/assets/raw.txt" | cut -d' ' -f1)" "No sibling"
+
+echo "[Test 2] Body and length of the gzip variant"
+curl -s --max-time 5 -H "Accept-Encoding: gzip" -D /tmp/webserv_gzip_static_gz.hdr \
+    -o /tmp/webserv_gzip_static_gz.out "$BASE_URL/assets/app.js"
+if cmp -s "$ROOT_DIR/assets/app.js.gz" /tmp/webserv_gzip_static_gz.out; then
+    check_result "identical" "identical" "Precompressed bytes"
+else
+    check_result "identical" "different" "Precompressed bytes"
+fi
+check_result "$(wc -c < "$ROOT_DIR/assets/app.js.gz" | tr -d ' ')" \
+    "$(header_value Content-Length /tmp/webserv_gzip_static_gz.hdr)" "Content-Length"
+curl -s --max-time 5 --compressed -o /tmp/webserv_gzip_static_decoded.out "$BASE_URL/assets/site.css"
+if cmp -s "$ROOT_DIR/assets/site.css" /tmp/webserv_gzip_static_decoded.out; then
+    check_result "identical" "identical" "curl --compressed decodes to the original"
+else
+    check_result "identical" "different" "curl --compressed decodes to the original"
+fi
+
+echo "[Test 3] HEAD and validators"
+curl -sI --max-time 5 -H "Accept-Encoding: gzip" "$BASE_URL/assets/app.js" > /tmp/webserv_gzip_static_head.hdr
+check_result "gzip" "$(header_value Content-Encoding /tmp/webserv_gzip_static_head.hdr)" "HEAD Content-Encoding"
+check_result "$(header_value Content-Length /tmp/webserv_gzip_static_gz.hdr)" \
+    "$(header_value Content-Length /tmp/webserv_gzip_static_head.hdr)" "HEAD Content-Length"
+GZ_ETAG=$(header_value ETag /tmp/webserv_gzip_static_gz.hdr)
+curl -s --max-time 5 -D /tmp/webserv_gzip_static_id.hdr -o /dev/null "$BASE_URL/assets/app.js"
+ID_ETAG=$(header_value ETag /tmp/webserv_gzip_static_id.hdr)
+if [ -n "$GZ_ETAG" ] && [ "$GZ_ETAG" != "$ID_ETAG" ]; then
+    check_result "distinct" "distinct" "ETag per variant"
+else
+    check_result "distinct" "$GZ_ETAG / $ID_ETAG" "ETag per variant"
+fi
+CODE=$(curl -s --max-time 5 -o /dev/null -w "%{http_code}" -H "Accept-Encoding: gzip" \
+    -H "If-None-Match: $GZ_ETAG" "$BASE_URL/assets/app.js")
+check_result "304" "$CODE" "304 for the gzip variant"
+CODE=$(curl -s --max-time 5 -o /dev/null -w "%{http_code}" -H "If-None-Match: $GZ_ETAG" "$BASE_URL/assets/app.js")
+check_result "200" "$CODE" "gzip tag does not validate the identity variant"
+
+echo "[Test 4] Variants stay apart in the static cache"
+RESULTS=""
+for accept in "gzip" "" "br" "gzip" ""; do
+    RESULTS="$RESULTS$(fetch "$accept" "$BASE_URL/assets/app.js" | cut -d' ' -f1) "
+done
+check_result "gzip identity br gzip identity " "$RESULTS" "Alternating encodings"
+
+echo "[Test 5] Locations without gzip_static"
+check_result "identity function f1() { return 1; }" "$(fetch "br, gzip" "$BASE_URL/plain/app.js")" "Siblings ignored"
+check_result "" "$(header_value Vary /tmp/webserv_gzip_static.hdr)" "No Vary"
+
+# Prints "<Content-Type> <Content-Encoding>" of the last fetch
+last_headers() {
+    local encoding=$(header_value Content-Encoding /tmp/webserv_gzip_static.hdr)
+    echo "$(header_value Content-Type /tmp/webserv_gzip_static.hdr) ${encoding:-identity}"
+}
+
+echo "[Test 6] Sibling requested by name and negotiated, in both orders"
+fetch "" "$BASE_URL/assets/first.js.gz" > /dev/null
+fetch "gzip" "$BASE_URL/assets/first.js" > /dev/null
+check_result "application/javascript gzip" "$(last_headers)" "Negotiated after .gz by name"
+fetch "gzip" "$BASE_URL/assets/second.js" > /dev/null
+fetch "" "$BASE_URL/assets/second.js.gz" > /dev/null
+check_result "application/octet-stream identity" "$(last_headers)" ".gz by name after negotiated"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
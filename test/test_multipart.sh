@@ -0,0 +1,213 @@
+#!/bin/bash
+
+# Streaming Multipart Upload Test Suite
+# Tests several files in one multipart/form-data request, delimiters split over reads,
+# data that nearly matches the delimiter, malformed bodies leaving no files behind,
+# chunked multipart bodies and a large upload stored without buffering the body
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_multipart.conf"
+ROOT_DIR="/tmp/webserv_multipart_root"
+STORE="$ROOT_DIR/store"
+CLIENT="/tmp/webserv_multipart_client.py"
+PORT=8104
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_multipart"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# post <piece size> <chunked: 0|1> <part spec> [<part spec> ...] | --raw <body>
+# Builds a multipart body from "name=value" fields and "name@filename=content" files
+# (content with \r\n escapes), sends it in pieces of the given size and prints the status.
+post() {
+    python3 "$CLIENT" "$PORT" "$@"
+}
+
+stored() {
+    cat "$STORE/$1" 2>/dev/null
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$CLIENT"
+}
+
+trap cleanup EXIT
+
+cat > "$CLIENT" <<'EOF'
+import socket, sys, time
+
+BOUNDARY = "----TestBoundary7MA4YWxkTrZu0gW"
+port, piece, chunked = int(sys.argv[1]), int(sys.argv[2]), sys.argv[3] == "1"
+
+body = b""
+for spec in ([] if sys.argv[4] == "--raw" else sys.argv[4:]):
+    name, _, content = spec.partition("=")
+    content = content.encode().decode("unicode_escape").encode("latin-1")
+    if "@" in name:
+        name, filename = name.split("@", 1)
+        disposition = 'form-data; name="%s"; filename="%s"' % (name, filename)
+        body += b"--%s\r\nContent-Disposition: %s\r\nContent-Type: application/octet-stream\r\n\r\n" % (BOUNDARY.encode(), disposition.encode())
+    else:
+        body += b"--%s\r\nContent-Disposition: form-data; name=\"%s\"\r\n\r\n" % (BOUNDARY.encode(), name.encode())
+    body += content + b"\r\n"
+if sys.argv[4] == "--raw":
+    body = sys.argv[5].encode().decode("unicode_escape").encode("latin-1")
+else:
+    body += b"--%s--\r\n" % BOUNDARY.encode()
+
+head = "POST /store/ HTTP/1.1\r\nHost: localhost\r\nContent-Type: multipart/form-data; boundary=%s\r\n" % BOUNDARY
+if chunked:
+    head += "Transfer-Encoding: chunked\r\n\r\n"
+    framed = b""
+    for pos in range(0, len(body), 100):
+        framed += b"%x\r\n" % len(body[pos:pos + 100]) + body[pos:pos + 100] + b"\r\n"
+    body = framed + b"0\r\n\r\n"
+else:
+    head += "Content-Length: %d\r\n\r\n" % len(body)
+
+sock = socket.create_connection(("127.0.0.1", port))
+sock.sendall(head.encode())
+for pos in range(0, len(body), piece):
+    sock.sendall(body[pos:pos + piece])
+    if piece < len(body):
+        time.sleep(0.002)
+sock.settimeout(2)
+try:
+    print(sock.recv(65536).split(b" ")[1].decode())
+except (socket.timeout, IndexError):
+    print("none")
+EOF
+
+mkdir -p "$STORE" "$ROOT_DIR/files"
+head -c 3000 /dev/urandom > "$ROOT_DIR/files/one.bin"
+head -c 70000 /dev/urandom > "$ROOT_DIR/files/two.bin"
+printf 'plain text\r\nwith lines\r\n' > "$ROOT_DIR/files/three.txt"
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+    client_max_body_size 0;
+
+    location / {
+        allow_methods GET;
+    }
+
+    location /store {
+        root $STORE;
+        allow_methods GET POST;
+        upload_store $STORE;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Streaming Multipart Upload Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Several files in one request"
+RESPONSE=$(curl -s --max-time 5 -X POST "http://127.0.0.1:$PORT/store/" \
+    -F "note=not a file" -F "a=@$ROOT_DIR/files/one.bin" \
+    -F "b=@$ROOT_DIR/files/two.bin" -F "c=@$ROOT_DIR/files/three.txt")
+check_result "3" "$(echo "$RESPONSE" | grep -o "File uploaded" | wc -l)" "Every file listed"
+check_result "yes" "$(cmp -s "$ROOT_DIR/files/one.bin" "$STORE/one.bin" && echo yes)" "First file intact"
+check_result "yes" "$(cmp -s "$ROOT_DIR/files/two.bin" "$STORE/two.bin" && echo yes)" "Second file intact"
+check_result "yes" "$(cmp -s "$ROOT_DIR/files/three.txt" "$STORE/three.txt" && echo yes)" "Third file intact"
+check_result "3" "$(ls "$STORE" | wc -l)" "Form field not stored"
+check_result "true" "$(echo "$RESPONSE" | grep -q "Size: 70000 bytes" && echo true)" "Sizes reported"
+
+echo "[Test 2] Delimiters split over reads"
+check_result "201" "$(post 1 0 'x@bytewise.txt=first' 'y@bytewise2.txt=second')" "One byte per read"
+check_result "first|second" "$(stored bytewise.txt)|$(stored bytewise2.txt)" "Both parts stored"
+NEAR='a\r\n--\r\n------TestBoundary7MA4YWxkTrZu0g\r\n--x'
+check_result "201" "$(post 7 0 "z@near.txt=$NEAR")" "Data close to the delimiter"
+check_result "$(printf "$NEAR" | md5sum)" "$(stored near.txt | md5sum)" "Near misses kept as data"
+check_result "201" "$(post 1000 0 'e@empty.txt=')" "Empty file part"
+check_result "0" "$(stat -c %s "$STORE/empty.txt" 2>/dev/null)" "Empty file stored"
+check_result "201" "$(post 1000 0 'e@empty.txt=again')" "Name already taken"
+check_result "again" "$(stored empty_1.txt)" "Stored under a new name"
+
+echo "[Test 3] Malformed bodies"
+BEFORE=$(ls "$STORE" | wc -l)
+check_result "400" "$(post 1000 0 --raw '------TestBoundary7MA4YWxkTrZu0gW\r\nContent-Disposition: form-data; name="f"; filename="cut.txt"\r\n\r\nno close delimiter')" \
+    "Body ends inside a part"
+check_result "400" "$(post 1000 0 --raw "------TestBoundary7MA4YWxkTrZu0gW\\r\\nX-Long: $(head -c 9000 /dev/zero | tr '\0' a)\\r\\n\\r\\n")" \
+    "Part headers over 8 KB"
+check_result "400" "$(post 1000 0 --raw '------TestBoundary7MA4YWxkTrZu0gWjunk\r\n')" "Garbage after a delimiter"
+check_result "400" "$(post 1000 0 'only=a field')" "No file in the body"
+check_result "$BEFORE" "$(ls "$STORE" | wc -l)" "Nothing left behind"
+
+echo "[Test 4] Chunked multipart body"
+check_result "201" "$(post 50 1 'p@chunk1.txt=first file over chunks' 'q@chunk2.txt=second')" "Chunked upload"
+check_result "first file over chunks|second" "$(stored chunk1.txt)|$(stored chunk2.txt)" "Decoded and split"
+
+echo "[Test 5] Large upload"
+head -c $((64 * 1024 * 1024)) /dev/urandom > "$ROOT_DIR/files/large.bin"
+HWM_BEFORE=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+STATUS=$(curl -s -o /dev/null -w "%{http_code}" --max-time 30 -X POST "http://127.0.0.1:$PORT/store/" \
+    -F "big=@$ROOT_DIR/files/large.bin")
+HWM_AFTER=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+check_result "201" "$STATUS" "64 MB file"
+check_result "$(md5sum < "$ROOT_DIR/files/large.bin")" "$(md5sum < "$STORE/large.bin" 2>/dev/null)" "Stored intact"
+GROWTH=$(( (HWM_AFTER - HWM_BEFORE) / 1024 ))
+check_result "true" "$([ $GROWTH -lt 8 ] && echo true || echo "${GROWTH} MB")" "Peak memory grows by less than 8 MB"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
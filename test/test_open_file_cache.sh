@@ -0,0 +1,169 @@
+#!/bin/bash
+
+# Open File Cache Test Suite
+# Tests open_file_cache, open_file_cache_valid and open_file_cache_errors: cached
+# metadata and fds, revalidation after the TTL, error caching and CGI lookups
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_open_file_cache.conf"
+ROOT_DIR="/tmp/webserv_open_file_cache_root"
+BASE_URL="http://127.0.0.1:8095"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_open_file_cache"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_open_file_cache_*.out /tmp/webserv_open_file_cache_invalid.conf
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/cgi-bin" "$ROOT_DIR/dir"
+echo "<html><body>open file cache</body></html>" > "$ROOT_DIR/index.html"
+echo "<html><body>dir index</body></html>" > "$ROOT_DIR/dir/index.html"
+echo "short" > "$ROOT_DIR/page.txt"
+echo "old" > "$ROOT_DIR/renamed.txt"
+echo "doomed" > "$ROOT_DIR/doomed.txt"
+cat > "$ROOT_DIR/cgi-bin/hello.py" <<'EOF'
+import sys
+sys.stdout.write("Content-Type: text/plain\r\n\r\nhello from cgi\n")
+EOF
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8095;
+    root $ROOT_DIR;
+    index index.html;
+    open_file_cache max=64;
+    open_file_cache_valid 2;
+    open_file_cache_errors on;
+
+    location / {
+        allow_methods GET HEAD DELETE;
+    }
+
+    location /cgi-bin {
+        root $ROOT_DIR/cgi-bin;
+        allow_methods GET;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Open File Cache Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Files and directory indexes served through the cache"
+for i in 1 2; do
+    check_result "200" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/dir/)" "Directory index (pass $i)"
+done
+LENGTH=$(curl -sI --max-time 2 "$BASE_URL/page.txt" | grep -i "^Content-Length" | tr -d '\r' | awk '{print $2}')
+check_result "6" "$LENGTH" "HEAD Content-Length"
+
+echo "[Test 2] In-place edit keeps body and length consistent"
+echo "a considerably longer body" > "$ROOT_DIR/page.txt"
+check_result "a considerably longer body" "$(curl -s --max-time 2 $BASE_URL/page.txt)" "Edited body"
+
+echo "[Test 3] Replaced file picked up after open_file_cache_valid"
+curl -s -o /dev/null --max-time 2 $BASE_URL/renamed.txt
+echo "new" > "$ROOT_DIR/renamed.tmp"
+mv "$ROOT_DIR/renamed.tmp" "$ROOT_DIR/renamed.txt"
+sleep 3
+check_result "new" "$(curl -s --max-time 2 $BASE_URL/renamed.txt)" "After revalidation"
+
+echo "[Test 4] Errors cached until revalidation"
+check_result "404" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/later.txt)" "Missing file"
+echo "later" > "$ROOT_DIR/later.txt"
+check_result "404" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/later.txt)" "Cached 404"
+sleep 3
+check_result "200" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/later.txt)" "After revalidation"
+
+echo "[Test 5] DELETE drops the cached entry"
+curl -s -o /dev/null --max-time 2 $BASE_URL/doomed.txt
+check_result "200" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 -X DELETE $BASE_URL/doomed.txt)" "DELETE"
+check_result "404" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/doomed.txt)" "GET after DELETE"
+
+echo "[Test 6] CGI script and interpreter lookups"
+for i in 1 2; do
+    check_result "hello from cgi" "$(curl -s --max-time 5 $BASE_URL/cgi-bin/hello.py)" "CGI run $i"
+done
+
+kill -TERM $SERVER_PID
+sleep 1
+
+echo "[Test 7] Invalid open_file_cache directives rejected"
+for directive in "open_file_cache max=0" "open_file_cache on" "open_file_cache_valid 0"; do
+    cat > /tmp/webserv_open_file_cache_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:8095;
+    root ./www;
+    $directive;
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_open_file_cache_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid ${directive%% *}"; then
+        check_result "rejected" "rejected" "$directive"
+    else
+        check_result "rejected" "accepted" "$directive"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
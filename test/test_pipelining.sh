@@ -0,0 +1,223 @@
+#!/bin/bash
+
+# HTTP/1.1 Pipelining Test Suite
+# Tests several requests sent in one write, requests with bodies and requests split over
+# writes in a pipeline, response order, Connection: close inside a pipeline and pipeline_depth
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_pipelining.conf"
+ROOT_DIR="/tmp/webserv_pipelining_root"
+CLIENT="/tmp/webserv_pipelining_client.py"
+PORT=8100
+SINGLE_PORT=8101
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_pipelining"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# pipeline <port> <write> [<write> ...]
+# Sends each argument (with \r\n escapes) as one write, 0.2s apart, reads until the server
+# closes or goes quiet and prints "<status>:<first body line>" for every response.
+pipeline() {
+    python3 "$CLIENT" "$@"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$CLIENT" /tmp/webserv_pipelining_invalid.conf
+}
+
+trap cleanup EXIT
+
+cat > "$CLIENT" <<'EOF'
+import socket, sys, time
+
+sock = socket.create_connection(("127.0.0.1", int(sys.argv[1])))
+for i, chunk in enumerate(sys.argv[2:]):
+    if i > 0:
+        time.sleep(0.2)
+    sock.sendall(chunk.encode().decode("unicode_escape").encode("latin-1"))
+
+sock.settimeout(2)
+data = b""
+try:
+    while True:
+        part = sock.recv(65536)
+        if not part:
+            break
+        data += part
+except socket.timeout:
+    pass
+
+results = []
+while data:
+    head, _, rest = data.partition(b"\r\n\r\n")
+    lines = head.split(b"\r\n")
+    length = 0
+    for line in lines[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value)
+    body, data = rest[:length], rest[length:]
+    first = body.split(b"\n")[0].rstrip(b"\r").decode(errors="replace")[:20] if len(body) < 100 else "%d bytes" % len(body)
+    results.append("%s:%s" % (lines[0].split(b" ")[1].decode(), first))
+print(" ".join(results))
+EOF
+
+mkdir -p "$ROOT_DIR/upload"
+for i in 1 2 3 4 5 6 7 8 9 10; do echo "file $i" > "$ROOT_DIR/f$i.txt"; done
+head -c 300000 /dev/urandom > "$ROOT_DIR/big.bin"
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+    client_max_body_size 64;
+
+    location / {
+        allow_methods GET HEAD POST PUT;
+    }
+
+    location /upload {
+        root $ROOT_DIR/upload;
+        allow_methods GET PUT;
+        upload_store $ROOT_DIR/upload;
+    }
+}
+
+server {
+    listen 127.0.0.1:$SINGLE_PORT;
+    root $ROOT_DIR;
+    pipeline_depth 1;
+
+    location / {
+        allow_methods GET;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  HTTP/1.1 Pipelining Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+GET() {
+    printf 'GET %s HTTP/1.1\\r\\nHost: localhost\\r\\n%s\\r\\n' "$1" "$2"
+}
+
+echo "[Test 1] Ten requests in one write"
+REQUESTS=""
+EXPECTED=""
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    REQUESTS="$REQUESTS$(GET /f$i.txt)"
+    EXPECTED="${EXPECTED}200:file $i "
+done
+BEFORE=$(grep -c "Response sent" "$TEST_LOG_FILE")
+check_result "${EXPECTED% }" "$(pipeline $PORT "$REQUESTS")" "All answered in order"
+AFTER=$(grep -c "Response sent" "$TEST_LOG_FILE")
+check_result "1" "$((AFTER - BEFORE))" "Responses written as one batch"
+
+echo "[Test 2] Requests with bodies inside a pipeline"
+PUT='PUT /upload/put.txt HTTP/1.1\r\nHost: localhost\r\nContent-Length: 24\r\n\r\nGET /f9.txt HTTP/1.1\r\n\r\n'
+RESULT=$(pipeline $PORT "$(GET /f1.txt)$PUT$(GET /upload/put.txt)")
+check_result "200:file 1 201:<html><body><h1>Crea 200:GET /f9.txt HTTP/1.1" "$RESULT" "PUT body is not taken for a request"
+GET_BODY='GET /f2.txt HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello'
+check_result "200:file 2 200:file 3" "$(pipeline $PORT "$GET_BODY$(GET /f3.txt)")" "GET body skipped"
+check_result "200:file 4 200:file 5 200:file 6" \
+    "$(pipeline $PORT "$(GET /f4.txt)$(GET /f5.txt)$(GET /f6.txt)")" "No 413 from pipelined bytes"
+
+echo "[Test 3] Requests split over writes"
+check_result "200:file 1 200:file 2" "$(pipeline $PORT "$(GET /f1.txt)GET /f2" '.txt HTTP/1.1\r\nHost: local' 'host\r\n\r\n')" \
+    "Second request completed by later writes"
+check_result "200:file 7 200:file 8" "$(pipeline $PORT "$(GET /f7.txt)" "$(GET /f8.txt)")" "Request after the first response"
+
+echo "[Test 4] Files streamed with sendfile keep their place"
+check_result "200:file 1 200:300000 bytes 200:file 2" \
+    "$(pipeline $PORT "$(GET /f1.txt)$(GET /big.bin)$(GET /f2.txt)")" "Order around a large file"
+
+echo "[Test 5] Connection: close ends the pipeline"
+check_result "200:file 1 200:file 2" \
+    "$(pipeline $PORT "$(GET /f1.txt)$(GET /f2.txt 'Connection: close\r\n')$(GET /f3.txt)")" "Later requests dropped"
+
+echo "[Test 6] pipeline_depth 1"
+BEFORE=$(grep -c "Response sent" "$TEST_LOG_FILE")
+check_result "200:file 1 200:file 2 200:file 3" \
+    "$(pipeline $SINGLE_PORT "$(GET /f1.txt)$(GET /f2.txt)$(GET /f3.txt)")" "All answered"
+AFTER=$(grep -c "Response sent" "$TEST_LOG_FILE")
+check_result "3" "$((AFTER - BEFORE))" "One response per write"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+echo "[Test 7] Invalid pipeline_depth rejected"
+for value in "0" "2000" "many"; do
+    cat > /tmp/webserv_pipelining_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root ./www;
+    pipeline_depth $value;
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_pipelining_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid pipeline_depth"; then
+        check_result "rejected" "rejected" "pipeline_depth $value"
+    else
+        check_result "rejected" "accepted" "pipeline_depth $value"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,219 @@
+#!/bin/bash
+
+# Range Request Test Suite
+# Tests single and multipart byte ranges, suffix and open-ended ranges, If-Range,
+# 416 responses and ranges of files that are streamed with sendfile
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_range.conf"
+ROOT_DIR="/tmp/webserv_range_root"
+BASE_URL="http://127.0.0.1:8096"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_range"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+check_same() {
+    if cmp -s "$1" "$2"; then
+        check_result "identical" "identical" "$3"
+    else
+        check_result "identical" "different" "$3"
+    fi
+}
+
+header_value() {
+    grep -i "^$1:" "$2" | head -1 | cut -d' ' -f2- | tr -d '\r'
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_range_*.out /tmp/webserv_range_*.hdr
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR"
+head -c 10000 /dev/urandom > "$ROOT_DIR/small.bin"
+head -c 8388608 /dev/urandom > "$ROOT_DIR/big.bin"
+printf '0123456789abcdefghijklmnopqrstuvwxyz' > "$ROOT_DIR/alpha.txt"
+MTIME=$(date -u -r "$ROOT_DIR/big.bin" "+%a, %d %b %Y %H:%M:%S GMT")
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8096;
+    root $ROOT_DIR;
+    sendfile_threshold 65536;
+    static_cache_size 1048576;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Range Request Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Full responses advertise byte ranges"
+curl -s --max-time 5 -D /tmp/webserv_range_full.hdr -o /dev/null "$BASE_URL/small.bin"
+check_result "bytes" "$(header_value Accept-Ranges /tmp/webserv_range_full.hdr)" "Accept-Ranges on GET"
+curl -sI --max-time 5 "$BASE_URL/big.bin" > /tmp/webserv_range_head.hdr
+check_result "bytes" "$(header_value Accept-Ranges /tmp/webserv_range_head.hdr)" "Accept-Ranges on HEAD"
+
+echo "[Test 2] Single range of a small file"
+CODE=$(curl -s --max-time 5 -r 100-199 -D /tmp/webserv_range_single.hdr -o /tmp/webserv_range_single.out \
+    -w "%{http_code}" "$BASE_URL/small.bin")
+head -c 200 "$ROOT_DIR/small.bin" | tail -c 100 > /tmp/webserv_range_single_expected.out
+check_result "206" "$CODE" "Status"
+check_result "bytes 100-199/10000" "$(header_value Content-Range /tmp/webserv_range_single.hdr)" "Content-Range"
+check_same /tmp/webserv_range_single_expected.out /tmp/webserv_range_single.out "Range body"
+
+echo "[Test 3] Suffix and open-ended ranges"
+curl -s --max-time 5 -r -500 -o /tmp/webserv_range_suffix.out "$BASE_URL/small.bin"
+tail -c 500 "$ROOT_DIR/small.bin" > /tmp/webserv_range_suffix_expected.out
+check_same /tmp/webserv_range_suffix_expected.out /tmp/webserv_range_suffix.out "Last 500 bytes"
+curl -s --max-time 5 -r 9990- -o /tmp/webserv_range_open.out "$BASE_URL/small.bin"
+tail -c 10 "$ROOT_DIR/small.bin" > /tmp/webserv_range_open_expected.out
+check_same /tmp/webserv_range_open_expected.out /tmp/webserv_range_open.out "From 9990 to the end"
+check_result "0123456789abcdefghijklmnopqrstuvwxyz" \
+    "$(curl -s --max-time 5 -r 0-1000 "$BASE_URL/alpha.txt")" "End clamped to the file size"
+
+echo "[Test 4] Large range streamed with sendfile"
+CODE=$(curl -s --max-time 10 -r 1048576-5242879 -D /tmp/webserv_range_big.hdr -o /tmp/webserv_range_big.out \
+    -w "%{http_code}" "$BASE_URL/big.bin")
+dd if="$ROOT_DIR/big.bin" of=/tmp/webserv_range_big_expected.out bs=1048576 skip=1 count=4 2>/dev/null
+check_result "206" "$CODE" "Status"
+check_result "4194304" "$(header_value Content-Length /tmp/webserv_range_big.hdr)" "Content-Length"
+check_same /tmp/webserv_range_big_expected.out /tmp/webserv_range_big.out "4MB slice"
+
+echo "[Test 5] Multiple ranges as multipart/byteranges"
+curl -s --max-time 5 -r 0-3,10-12,-2 -D /tmp/webserv_range_multi.hdr -o /tmp/webserv_range_multi.out \
+    "$BASE_URL/alpha.txt"
+TYPE=$(header_value Content-Type /tmp/webserv_range_multi.hdr)
+BOUNDARY=${TYPE#*boundary=}
+check_result "multipart/byteranges" "${TYPE%%;*}" "Content-Type"
+check_result "$(header_value Content-Length /tmp/webserv_range_multi.hdr)" \
+    "$(wc -c < /tmp/webserv_range_multi.out | tr -d ' ')" "Content-Length matches the body"
+PARTS=$(grep -a "^Content-Range" /tmp/webserv_range_multi.out | tr -d '\r' | awk '{print $3}' | tr '\n' ' ')
+check_result "0-3/36 10-12/36 34-35/36 " "$PARTS" "Part ranges"
+BODIES=$(tr -d '\r' < /tmp/webserv_range_multi.out | grep -av -e "^--" -e "^Content-" -e "^$" | tr '\n' ' ')
+check_result "0123 abc yz " "$BODIES" "Part bodies"
+check_result "1" "$(grep -ac -- "^--$BOUNDARY--" /tmp/webserv_range_multi.out)" "Closing boundary"
+
+echo "[Test 6] Multiple ranges of a large file"
+curl -s --max-time 10 -r 0-1048575,7340032- -D /tmp/webserv_range_bigmulti.hdr \
+    -o /tmp/webserv_range_bigmulti.out "$BASE_URL/big.bin"
+FIRST=$(grep -ac "^Content-Range: bytes 0-1048575/8388608" /tmp/webserv_range_bigmulti.out)
+SECOND=$(grep -ac "^Content-Range: bytes 7340032-8388607/8388608" /tmp/webserv_range_bigmulti.out)
+check_result "1 1" "$FIRST $SECOND" "Both parts present"
+check_result "$(header_value Content-Length /tmp/webserv_range_bigmulti.hdr)" \
+    "$(wc -c < /tmp/webserv_range_bigmulti.out | tr -d ' ')" "Content-Length matches the body"
+
+echo "[Test 7] Unsatisfiable range"
+CODE=$(curl -s --max-time 5 -r 20000- -D /tmp/webserv_range_416.hdr -o /dev/null -w "%{http_code}" \
+    "$BASE_URL/small.bin")
+check_result "416" "$CODE" "Status"
+check_result "bytes */10000" "$(header_value Content-Range /tmp/webserv_range_416.hdr)" "Content-Range"
+
+echo "[Test 8] Malformed or foreign ranges are ignored"
+for range in "bytes=5-2" "bytes=abc" "items=0-1"; do
+    CODE=$(curl -s --max-time 5 -H "Range: $range" -o /dev/null -w "%{http_code}" "$BASE_URL/small.bin")
+    check_result "200" "$CODE" "Range: $range"
+done
+
+echo "[Test 9] If-Range"
+CODE=$(curl -s --max-time 5 -r 0-9 -H "If-Range: $MTIME" -o /dev/null -w "%{http_code}" "$BASE_URL/big.bin")
+check_result "206" "$CODE" "Matching date"
+CODE=$(curl -s --max-time 5 -r 0-9 -H "If-Range: Thu, 01 Jan 1970 00:00:00 GMT" -o /dev/null \
+    -w "%{http_code}" "$BASE_URL/small.bin")
+check_result "200" "$CODE" "Stale date"
+CODE=$(curl -s --max-time 5 -r 0-9 -H 'If-Range: "unknown"' -o /dev/null -w "%{http_code}" "$BASE_URL/small.bin")
+check_result "200" "$CODE" "Entity tag"
+
+echo "[Test 10] Keep-alive after range responses"
+BEFORE=$(grep -c "New connection" "$TEST_LOG_FILE")
+CODES=$(curl -s --max-time 10 -r 0-1,5-6 -o /dev/null -o /dev/null -o /dev/null -w "%{http_code}\n" \
+    "$BASE_URL/alpha.txt" "$BASE_URL/big.bin" "$BASE_URL/small.bin" | tr '\n' ' ')
+AFTER=$(grep -c "New connection" "$TEST_LOG_FILE")
+check_result "206 206 206 " "$CODES" "Three responses"
+check_result "1" "$((AFTER - BEFORE))" "Connections opened"
+
+echo "[Test 11] Full response still served from the static cache"
+curl -s --max-time 5 -o /tmp/webserv_range_cached.out "$BASE_URL/small.bin"
+check_same "$ROOT_DIR/small.bin" /tmp/webserv_range_cached.out "Full body after ranges"
+
+echo "[Test 12] Overlapping and adjacent ranges merged"
+CODE=$(curl -s --max-time 5 -r 0-3,2-5,6-8 -D /tmp/webserv_range_merged.hdr -o /tmp/webserv_range_merged.out \
+    -w "%{http_code}" "$BASE_URL/alpha.txt")
+check_result "206" "$CODE" "Status"
+check_result "bytes 0-8/36" "$(header_value Content-Range /tmp/webserv_range_merged.hdr)" "Single merged range"
+check_result "012345678" "$(cat /tmp/webserv_range_merged.out)" "Merged body"
+PARTS=$(curl -s --max-time 5 -r 30-35,10-12,0-3,11-14 "$BASE_URL/alpha.txt" | grep -a "^Content-Range" \
+    | tr -d '\r' | awk '{print $3}' | tr '\n' ' ')
+check_result "0-3/36 10-14/36 30-35/36 " "$PARTS" "Parts sorted and merged"
+REPEATED="0-"
+for i in $(seq 2 16); do REPEATED="$REPEATED,0-"; done
+CODE=$(curl -s --max-time 5 -H "Range: bytes=$REPEATED" -D /tmp/webserv_range_whole.hdr \
+    -o /tmp/webserv_range_whole.out -w "%{http_code}" "$BASE_URL/small.bin")
+check_result "200" "$CODE" "Ranges covering the file"
+check_same "$ROOT_DIR/small.bin" /tmp/webserv_range_whole.out "Whole file sent once"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,207 @@
+#!/bin/bash
+
+# Request Parser Test Suite
+# Tests request lines and headers split over many reads, tolerated line endings,
+# header names in any case, framing taken from the parsed headers, the header count limit,
+# Expect: 100-continue and malformed requests
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_parser.conf"
+ROOT_DIR="/tmp/webserv_parser_root"
+CLIENT="/tmp/webserv_parser_client.py"
+PORT=8102
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_request_parser"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# send <write> [<write> ...]
+# Sends each argument (with \r\n escapes) as one write, 0.1s apart, and prints
+# "<status>:<first body line>" for every response until the server closes or goes quiet.
+send() {
+    python3 "$CLIENT" "$PORT" "$@"
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" "$CLIENT"
+}
+
+trap cleanup EXIT
+
+cat > "$CLIENT" <<'EOF'
+import socket, sys, time
+
+sock = socket.create_connection(("127.0.0.1", int(sys.argv[1])))
+for i, chunk in enumerate(sys.argv[2:]):
+    if i > 0:
+        time.sleep(0.1)
+    sock.sendall(chunk.encode().decode("unicode_escape").encode("latin-1"))
+
+sock.settimeout(2)
+data = b""
+try:
+    while True:
+        part = sock.recv(65536)
+        if not part:
+            break
+        data += part
+except socket.timeout:
+    pass
+
+results = []
+while data:
+    head, _, rest = data.partition(b"\r\n\r\n")
+    lines = head.split(b"\r\n")
+    length = 0
+    for line in lines[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value)
+    body, data = rest[:length], rest[length:]
+    first = body.split(b"\n")[0].rstrip(b"\r").decode(errors="replace")[:20]
+    results.append("%s:%s" % (lines[0].split(b" ")[1].decode(), first))
+print(" ".join(results))
+EOF
+
+mkdir -p "$ROOT_DIR/upload"
+echo "file one" > "$ROOT_DIR/one.txt"
+echo "file two" > "$ROOT_DIR/two.txt"
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root $ROOT_DIR;
+
+    location / {
+        allow_methods GET HEAD POST PUT;
+    }
+
+    location /upload {
+        root $ROOT_DIR/upload;
+        allow_methods GET PUT;
+        upload_store $ROOT_DIR/upload;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Request Parser Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Requests split over many reads"
+check_result "200:file one" "$(send 'GE' 'T /one' '.txt HT' 'TP/1.1\r' '\nHo' 'st: localhost\r\n' '\r' '\n')" \
+    "Split inside every token"
+check_result "200:file one" "$(send 'GET /one.txt HTTP/1.1\r\nHost: localhost\r\nX-Long: ' \
+    'aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa' 'bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb' '\r\n\r\n')" \
+    "Header value over three reads"
+
+echo "[Test 2] Tolerated request forms"
+check_result "200:file one" "$(send 'GET /one.txt HTTP/1.1\nHost: localhost\n\n')" "Bare LF line endings"
+check_result "200:file one" "$(send '\r\n\r\nGET /one.txt HTTP/1.1\r\nHost: localhost\r\n\r\n')" "Empty lines before the request"
+check_result "200:file one" "$(send 'GET /one.txt?lang=en HTTP/1.1\r\nHost: localhost\r\n\r\n')" "Query string ignored for files"
+check_result "200:file one" "$(send 'GET /one.txt HTTP/1.1\r\nhOsT:   localhost   \r\n\r\n')" "Header name case and padding"
+
+echo "[Test 3] Framing from parsed headers"
+check_result "200:file one 200:file two" \
+    "$(send 'GET /one.txt HTTP/1.1\r\nHost: localhost\r\nX-Note: content-length: 99\r\n\r\nGET /two.txt HTTP/1.1\r\nHost: localhost\r\n\r\n')" \
+    "Header value mentioning content-length"
+check_result "201:<html><body><h1>Crea 200:abcde" \
+    "$(send 'PUT /upload/lower.txt HTTP/1.1\r\nHost: localhost\r\ncontent-LENGTH: 5\r\n\r\nabcdeGET /upload/lower.txt HTTP/1.1\r\nHost: localhost\r\n\r\n')" \
+    "Content-Length in any case"
+check_result "200:file one" \
+    "$(send 'GET /one.txt HTTP/1.1\r\nHost: localhost\r\nConnection: Keep-Alive, CLOSE\r\n\r\nGET /two.txt HTTP/1.1\r\nHost: localhost\r\n\r\n')" \
+    "Connection tokens in any case"
+check_result "206:ile" "$(send 'GET /one.txt HTTP/1.1\r\nHost: localhost\r\nrAnGe: bytes=1-3\r\n\r\n')" \
+    "Known header found in any case"
+
+echo "[Test 4] Header count limit"
+HEADERS=""
+for i in $(seq 1 99); do HEADERS="${HEADERS}X-H$i: $i\\r\\n"; done
+check_result "200:file one" "$(send "GET /one.txt HTTP/1.1\\r\\nHost: localhost\\r\\n$HEADERS\\r\\n")" "100 headers accepted"
+check_result "431:" "$(send "GET /one.txt HTTP/1.1\\r\\nHost: localhost\\r\\nX-Extra: 1\\r\\n$HEADERS\\r\\n" | cut -c1-4)" \
+    "101 headers rejected"
+
+echo "[Test 5] Expect: 100-continue"
+check_result "100: 201:<html><body><h1>Crea" \
+    "$(send 'PUT /upload/expect.txt HTTP/1.1\r\nHost: localhost\r\nExpect: 100-Continue\r\nContent-Length: 5\r\n\r\n' 'hello')" \
+    "Interim response before the body"
+check_result "201:<html><body><h1>Crea" \
+    "$(send 'PUT /upload/expect2.txt HTTP/1.1\r\nHost: localhost\r\nExpect: 100-continue\r\nContent-Length: 5\r\n\r\nhello')" \
+    "No interim response once the body is in"
+check_result "201:<html><body><h1>Crea" \
+    "$(send 'PUT /upload/expect3.txt HTTP/1.0\r\nHost: localhost\r\nExpect: 100-continue\r\nContent-Length: 5\r\n\r\n' 'hello')" \
+    "No interim response to HTTP/1.0"
+
+echo "[Test 6] Malformed requests"
+check_result "400:" "$(send 'GET /one.txt\r\nHost: localhost\r\n\r\n' | cut -c1-4)" "Missing version"
+check_result "400:" "$(send 'GET /one.txt HTTP/1\r\nHost: localhost\r\n\r\n' | cut -c1-4)" "Bad version"
+check_result "400:" "$(send 'GET /one.txt HTTP/1.1\r\nHost : localhost\r\n\r\n' | cut -c1-4)" "Space before colon"
+check_result "400:" "$(send 'GET /one.txt HTTP/1.1\r\nHost: localhost\r\nX-A: 1\r\n  folded\r\n\r\n' | cut -c1-4)" "Folded header line"
+check_result "400:" "$(send 'GET /one.txt HTTP/1.1\r\nHost: a\r\nHost: b\r\n\r\n' | cut -c1-4)" "Two Host headers"
+check_result "400:" "$(send 'PUT /upload/x.txt HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5x\r\n\r\nabcde' | cut -c1-4)" "Invalid Content-Length"
+check_result "400:" "$(send 'PUT /upload/x.txt HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\nabcdef' | cut -c1-4)" \
+    "Conflicting Content-Length"
+check_result "501:" "$(send 'PUT /upload/x.txt HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: gzip\r\n\r\n' | cut -c1-4)" \
+    "Unknown transfer coding"
+check_result "200:file one 400:" "$(send 'GET /one.txt HTTP/1.1\r\nHost: localhost\r\n\r\nGET /two.txt HTTP/1.1\r\nBad Header\r\n\r\n' | cut -c1-17)" \
+    "Malformed request after a good one"
+echo
+
+kill -TERM $SERVER_PID
+sleep 1
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
@@ -0,0 +1,155 @@
+#!/bin/bash
+
+# Static File Delivery Test Suite
+# Tests sendfile() streaming of large files, inline delivery below sendfile_threshold,
+# keep-alive after a streamed body and aborted downloads
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_sendfile.conf"
+ROOT_DIR="/tmp/webserv_sendfile_root"
+BASE_URL="http://127.0.0.1:8093"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_sendfile"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_sendfile_*.out /tmp/webserv_sendfile_invalid.conf
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR"
+echo "<html><body>sendfile</body></html>" > "$ROOT_DIR/index.html"
+head -c 1000 /dev/urandom > "$ROOT_DIR/small.bin"
+head -c 33554432 /dev/urandom > "$ROOT_DIR/big.bin"
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8093;
+    root $ROOT_DIR;
+    index index.html;
+    sendfile_threshold 4096;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Static File Delivery Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] File below the threshold is sent inline"
+curl -s --max-time 5 -o /tmp/webserv_sendfile_small.out "$BASE_URL/small.bin"
+if cmp -s "$ROOT_DIR/small.bin" /tmp/webserv_sendfile_small.out; then
+    check_result "identical" "identical" "1KB download"
+else
+    check_result "identical" "different" "1KB download"
+fi
+
+echo "[Test 2] Large file streamed with sendfile"
+curl -s --max-time 20 -o /tmp/webserv_sendfile_big.out "$BASE_URL/big.bin"
+if cmp -s "$ROOT_DIR/big.bin" /tmp/webserv_sendfile_big.out; then
+    check_result "identical" "identical" "32MB download"
+else
+    check_result "identical" "different" "32MB download"
+fi
+
+echo "[Test 3] Content-Length and HEAD for a streamed file"
+LENGTH=$(curl -sI --max-time 5 "$BASE_URL/big.bin" | grep -i "^Content-Length" | tr -d '\r' | awk '{print $2}')
+check_result "33554432" "$LENGTH" "HEAD Content-Length"
+
+echo "[Test 4] Keep-alive after a streamed body"
+BEFORE=$(grep -c "New connection" "$TEST_LOG_FILE")
+CODES=$(curl -s --max-time 20 -o /dev/null -o /dev/null -o /dev/null -w "%{http_code}\n" \
+    "$BASE_URL/big.bin" "$BASE_URL/small.bin" "$BASE_URL/big.bin" | tr '\n' ' ')
+AFTER=$(grep -c "New connection" "$TEST_LOG_FILE")
+check_result "200 200 200 " "$CODES" "Three responses"
+check_result "1" "$((AFTER - BEFORE))" "Connections opened"
+
+echo "[Test 5] Aborted download does not affect the server"
+curl -s --max-time 1 --limit-rate 100k -o /dev/null "$BASE_URL/big.bin"
+sleep 0.5
+check_result "200" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/)" "Request after abort"
+
+echo "[Test 6] Missing file"
+check_result "404" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/missing.bin)" "Missing file"
+
+kill -TERM $SERVER_PID
+sleep 1
+
+echo "[Test 7] Invalid sendfile_threshold rejected"
+for value in "abc" "-1" "10k"; do
+    cat > /tmp/webserv_sendfile_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:8093;
+    root ./www;
+    sendfile_threshold $value;
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_sendfile_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid sendfile_threshold"; then
+        check_result "rejected" "rejected" "sendfile_threshold $value"
+    else
+        check_result "rejected" "accepted" "sendfile_threshold $value"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
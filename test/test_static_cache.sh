@@ -0,0 +1,192 @@
+#!/bin/bash
+
+# Static Cache Test Suite
+# Tests the per-server LRU response cache: hits, inotify invalidation on edit, rename
+# and delete, eviction under the byte budget and shared bodies across clients
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_static_cache.conf"
+ROOT_DIR="/tmp/webserv_static_cache_root"
+BASE_URL="http://127.0.0.1:8094"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_static_cache"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -rf "$CONFIG_FILE" "$ROOT_DIR" /tmp/webserv_static_cache_*.out /tmp/webserv_static_cache_invalid.conf
+}
+
+trap cleanup EXIT
+
+mkdir -p "$ROOT_DIR/sub"
+echo "<html><body>cache</body></html>" > "$ROOT_DIR/index.html"
+echo "version 1" > "$ROOT_DIR/page.txt"
+echo "nested 1" > "$ROOT_DIR/sub/nested.txt"
+head -c 60000 /dev/urandom > "$ROOT_DIR/shared.bin"
+head -c 200000 /dev/urandom > "$ROOT_DIR/large.bin"
+mkdir -p "$ROOT_DIR/big"
+head -c 200000 /dev/urandom > "$ROOT_DIR/big/large.bin"
+for i in 1 2 3 4 5 6; do
+    head -c 30000 /dev/urandom > "$ROOT_DIR/fill$i.bin"
+done
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8094;
+    root $ROOT_DIR;
+    index index.html;
+    static_cache_size 131072;
+    static_cache_max_entry 65536;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Static Cache Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Repeated requests served from the cache"
+check_result "version 1" "$(curl -s --max-time 2 $BASE_URL/page.txt)" "First request"
+check_result "version 1" "$(curl -s --max-time 2 $BASE_URL/page.txt)" "Cached request"
+
+echo "[Test 2] Edited file visible immediately"
+echo "version 2" > "$ROOT_DIR/page.txt"
+check_result "version 2" "$(curl -s --max-time 2 $BASE_URL/page.txt)" "After in-place edit"
+
+echo "[Test 3] File replaced by rename"
+curl -s -o /dev/null --max-time 2 $BASE_URL/sub/nested.txt
+echo "nested 2" > "$ROOT_DIR/sub/nested.tmp"
+mv "$ROOT_DIR/sub/nested.tmp" "$ROOT_DIR/sub/nested.txt"
+check_result "nested 2" "$(curl -s --max-time 2 $BASE_URL/sub/nested.txt)" "After rename"
+
+echo "[Test 4] Deleted file no longer served"
+rm "$ROOT_DIR/page.txt"
+check_result "404" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 $BASE_URL/page.txt)" "After delete"
+
+echo "[Test 5] Cached body shared by concurrent clients"
+CURL_PIDS=""
+for i in $(seq 1 8); do
+    curl -s --max-time 10 -o /tmp/webserv_static_cache_$i.out "$BASE_URL/shared.bin" &
+    CURL_PIDS="$CURL_PIDS $!"
+done
+wait $CURL_PIDS
+INTACT=0
+for i in $(seq 1 8); do
+    cmp -s "$ROOT_DIR/shared.bin" /tmp/webserv_static_cache_$i.out && INTACT=$((INTACT + 1))
+done
+check_result "8" "$INTACT" "Intact downloads out of 8"
+
+echo "[Test 6] Files above static_cache_max_entry bypass the cache"
+curl -s --max-time 5 -o /tmp/webserv_static_cache_large.out "$BASE_URL/large.bin"
+curl -s --max-time 5 -o /tmp/webserv_static_cache_large.out "$BASE_URL/large.bin"
+if cmp -s "$ROOT_DIR/large.bin" /tmp/webserv_static_cache_large.out; then
+    check_result "identical" "identical" "200KB download"
+else
+    check_result "identical" "different" "200KB download"
+fi
+
+echo "[Test 7] Byte budget enforced by LRU eviction"
+for i in 1 2 3 4 5 6; do
+    curl -s --max-time 2 -o /tmp/webserv_static_cache_fill.out "$BASE_URL/fill$i.bin"
+done
+cmp -s "$ROOT_DIR/fill6.bin" /tmp/webserv_static_cache_fill.out && RESULT="identical" || RESULT="different"
+check_result "identical" "$RESULT" "Last filler download"
+
+echo "[Test 8] Only directories with cached files are watched, once each"
+curl -s --max-time 5 -o /dev/null "$BASE_URL/big/large.bin"
+curl -s --max-time 5 -o /dev/null "$BASE_URL/big/large.bin"
+curl -s --max-time 2 -o /dev/null "$BASE_URL/fill6.bin"
+WATCHES=$(cat /proc/$SERVER_PID/fdinfo/* 2>/dev/null | grep -c "^inotify wd:")
+check_result "1" "$WATCHES" "inotify watches (document root only)"
+
+kill -TERM $SERVER_PID
+sleep 1
+
+STATS=$(grep "Static cache 127.0.0.1:8094" "$TEST_LOG_FILE")
+HITS=$(echo "$STATS" | sed -E 's/.*: ([0-9]+) hits.*/\1/')
+EVICTIONS=$(echo "$STATS" | sed -E 's/.* ([0-9]+) evictions.*/\1/')
+INVALIDATIONS=$(echo "$STATS" | sed -E 's/.* ([0-9]+) invalidations.*/\1/')
+[ -n "$HITS" ] && [ "$HITS" -ge 8 ] && RESULT="yes" || RESULT="no ($STATS)"
+check_result "yes" "$RESULT" "Hits counted"
+[ -n "$EVICTIONS" ] && [ "$EVICTIONS" -ge 1 ] && RESULT="yes" || RESULT="no ($STATS)"
+check_result "yes" "$RESULT" "Evictions counted"
+[ -n "$INVALIDATIONS" ] && [ "$INVALIDATIONS" -ge 3 ] && RESULT="yes" || RESULT="no ($STATS)"
+check_result "yes" "$RESULT" "Invalidations counted"
+
+echo "[Test 9] Invalid cache sizes rejected"
+for directive in "static_cache_size abc" "static_cache_max_entry -5"; do
+    cat > /tmp/webserv_static_cache_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:8094;
+    root ./www;
+    $directive;
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_static_cache_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid ${directive%% *}"; then
+        check_result "rejected" "rejected" "$directive"
+    else
+        check_result "rejected" "accepted" "$directive"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
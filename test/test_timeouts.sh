@@ -0,0 +1,185 @@
+#!/bin/bash
+
+# Timeout Test Suite
+# Tests client_header_timeout, client_body_timeout, keepalive_timeout, send_timeout
+# and per-location cgi_timeout (driven by the per-worker timer wheel)
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+CONFIG_FILE="/tmp/webserv_timeouts.conf"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_timeouts"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -f "$CONFIG_FILE" /tmp/webserv_timeouts_invalid.conf
+}
+
+trap cleanup EXIT
+
+# Opens a connection, sends the given chunks with a delay between them and prints
+# "closed N" (whole seconds until the server closed it) or "open" after a limit.
+# Usage: probe <initial_payload> <drip_payload> <drip_interval> <limit_seconds>
+probe() {
+    python3 - "$1" "$2" "$3" "$4" <<'EOF'
+import socket, sys, time
+payload, drip, interval, limit = sys.argv[1], sys.argv[2], float(sys.argv[3]), float(sys.argv[4])
+s = socket.create_connection(("127.0.0.1", 8092))
+start = time.time()
+if payload:
+    s.sendall(payload.encode().decode("unicode_escape").encode())
+s.settimeout(interval if drip else limit)
+while time.time() - start < limit:
+    try:
+        data = s.recv(65536)
+        if not data:
+            print("closed %d" % int(time.time() - start))
+            sys.exit(0)
+    except socket.timeout:
+        if drip:
+            try:
+                s.sendall(drip.encode())
+            except OSError:
+                print("closed %d" % int(time.time() - start))
+                sys.exit(0)
+    except OSError:
+        print("closed %d" % int(time.time() - start))
+        sys.exit(0)
+print("open")
+EOF
+}
+
+cat > "$CONFIG_FILE" <<EOF
+server {
+    listen 127.0.0.1:8092;
+    root ./www;
+    index index.html;
+    client_header_timeout 2;
+    client_body_timeout 2s;
+    keepalive_timeout 1;
+    send_timeout 5;
+
+    location / {
+        allow_methods GET POST;
+    }
+
+    location /cgi-bin {
+        root ./www/cgi-bin;
+        allow_methods GET POST;
+        cgi_path /usr/bin/python3;
+        cgi_ext .py;
+        cgi_timeout 2;
+    }
+}
+EOF
+
+echo "========================================"
+echo "  Timeout Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+start_server_with_logging "$CONFIG_FILE"
+sleep 1
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1] Idle connection closed by client_header_timeout"
+check_result "closed 2" "$(probe "" "" 1 6)" "Silent connection"
+
+echo "[Test 2] Slowloris header is not kept alive by trickling bytes"
+check_result "closed 2" "$(probe "GET / HTTP/1.1\r\nHost: x\r\n" "X" 0.3 6)" "Trickled header"
+
+echo "[Test 3] Stalled body closed by client_body_timeout"
+check_result "closed 2" "$(probe "POST / HTTP/1.1\r\nHost: x\r\nContent-Length: 100\r\n\r\n0123456789" "" 1 6)" "Stalled body"
+
+echo "[Test 4] Idle keep-alive connection closed by keepalive_timeout"
+check_result "closed 1" "$(probe "GET / HTTP/1.1\r\nHost: x\r\n\r\n" "" 0.5 6)" "Keep-alive idle"
+
+echo "[Test 5] Keep-alive still works within the timeout"
+CODES=$(curl -s -o /dev/null -o /dev/null -w "%{http_code}\n" --max-time 5 http://127.0.0.1:8092/ http://127.0.0.1:8092/ | tr '\n' ' ')
+check_result "200 200 " "$CODES" "Two requests on one connection"
+
+echo "[Test 6] CGI killed by per-location cgi_timeout"
+START=$(date +%s)
+CODE=$(curl -s -o /dev/null -w "%{http_code}" --max-time 10 http://127.0.0.1:8092/cgi-bin/infinite.py)
+ELAPSED=$(( $(date +%s) - START ))
+check_result "504" "$CODE" "CGI timeout status"
+if [ $ELAPSED -ge 2 ] && [ $ELAPSED -le 4 ]; then
+    check_result "2-4s" "2-4s" "CGI timeout after ${ELAPSED}s"
+else
+    check_result "2-4s" "${ELAPSED}s" "CGI timeout delay"
+fi
+
+echo "[Test 7] Server still responsive"
+check_result "200" "$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 http://127.0.0.1:8092/)" "Final request"
+
+kill -TERM $SERVER_PID
+sleep 1
+
+echo "[Test 8] Invalid timeout values rejected"
+for directive in "client_header_timeout 0" "send_timeout abc" "keepalive_timeout -1"; do
+    cat > /tmp/webserv_timeouts_invalid.conf <<EOF
+server {
+    listen 127.0.0.1:8092;
+    root ./www;
+    $directive;
+}
+EOF
+    OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_timeouts_invalid.conf 2>&1)
+    if echo "$OUTPUT" | grep -qi "invalid ${directive%% *}"; then
+        check_result "rejected" "rejected" "$directive"
+    else
+        check_result "rejected" "accepted" "$directive"
+    fi
+done
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi
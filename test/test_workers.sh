@@ -0,0 +1,236 @@
+#!/bin/bash
+
+# Multi-Worker Test Suite
+# Tests the worker_threads multi-reactor mode (SO_REUSEPORT listeners per worker)
+# and the worker_processes pre-fork mode with crash supervision
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+WEBSERV_BIN="$PROJECT_DIR/webserv"
+THREADS_CONFIG="/tmp/webserv_workers_threads.conf"
+PROCESSES_CONFIG="/tmp/webserv_workers_processes.conf"
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+# Source logging helper
+source "$SCRIPT_DIR/test_logging_helper.sh"
+
+# Setup logging for this test
+setup_test_logging "test_workers"
+
+check_result() {
+    local expected=$1
+    local actual=$2
+    local test_name=$3
+
+    if [ "$expected" = "$actual" ]; then
+        echo -e "${GREEN}✓${NC} $test_name: $actual"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}✗${NC} $test_name: expected $expected, got $actual"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+cleanup() {
+    pkill -9 webserv 2>/dev/null
+    rm -f "$THREADS_CONFIG" "$PROCESSES_CONFIG" /tmp/webserv_workers_invalid.conf
+}
+
+trap cleanup EXIT
+
+write_config() {
+    local file=$1
+    local directives=$2
+    cat > "$file" <<EOF
+$directives
+
+server {
+    listen 127.0.0.1:8090;
+    root ./www;
+    index index.html;
+
+    location / {
+        allow_methods GET HEAD;
+    }
+}
+EOF
+}
+
+# Sends N sequential requests and prints how many returned 200
+count_ok() {
+    local count=$1
+    local ok=0
+    for i in $(seq 1 $count); do
+        code=$(curl -s -o /dev/null -w "%{http_code}" --max-time 2 http://127.0.0.1:8090/ 2>/dev/null)
+        [ "$code" = "200" ] && ok=$((ok + 1))
+    done
+    echo $ok
+}
+
+echo "========================================"
+echo "  Multi-Worker Test Suite"
+echo "========================================"
+echo
+echo -e "${YELLOW}Server output log: $TEST_LOG_FILE${NC}\n"
+
+cd "$PROJECT_DIR"
+pkill -9 webserv 2>/dev/null
+sleep 1
+
+# ==================== SECTION 1: Worker threads ====================
+echo "========================================"
+echo "SECTION 1: worker_threads"
+echo "========================================"
+
+write_config "$THREADS_CONFIG" "worker_threads 4;
+worker_cpu_affinity on;"
+start_server_with_logging "$THREADS_CONFIG"
+sleep 2
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 1.1] Four workers initialized"
+WORKERS=$(grep -c "Initialized 1 server(s) for worker" "$TEST_LOG_FILE")
+check_result "4" "$WORKERS" "Workers initialized"
+
+echo "[Test 1.2] Sequential requests served"
+check_result "50" "$(count_ok 50)" "Successful responses out of 50"
+
+echo "[Test 1.3] Concurrent requests served"
+CURL_PIDS=""
+for i in $(seq 1 40); do
+    curl -s -o /dev/null -w "%{http_code}\n" --max-time 5 http://127.0.0.1:8090/ &
+    CURL_PIDS="$CURL_PIDS $!"
+done > /tmp/webserv_workers_concurrent.txt
+wait $CURL_PIDS
+CONCURRENT_OK=$(grep -c "200" /tmp/webserv_workers_concurrent.txt)
+rm -f /tmp/webserv_workers_concurrent.txt
+check_result "40" "$CONCURRENT_OK" "Concurrent successful responses out of 40"
+
+echo "[Test 1.4] Graceful shutdown reports per-worker stats"
+kill -TERM $SERVER_PID
+sleep 0.5
+check_result "stopped" "$(ps -p $SERVER_PID > /dev/null && echo running || echo stopped)" \
+    "Idle workers woken at once, not at their epoll timeout"
+sleep 1.5
+STATS_LINES=$(grep -c "^Worker [0-9]*: " "$TEST_LOG_FILE")
+check_result "4" "$STATS_LINES" "Worker stats lines"
+echo
+
+# ==================== SECTION 2: Worker processes ====================
+echo "========================================"
+echo "SECTION 2: worker_processes"
+echo "========================================"
+
+write_config "$PROCESSES_CONFIG" "worker_processes 3;"
+start_server_with_logging "$PROCESSES_CONFIG"
+sleep 2
+
+if ! ps -p $SERVER_PID > /dev/null; then
+    echo -e "${RED}✗ Server failed to start${NC}"
+    cat "$TEST_LOG_FILE"
+    exit 1
+fi
+
+echo "[Test 2.1] Master forks three workers"
+WORKER_PIDS=$(pgrep -P $SERVER_PID -x webserv | wc -l)
+check_result "3" "$WORKER_PIDS" "Worker processes running"
+
+echo "[Test 2.2] Requests served by the worker pool"
+check_result "30" "$(count_ok 30)" "Successful responses out of 30"
+
+echo "[Test 2.3] Crashed worker is replaced"
+VICTIM=$(pgrep -P $SERVER_PID -x webserv | head -1)
+kill -9 $VICTIM
+sleep 0.5
+WORKER_PIDS=$(pgrep -P $SERVER_PID -x webserv | wc -l)
+check_result "3" "$WORKER_PIDS" "Worker processes after crash"
+if pgrep -P $SERVER_PID -x webserv | grep -qx "$VICTIM"; then
+    echo -e "${RED}✗${NC} Killed worker $VICTIM still listed"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+else
+    echo -e "${GREEN}✓${NC} Killed worker $VICTIM replaced"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+fi
+check_result "30" "$(count_ok 30)" "Successful responses after crash"
+
+echo "[Test 2.4] Throttled respawn does not hold up the master"
+sleep 1.2
+kill -9 $(pgrep -P $SERVER_PID -x webserv | sort -n | head -1)
+sleep 0.2
+kill -9 $(pgrep -P $SERVER_PID -x webserv | sort -n | tail -1)
+sleep 0.1
+kill -9 $(pgrep -P $SERVER_PID -x webserv | sort -n | head -1)
+sleep 0.3
+check_result "2" "$(pgrep -P $SERVER_PID -x webserv | wc -l)" "Other dead worker replaced while one waits"
+sleep 1.5
+check_result "3" "$(pgrep -P $SERVER_PID -x webserv | wc -l)" "Throttled slot filled after the delay"
+
+echo "[Test 2.5] Master stops all workers on SIGTERM"
+kill -TERM $SERVER_PID
+sleep 2
+REMAINING=$(pgrep -x webserv | wc -l)
+check_result "0" "$REMAINING" "Processes left after shutdown"
+echo
+
+# ==================== SECTION 3: Invalid values ====================
+echo "========================================"
+echo "SECTION 3: Invalid worker counts"
+echo "========================================"
+
+write_config /tmp/webserv_workers_invalid.conf "worker_threads 0;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_workers_invalid.conf 2>&1)
+if echo "$OUTPUT" | grep -qi "invalid worker_threads"; then
+    echo -e "${GREEN}✓${NC} worker_threads 0 rejected"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo -e "${RED}✗${NC} worker_threads 0 not rejected"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+
+write_config /tmp/webserv_workers_invalid.conf "worker_processes 2abc;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_workers_invalid.conf 2>&1)
+if echo "$OUTPUT" | grep -qi "invalid worker_processes 2abc"; then
+    echo -e "${GREEN}✓${NC} worker_processes 2abc rejected"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo -e "${RED}✗${NC} worker_processes 2abc not rejected"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+
+write_config /tmp/webserv_workers_invalid.conf "worker_processes 2;
+worker_threads 2;"
+OUTPUT=$(timeout 2 $WEBSERV_BIN /tmp/webserv_workers_invalid.conf 2>&1)
+if echo "$OUTPUT" | grep -qi "cannot both be greater than 1"; then
+    echo -e "${GREEN}✓${NC} Mixed process and thread workers rejected"
+    TESTS_PASSED=$((TESTS_PASSED + 1))
+else
+    echo -e "${RED}✗${NC} Mixed process and thread workers not rejected"
+    TESTS_FAILED=$((TESTS_FAILED + 1))
+fi
+echo
+
+# ==================== Summary ====================
+echo "========================================"
+echo "  Test Summary"
+echo "========================================"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All tests passed! ✓${NC}"
+    exit 0
+else
+    echo -e "${RED}Some tests failed ✗${NC}"
+    exit 1
+fi